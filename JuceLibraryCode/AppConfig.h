@@ -33,11 +33,14 @@
 
 //#define  JUCE_USE_COREIMAGE_LOADER
 #define    JUCE_USE_DIRECTWRITE 1
+//#define  JUCE_USE_HARFBUZZ
+#define    JUCE_USE_GLYPH_ALPHA_ATLAS 1
 
 //==============================================================================
 // juce_gui_basics flags:
 
 //#define  JUCE_ENABLE_REPAINT_DEBUGGING
+//#define  JUCE_ENABLE_REPAINT_STATISTICS
 //#define  JUCE_USE_XSHM
 //#define  JUCE_USE_XRENDER
 //#define  JUCE_USE_XCURSOR
@@ -308,6 +308,9 @@ BEGIN_JUCE_NAMESPACE
 #ifndef __JUCE_IDENTIFIER_JUCEHEADER__
  #include "text/juce_Identifier.h"
 #endif
+#ifndef __JUCE_INDEXEDSTRING_JUCEHEADER__
+ #include "text/juce_IndexedString.h"
+#endif
 #ifndef __JUCE_LOCALISEDSTRINGS_JUCEHEADER__
  #include "text/juce_LocalisedStrings.h"
 #endif
@@ -386,6 +389,9 @@ BEGIN_JUCE_NAMESPACE
 #ifndef __JUCE_XMLELEMENT_JUCEHEADER__
  #include "xml/juce_XmlElement.h"
 #endif
+#ifndef __JUCE_XMLSTREAMREADER_JUCEHEADER__
+ #include "xml/juce_XmlStreamReader.h"
+#endif
 #ifndef __JUCE_GZIPCOMPRESSOROUTPUTSTREAM_JUCEHEADER__
  #include "zip/juce_GZIPCompressorOutputStream.h"
 #endif
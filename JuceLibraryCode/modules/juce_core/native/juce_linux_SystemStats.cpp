@@ -54,8 +54,17 @@ namespace LinuxStatsHelpers
 {
     String getCpuInfo (const char* const key)
     {
+        // files in /proc report a size of zero, so File::readLines() would find nothing
+        // here - this just reads until there's no more data instead
+        MemoryOutputStream text;
+        FileInputStream in (File ("/proc/cpuinfo"));
+        char buffer [4096];
+
+        for (int numRead; (numRead = in.read (buffer, (int) sizeof (buffer))) > 0;)
+            text.write (buffer, (size_t) numRead);
+
         StringArray lines;
-        File ("/proc/cpuinfo").readLines (lines);
+        lines.addLines (text.toString());
 
         for (int i = lines.size(); --i >= 0;) // (NB - it's important that this runs in reverse order)
             if (lines[i].startsWithIgnoreCase (key))
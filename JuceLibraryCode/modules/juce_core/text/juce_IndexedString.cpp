@@ -0,0 +1,141 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library - "Jules' Utility Class Extensions"
+   Copyright 2004-11 by Raw Material Software Ltd.
+
+  ------------------------------------------------------------------------------
+
+   JUCE can be redistributed and/or modified under the terms of the GNU General
+   Public License (Version 2), as published by the Free Software Foundation.
+   A copy of the license is included in the JUCE distribution, or can be found
+   online at www.gnu.org/licenses.
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.rawmaterialsoftware.com/juce for more information.
+
+  ==============================================================================
+*/
+
+
+BEGIN_JUCE_NAMESPACE
+
+//==============================================================================
+IndexedString::IndexedString (const String& text_)
+    : text (text_), numChars (0)
+{
+    const String::CharPointerType start (text.getCharPointer());
+    String::CharPointerType t (start);
+
+    for (;;)
+    {
+        if ((numChars & ((1 << offsetSpacingBits) - 1)) == 0)
+            offsets.add ((int) (t.getAddress() - start.getAddress()));
+
+        if (t.isEmpty())
+            break;
+
+        ++t;
+        ++numChars;
+    }
+}
+
+IndexedString::~IndexedString()
+{
+}
+
+//==============================================================================
+String::CharPointerType IndexedString::getCharPointer (int characterIndex) const noexcept
+{
+    jassert (isPositiveAndNotGreaterThan (characterIndex, numChars));
+    characterIndex = jlimit (0, numChars, characterIndex);
+
+    String::CharPointerType t (text.getCharPointer().getAddress()
+                                 + offsets.getUnchecked (characterIndex >> offsetSpacingBits));
+
+    t += (characterIndex & ((1 << offsetSpacingBits) - 1));
+    return t;
+}
+
+juce_wchar IndexedString::operator[] (const int characterIndex) const noexcept
+{
+    return isPositiveAndBelow (characterIndex, numChars) ? *getCharPointer (characterIndex) : 0;
+}
+
+String IndexedString::substring (int startIndex, int endIndex) const
+{
+    if (startIndex < 0)
+        startIndex = 0;
+
+    if (endIndex > numChars)
+        endIndex = numChars;
+
+    if (endIndex <= startIndex)
+        return String::empty;
+
+    if (startIndex == 0 && endIndex == numChars)
+        return text;
+
+    return String (getCharPointer (startIndex), getCharPointer (endIndex));
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class IndexedStringTests  : public UnitTest
+{
+public:
+    IndexedStringTests() : UnitTest ("IndexedString") {}
+
+    static String createRandomString (Random& r, const int length)
+    {
+        HeapBlock<juce_wchar> buffer;
+        buffer.calloc ((size_t) length + 1);
+
+        for (int i = 0; i < length; ++i)
+            buffer[i] = (juce_wchar) (r.nextBool() ? 1 + r.nextInt (0x7f)
+                                                   : 0x80 + r.nextInt (0xd000));
+
+        return CharPointer_UTF32 (buffer);
+    }
+
+    void runTest()
+    {
+        beginTest ("Character access");
+
+        Random r;
+
+        for (int i = 0; i < 20; ++i)
+        {
+            const String s (createRandomString (r, r.nextInt (300)));
+            const IndexedString indexed (s);
+
+            expectEquals (indexed.length(), s.length());
+            expect (*indexed.getCharPointer (indexed.length()) == 0);
+
+            for (int j = 0; j < s.length(); ++j)
+                expect (indexed[j] == s[j]);
+
+            expect (indexed[-1] == 0 && indexed [s.length()] == 0);
+
+            for (int j = 0; j < 50; ++j)
+            {
+                const int start = r.nextInt (s.length() + 10) - 5;
+                const int end   = r.nextInt (s.length() + 10) - 5;
+                expectEquals (indexed.substring (start, end), s.substring (start, end));
+            }
+        }
+    }
+};
+
+static IndexedStringTests indexedStringUnitTests;
+
+#endif
+
+END_JUCE_NAMESPACE
@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library - "Jules' Utility Class Extensions"
+   Copyright 2004-11 by Raw Material Software Ltd.
+
+  ------------------------------------------------------------------------------
+
+   JUCE can be redistributed and/or modified under the terms of the GNU General
+   Public License (Version 2), as published by the Free Software Foundation.
+   A copy of the license is included in the JUCE distribution, or can be found
+   online at www.gnu.org/licenses.
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.rawmaterialsoftware.com/juce for more information.
+
+  ==============================================================================
+*/
+
+
+#ifndef __JUCE_INDEXEDSTRING_JUCEHEADER__
+#define __JUCE_INDEXEDSTRING_JUCEHEADER__
+
+#include "juce_String.h"
+#include "../containers/juce_Array.h"
+
+
+//==============================================================================
+/**
+    A String, along with an index that gives quick access to any of its characters.
+
+    Strings are stored in a variable-length encoding, so finding the character at a
+    particular index means scanning all the characters that come before it. This makes
+    something like String::substring() slow when it's used to pick out lots of pieces of a
+    long string. An IndexedString scans the string once when it's created, remembering
+    where every few characters begin, so that any character can then be found with only a
+    short scan from the nearest of these.
+
+    @see String
+*/
+class JUCE_API  IndexedString
+{
+public:
+    //==============================================================================
+    /** Creates an index of the given string. */
+    explicit IndexedString (const String& text);
+
+    /** Destructor. */
+    ~IndexedString();
+
+    //==============================================================================
+    /** Returns the string that this object indexes. */
+    const String& getString() const noexcept                { return text; }
+
+    /** Returns the number of characters in the string. */
+    int length() const noexcept                             { return numChars; }
+
+    /** Returns a pointer to the character at the given index.
+        The index can be anywhere from 0 to length(), where length() will return a
+        pointer to the string's null terminator.
+    */
+    String::CharPointerType getCharPointer (int characterIndex) const noexcept;
+
+    /** Returns the character at the given index.
+        If the index is out of range, this will return 0.
+    */
+    juce_wchar operator[] (int characterIndex) const noexcept;
+
+    /** Returns a section of the string.
+        This behaves in the same way as String::substring(), but doesn't need to scan
+        the string to find the start and end of the section.
+    */
+    String substring (int startIndex, int endIndex) const;
+
+private:
+    //==============================================================================
+    String text;
+    int numChars;
+    Array<int> offsets; // the position of every (1 << offsetSpacingBits)th character, in units of CharType
+
+    enum { offsetSpacingBits = 5 };
+
+    JUCE_LEAK_DETECTOR (IndexedString);
+};
+
+
+#endif   // __JUCE_INDEXEDSTRING_JUCEHEADER__
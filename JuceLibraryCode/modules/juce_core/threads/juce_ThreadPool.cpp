@@ -30,8 +30,8 @@ ThreadPoolJob::ThreadPoolJob (const String& name)
     : jobName (name),
       pool (nullptr),
       shouldStop (false),
-      isActive (false),
-      shouldBeDeleted (false)
+      shouldBeDeleted (false),
+      indexInPool (-1)
 {
 }
 
@@ -65,7 +65,10 @@ public:
     ThreadPoolThread (ThreadPool& pool_)
         : Thread ("Pool"),
           pool (pool_),
-          busy (false)
+          busy (false),
+          queueSize (0),
+          queueStart (0),
+          numInQueue (0)
     {
     }
 
@@ -73,30 +76,183 @@ public:
     {
         while (! threadShouldExit())
         {
-            if (! pool.runNextJob())
-                wait (500);
+            if (! pool.runNextJob (*this))
+            {
+                if (pool.workStealing)
+                    waitForMoreJobs();
+                else
+                    wait (500);
+            }
+        }
+    }
+
+    //==============================================================================
+    // In work-stealing mode, each thread takes jobs from the back of its own queue,
+    // and other threads that have run out of work steal them from the front.
+    void addToQueue (ThreadPoolJob* const job, const bool atFront)
+    {
+        const SpinLock::ScopedLockType sl (queueLock);
+
+        if (numInQueue == queueSize)
+        {
+            const int newSize = jmax (16, queueSize * 2);
+            HeapBlock<ThreadPoolJob*> newQueue ((size_t) newSize);
+
+            for (int i = 0; i < numInQueue; ++i)
+                newQueue[i] = queue [(queueStart + i) & (queueSize - 1)];
+
+            queue.swapWith (newQueue);
+            queueSize = newSize;
+            queueStart = 0;
+        }
+
+        if (atFront)
+        {
+            queueStart = (queueStart - 1) & (queueSize - 1);
+            queue [queueStart] = job;
+        }
+        else
+        {
+            queue [(queueStart + numInQueue) & (queueSize - 1)] = job;
+        }
+
+        ++numInQueue;
+        ++(pool.numQueuedJobs);
+    }
+
+    ThreadPoolJob* takeFromQueue (const bool fromFront)
+    {
+        const SpinLock::ScopedLockType sl (queueLock);
+
+        if (numInQueue == 0)
+            return nullptr;
+
+        ThreadPoolJob* job;
+        --numInQueue;
+
+        if (fromFront)
+        {
+            job = queue [queueStart];
+            queueStart = (queueStart + 1) & (queueSize - 1);
+        }
+        else
+        {
+            job = queue [(queueStart + numInQueue) & (queueSize - 1)];
+        }
+
+        // This is set while the queue is still locked, so that a job which is in the pool but
+        // isn't active is always in one of the queues.
+        job->isActive = 1;
+        --(pool.numQueuedJobs);
+        return job;
+    }
+
+    bool removeFromQueue (ThreadPoolJob* const job)
+    {
+        const SpinLock::ScopedLockType sl (queueLock);
+
+        for (int i = 0; i < numInQueue; ++i)
+        {
+            if (queue [(queueStart + i) & (queueSize - 1)] == job)
+            {
+                removeQueueItem (i);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void removeFromQueue (JobSelector* const selector, Array<ThreadPoolJob*>& removedJobs)
+    {
+        const SpinLock::ScopedLockType sl (queueLock);
+
+        for (int i = numInQueue; --i >= 0;)
+        {
+            ThreadPoolJob* const job = queue [(queueStart + i) & (queueSize - 1)];
+
+            if (selector == nullptr || selector->isJobSuitable (job))
+            {
+                removeQueueItem (i);
+                removedJobs.add (job);
+            }
         }
     }
 
+    bool wakeUpIfSleeping()
+    {
+        if (isSleeping.compareAndSetBool (0, 1))
+        {
+            notify();
+            return true;
+        }
+
+        return false;
+    }
+
 private:
     ThreadPool& pool;
     bool volatile busy;
 
+    SpinLock queueLock;
+    HeapBlock<ThreadPoolJob*> queue;
+    int queueSize, queueStart, numInQueue;
+    Atomic<int> isSleeping;
+
+    void removeQueueItem (const int index)
+    {
+        for (int i = index + 1; i < numInQueue; ++i)
+            queue [(queueStart + i - 1) & (queueSize - 1)] = queue [(queueStart + i) & (queueSize - 1)];
+
+        --numInQueue;
+        --(pool.numQueuedJobs);
+    }
+
+    void waitForMoreJobs()
+    {
+        // The flag has to be set before checking for jobs, so that a job which gets
+        // added after the check will always find this thread asleep and wake it up.
+        isSleeping = 1;
+
+        if (pool.numQueuedJobs.get() == 0 && ! threadShouldExit())
+            wait (-1);
+
+        isSleeping = 0;
+    }
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ThreadPoolThread);
 };
 
+//==============================================================================
+/*  In work-stealing mode, the jobs that are in the pool are split between several of these
+    lists, so that threads which are adding and finishing jobs at the same time don't all have
+    to go through one lock. A job's list is chosen from its address, so contains() can find it
+    without touching the job itself, which may already have been deleted.
+*/
+struct ThreadPool::JobListShard
+{
+    CriticalSection lock;
+    Array <ThreadPoolJob*> jobs;
+};
+
 //==============================================================================
 ThreadPool::ThreadPool (const int numThreads,
                         const bool startThreadsOnlyWhenNeeded,
-                        const int stopThreadsWhenNotUsedTimeoutMs)
+                        const int stopThreadsWhenNotUsedTimeoutMs,
+                        const bool useWorkStealing)
     : threadStopTimeout (stopThreadsWhenNotUsedTimeoutMs),
-      priority (5)
+      priority (5),
+      workStealing (useWorkStealing)
 {
     jassert (numThreads > 0); // not much point having one of these with no threads in it.
 
     for (int i = jmax (1, numThreads); --i >= 0;)
         threads.add (new ThreadPoolThread (*this));
 
+    if (workStealing)
+        for (int i = 0; i < numJobListShards; ++i)
+            jobListShards.add (new JobListShard());
+
     if (! startThreadsOnlyWhenNeeded)
         for (int i = threads.size(); --i >= 0;)
             threads.getUnchecked(i)->startThread (priority);
@@ -123,11 +279,17 @@ void ThreadPool::addJob (ThreadPoolJob* const job)
     {
         job->pool = this;
         job->shouldStop = false;
-        job->isActive = false;
+        job->isActive = 0;
+
+        if (workStealing)
+        {
+            addJobToQueue (job);
+            return;
+        }
 
         {
             const ScopedLock sl (lock);
-            jobs.add (job);
+            addToJobList (job);
 
             int numRunning = 0;
 
@@ -163,27 +325,175 @@ void ThreadPool::addJob (ThreadPoolJob* const job)
     }
 }
 
+void ThreadPool::addJobToQueue (ThreadPoolJob* const job)
+{
+    // (the job has to be in the list before it's queued, so that the thread which runs it will find it there)
+    {
+        const ScopedLock sl (getLockFor (job));
+        addToJobList (job);
+    }
+
+    // A job that's added by one of the pool's own jobs goes onto the queue of the thread
+    // that's running it; others are shared out between the threads in turn.
+    ThreadPoolThread* thread = dynamic_cast <ThreadPoolThread*> (Thread::getCurrentThread());
+
+    if (thread == nullptr || ! threads.contains (thread))
+        thread = threads.getUnchecked ((int) ((uint32) (++nextQueueIndex) % (uint32) threads.size()));
+
+    thread->addToQueue (job, false);
+
+    if (thread->wakeUpIfSleeping())
+        return;
+
+    for (int i = 0; i < threads.size(); ++i)
+        if (threads.getUnchecked(i)->wakeUpIfSleeping())
+            return;
+
+    // If all the running threads are busy, start another one (which will steal the job).
+    for (int i = 0; i < threads.size(); ++i)
+    {
+        if (! threads.getUnchecked(i)->isThreadRunning())
+        {
+            threads.getUnchecked(i)->startThread (priority);
+            return;
+        }
+    }
+}
+
+ThreadPoolJob* ThreadPool::takeQueuedJob (ThreadPoolThread& thread)
+{
+    ThreadPoolJob* job = thread.takeFromQueue (false);
+
+    if (job == nullptr && numQueuedJobs.get() > 0)
+    {
+        const int index = threads.indexOf (&thread);
+
+        for (int i = 1; i < threads.size() && job == nullptr; ++i)
+            job = threads.getUnchecked ((index + i) % threads.size())->takeFromQueue (true);
+    }
+
+    return job;
+}
+
+bool ThreadPool::removeQueuedJob (ThreadPoolJob* const job)
+{
+    for (int i = threads.size(); --i >= 0;)
+        if (threads.getUnchecked(i)->removeFromQueue (job))
+            return true;
+
+    return false;
+}
+
+ThreadPool::JobListShard& ThreadPool::getShardFor (const ThreadPoolJob* const job) const noexcept
+{
+    // (the low bits of an object's address are mostly the same, so the high bits of a hash are used)
+    const uint32 hash = (uint32) (((pointer_sized_uint) job) >> 4) * 2654435761u;
+    return *jobListShards.getUnchecked ((int) (hash >> 28) & (numJobListShards - 1));
+}
+
+const CriticalSection& ThreadPool::getLockFor (const ThreadPoolJob* const job) const noexcept
+{
+    return workStealing ? getShardFor (job).lock : lock;
+}
+
+const Array <ThreadPoolJob*>& ThreadPool::getJobListFor (const ThreadPoolJob* const job) const noexcept
+{
+    return workStealing ? getShardFor (job).jobs : jobs;
+}
+
+// These must only be called with the lock for the job held.
+void ThreadPool::addToJobList (ThreadPoolJob* const job)
+{
+    if (workStealing)
+    {
+        Array <ThreadPoolJob*>& list = getShardFor (job).jobs;
+        job->indexInPool = list.size();
+        list.add (job);
+        ++numJobs;
+    }
+    else
+    {
+        jobs.add (job);
+    }
+}
+
+void ThreadPool::removeFromJobList (ThreadPoolJob* const job)
+{
+    if (workStealing)
+    {
+        // The order of the list doesn't matter in this mode, so the gap can be filled by the last job.
+        jassert (isInJobList (job));
+        Array <ThreadPoolJob*>& list = getShardFor (job).jobs;
+        ThreadPoolJob* const lastJob = list.getLast();
+        lastJob->indexInPool = job->indexInPool;
+        list.set (job->indexInPool, lastJob);
+        list.removeLast();
+        --numJobs;
+    }
+    else
+    {
+        jobs.removeValue (job);
+    }
+}
+
+bool ThreadPool::isInJobList (ThreadPoolJob* const job) const
+{
+    if (workStealing)
+        return getShardFor (job).jobs [job->indexInPool] == job;
+
+    return jobs.contains (job);
+}
+
+bool ThreadPool::hasFinishedWith (const ThreadPoolJob* const job) const
+{
+    const ScopedLock sl (getLockFor (job));
+    return job->pool != this;
+}
+
 int ThreadPool::getNumJobs() const
 {
-    return jobs.size();
+    return workStealing ? numJobs.get() : jobs.size();
+}
+
+int ThreadPool::getNumThreads() const noexcept
+{
+    return threads.size();
 }
 
-ThreadPoolJob* ThreadPool::getJob (const int index) const
+ThreadPoolJob* ThreadPool::getJob (int index) const
 {
+    if (workStealing)
+    {
+        for (int i = 0; i < jobListShards.size() && index >= 0; ++i)
+        {
+            const JobListShard& shard = *jobListShards.getUnchecked (i);
+            const ScopedLock sl (shard.lock);
+
+            if (index < shard.jobs.size())
+                return shard.jobs.getUnchecked (index);
+
+            index -= shard.jobs.size();
+        }
+
+        return nullptr;
+    }
+
     const ScopedLock sl (lock);
     return jobs [index];
 }
 
+// (these can't use the jobs' indexInPool values like isInJobList() does, because the caller
+// may be asking about a job that has already finished and been deleted)
 bool ThreadPool::contains (const ThreadPoolJob* const job) const
 {
-    const ScopedLock sl (lock);
-    return jobs.contains (const_cast <ThreadPoolJob*> (job));
+    const ScopedLock sl (getLockFor (job));
+    return getJobListFor (job).contains (const_cast <ThreadPoolJob*> (job));
 }
 
 bool ThreadPool::isJobRunning (const ThreadPoolJob* const job) const
 {
-    const ScopedLock sl (lock);
-    return jobs.contains (const_cast <ThreadPoolJob*> (job)) && job->isActive;
+    const ScopedLock sl (getLockFor (job));
+    return getJobListFor (job).contains (const_cast <ThreadPoolJob*> (job)) && job->isActive.get() != 0;
 }
 
 bool ThreadPool::waitForJobToFinish (const ThreadPoolJob* const job,
@@ -213,11 +523,13 @@ bool ThreadPool::removeJob (ThreadPoolJob* const job,
 
     if (job != nullptr)
     {
-        const ScopedLock sl (lock);
+        const ScopedLock sl (getLockFor (job));
 
-        if (jobs.contains (job))
+        if (getJobListFor (job).contains (job))
         {
-            if (job->isActive)
+            // In work-stealing mode, a job that isn't active is in one of the threads' queues,
+            // unless a thread has just taken it, in which case it's about to be run.
+            if (job->isActive.get() != 0 || (workStealing && ! removeQueuedJob (job)))
             {
                 if (interruptIfRunning)
                     job->signalJobShouldExit();
@@ -226,7 +538,7 @@ bool ThreadPool::removeJob (ThreadPoolJob* const job,
             }
             else
             {
-                jobs.removeValue (job);
+                removeFromJobList (job);
                 job->pool = nullptr;
             }
         }
@@ -242,6 +554,48 @@ bool ThreadPool::removeAllJobs (const bool interruptRunningJobs,
 {
     Array <ThreadPoolJob*> jobsToWaitFor;
 
+    if (workStealing)
+    {
+        Array <ThreadPoolJob*> queuedJobs;
+
+        for (int i = threads.size(); --i >= 0;)
+            threads.getUnchecked(i)->removeFromQueue (selectedJobsToRemove, queuedJobs);
+
+        for (int i = queuedJobs.size(); --i >= 0;)
+        {
+            ThreadPoolJob* const job = queuedJobs.getUnchecked(i);
+
+            {
+                const ScopedLock sl (getLockFor (job));
+                removeFromJobList (job);
+                job->pool = nullptr;
+            }
+
+            if (deleteInactiveJobs)
+                delete job;
+        }
+
+        // Any jobs that are left must have been taken by a thread
+        for (int i = jobListShards.size(); --i >= 0;)
+        {
+            const JobListShard& shard = *jobListShards.getUnchecked (i);
+            const ScopedLock sl (shard.lock);
+
+            for (int j = shard.jobs.size(); --j >= 0;)
+            {
+                ThreadPoolJob* const job = shard.jobs.getUnchecked (j);
+
+                if (selectedJobsToRemove == nullptr || selectedJobsToRemove->isJobSuitable (job))
+                {
+                    jobsToWaitFor.add (job);
+
+                    if (interruptRunningJobs)
+                        job->signalJobShouldExit();
+                }
+            }
+        }
+    }
+    else
     {
         const ScopedLock sl (lock);
 
@@ -251,7 +605,7 @@ bool ThreadPool::removeAllJobs (const bool interruptRunningJobs,
 
             if (selectedJobsToRemove == nullptr || selectedJobsToRemove->isJobSuitable (job))
             {
-                if (job->isActive)
+                if (job->isActive.get() != 0)
                 {
                     jobsToWaitFor.add (job);
 
@@ -294,18 +648,35 @@ bool ThreadPool::removeAllJobs (const bool interruptRunningJobs,
 StringArray ThreadPool::getNamesOfAllJobs (const bool onlyReturnActiveJobs) const
 {
     StringArray s;
-    const ScopedLock sl (lock);
 
-    for (int i = 0; i < jobs.size(); ++i)
+    if (workStealing)
+    {
+        for (int i = 0; i < jobListShards.size(); ++i)
+        {
+            const JobListShard& shard = *jobListShards.getUnchecked (i);
+            const ScopedLock sl (shard.lock);
+            addNamesOfJobs (shard.jobs, onlyReturnActiveJobs, s);
+        }
+    }
+    else
     {
-        const ThreadPoolJob* const job = jobs.getUnchecked(i);
-        if (job->isActive || ! onlyReturnActiveJobs)
-            s.add (job->getJobName());
+        const ScopedLock sl (lock);
+        addNamesOfJobs (jobs, onlyReturnActiveJobs, s);
     }
 
     return s;
 }
 
+void ThreadPool::addNamesOfJobs (const Array <ThreadPoolJob*>& jobList, const bool onlyReturnActiveJobs, StringArray& names)
+{
+    for (int i = 0; i < jobList.size(); ++i)
+    {
+        const ThreadPoolJob* const job = jobList.getUnchecked(i);
+        if (job->isActive.get() != 0 || ! onlyReturnActiveJobs)
+            names.add (job->getJobName());
+    }
+}
+
 bool ThreadPool::setThreadPriorities (const int newPriority)
 {
     bool ok = true;
@@ -322,10 +693,15 @@ bool ThreadPool::setThreadPriorities (const int newPriority)
     return ok;
 }
 
-bool ThreadPool::runNextJob()
+bool ThreadPool::runNextJob (ThreadPoolThread& thread)
 {
     ThreadPoolJob* job = nullptr;
 
+    if (workStealing)
+    {
+        job = takeQueuedJob (thread);
+    }
+    else
     {
         const ScopedLock sl (lock);
 
@@ -333,14 +709,14 @@ bool ThreadPool::runNextJob()
         {
             job = jobs[i];
 
-            if (job != nullptr && ! (job->isActive || job->shouldStop))
+            if (job != nullptr && ! (job->isActive.get() != 0 || job->shouldStop))
                 break;
 
             job = nullptr;
         }
 
         if (job != nullptr)
-            job->isActive = true;
+            job->isActive = 1;
 
     }
 
@@ -351,42 +727,63 @@ bool ThreadPool::runNextJob()
             ThreadPoolJob::JobStatus result = job->runJob();
 
             lastJobEndTime = Time::getApproximateMillisecondCounter();
+            bool shouldDelete = false;
 
-            const ScopedLock sl (lock);
-
-            if (jobs.contains (job))
             {
-                job->isActive = false;
+                const ScopedLock sl (getLockFor (job));
 
-                if (result != ThreadPoolJob::jobNeedsRunningAgain || job->shouldStop)
+                if (isInJobList (job))
                 {
-                    job->pool = nullptr;
-                    job->shouldStop = true;
-                    jobs.removeValue (job);
+                    job->isActive = 0;
 
-                    if (result == ThreadPoolJob::jobHasFinishedAndShouldBeDeleted)
-                        delete job;
+                    if (result != ThreadPoolJob::jobNeedsRunningAgain || job->shouldStop)
+                    {
+                        job->pool = nullptr;
+                        job->shouldStop = true;
+                        removeFromJobList (job);
+                        shouldDelete = (result == ThreadPoolJob::jobHasFinishedAndShouldBeDeleted);
 
-                    jobFinishedSignal.signal();
-                }
-                else
-                {
-                    // move the job to the end of the queue if it wants another go
-                    jobs.move (jobs.indexOf (job), -1);
+                        jobFinishedSignal.signal();
+                    }
+                    else if (workStealing)
+                    {
+                        // put the job where this thread will get to it after the rest of its queue
+                        thread.addToQueue (job, true);
+                    }
+                    else
+                    {
+                        // move the job to the end of the queue if it wants another go
+                        jobs.move (jobs.indexOf (job), -1);
+                    }
                 }
             }
+
+            // (the job's destructor is called without any of the pool's locks held)
+            if (shouldDelete)
+                delete job;
         }
 #if JUCE_CATCH_UNHANDLED_EXCEPTIONS
         catch (...)
         {
-            const ScopedLock sl (lock);
-            jobs.removeValue (job);
+            const ScopedLock sl (getLockFor (job));
+
+            if (isInJobList (job))
+            {
+                job->isActive = 0;
+                job->pool = nullptr;
+                job->shouldStop = true;
+                removeFromJobList (job);
+
+                jobFinishedSignal.signal();
+            }
         }
 #endif
     }
     else
     {
-        if (threadStopTimeout > 0
+        // (in work-stealing mode, the idle threads are left sleeping in waitForMoreJobs() instead, because
+        // one that stopped itself could leave behind a job that had just been put on its queue)
+        if (threadStopTimeout > 0 && ! workStealing
              && Time::getApproximateMillisecondCounter() > lastJobEndTime + threadStopTimeout)
         {
             const ScopedLock sl (lock);
@@ -404,4 +801,727 @@ bool ThreadPool::runNextJob()
     return true;
 }
 
+//==============================================================================
+namespace ThreadPoolHelpers
+{
+    /** Hands out the ranges of a parallelFor() to whichever threads ask for them. */
+    class ParallelForRanges
+    {
+    public:
+        ParallelForRanges (ThreadPool::ParallelForCallback& callback_, const int numItems_, const int rangeSize_) noexcept
+            : callback (callback_), numItems (numItems_), rangeSize (rangeSize_)
+        {
+        }
+
+        void processRanges()
+        {
+            for (;;)
+            {
+                const int start = (nextIndex += rangeSize) - rangeSize;
+
+                if (start >= numItems)
+                    break;
+
+                const int end = jmin (numItems, start + rangeSize);
+                callback.processRange (start, end);
+
+                if ((numItemsDone += (end - start)) >= numItems)
+                    finished.signal();
+            }
+        }
+
+        void waitUntilFinished()
+        {
+            while (numItemsDone.get() < numItems)
+                finished.wait (-1);
+        }
+
+    private:
+        ThreadPool::ParallelForCallback& callback;
+        const int numItems, rangeSize;
+        Atomic<int> nextIndex, numItemsDone;
+        WaitableEvent finished;
+
+        JUCE_DECLARE_NON_COPYABLE (ParallelForRanges);
+    };
+
+    class ParallelForJob  : public ThreadPoolJob
+    {
+    public:
+        ParallelForJob (ParallelForRanges& ranges_)
+            : ThreadPoolJob ("parallelFor"), ranges (ranges_)
+        {
+        }
+
+        JobStatus runJob()
+        {
+            ranges.processRanges();
+            return jobHasFinished;
+        }
+
+    private:
+        ParallelForRanges& ranges;
+
+        JUCE_DECLARE_NON_COPYABLE (ParallelForJob);
+    };
+}
+
+void ThreadPool::parallelFor (const int numItems, ParallelForCallback& callback, const int minItemsPerRange)
+{
+    using namespace ThreadPoolHelpers;
+
+    if (numItems <= 0)
+        return;
+
+    // Each thread should get several ranges, so that they all tend to finish at about the same time
+    const int rangeSize = jmax (1, minItemsPerRange, numItems / ((threads.size() + 1) * 4));
+    const int numHelpers = jmin (threads.size(), (numItems - 1) / rangeSize);
+
+    if (numHelpers <= 0)
+    {
+        callback.processRange (0, numItems);
+        return;
+    }
+
+    ParallelForRanges ranges (callback, numItems, rangeSize);
+    OwnedArray<ParallelForJob> helpers;
+
+    for (int i = 0; i < numHelpers; ++i)
+    {
+        helpers.add (new ParallelForJob (ranges));
+        addJob (helpers.getLast());
+    }
+
+    ranges.processRanges();
+    ranges.waitUntilFinished();
+
+    // Any helpers that haven't been started by now aren't needed, and those that
+    // have will already have run out of ranges, so this won't have to wait long.
+    for (int i = helpers.size(); --i >= 0;)
+        removeJob (helpers.getUnchecked (i), false, -1);
+}
+
+//==============================================================================
+class ThreadPoolTaskGroup::Helper  : public ThreadPoolJob
+{
+public:
+    Helper (ThreadPoolTaskGroup& group_)
+        : ThreadPoolJob ("Task group"), hasStopped (false), group (group_)
+    {
+    }
+
+    JobStatus runJob()
+    {
+        while (ThreadPoolTaskGroup::Task* const task = group.takeNextTask (this))
+            group.runTask (task);
+
+        return jobHasFinished;
+    }
+
+    bool hasStopped;    // set once it has stopped looking for tasks - only used with the group's lock held
+
+private:
+    ThreadPoolTaskGroup& group;
+
+    JUCE_DECLARE_NON_COPYABLE (Helper);
+};
+
+ThreadPoolTaskGroup::ThreadPoolTaskGroup (ThreadPool* const threadPool)
+    : pool (threadPool),
+      nextTaskIndex (0),
+      numUnfinishedTasks (0),
+      numActiveHelpers (0),
+      isWaiting (false)
+{
+}
+
+ThreadPoolTaskGroup::~ThreadPoolTaskGroup()
+{
+    wait();
+}
+
+void ThreadPoolTaskGroup::addTask (Task* const task)
+{
+    jassert (task != nullptr);
+
+    if (task != nullptr)
+    {
+        const ScopedLock sl (lock);
+        tasks.add (task);
+        ++numUnfinishedTasks;
+
+        if (pool != nullptr && numActiveHelpers < pool->getNumThreads())
+        {
+            ++numActiveHelpers;
+            pool->addJob (getIdleHelper());
+        }
+
+        if (isWaiting)
+            taskFinishedOrAdded.signal();
+    }
+}
+
+ThreadPoolTaskGroup::Helper* ThreadPoolTaskGroup::getIdleHelper()
+{
+    // There are never more helpers than the pool has threads, so if they've all been created
+    // then at least one of them must have stopped, and it can be used again as soon as the
+    // pool has finished with it.
+    for (;;)
+    {
+        for (int i = 0; i < helpers.size(); ++i)
+        {
+            Helper* const helper = helpers.getUnchecked (i);
+
+            if (helper->hasStopped && pool->hasFinishedWith (helper))
+            {
+                helper->hasStopped = false;
+                return helper;
+            }
+        }
+
+        if (helpers.size() < pool->getNumThreads())
+        {
+            Helper* const helper = new Helper (*this);
+            helpers.add (helper);
+            return helper;
+        }
+
+        // (a helper that has stopped will have returned from its runJob() method, so this
+        // only has to wait for the pool to take it out of its list)
+        Thread::yield();
+    }
+}
+
+ThreadPoolTaskGroup::Task* ThreadPoolTaskGroup::takeNextTask (Helper* const helper)
+{
+    const ScopedLock sl (lock);
+
+    if (nextTaskIndex < tasks.size())
+    {
+        Task* const task = tasks.getUnchecked (nextTaskIndex++);
+
+        if (nextTaskIndex == tasks.size())
+        {
+            tasks.clearQuick();
+            nextTaskIndex = 0;
+        }
+
+        return task;
+    }
+
+    // (a helper that stops looking for tasks has to be replaced when another task is added)
+    if (helper != nullptr)
+    {
+        helper->hasStopped = true;
+        --numActiveHelpers;
+    }
+
+    return nullptr;
+}
+
+void ThreadPoolTaskGroup::runTask (Task* const task)
+{
+    task->run();
+    delete task;
+
+    const ScopedLock sl (lock);
+
+    if (--numUnfinishedTasks == 0 && isWaiting)
+        taskFinishedOrAdded.signal();
+}
+
+void ThreadPoolTaskGroup::wait()
+{
+    for (;;)
+    {
+        Task* const task = takeNextTask (nullptr);
+
+        if (task != nullptr)
+        {
+            runTask (task);
+            continue;
+        }
+
+        {
+            const ScopedLock sl (lock);
+
+            if (numUnfinishedTasks == 0)
+            {
+                isWaiting = false;
+                break;
+            }
+
+            isWaiting = true;
+        }
+
+        taskFinishedOrAdded.wait (-1);
+    }
+
+    // All the tasks have finished, so any helpers that are still queued can be removed,
+    // and any that are running are just about to return. They're kept for the next tasks.
+    if (pool != nullptr)
+        for (int i = helpers.size(); --i >= 0;)
+            pool->removeJob (helpers.getUnchecked (i), false, -1);
+
+    const ScopedLock sl (lock);
+    numActiveHelpers = 0;
+
+    // (unless another thread has added a task in the meantime, they'll all have been released)
+    for (int i = helpers.size(); --i >= 0;)
+    {
+        Helper* const helper = helpers.getUnchecked (i);
+
+        if (pool->hasFinishedWith (helper))
+            helper->hasStopped = true;
+        else if (! helper->hasStopped)
+            ++numActiveHelpers;
+    }
+}
+
+int ThreadPoolTaskGroup::getNumUnfinishedTasks() const
+{
+    const ScopedLock sl (lock);
+    return numUnfinishedTasks;
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class ThreadPoolTests  : public UnitTest
+{
+public:
+    ThreadPoolTests() : UnitTest ("ThreadPool") {}
+
+    struct Counters
+    {
+        Atomic<int> numRuns, numJobsLeft;
+        WaitableEvent allJobsFinished;
+    };
+
+    class CountingJob  : public ThreadPoolJob
+    {
+    public:
+        CountingJob (Counters& counters_, int numRunsNeeded_, bool deleteWhenFinished_,
+                     ThreadPool* poolForChildren_ = nullptr, int depth_ = 0)
+            : ThreadPoolJob ("Counting"),
+              counters (counters_), numRunsNeeded (numRunsNeeded_), deleteWhenFinished (deleteWhenFinished_),
+              poolForChildren (poolForChildren_), depth (depth_)
+        {
+        }
+
+        JobStatus runJob()
+        {
+            ++(counters.numRuns);
+
+            if (--numRunsNeeded > 0)
+                return jobNeedsRunningAgain;
+
+            if (poolForChildren != nullptr && depth > 0)
+                for (int i = 0; i < numChildren; ++i)
+                    poolForChildren->addJob (new CountingJob (counters, 1, true, poolForChildren, depth - 1));
+
+            if (--(counters.numJobsLeft) == 0)
+                counters.allJobsFinished.signal();
+
+            return deleteWhenFinished ? jobHasFinishedAndShouldBeDeleted : jobHasFinished;
+        }
+
+        enum { numChildren = 4 };
+
+    private:
+        Counters& counters;
+        int numRunsNeeded;
+        const bool deleteWhenFinished;
+        ThreadPool* const poolForChildren;
+        const int depth;
+    };
+
+    class BlockingJob  : public ThreadPoolJob
+    {
+    public:
+        BlockingJob() : ThreadPoolJob ("Blocking") {}
+
+        JobStatus runJob()
+        {
+            while (! (shouldExit() || release.wait (1)))
+            {}
+
+            return jobHasFinished;
+        }
+
+        WaitableEvent release;
+    };
+
+    void waitUntilEmpty (ThreadPool& pool)
+    {
+        // (a job's counted as finished just before the pool lets go of it)
+        while (pool.getNumJobs() > 0)
+            Thread::yield();
+    }
+
+    void testRunningJobs (const bool workStealing)
+    {
+        ThreadPool pool (4, true, 5000, workStealing);
+        OwnedArray<CountingJob> ownedJobs;
+        Counters counters;
+        const int numJobs = 1000;
+        int expectedRuns = 0;
+
+        counters.numJobsLeft = numJobs;
+
+        for (int i = 0; i < numJobs; ++i)
+        {
+            const int numRuns = (i % 3) + 1;
+            expectedRuns += numRuns;
+
+            CountingJob* const job = new CountingJob (counters, numRuns, (i & 1) != 0);
+
+            if ((i & 1) == 0)
+                ownedJobs.add (job);
+
+            pool.addJob (job);
+        }
+
+        expect (counters.allJobsFinished.wait (20000));
+        waitUntilEmpty (pool);
+        expectEquals (counters.numRuns.get(), expectedRuns);
+
+        for (int i = 0; i < ownedJobs.size(); ++i)
+            expect (! pool.contains (ownedJobs.getUnchecked(i)));
+    }
+
+    void testJobsAddingJobs (const bool workStealing)
+    {
+        ThreadPool pool (3, true, 5000, workStealing);
+        Counters counters;
+        const int depth = 5;
+        int numJobs = 0;
+
+        for (int i = 0, n = 1; i <= depth; ++i, n *= CountingJob::numChildren)
+            numJobs += n;
+
+        counters.numJobsLeft = numJobs;
+        pool.addJob (new CountingJob (counters, 1, true, &pool, depth));
+
+        expect (counters.allJobsFinished.wait (20000));
+        waitUntilEmpty (pool);
+        expectEquals (counters.numRuns.get(), numJobs);
+    }
+
+    void testRemovingJobs (const bool workStealing)
+    {
+        ThreadPool pool (1, true, 5000, workStealing);
+        BlockingJob blocker;
+        OwnedArray<CountingJob> jobs;
+        Counters counters;
+
+        pool.addJob (&blocker);
+
+        while (! pool.isJobRunning (&blocker))
+            Thread::yield();
+
+        for (int i = 0; i < 10; ++i)
+        {
+            jobs.add (new CountingJob (counters, 1, false));
+            pool.addJob (jobs.getLast());
+        }
+
+        expectEquals (pool.getNumJobs(), 11);
+        expectEquals (pool.getNamesOfAllJobs (false).size(), 11);
+        expectEquals (pool.getNamesOfAllJobs (true).size(), 1);
+
+        Array<ThreadPoolJob*> jobsFound;
+
+        for (int i = 0; i < pool.getNumJobs(); ++i)
+            jobsFound.addIfNotAlreadyThere (pool.getJob (i));
+
+        expectEquals (jobsFound.size(), 11);
+        expect (jobsFound.contains (&blocker) && jobsFound.contains (jobs[9]));
+        expect (pool.getJob (11) == nullptr);
+
+        expect (pool.removeJob (jobs[3], false, 0));
+        expect (! pool.contains (jobs[3]));
+        expectEquals (pool.getNumJobs(), 10);
+
+        // the blocking job can't finish yet, so this gives up, but still removes the others
+        expect (! pool.removeAllJobs (false, 0));
+        expectEquals (pool.getNumJobs(), 1);
+        expect (pool.isJobRunning (&blocker));
+
+        blocker.release.signal();
+        expect (pool.waitForJobToFinish (&blocker, 10000));
+        expectEquals (pool.getNumJobs(), 0);
+        expectEquals (counters.numRuns.get(), 0);
+
+        // ..and a running job should see that it's been asked to stop
+        pool.addJob (&blocker);
+
+        while (! pool.isJobRunning (&blocker))
+            Thread::yield();
+
+        expect (pool.removeJob (&blocker, true, 10000));
+        expect (! pool.contains (&blocker));
+    }
+
+   #if JUCE_CATCH_UNHANDLED_EXCEPTIONS
+    class ThrowingJob  : public ThreadPoolJob
+    {
+    public:
+        ThrowingJob() : ThreadPoolJob ("Throwing") {}
+
+        JobStatus runJob()
+        {
+            throw 0;
+        }
+    };
+
+    void testThrowingJobs (const bool workStealing)
+    {
+        ThreadPool pool (2, true, 5000, workStealing);
+        OwnedArray<ThrowingJob> throwers;
+        OwnedArray<CountingJob> jobs;
+        Counters counters;
+
+        // (the throwing jobs are removed from the middle of the list, so the others get moved around)
+        for (int i = 0; i < 20; ++i)
+        {
+            jobs.add (new CountingJob (counters, 2, false));
+            pool.addJob (jobs.getLast());
+
+            throwers.add (new ThrowingJob());
+            pool.addJob (throwers.getLast());
+        }
+
+        for (int i = 0; i < throwers.size(); ++i)
+            expect (pool.waitForJobToFinish (throwers.getUnchecked (i), 10000));
+
+        for (int i = 0; i < jobs.size(); ++i)
+            expect (pool.waitForJobToFinish (jobs.getUnchecked (i), 10000));
+
+        expectEquals (pool.getNumJobs(), 0);
+        expectEquals (counters.numRuns.get(), 40);
+
+        // a job that has thrown can be added again
+        pool.addJob (throwers.getFirst());
+        expect (pool.waitForJobToFinish (throwers.getFirst(), 10000));
+    }
+   #endif
+
+    class CountingCallback  : public ThreadPool::ParallelForCallback
+    {
+    public:
+        CountingCallback (const int numItems)
+        {
+            counts.insertMultiple (0, 0, numItems);
+        }
+
+        void processRange (const int startIndex, const int endIndex)
+        {
+            // (each index is only given to one thread, so they can be written to without locking)
+            for (int i = startIndex; i < endIndex; ++i)
+                ++counts.getReference (i);
+        }
+
+        bool eachItemWasProcessedOnce() const
+        {
+            for (int i = counts.size(); --i >= 0;)
+                if (counts.getUnchecked (i) != 1)
+                    return false;
+
+            return true;
+        }
+
+    private:
+        Array<int> counts;
+    };
+
+    class NestedParallelForJob  : public ThreadPoolJob
+    {
+    public:
+        NestedParallelForJob (ThreadPool& pool_)
+            : ThreadPoolJob ("Nested"), pool (pool_), callback (5000)
+        {
+        }
+
+        JobStatus runJob()
+        {
+            pool.parallelFor (5000, callback);
+            return jobHasFinished;
+        }
+
+        ThreadPool& pool;
+        CountingCallback callback;
+    };
+
+    void testParallelFor (const bool workStealing)
+    {
+        ThreadPool pool (4, true, 5000, workStealing);
+        const int sizes[] = { 0, 1, 7, 1000, 100000 };
+
+        for (int i = 0; i < numElementsInArray (sizes); ++i)
+        {
+            for (int minItemsPerRange = 1; minItemsPerRange <= 256; minItemsPerRange *= 16)
+            {
+                CountingCallback callback (sizes[i]);
+                pool.parallelFor (sizes[i], callback, minItemsPerRange);
+                expect (callback.eachItemWasProcessedOnce());
+            }
+        }
+
+        // using parallelFor inside the pool's own jobs mustn't deadlock, even with every thread busy
+        OwnedArray<NestedParallelForJob> jobs;
+
+        for (int i = 0; i < 8; ++i)
+        {
+            jobs.add (new NestedParallelForJob (pool));
+            pool.addJob (jobs.getLast());
+        }
+
+        for (int i = 0; i < jobs.size(); ++i)
+        {
+            expect (pool.waitForJobToFinish (jobs.getUnchecked (i), 20000));
+            expect (jobs.getUnchecked (i)->callback.eachItemWasProcessedOnce());
+        }
+    }
+
+    class CountingTask  : public ThreadPoolTaskGroup::Task
+    {
+    public:
+        CountingTask (ThreadPoolTaskGroup& group_, Atomic<int>& counter_, const int numChildren_)
+            : group (group_), counter (counter_), numChildren (numChildren_)
+        {
+        }
+
+        void run()
+        {
+            ++counter;
+
+            for (int i = 0; i < numChildren; ++i)
+                group.addTask (new CountingTask (group, counter, 0));
+        }
+
+    private:
+        ThreadPoolTaskGroup& group;
+        Atomic<int>& counter;
+        const int numChildren;
+    };
+
+    void testTaskGroup (ThreadPool* const pool)
+    {
+        Atomic<int> counter;
+
+        {
+            ThreadPoolTaskGroup group (pool);
+
+            for (int i = 0; i < 100; ++i)
+                group.addTask (new CountingTask (group, counter, i < 10 ? 5 : 0));
+
+            group.wait();
+            expectEquals (counter.get(), 150);
+            expectEquals (group.getNumUnfinishedTasks(), 0);
+
+            // the group can be re-used after waiting, and its destructor waits too
+            for (int i = 0; i < 10; ++i)
+                group.addTask (new CountingTask (group, counter, 1));
+        }
+
+        expectEquals (counter.get(), 170);
+
+        if (pool != nullptr)
+        {
+            // adding tasks in bursts, with the helpers stopping in between, re-uses the same helpers
+            ThreadPoolTaskGroup group (pool);
+
+            for (int burst = 0; burst < 200; ++burst)
+            {
+                for (int i = 0; i < 3; ++i)
+                    group.addTask (new CountingTask (group, counter, 0));
+
+                while (group.getNumUnfinishedTasks() > 0)
+                    Thread::sleep (1);
+
+                expect (pool->getNumJobs() <= pool->getNumThreads());
+            }
+
+            group.wait();
+            expectEquals (counter.get(), 770);
+        }
+    }
+
+    double measureJobsPerSecond (const bool workStealing, const int numThreads, const int numJobs)
+    {
+        ThreadPool pool (numThreads, false, 0, workStealing);
+        double bestTime = 1.0e10;
+
+        for (int round = 0; round < 3; ++round)
+        {
+            Counters counters;
+            Array<CountingJob*> jobs;
+            counters.numJobsLeft = numJobs;
+
+            for (int i = 0; i < numJobs; ++i)
+                jobs.add (new CountingJob (counters, 1, true));
+
+            const double startTime = Time::getMillisecondCounterHiRes();
+
+            for (int i = 0; i < numJobs; ++i)
+                pool.addJob (jobs.getUnchecked(i));
+
+            counters.allJobsFinished.wait (-1);
+            bestTime = jmin (bestTime, Time::getMillisecondCounterHiRes() - startTime);
+            waitUntilEmpty (pool);
+        }
+
+        return numJobs * 1000.0 / jmax (0.001, bestTime);
+    }
+
+    void runTest()
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            const bool workStealing = (i != 0);
+            const String mode (workStealing ? " (work-stealing)" : " (shared queue)");
+
+            beginTest ("Running jobs" + mode);
+            testRunningJobs (workStealing);
+
+            beginTest ("Jobs adding jobs" + mode);
+            testJobsAddingJobs (workStealing);
+
+            beginTest ("Removing jobs" + mode);
+            testRemovingJobs (workStealing);
+
+           #if JUCE_CATCH_UNHANDLED_EXCEPTIONS
+            beginTest ("Jobs that throw" + mode);
+            testThrowingJobs (workStealing);
+           #endif
+
+            beginTest ("parallelFor" + mode);
+            testParallelFor (workStealing);
+
+            beginTest ("Task groups" + mode);
+            ThreadPool pool (3, true, 5000, workStealing);
+            testTaskGroup (&pool);
+        }
+
+        beginTest ("Task groups without a pool");
+        testTaskGroup (nullptr);
+
+        beginTest ("Benchmark");
+
+        const int numThreads = jmax (2, SystemStats::getNumCpus());
+        const int numJobs = 20000;
+        const double sharedQueueRate = measureJobsPerSecond (false, numThreads, numJobs);
+        const double workStealingRate = measureJobsPerSecond (true, numThreads, numJobs);
+
+        logMessage (String (numJobs) + " short jobs on " + String (numThreads) + " threads: shared queue "
+                     + String (roundToInt (sharedQueueRate)) + " jobs/s, work-stealing "
+                     + String (roundToInt (workStealingRate)) + " jobs/s");
+    }
+};
+
+static ThreadPoolTests threadPoolUnitTests;
+
+#endif
+
 END_JUCE_NAMESPACE
@@ -106,7 +106,7 @@ public:
 
     //==============================================================================
     /** Returns true if this job is currently running its runJob() method. */
-    bool isRunning() const                  { return isActive; }
+    bool isRunning() const                  { return isActive.get() != 0; }
 
     /** Returns true if something is trying to interrupt this job and make it stop.
 
@@ -130,7 +130,9 @@ private:
     friend class ThreadPoolThread;
     String jobName;
     ThreadPool* pool;
-    bool shouldStop, isActive, shouldBeDeleted;
+    bool shouldStop, shouldBeDeleted;
+    Atomic<int> isActive; // (a thread sets this while holding its queue's lock, not the job list's)
+    int indexInPool;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ThreadPoolJob);
 };
@@ -161,11 +163,21 @@ public:
                                             they're ready for action
         @param stopThreadsWhenNotUsedTimeoutMs  if this timeout is > 0, then if any threads have been
                                             inactive for this length of time, they will automatically
-                                            be stopped until more jobs come along and they're needed
+                                            be stopped until more jobs come along and they're needed.
+                                            This has no effect if useWorkStealing is true
+        @param useWorkStealing              if this is true, each thread keeps its own queue of jobs, and
+                                            a thread that runs out of work takes jobs from the other threads'
+                                            queues, so adding and running a job never involves searching
+                                            the whole list. This is much quicker when there are large numbers
+                                            of short jobs, but jobs may not be started in the order in which
+                                            they were added. In this mode, idle threads sleep until a job is
+                                            added rather than being stopped, so stopThreadsWhenNotUsedTimeoutMs
+                                            is ignored
     */
     ThreadPool (int numberOfThreads,
                 bool startThreadsOnlyWhenNeeded = true,
-                int stopThreadsWhenNotUsedTimeoutMs = 5000);
+                int stopThreadsWhenNotUsedTimeoutMs = 5000,
+                bool useWorkStealing = false);
 
     /** Destructor.
 
@@ -248,6 +260,10 @@ public:
     */
     int getNumJobs() const;
 
+    /** Returns the number of threads that the pool was created with.
+    */
+    int getNumThreads() const noexcept;
+
     /** Returns one of the jobs in the queue.
 
         Note that this can be a very volatile list as jobs might be continuously getting shifted
@@ -257,6 +273,10 @@ public:
 
     /** Returns true if the given job is currently queued or running.
 
+        This searches the list of jobs that the given one would be in (in work-stealing
+        mode, the pool's jobs are split between several lists), so its cost grows with
+        the number of jobs that are queued.
+
         @see isJobRunning()
     */
     bool contains (const ThreadPoolJob* job) const;
@@ -272,6 +292,9 @@ public:
 
         If the timeout period expires before the job finishes, this will return false;
         it returns true if the job has finished successfully.
+
+        This polls contains() while it waits, so if you need to wait for a large number
+        of jobs, a ThreadPoolTaskGroup will be much cheaper than calling this for each one.
     */
     bool waitForJobToFinish (const ThreadPoolJob* job,
                              int timeOutMilliseconds) const;
@@ -289,25 +312,163 @@ public:
     */
     bool setThreadPriorities (int newPriority);
 
+    //==============================================================================
+    /** A callback that parallelFor() uses to process a range of items. */
+    class JUCE_API  ParallelForCallback
+    {
+    public:
+        virtual ~ParallelForCallback() {}
+
+        /** Should process the items from startIndex up to (but not including) endIndex.
+
+            This will be called by several threads at once, each time with a different range,
+            so any implementation must be thread-safe.
+        */
+        virtual void processRange (int startIndex, int endIndex) = 0;
+    };
+
+    /** Processes a number of items, sharing them out between the calling thread and the pool's threads.
+
+        The items are divided into ranges which are handed out to the threads as they become
+        free, and this method won't return until all of them have been processed. The calling
+        thread does some of the work itself, so this can safely be called from inside one of the
+        pool's own jobs: if all the other threads are busy, it'll just do everything itself.
+
+        @param numItems             the number of items to process
+        @param callback             the callback that will process them
+        @param minItemsPerRange     the smallest number of items that will be handed to a thread
+                                    at once. Use this to stop very cheap items from being split
+                                    into ranges that aren't worth the overhead of sharing out
+        @see ThreadPoolTaskGroup
+    */
+    void parallelFor (int numItems, ParallelForCallback& callback, int minItemsPerRange = 1);
+
 
 private:
     //==============================================================================
     const int threadStopTimeout;
     int priority;
+    const bool workStealing;
     class ThreadPoolThread;
     friend class OwnedArray <ThreadPoolThread>;
     OwnedArray <ThreadPoolThread> threads;
     Array <ThreadPoolJob*> jobs;
 
+    // (in work-stealing mode, the jobs are kept in these instead of the jobs array)
+    struct JobListShard;
+    friend class OwnedArray <JobListShard>;
+    OwnedArray <JobListShard> jobListShards;
+    enum { numJobListShards = 16 };
+
     CriticalSection lock;
     uint32 lastJobEndTime;
     WaitableEvent jobFinishedSignal;
+    Atomic<int> numQueuedJobs, numJobs, nextQueueIndex;
 
     friend class ThreadPoolThread;
-    bool runNextJob();
+    bool runNextJob (ThreadPoolThread&);
+    ThreadPoolJob* takeQueuedJob (ThreadPoolThread&);
+    bool removeQueuedJob (ThreadPoolJob*);
+    void addJobToQueue (ThreadPoolJob*);
+    JobListShard& getShardFor (const ThreadPoolJob*) const noexcept;
+    const CriticalSection& getLockFor (const ThreadPoolJob*) const noexcept;
+    const Array <ThreadPoolJob*>& getJobListFor (const ThreadPoolJob*) const noexcept;
+    void addToJobList (ThreadPoolJob*);
+    void removeFromJobList (ThreadPoolJob*);
+    bool isInJobList (ThreadPoolJob*) const;
+    static void addNamesOfJobs (const Array <ThreadPoolJob*>&, bool onlyActiveJobs, StringArray&);
+
+    friend class ThreadPoolTaskGroup;
+    bool hasFinishedWith (const ThreadPoolJob*) const;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ThreadPool);
 };
 
 
+//==============================================================================
+/**
+    A group of tasks that are run by a ThreadPool, and which can be waited for together.
+
+    Tasks are added with addTask(), and are run by the pool's threads as they become free.
+    The thread that calls wait() helps out by running any tasks that haven't been started,
+    and then waits for the rest to finish. A task can add more tasks to its own group while
+    it's running (e.g. to split up its work, or to start something that depends on its
+    results), and wait() won't return until those have finished too.
+
+    @code
+    ThreadPoolTaskGroup group (&pool);
+
+    for (int i = 0; i < pages.size(); ++i)
+        group.addTask (new PageLayoutTask (pages[i]));
+
+    group.wait();
+    @endcode
+
+    @see ThreadPool::parallelFor
+*/
+class JUCE_API  ThreadPoolTaskGroup
+{
+public:
+    //==============================================================================
+    /** Creates a group whose tasks will be run by a pool's threads.
+        If the pool is nullptr, all the tasks will be run by the thread that calls wait().
+    */
+    explicit ThreadPoolTaskGroup (ThreadPool* threadPool);
+
+    /** Destructor.
+        This calls wait(), so any tasks that haven't finished will be run first.
+    */
+    ~ThreadPoolTaskGroup();
+
+    //==============================================================================
+    /** A piece of work that can be added to a ThreadPoolTaskGroup. */
+    class JUCE_API  Task
+    {
+    public:
+        virtual ~Task() {}
+
+        /** Does the task's work. This may be called on any thread. */
+        virtual void run() = 0;
+    };
+
+    /** Adds a task to the group.
+
+        The group takes ownership of the task, and will delete it after it has been run.
+        This can be called on any thread, including from inside one of the group's tasks.
+    */
+    void addTask (Task* task);
+
+    /** Runs the group's tasks on the calling thread until there are none left to start,
+        and then waits for any that other threads are still running.
+
+        Only one thread should wait for a group at a time, and it mustn't be called from
+        inside one of the group's own tasks.
+    */
+    void wait();
+
+    /** Returns the number of tasks that have been added but haven't yet finished. */
+    int getNumUnfinishedTasks() const;
+
+private:
+    //==============================================================================
+    class Helper;
+    friend class Helper;
+    friend class OwnedArray <Helper>;
+
+    ThreadPool* const pool;
+    CriticalSection lock;
+    Array <Task*> tasks;
+    OwnedArray <Helper> helpers;
+    int nextTaskIndex, numUnfinishedTasks, numActiveHelpers;
+    bool isWaiting;
+    WaitableEvent taskFinishedOrAdded;
+
+    Helper* getIdleHelper();
+    Task* takeNextTask (Helper*);
+    void runTask (Task*);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ThreadPoolTaskGroup);
+};
+
+
 #endif   // __JUCE_THREADPOOL_JUCEHEADER__
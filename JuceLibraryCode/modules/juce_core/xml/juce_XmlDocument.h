@@ -67,7 +67,7 @@ class InputSource;
         ...etc
     @endcode
 
-    @see XmlElement
+    @see XmlElement, XmlStreamReader
 */
 class JUCE_API  XmlDocument
 {
@@ -0,0 +1,641 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library - "Jules' Utility Class Extensions"
+   Copyright 2004-11 by Raw Material Software Ltd.
+
+  ------------------------------------------------------------------------------
+
+   JUCE can be redistributed and/or modified under the terms of the GNU General
+   Public License (Version 2), as published by the Free Software Foundation.
+   A copy of the license is included in the JUCE distribution, or can be found
+   online at www.gnu.org/licenses.
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.rawmaterialsoftware.com/juce for more information.
+
+  ==============================================================================
+*/
+
+BEGIN_JUCE_NAMESPACE
+
+XmlStreamReader::Text::Text() noexcept
+    : start (nullptr), end (nullptr), containsEntities (false)
+{
+}
+
+XmlStreamReader::Text::Text (const char* const start_, const char* const end_, const bool containsEntities_) noexcept
+    : start (start_), end (end_), containsEntities (containsEntities_)
+{
+}
+
+bool XmlStreamReader::Text::operator== (const char* const other) const noexcept
+{
+    const size_t len = (size_t) (end - start);
+    return strlen (other) == len && memcmp (start, other, len) == 0;
+}
+
+bool XmlStreamReader::Text::operator!= (const char* const other) const noexcept
+{
+    return ! operator== (other);
+}
+
+String XmlStreamReader::Text::toString() const
+{
+    if (! containsEntities)
+        return String (CharPointer_UTF8 (start), CharPointer_UTF8 (end));
+
+    MemoryOutputStream out ((size_t) (end - start));
+    const char* t = start;
+
+    while (t < end)
+    {
+        const char* const ampersand = static_cast <const char*> (memchr (t, '&', (size_t) (end - t)));
+
+        if (ampersand == nullptr)
+        {
+            out.write (t, (size_t) (end - t));
+            break;
+        }
+
+        out.write (t, (size_t) (ampersand - t));
+        t = ampersand + 1;
+
+        const char* const semicolon = static_cast <const char*> (memchr (t, ';', (size_t) (end - t)));
+        const String name (semicolon != nullptr ? String (CharPointer_UTF8 (t), CharPointer_UTF8 (semicolon)) : String::empty);
+        juce_wchar c = 0;
+
+        if      (name.equalsIgnoreCase ("amp"))   c = '&';
+        else if (name.equalsIgnoreCase ("quot"))  c = '"';
+        else if (name.equalsIgnoreCase ("apos"))  c = '\'';
+        else if (name.equalsIgnoreCase ("lt"))    c = '<';
+        else if (name.equalsIgnoreCase ("gt"))    c = '>';
+        else if (name[0] == '#')
+            c = (name[1] == 'x' || name[1] == 'X') ? (juce_wchar) name.substring (2).getHexValue32()
+                                                   : (juce_wchar) name.substring (1).getIntValue();
+
+        if (c != 0)
+        {
+            out << String::charToString (c);
+            t = semicolon + 1;
+        }
+        else
+        {
+            out.writeByte ('&');    // not an entity that we can expand, so leave it alone
+        }
+    }
+
+    return out.toUTF8();
+}
+
+//==============================================================================
+XmlStreamReader::XmlStreamReader (const void* const xmlData, const size_t numBytes)
+{
+    setData (xmlData, numBytes);
+}
+
+XmlStreamReader::XmlStreamReader (const File& file)
+    : mappedFile (new MemoryMappedFile (file, MemoryMappedFile::readOnly))
+{
+    setData (mappedFile->getData(), mappedFile->getSize());
+}
+
+XmlStreamReader::XmlStreamReader (InputStream& in)
+{
+    in.readIntoMemoryBlock (loadedData);
+    setData (loadedData.getData(), loadedData.getSize());
+}
+
+XmlStreamReader::~XmlStreamReader()
+{
+}
+
+void XmlStreamReader::setData (const void* const xmlData, const size_t numBytes) noexcept
+{
+    input = static_cast <const char*> (xmlData);
+    inputEnd = input + (input != nullptr ? numBytes : 0);
+    currentToken = text;
+    depth = tokenDepth = 0;
+    ignoreEmptyTextElements = true;
+    elementIsEmpty = false;
+
+    if (startsWith ("\xef\xbb\xbf"))  // skip a UTF-8 byte-order mark
+        input += 3;
+}
+
+void XmlStreamReader::setEmptyTextElementsIgnored (const bool shouldBeIgnored) noexcept
+{
+    ignoreEmptyTextElements = shouldBeIgnored;
+}
+
+//==============================================================================
+XmlStreamReader::TokenType XmlStreamReader::next()
+{
+    if (currentToken == endOfDocument || currentToken == parseError)
+        return currentToken;
+
+    if (currentToken == startOfElement && elementIsEmpty)
+    {
+        // an element like <foo/> gets an end tag as well, so that they always match up
+        elementIsEmpty = false;
+        tokenDepth = --depth;
+        attributes.clearQuick();
+        return currentToken = endOfElement;
+    }
+
+    for (;;)
+    {
+        if (input >= inputEnd)
+        {
+            if (depth > 0)
+                return setError ("unmatched tags");
+
+            return currentToken = endOfDocument;
+        }
+
+        if (*input != '<')
+        {
+            if (readText())
+                return currentToken = text;
+        }
+        else if (startsWith ("</"))
+        {
+            return readEndTag();
+        }
+        else if (startsWith ("<![CDATA["))
+        {
+            return readCDATA();
+        }
+        else if (startsWith ("<!--"))
+        {
+            if (! skipPast ("-->"))
+                return setError ("unterminated comment");
+        }
+        else if (startsWith ("<?"))
+        {
+            if (! skipPast ("?>"))
+                return setError ("unterminated processing instruction");
+        }
+        else if (startsWith ("<!"))
+        {
+            if (! skipDeclaration())
+                return setError ("unterminated declaration");
+        }
+        else
+        {
+            return readStartTag();
+        }
+    }
+}
+
+XmlStreamReader::TokenType XmlStreamReader::setError (const String& message)
+{
+    lastError = message;
+    input = inputEnd;
+    return currentToken = parseError;
+}
+
+bool XmlStreamReader::startsWith (const char* s) const noexcept
+{
+    for (const char* t = input; *s != 0; ++s, ++t)
+        if (t >= inputEnd || *t != *s)
+            return false;
+
+    return true;
+}
+
+bool XmlStreamReader::skipPast (const char* const terminator) noexcept
+{
+    const char firstChar = *terminator;
+
+    for (; input < inputEnd; ++input)
+    {
+        if (*input == firstChar && startsWith (terminator))
+        {
+            input += strlen (terminator);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool XmlStreamReader::skipDeclaration() noexcept
+{
+    // a DOCTYPE can contain a bracketed list of declarations, which may include '>' characters
+    int bracketLevel = 0;
+
+    for (++input; input < inputEnd; ++input)
+    {
+        const char c = *input;
+
+        if (c == '[')
+            ++bracketLevel;
+        else if (c == ']')
+            --bracketLevel;
+        else if (c == '>' && bracketLevel <= 0)
+        {
+            ++input;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void XmlStreamReader::skipWhitespace() noexcept
+{
+    while (input < inputEnd && CharacterFunctions::isWhitespace (*input))
+        ++input;
+}
+
+const char* XmlStreamReader::findEndOfName() const noexcept
+{
+    const char* t = input;
+
+    // any multi-byte UTF-8 sequence is allowed, as XmlDocument allows all letters
+    while (t < inputEnd && (XmlIdentifierChars::isIdentifierChar ((juce_wchar) (uint8) *t) || (uint8) *t >= 0x80))
+        ++t;
+
+    return t;
+}
+
+//==============================================================================
+XmlStreamReader::TokenType XmlStreamReader::readStartTag()
+{
+    ++input;
+    const char* const endOfName = findEndOfName();
+
+    if (endOfName == input)
+        return setError ("tag name missing");
+
+    tagName = Text (input, endOfName, false);
+    input = endOfName;
+    attributes.clearQuick();
+
+    for (;;)
+    {
+        skipWhitespace();
+
+        if (input >= inputEnd)
+            return setError ("unmatched tags");
+
+        if (*input == '/' && input + 1 < inputEnd && input[1] == '>')
+        {
+            input += 2;
+            elementIsEmpty = true;
+            break;
+        }
+
+        if (*input == '>')
+        {
+            ++input;
+            elementIsEmpty = false;
+            break;
+        }
+
+        const char* const endOfAttributeName = findEndOfName();
+
+        if (endOfAttributeName == input)
+            return setError ("illegal character found in " + tagName.toString().quoted() + ": '" + String::charToString ((juce_wchar) (uint8) *input) + "'");
+
+        Attribute att;
+        att.name = Text (input, endOfAttributeName, false);
+        input = endOfAttributeName;
+        skipWhitespace();
+
+        if (input >= inputEnd || *input != '=')
+            return setError ("expected '=' after attribute " + att.name.toString().quoted());
+
+        ++input;
+        skipWhitespace();
+
+        if (input >= inputEnd || (*input != '"' && *input != '\''))
+            return setError ("expected a quoted value for attribute " + att.name.toString().quoted());
+
+        const char quote = *input++;
+        const char* const valueStart = input;
+        const char* const valueEnd = static_cast <const char*> (memchr (input, quote, (size_t) (inputEnd - input)));
+
+        if (valueEnd == nullptr)
+            return setError ("unterminated attribute value");
+
+        att.value = Text (valueStart, valueEnd, memchr (valueStart, '&', (size_t) (valueEnd - valueStart)) != nullptr);
+        attributes.add (att);
+        input = valueEnd + 1;
+    }
+
+    tokenDepth = depth++;
+    return currentToken = startOfElement;
+}
+
+XmlStreamReader::TokenType XmlStreamReader::readEndTag()
+{
+    input += 2;
+    const char* const endOfName = findEndOfName();
+    tagName = Text (input, endOfName, false);
+
+    const char* const closeBracket = static_cast <const char*> (memchr (endOfName, '>', (size_t) (inputEnd - endOfName)));
+
+    if (closeBracket == nullptr)
+        return setError ("unterminated end tag");
+
+    if (depth <= 0)
+        return setError ("unmatched tags");
+
+    input = closeBracket + 1;
+    attributes.clearQuick();
+    tokenDepth = --depth;
+    return currentToken = endOfElement;
+}
+
+bool XmlStreamReader::readText()
+{
+    const char* const start = input;
+    const char* const endOfText = static_cast <const char*> (memchr (input, '<', (size_t) (inputEnd - input)));
+    input = (endOfText != nullptr) ? endOfText : inputEnd;
+
+    if (depth == 0)
+        return false;   // anything outside the outer element is ignored, as XmlDocument does
+
+    bool containsEntities = false, isEmpty = true;
+
+    for (const char* t = start; t < input; ++t)
+    {
+        if (*t == '&')
+        {
+            containsEntities = true;
+            isEmpty = false;
+            break;
+        }
+
+        if (isEmpty && ! CharacterFunctions::isWhitespace (*t))
+            isEmpty = false;
+    }
+
+    if (isEmpty && ignoreEmptyTextElements)
+        return false;
+
+    currentText = Text (start, input, containsEntities);
+    tokenDepth = depth;
+    return true;
+}
+
+XmlStreamReader::TokenType XmlStreamReader::readCDATA()
+{
+    input += 9;
+    const char* const start = input;
+
+    if (! skipPast ("]]>"))
+        return setError ("unterminated CDATA section");
+
+    currentText = Text (start, input - 3, false);
+    tokenDepth = depth;
+    return currentToken = text;
+}
+
+//==============================================================================
+bool XmlStreamReader::hasTagName (const char* const possibleTagName) const noexcept
+{
+    return tagName == possibleTagName;
+}
+
+const XmlStreamReader::Text& XmlStreamReader::getAttributeName (const int attributeIndex) const noexcept
+{
+    jassert (isPositiveAndBelow (attributeIndex, attributes.size()));
+    return attributes.getReference (attributeIndex).name;
+}
+
+const XmlStreamReader::Text& XmlStreamReader::getAttributeValue (const int attributeIndex) const noexcept
+{
+    jassert (isPositiveAndBelow (attributeIndex, attributes.size()));
+    return attributes.getReference (attributeIndex).value;
+}
+
+XmlStreamReader::Text XmlStreamReader::getAttributeValue (const char* const attributeName) const noexcept
+{
+    for (int i = 0; i < attributes.size(); ++i)
+        if (attributes.getReference (i).name == attributeName)
+            return attributes.getReference (i).value;
+
+    return Text();
+}
+
+//==============================================================================
+bool XmlStreamReader::skipElement()
+{
+    jassert (currentToken == startOfElement); // this must be called at the start of an element!
+
+    const int elementDepth = tokenDepth;
+
+    for (;;)
+    {
+        const TokenType t = next();
+
+        if (t == endOfDocument || t == parseError)
+            return false;
+
+        if (t == endOfElement && tokenDepth == elementDepth)
+            return true;
+    }
+}
+
+String XmlStreamReader::readAllSubText()
+{
+    jassert (currentToken == startOfElement); // this must be called at the start of an element!
+
+    const int elementDepth = tokenDepth;
+    String result;
+
+    for (;;)
+    {
+        const TokenType t = next();
+
+        if (t == text)
+            result += currentText.toString();
+        else if (t == endOfDocument || t == parseError
+                  || (t == endOfElement && tokenDepth == elementDepth))
+            break;
+    }
+
+    return result;
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class XmlStreamReaderTests  : public UnitTest
+{
+public:
+    XmlStreamReaderTests() : UnitTest ("XmlStreamReader") {}
+
+    // Describes each token in turn, e.g. "<a x=1>[text]</a>", with "!" and the error
+    // message at the end if the reader stopped on one.
+    static String describeTokens (const char* const xml, const bool ignoreEmptyText = true)
+    {
+        XmlStreamReader reader (xml, strlen (xml));
+        reader.setEmptyTextElementsIgnored (ignoreEmptyText);
+        String s;
+
+        for (;;)
+        {
+            switch (reader.next())
+            {
+                case XmlStreamReader::startOfElement:
+                    s << '<' << reader.getTagName().toString();
+
+                    for (int i = 0; i < reader.getNumAttributes(); ++i)
+                        s << ' ' << reader.getAttributeName (i).toString() << '=' << reader.getAttributeValue (i).toString();
+
+                    s << '>';
+                    break;
+
+                case XmlStreamReader::endOfElement:     s << "</" << reader.getTagName().toString() << '>'; break;
+                case XmlStreamReader::text:             s << '[' << reader.getText().toString() << ']'; break;
+                case XmlStreamReader::parseError:       return s + "!" + reader.getLastParseError();
+                case XmlStreamReader::endOfDocument:    return s;
+                default:                                jassertfalse; return s;
+            }
+        }
+    }
+
+    void runTest()
+    {
+        beginTest ("Nesting");
+
+        expectEquals (describeTokens ("<a><b>x</b><c/>y<d><e/></d></a>"),
+                      String ("<a><b>[x]</b><c></c>[y]<d><e></e></d></a>"));
+
+        {
+            const char* const xml = "<a><b><c/></b>text</a>";
+            XmlStreamReader reader (xml, strlen (xml));
+
+            const int expectedDepths[] = { 0, 1, 2, 2, 1, 1, 0 };
+
+            for (int i = 0; i < numElementsInArray (expectedDepths); ++i)
+            {
+                expect (reader.next() != XmlStreamReader::endOfDocument);
+                expectEquals (reader.getDepth(), expectedDepths[i]);
+            }
+
+            expect (reader.next() == XmlStreamReader::endOfDocument);
+            expect (reader.next() == XmlStreamReader::endOfDocument);
+        }
+
+        {
+            const char* const xml = "<doc><skip><x>1</x><y/></skip><keep a='1'>k<i>j</i></keep></doc>";
+            XmlStreamReader reader (xml, strlen (xml));
+
+            expect (reader.next() == XmlStreamReader::startOfElement && reader.hasTagName ("doc"));
+            expect (reader.next() == XmlStreamReader::startOfElement && reader.hasTagName ("skip"));
+            expect (reader.skipElement());
+            expect (reader.getCurrentToken() == XmlStreamReader::endOfElement && reader.hasTagName ("skip"));
+            expect (reader.next() == XmlStreamReader::startOfElement && reader.hasTagName ("keep"));
+            expectEquals (reader.readAllSubText(), String ("kj"));
+            expect (reader.getCurrentToken() == XmlStreamReader::endOfElement && reader.hasTagName ("keep"));
+            expect (reader.next() == XmlStreamReader::endOfElement && reader.hasTagName ("doc"));
+            expect (reader.next() == XmlStreamReader::endOfDocument);
+        }
+
+        beginTest ("Attributes");
+
+        expectEquals (describeTokens ("<a x=\"1\" y = '2'  z=\"it's\" w='say \"hi\"'/>"),
+                      String ("<a x=1 y=2 z=it's w=say \"hi\"></a>"));
+
+        {
+            const char* const xml = "<a first=\"1\" second=\"two &amp; three\"><b/></a>";
+            XmlStreamReader reader (xml, strlen (xml));
+
+            expect (reader.next() == XmlStreamReader::startOfElement);
+            expectEquals (reader.getNumAttributes(), 2);
+            expect (reader.getAttributeName (0) == "first");
+            expectEquals (reader.getAttributeValue ("second").toString(), String ("two & three"));
+            expect (reader.getAttributeValue ("second") != "two & three");  // the raw text is unexpanded
+            expect (reader.getAttributeValue ("missing").isEmpty());
+
+            expect (reader.next() == XmlStreamReader::startOfElement);
+            expectEquals (reader.getNumAttributes(), 0);
+        }
+
+        beginTest ("Entities");
+
+        expectEquals (describeTokens ("<a>&lt;&gt;&amp;&quot;&apos; &#65;&#x42;&#X43;</a>"),
+                      String ("<a>[<>&\"' ABC]</a>"));
+        expectEquals (describeTokens ("<a>&unknown; &amp &#x20AC;</a>"),
+                      String ("<a>[&unknown; &amp ") + String::charToString (0x20ac) + "]</a>");
+        expectEquals (describeTokens ("<a>\xc2\xa3&amp;\xe2\x82\xac</a>"),
+                      String ("<a>[") + String::charToString (0xa3) + "&" + String::charToString (0x20ac) + "]</a>");
+
+        beginTest ("CDATA");
+
+        expectEquals (describeTokens ("<a><![CDATA[<b>&amp;]]]]><![CDATA[>]]></a>"),
+                      String ("<a>[<b>&amp;]]][>]</a>"));
+        expectEquals (describeTokens ("<a><![CDATA[]]></a>"), String ("<a>[]</a>"));
+
+        beginTest ("Comments, declarations and whitespace");
+
+        expectEquals (describeTokens ("\xef\xbb\xbf<?xml version=\"1.0\"?>\n"
+                                      "<!DOCTYPE a [ <!ENTITY e \"x>y\"> ]>\n"
+                                      "<!-- a <comment> -->\n"
+                                      "<a><!-- -- --> x <?pi <a>?>y</a>\n"
+                                      "<!-- trailing -->"),
+                      String ("<a>[ x ][y]</a>"));
+
+        expectEquals (describeTokens ("<a> <b/>\n</a>"), String ("<a><b></b></a>"));
+        expectEquals (describeTokens ("<a> <b/>\n</a>", false), String ("<a>[ ]<b></b>[\n]</a>"));
+        expectEquals (describeTokens ("text outside <a/> the element"), String ("<a></a>"));
+        expectEquals (describeTokens (""), String::empty);
+
+        beginTest ("Truncated input");
+
+        const char* const complete = "<a x=\"1\"><!-- c --><b>t&amp;</b><![CDATA[d]]><c/></a>";
+        const int length = (int) strlen (complete);
+
+        for (int i = 1; i < length; ++i)
+        {
+            XmlStreamReader reader (complete, (size_t) i);
+            XmlStreamReader::TokenType t;
+            int numTokens = 0;
+
+            do
+            {
+                t = reader.next();
+            }
+            while (t != XmlStreamReader::endOfDocument && t != XmlStreamReader::parseError && ++numTokens < 100);
+
+            // all of these are cut off inside the outer element, so must all fail
+            expect (t == XmlStreamReader::parseError);
+            expect (reader.getLastParseError().isNotEmpty());
+            expect (reader.next() == XmlStreamReader::parseError);
+        }
+
+        expect (! describeTokens (complete).containsChar ('!'));
+
+        beginTest ("Errors");
+
+        expectEquals (describeTokens ("<a><b></b>"), String ("<a><b></b>!unmatched tags"));
+        expectEquals (describeTokens ("<a/></a>"), String ("<a></a>!unmatched tags"));
+        expectEquals (describeTokens ("<a>< b/></a>"), String ("<a>!tag name missing"));
+        expectEquals (describeTokens ("<a x></a>"), String ("!expected '=' after attribute \"x\""));
+        expectEquals (describeTokens ("<a x=1></a>"), String ("!expected a quoted value for attribute \"x\""));
+        expectEquals (describeTokens ("<a x=\"1></a>"), String ("!unterminated attribute value"));
+        expectEquals (describeTokens ("<a ;></a>"), String ("!illegal character found in \"a\": ';'"));
+        expectEquals (describeTokens ("<a></a"), String ("<a>!unterminated end tag"));
+        expectEquals (describeTokens ("<a><!-- x</a>"), String ("<a>!unterminated comment"));
+        expectEquals (describeTokens ("<a><![CDATA[x</a>"), String ("<a>!unterminated CDATA section"));
+        expectEquals (describeTokens ("<?xml <a></a>"), String ("!unterminated processing instruction"));
+        expectEquals (describeTokens ("<!DOCTYPE a [ <a></a>"), String ("!unterminated declaration"));
+    }
+};
+
+static XmlStreamReaderTests xmlStreamReaderUnitTests;
+
+#endif
+
+END_JUCE_NAMESPACE
@@ -0,0 +1,233 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library - "Jules' Utility Class Extensions"
+   Copyright 2004-11 by Raw Material Software Ltd.
+
+  ------------------------------------------------------------------------------
+
+   JUCE can be redistributed and/or modified under the terms of the GNU General
+   Public License (Version 2), as published by the Free Software Foundation.
+   A copy of the license is included in the JUCE distribution, or can be found
+   online at www.gnu.org/licenses.
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.rawmaterialsoftware.com/juce for more information.
+
+  ==============================================================================
+*/
+
+#ifndef __JUCE_XMLSTREAMREADER_JUCEHEADER__
+#define __JUCE_XMLSTREAMREADER_JUCEHEADER__
+
+#include "../files/juce_File.h"
+#include "../files/juce_MemoryMappedFile.h"
+#include "../memory/juce_MemoryBlock.h"
+#include "../memory/juce_ScopedPointer.h"
+#include "../containers/juce_Array.h"
+class InputStream;
+
+
+//==============================================================================
+/**
+    Reads through an XML document one piece at a time, without building a tree of
+    XmlElement objects.
+
+    Where an XmlDocument has to parse a whole file and copy every tag name, attribute
+    and piece of text into a String before you can look at any of it, this class just
+    steps through the raw data, and hands back pointers into it. That makes it much
+    quicker when you only need a small part of a large document, e.g. to find one
+    element and read its text.
+
+    Each call to next() moves on to the next start tag, end tag or block of text. An
+    empty element such as \<foo/\> is reported as a start followed by an end, so the two
+    always match up. Comments, processing instructions and DOCTYPE declarations are
+    skipped, and CDATA sections are returned as text.
+
+    The data must be UTF-8 (or plain ASCII), and it has to stay in memory while the
+    reader and any Text objects that it returned are in use. The reader doesn't check
+    that the document is valid, and it doesn't load any external entities.
+
+    e.g.
+    @code
+
+    XmlStreamReader reader (File ("myfile.xml"));
+
+    while (reader.next() == XmlStreamReader::startOfElement)
+    {
+        if (reader.hasTagName ("title"))
+        {
+            String title (reader.readAllSubText());
+            ...etc
+    @endcode
+
+    @see XmlDocument, XmlElement
+*/
+class JUCE_API  XmlStreamReader
+{
+public:
+    //==============================================================================
+    /** Creates a reader for a block of XML data.
+        The data isn't copied, so it must remain valid for as long as the reader is used.
+    */
+    XmlStreamReader (const void* xmlData, size_t numBytes);
+
+    /** Creates a reader for a file.
+        The file is mapped into memory rather than being loaded.
+    */
+    explicit XmlStreamReader (const File& file);
+
+    /** Creates a reader for the contents of a stream.
+        The remainder of the stream is read into memory before parsing begins.
+    */
+    explicit XmlStreamReader (InputStream& input);
+
+    /** Destructor. */
+    ~XmlStreamReader();
+
+    //==============================================================================
+    /** A piece of the document's text.
+
+        This just points into the data that's being read, so it's cheap to create and
+        compare, but it only remains valid while the reader's data does.
+    */
+    class JUCE_API  Text
+    {
+    public:
+        Text() noexcept;
+        Text (const char* start, const char* end, bool containsEntities) noexcept;
+
+        /** Returns true if this is an empty string. */
+        bool isEmpty() const noexcept               { return start == end; }
+
+        /** Returns the number of bytes of UTF-8 data in the text. */
+        int getNumBytes() const noexcept            { return (int) (end - start); }
+
+        /** Compares the raw text with a null-terminated UTF-8 string. */
+        bool operator== (const char* other) const noexcept;
+        /** Compares the raw text with a null-terminated UTF-8 string. */
+        bool operator!= (const char* other) const noexcept;
+
+        /** Returns the text as a String, with any entities (e.g. "&amp;") replaced by
+            the characters that they stand for.
+        */
+        String toString() const;
+
+    private:
+        const char* start;
+        const char* end;
+        bool containsEntities;
+    };
+
+    //==============================================================================
+    /** The kinds of token that next() can return. */
+    enum TokenType
+    {
+        startOfElement,     /**< A start tag, e.g. \<foo bar="1"\> or \<foo/\>. */
+        endOfElement,       /**< An end tag, e.g. \</foo\>, or the end of an empty element. */
+        text,               /**< A block of text or a CDATA section. */
+        endOfDocument,      /**< The end of the data has been reached. */
+        parseError          /**< The document is malformed - see getLastParseError(). */
+    };
+
+    /** Moves on to the next token in the document, and returns its type.
+        Once the end of the document or an error has been reached, this will keep
+        returning the same thing.
+    */
+    TokenType next();
+
+    /** Returns the type of the token that the last call to next() found. */
+    TokenType getCurrentToken() const noexcept                  { return currentToken; }
+
+    /** Returns the number of elements that enclose the current token.
+        For the document's outer element, this is 0 for both its start and end tags, and
+        the text and elements directly inside it have a depth of 1.
+    */
+    int getDepth() const noexcept                               { return tokenDepth; }
+
+    //==============================================================================
+    /** Returns the tag name of the current start or end tag. */
+    const Text& getTagName() const noexcept                     { return tagName; }
+
+    /** Tests whether the current start or end tag has the given name. */
+    bool hasTagName (const char* possibleTagName) const noexcept;
+
+    /** Returns the number of attributes of the current start tag. */
+    int getNumAttributes() const noexcept                       { return attributes.size(); }
+
+    /** Returns the name of one of the current start tag's attributes. */
+    const Text& getAttributeName (int attributeIndex) const noexcept;
+
+    /** Returns the value of one of the current start tag's attributes. */
+    const Text& getAttributeValue (int attributeIndex) const noexcept;
+
+    /** Returns the value of the current start tag's attribute with the given name, or an
+        empty Text if it doesn't have that attribute.
+    */
+    Text getAttributeValue (const char* attributeName) const noexcept;
+
+    /** Returns the current block of text. */
+    const Text& getText() const noexcept                        { return currentText; }
+
+    //==============================================================================
+    /** When positioned at a start tag, this moves past the element's end tag without
+        returning any of the tokens in between.
+        @returns false if the end of the document or an error was reached first
+    */
+    bool skipElement();
+
+    /** When positioned at a start tag, this returns all the text inside the element and
+        any elements within it, and leaves the reader at the element's end tag.
+        This produces the same result as XmlElement::getAllSubText().
+    */
+    String readAllSubText();
+
+    /** Sets a flag to change the treatment of blocks of text that contain only whitespace.
+        If true (the default), next() skips these rather than returning them as text.
+        @see XmlDocument::setEmptyTextElementsIgnored
+    */
+    void setEmptyTextElementsIgnored (bool shouldBeIgnored) noexcept;
+
+    /** Returns a description of the error that stopped the reader, if there was one. */
+    const String& getLastParseError() const noexcept            { return lastError; }
+
+private:
+    //==============================================================================
+    struct Attribute
+    {
+        Text name, value;
+    };
+
+    ScopedPointer<MemoryMappedFile> mappedFile;
+    MemoryBlock loadedData;
+    const char* input;
+    const char* inputEnd;
+    TokenType currentToken;
+    int depth, tokenDepth;
+    bool ignoreEmptyTextElements, elementIsEmpty;
+    Text tagName, currentText;
+    Array<Attribute> attributes;
+    String lastError;
+
+    void setData (const void*, size_t) noexcept;
+    TokenType setError (const String&);
+    TokenType readStartTag();
+    TokenType readEndTag();
+    bool readText();
+    TokenType readCDATA();
+    bool skipPast (const char* terminator) noexcept;
+    bool skipDeclaration() noexcept;
+    void skipWhitespace() noexcept;
+    const char* findEndOfName() const noexcept;
+    bool startsWith (const char* s) const noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE (XmlStreamReader);
+};
+
+#endif   // __JUCE_XMLSTREAMREADER_JUCEHEADER__
@@ -59,7 +59,9 @@ public:
 private:
     friend class MessageListener;
     friend class MessageManager;
+    friend class InternalMessageQueue;
     MessageListener* messageRecipient;
+    Atomic<Message*> nextInQueue;   // links the messages that are waiting in a platform's message queue
 
     // Avoid the leak-detector because for plugins, the host can unload our DLL with undelivered
     // messages still in the system event queue. These aren't harmful, but can cause annoying assertions.
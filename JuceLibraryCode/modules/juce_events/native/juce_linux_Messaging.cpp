@@ -39,48 +39,66 @@ ScopedXLock::ScopedXLock()       { XLockDisplay (display); }
 ScopedXLock::~ScopedXLock()      { XUnlockDisplay (display); }
 
 //==============================================================================
+/*  Holds the messages that are waiting to be delivered on the message thread.
+
+    Messages are posted without taking a lock: they're linked into a list through their
+    nextInQueue pointers, using Dmitry Vyukov's intrusive multiple-producer, single-consumer
+    queue. A thread only writes to the eventfd if the message thread hasn't already been
+    woken up, so a burst of posts costs one system call, and the messages that have arrived
+    are then delivered in batches.
+*/
 class InternalMessageQueue
 {
 public:
     InternalMessageQueue()
-        : bytesInSocket (0),
+        : head (&stub),
+          tail (&stub),
+          wakeUpFd (eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)),
+          pollFd (epoll_create1 (EPOLL_CLOEXEC)),
+          displayFd (-1),
           totalEventCount (0)
     {
-        int ret = ::socketpair (AF_LOCAL, SOCK_STREAM, 0, fd);
-        (void) ret; jassert (ret == 0);
+        jassert (wakeUpFd >= 0 && pollFd >= 0);
+        addToPoll (wakeUpFd);
     }
 
     ~InternalMessageQueue()
     {
-        close (fd[0]);
-        close (fd[1]);
+        for (;;)
+        {
+            Message* const msg = pop();
+
+            if (msg == nullptr)
+                break;
+
+            msg->decReferenceCount();
+        }
+
+        close (pollFd);
+        close (wakeUpFd);
 
         clearSingletonInstance();
     }
 
     //==============================================================================
-    void postMessage (Message* msg)
+    void postMessage (Message* const msg)
     {
-        const int maxBytesInSocketQueue = 128;
+        msg->incReferenceCount();
+        push (msg);
 
-        ScopedLock sl (lock);
-        queue.add (msg);
-
-        if (bytesInSocket < maxBytesInSocketQueue)
+        if (wakeUpPending.compareAndSetBool (1, 0))
         {
-            ++bytesInSocket;
-
-            ScopedUnlock ul (lock);
-            const unsigned char x = 0xff;
-            size_t bytesWritten = write (fd[0], &x, 1);
+            const uint64 one = 1;
+            ssize_t bytesWritten = write (wakeUpFd, &one, sizeof (one));
             (void) bytesWritten;
         }
     }
 
-    bool isEmpty() const
+    bool isEmpty() const noexcept
     {
-        ScopedLock sl (lock);
-        return queue.size() == 0;
+        // (if a message is half-way through being posted, this may say that the queue's
+        // empty, but the thread that's posting it will wake us up when it's finished)
+        return tail == &stub && stub.nextInQueue.get() == nullptr;
     }
 
     bool dispatchNextEvent()
@@ -88,9 +106,9 @@ public:
         // This alternates between giving priority to XEvents or internal messages,
         // to keep everything running smoothly..
         if ((++totalEventCount & 1) != 0)
-            return dispatchNextXEvent() || dispatchNextInternalMessage();
+            return dispatchNextXEvent() || dispatchNextInternalMessages();
         else
-            return dispatchNextInternalMessage() || dispatchNextXEvent();
+            return dispatchNextInternalMessages() || dispatchNextXEvent();
     }
 
     // Wait for an event (either XEvent, or an internal Message)
@@ -102,52 +120,103 @@ public:
         if (display != 0)
         {
             ScopedXLock xlock;
+
+            if (displayFd < 0)
+            {
+                displayFd = XConnectionNumber (display);
+                addToPoll (displayFd);
+            }
+
             if (XPending (display))
                 return true;
         }
 
-        struct timeval tv;
-        tv.tv_sec = 0;
-        tv.tv_usec = timeoutMs * 1000;
-        int fd0 = getWaitHandle();
-        int fdmax = fd0;
-
-        fd_set readset;
-        FD_ZERO (&readset);
-        FD_SET (fd0, &readset);
+        epoll_event events[2];
+        const int numEvents = epoll_wait (pollFd, events, numElementsInArray (events), timeoutMs);
 
-        if (display != 0)
-        {
-            ScopedXLock xlock;
-            int fd1 = XConnectionNumber (display);
-            FD_SET (fd1, &readset);
-            fdmax = jmax (fd0, fd1);
-        }
+        // A thread can write to the eventfd just after we've cleared wakeUpPending, which
+        // leaves it readable with no flag set - it has to be drained here, or epoll would
+        // keep returning it straight away.
+        for (int i = 0; i < numEvents; ++i)
+            if (events[i].data.fd == wakeUpFd)
+                drainWakeUpFd();
 
-        const int ret = select (fdmax + 1, &readset, 0, 0, &tv);
-        return (ret > 0); // ret <= 0 if error or timeout
+        return numEvents > 0;
     }
 
     //==============================================================================
     juce_DeclareSingleton_SingleThreaded_Minimal (InternalMessageQueue);
 
 private:
-    CriticalSection lock;
-    ReferenceCountedArray <Message> queue;
-    int fd[2];
-    int bytesInSocket;
+    Message stub;
+    Atomic<Message*> head;   // the last message that was posted
+    Message* tail;           // the next message to deliver - only used by the message thread
+    Atomic<int> wakeUpPending;
+    const int wakeUpFd, pollFd;
+    int displayFd;
     int totalEventCount;
 
-    int getWaitHandle() const noexcept      { return fd[1]; }
+    enum { maxMessagesPerBatch = 64 };
 
-    static bool setNonBlocking (int handle)
+    void addToPoll (const int fd)
     {
-        int socketFlags = fcntl (handle, F_GETFL, 0);
-        if (socketFlags == -1)
-            return false;
+        epoll_event ev;
+        zerostruct (ev);
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+
+        const int ret = epoll_ctl (pollFd, EPOLL_CTL_ADD, fd, &ev);
+        (void) ret; jassert (ret == 0);
+    }
+
+    void drainWakeUpFd() const noexcept
+    {
+        uint64 count;
+        ssize_t bytesRead = read (wakeUpFd, &count, sizeof (count));
+        (void) bytesRead;
+    }
 
-        socketFlags |= O_NONBLOCK;
-        return fcntl (handle, F_SETFL, socketFlags) == 0;
+    void push (Message* const msg) noexcept
+    {
+        msg->nextInQueue = (Message*) nullptr;
+        Message* const previous = head.exchange (msg);
+        previous->nextInQueue = msg;
+    }
+
+    Message* pop() noexcept
+    {
+        Message* first = tail;
+        Message* next = first->nextInQueue.get();
+
+        if (first == &stub)
+        {
+            if (next == nullptr)
+                return nullptr;
+
+            tail = first = next;
+            next = next->nextInQueue.get();
+        }
+
+        if (next != nullptr)
+        {
+            tail = next;
+            return first;
+        }
+
+        if (first != head.get())
+            return nullptr;  // another thread is half-way through posting a message
+
+        // The stub goes back on the end, so that the last message can be removed..
+        push (&stub);
+        next = first->nextInQueue.get();
+
+        if (next != nullptr)
+        {
+            tail = next;
+            return first;
+        }
+
+        return nullptr;
     }
 
     static bool dispatchNextXEvent()
@@ -173,33 +242,35 @@ private:
         return true;
     }
 
-    Message::Ptr popNextMessage()
+    bool dispatchNextInternalMessages()
     {
-        const ScopedLock sl (lock);
-
-        if (bytesInSocket > 0)
+        if (wakeUpPending.get() != 0)
         {
-            --bytesInSocket;
-
-            const ScopedUnlock ul (lock);
-            unsigned char x;
-            size_t numBytes = read (fd[1], &x, 1);
-            (void) numBytes;
+            // Any messages that are posted after the flag is cleared will wake us up again.
+            drainWakeUpFd();
+            wakeUpPending = 0;
         }
 
-        return queue.removeAndReturn (0);
-    }
+        int numDispatched = 0;
 
-    bool dispatchNextInternalMessage()
-    {
-        const Message::Ptr msg (popNextMessage());
+        while (numDispatched < maxMessagesPerBatch)
+        {
+            Message* const msg = pop();
 
-        if (msg == nullptr)
-            return false;
+            if (msg == nullptr)
+                break;
 
-        MessageManager::getInstance()->deliverMessage (msg);
-        return true;
+            const Message::Ptr deleter (msg);
+            msg->decReferenceCount();
+
+            MessageManager::getInstance()->deliverMessage (msg);
+            ++numDispatched;
+        }
+
+        return numDispatched > 0;
     }
+
+    JUCE_DECLARE_NON_COPYABLE (InternalMessageQueue);
 };
 
 juce_ImplementSingleton_SingleThreaded (InternalMessageQueue);
@@ -432,3 +503,232 @@ bool MessageManager::dispatchNextMessageOnSystemQueue (bool returnIfNoPendingMes
 
     return false;
 }
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class InternalMessageQueueTests  : public UnitTest
+{
+public:
+    InternalMessageQueueTests() : UnitTest ("InternalMessageQueue") {}
+
+    // (these are only touched by the message thread)
+    struct Results
+    {
+        Array<int64> latencies;
+        Array<int> lastSequenceNumbers;
+        int numReceived;
+        bool allInOrder;
+    };
+
+    class TimedMessage  : public CallbackMessage
+    {
+    public:
+        TimedMessage (Results& results_, const int producer_, const int sequenceNumber_)
+            : results (results_), producer (producer_), sequenceNumber (sequenceNumber_),
+              timePosted (Time::getHighResolutionTicks())
+        {
+        }
+
+        void messageCallback()
+        {
+            results.latencies.add (Time::getHighResolutionTicks() - timePosted);
+
+            if (sequenceNumber != results.lastSequenceNumbers [producer] + 1)
+                results.allInOrder = false;
+
+            results.lastSequenceNumbers.set (producer, sequenceNumber);
+            ++results.numReceived;
+        }
+
+    private:
+        Results& results;
+        const int producer, sequenceNumber;
+        const int64 timePosted;
+    };
+
+    class Producer  : public Thread
+    {
+    public:
+        Producer (Results& results_, const int index_, const int numMessages_)
+            : Thread ("Message queue test"),
+              results (results_), index (index_), numMessages (numMessages_), timeFinished (0)
+        {
+        }
+
+        void run()
+        {
+            for (int i = 0; i < numMessages; ++i)
+                (new TimedMessage (results, index, i))->post();
+
+            timeFinished = Time::getHighResolutionTicks();
+        }
+
+        Results& results;
+        const int index, numMessages;
+        int64 timeFinished;
+    };
+
+    String getLatencyPercentile (const Results& results, const double percentile) const
+    {
+        const int index = jmin (results.latencies.size() - 1, (int) (results.latencies.size() * percentile / 100.0));
+        return String (Time::highResolutionTicksToSeconds (results.latencies [index]) * 1.0e6, 1) + "us";
+    }
+
+    void runTest()
+    {
+        beginTest ("Posting from many threads");
+
+        InternalMessageQueue* const queue = InternalMessageQueue::getInstanceWithoutCreating();
+
+        // The messages can only be taken off the queue by the message thread.
+        if (queue == nullptr || ! MessageManager::getInstance()->isThisTheMessageThread())
+        {
+            logMessage ("Skipped - this must be run on the message thread");
+            return;
+        }
+
+        const int numProducers = 4;
+        const int messagesPerProducer = 25000;
+        const int totalMessages = numProducers * messagesPerProducer;
+
+        Results results;
+        results.latencies.ensureStorageAllocated (totalMessages);
+        results.lastSequenceNumbers.insertMultiple (0, -1, numProducers);
+        results.numReceived = 0;
+        results.allInOrder = true;
+
+        OwnedArray<Producer> producers;
+
+        for (int i = 0; i < numProducers; ++i)
+            producers.add (new Producer (results, i, messagesPerProducer));
+
+        const int64 startTime = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numProducers; ++i)
+            producers.getUnchecked (i)->startThread();
+
+        const uint32 timeoutTime = Time::getMillisecondCounter() + 30000;
+
+        while (results.numReceived < totalMessages && Time::getMillisecondCounter() < timeoutTime)
+            if (! queue->dispatchNextEvent())
+                queue->sleepUntilEvent (100);
+
+        const int64 endTime = Time::getHighResolutionTicks();
+        int64 lastPostTime = startTime;
+
+        for (int i = 0; i < numProducers; ++i)
+        {
+            producers.getUnchecked (i)->stopThread (5000);
+            lastPostTime = jmax (lastPostTime, producers.getUnchecked (i)->timeFinished);
+        }
+
+        expectEquals (results.numReceived, totalMessages);
+        expect (results.allInOrder);
+
+        DefaultElementComparator<int64> comparator;
+        results.latencies.sort (comparator);
+
+        logMessage (String (totalMessages) + " messages from " + String (numProducers) + " threads: "
+                      + String (roundToInt (totalMessages / Time::highResolutionTicksToSeconds (lastPostTime - startTime))) + " posts/sec, "
+                      + String (roundToInt (results.numReceived / Time::highResolutionTicksToSeconds (endTime - startTime))) + " deliveries/sec");
+
+        logMessage ("Latency: 50% " + getLatencyPercentile (results, 50.0)
+                      + ", 90% " + getLatencyPercentile (results, 90.0)
+                      + ", 99% " + getLatencyPercentile (results, 99.0)
+                      + ", 99.9% " + getLatencyPercentile (results, 99.9)
+                      + ", max " + getLatencyPercentile (results, 100.0));
+
+        checkQueueGoesIdle (*queue);
+
+        runWorkerThreadTest (*queue);
+    }
+
+    //==============================================================================
+    class SinglePoster  : public Thread
+    {
+    public:
+        SinglePoster (Results& results_, const int numMessages_)
+            : Thread ("Message queue test"), results (results_), numMessages (numMessages_)
+        {
+        }
+
+        void run()
+        {
+            for (int i = 0; i < numMessages && ! threadShouldExit(); ++i)
+            {
+                (new TimedMessage (results, 0, i))->post();
+                posted.signal();
+
+                if (! readyForNext.wait (5000))
+                    break;
+            }
+        }
+
+        Results& results;
+        const int numMessages;
+        WaitableEvent posted, readyForNext;
+    };
+
+    // Once everything's been delivered, the wake-up fd mustn't be left readable, or the
+    // message thread would spin instead of sleeping.
+    void checkQueueGoesIdle (InternalMessageQueue& queue)
+    {
+        while (queue.dispatchNextEvent())
+        {}
+
+        int numWakeUps = 0;
+
+        while (numWakeUps < 2 && queue.sleepUntilEvent (0))
+        {
+            ++numWakeUps;
+
+            while (queue.dispatchNextEvent())
+            {}
+        }
+
+        expect (numWakeUps < 2);
+    }
+
+    void runWorkerThreadTest (InternalMessageQueue& queue)
+    {
+        beginTest ("Posting from a worker thread");
+
+        const int numMessages = 2000;
+
+        Results results;
+        results.lastSequenceNumbers.add (-1);
+        results.numReceived = 0;
+        results.allInOrder = true;
+
+        SinglePoster poster (results, numMessages);
+        poster.startThread();
+
+        for (int i = 0; i < numMessages; ++i)
+        {
+            const uint32 timeoutTime = Time::getMillisecondCounter() + 5000;
+
+            while (results.numReceived <= i && Time::getMillisecondCounter() < timeoutTime)
+                if (! queue.dispatchNextEvent())
+                    queue.sleepUntilEvent (100);
+
+            if (results.numReceived <= i)
+                break;
+
+            // The message can be delivered before the poster has written to the eventfd, so
+            // wait until it has before checking that the queue's gone back to sleep.
+            poster.posted.wait (5000);
+            checkQueueGoesIdle (queue);
+            poster.readyForNext.signal();
+        }
+
+        poster.stopThread (5000);
+
+        expectEquals (results.numReceived, numMessages);
+        expect (results.allInOrder);
+    }
+};
+
+static InternalMessageQueueTests internalMessageQueueUnitTests;
+
+#endif
@@ -314,15 +314,14 @@ void Graphics::drawFittedText (const String& text,
          && width > 0 && height > 0
          && context->clipRegionIntersects (Rectangle<int> (x, y, width, height)))
     {
-        GlyphArrangement arr;
-
-        arr.addFittedText (context->getFont(), text,
-                           (float) x, (float) y, (float) width, (float) height,
-                           justification,
-                           maximumNumberOfLines,
-                           minimumHorizontalScale);
-
-        arr.draw (*this);
+        const TextLayoutCache::CachedGlyphs::Ptr glyphs (TextLayoutCache::getFittedText (context->getFont(), text,
+                                                                                         (float) width, (float) height,
+                                                                                         justification,
+                                                                                         maximumNumberOfLines,
+                                                                                         minimumHorizontalScale));
+
+        // (the cached glyphs were fitted into a rectangle at the origin, so the same ones can be used anywhere)
+        glyphs->getGlyphs().draw (*this, AffineTransform::translation ((float) x, (float) y));
     }
 }
 
@@ -0,0 +1,821 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library - "Jules' Utility Class Extensions"
+   Copyright 2004-11 by Raw Material Software Ltd.
+
+  ------------------------------------------------------------------------------
+
+   JUCE can be redistributed and/or modified under the terms of the GNU General
+   Public License (Version 2), as published by the Free Software Foundation.
+   A copy of the license is included in the JUCE distribution, or can be found
+   online at www.gnu.org/licenses.
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.rawmaterialsoftware.com/juce for more information.
+
+  ==============================================================================
+*/
+
+
+BEGIN_JUCE_NAMESPACE
+
+//==============================================================================
+/** A chain of large memory blocks that the recorded operations are allocated from.
+
+    Operations are only ever added to the end, and are all deleted together, so
+    allocating one is just a matter of bumping a pointer. When a recording is cleared,
+    the blocks are kept so that the next one can use them again.
+*/
+class LowLevelGraphicsRecorder::CommandBuffer
+{
+public:
+    CommandBuffer() noexcept  : currentBlock (0) {}
+
+    void* allocate (size_t numBytes)
+    {
+        numBytes = (numBytes + alignment - 1) & ~(size_t) (alignment - 1);
+
+        while (currentBlock < blocks.size())
+        {
+            Block& b = *blocks.getUnchecked (currentBlock);
+
+            if (b.used + numBytes <= b.size)
+            {
+                void* const p = b.data + b.used;
+                b.used += numBytes;
+                return p;
+            }
+
+            ++currentBlock;
+        }
+
+        Block* const b = new Block (jmax ((size_t) blockSize, numBytes));
+        blocks.add (b);
+        b->used = numBytes;
+        return b->data;
+    }
+
+    void reset() noexcept
+    {
+        for (int i = blocks.size(); --i >= 0;)
+            blocks.getUnchecked (i)->used = 0;
+
+        currentBlock = 0;
+    }
+
+    size_t getMemoryUsage() const noexcept
+    {
+        size_t total = 0;
+
+        for (int i = blocks.size(); --i >= 0;)
+            total += blocks.getUnchecked (i)->size;
+
+        return total;
+    }
+
+private:
+    struct Block
+    {
+        Block (const size_t size_)  : size (size_), used (0)     { data.malloc (size); }
+
+        HeapBlock<char> data;
+        const size_t size;
+        size_t used;
+
+        JUCE_DECLARE_NON_COPYABLE (Block);
+    };
+
+    OwnedArray<Block> blocks;
+    int currentBlock;
+
+    enum { blockSize = 16384, alignment = 16 };
+
+    JUCE_DECLARE_NON_COPYABLE (CommandBuffer);
+};
+
+//==============================================================================
+class LowLevelGraphicsRecorder::Operation
+{
+public:
+    enum Type
+    {
+        setOriginType, addTransformType,
+        clipToRectangleType, clipToRectangleListType, excludeClipRectangleType,
+        clipToPathType, clipToImageAlphaType,
+        saveStateType, restoreStateType,
+        beginTransparencyLayerType, endTransparencyLayerType,
+        setFillType, setOpacityType, setInterpolationQualityType,
+        fillRectType, fillPathType, drawImageType,
+        drawLineType, drawVerticalLineType, drawHorizontalLineType,
+        setFontType, drawGlyphType
+    };
+
+    explicit Operation (const Type type_) noexcept  : type (type_) {}
+    virtual ~Operation() {}
+
+    virtual void perform (LowLevelGraphicsContext&) const = 0;
+
+    bool isSameAs (const Operation& other) const
+    {
+        return type == other.type && hasSameParameters (other);
+    }
+
+    // Operations live in a CommandBuffer, so they're never deleted, just destroyed.
+    static void* operator new (size_t numBytes, CommandBuffer& buffer)     { return buffer.allocate (numBytes); }
+    static void operator delete (void*, CommandBuffer&) noexcept           {}
+    static void operator delete (void*) noexcept                           {}
+
+protected:
+    // This is only called with another operation of the same type.
+    virtual bool hasSameParameters (const Operation&) const = 0;
+
+private:
+    const Type type;
+
+    JUCE_DECLARE_NON_COPYABLE (Operation);
+};
+
+namespace RecordedOperations
+{
+    typedef LowLevelGraphicsRecorder::Operation Operation;
+
+    static bool areSame (const RectangleList& r1, const RectangleList& r2) noexcept
+    {
+        if (r1.getNumRectangles() != r2.getNumRectangles())
+            return false;
+
+        for (int i = r1.getNumRectangles(); --i >= 0;)
+            if (r1.getRectangle (i) != r2.getRectangle (i))
+                return false;
+
+        return true;
+    }
+
+    struct SetOrigin  : public Operation
+    {
+        SetOrigin (int x_, int y_) noexcept  : Operation (setOriginType), x (x_), y (y_) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.setOrigin (x, y); }
+        bool hasSameParameters (const Operation& other) const       { const SetOrigin& o = static_cast <const SetOrigin&> (other); return x == o.x && y == o.y; }
+        const int x, y;
+    };
+
+    struct AddTransform  : public Operation
+    {
+        AddTransform (const AffineTransform& t) noexcept  : Operation (addTransformType), transform (t) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.addTransform (transform); }
+        bool hasSameParameters (const Operation& other) const       { return transform == static_cast <const AddTransform&> (other).transform; }
+        const AffineTransform transform;
+    };
+
+    struct ClipToRectangle  : public Operation
+    {
+        ClipToRectangle (const Rectangle<int>& r) noexcept  : Operation (clipToRectangleType), area (r) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.clipToRectangle (area); }
+        bool hasSameParameters (const Operation& other) const       { return area == static_cast <const ClipToRectangle&> (other).area; }
+        const Rectangle<int> area;
+    };
+
+    struct ClipToRectangleList  : public Operation
+    {
+        ClipToRectangleList (const RectangleList& r)  : Operation (clipToRectangleListType), region (r) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.clipToRectangleList (region); }
+        bool hasSameParameters (const Operation& other) const       { return areSame (region, static_cast <const ClipToRectangleList&> (other).region); }
+        const RectangleList region;
+    };
+
+    struct ExcludeClipRectangle  : public Operation
+    {
+        ExcludeClipRectangle (const Rectangle<int>& r) noexcept  : Operation (excludeClipRectangleType), area (r) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.excludeClipRectangle (area); }
+        bool hasSameParameters (const Operation& other) const       { return area == static_cast <const ExcludeClipRectangle&> (other).area; }
+        const Rectangle<int> area;
+    };
+
+    struct ClipToPath  : public Operation
+    {
+        ClipToPath (const Path& p, const AffineTransform& t)  : Operation (clipToPathType), path (p), transform (t) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.clipToPath (path, transform); }
+        bool hasSameParameters (const Operation& other) const       { const ClipToPath& o = static_cast <const ClipToPath&> (other); return transform == o.transform && path == o.path; }
+        const Path path;
+        const AffineTransform transform;
+    };
+
+    struct ClipToImageAlpha  : public Operation
+    {
+        ClipToImageAlpha (const Image& i, const AffineTransform& t)  : Operation (clipToImageAlphaType), image (i), transform (t) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.clipToImageAlpha (image, transform); }
+        bool hasSameParameters (const Operation& other) const       { const ClipToImageAlpha& o = static_cast <const ClipToImageAlpha&> (other); return image == o.image && transform == o.transform; }
+        const Image image;
+        const AffineTransform transform;
+    };
+
+    struct SaveState  : public Operation
+    {
+        SaveState() noexcept  : Operation (saveStateType) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.saveState(); }
+        bool hasSameParameters (const Operation&) const             { return true; }
+    };
+
+    struct RestoreState  : public Operation
+    {
+        RestoreState() noexcept  : Operation (restoreStateType) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.restoreState(); }
+        bool hasSameParameters (const Operation&) const             { return true; }
+    };
+
+    struct BeginTransparencyLayer  : public Operation
+    {
+        BeginTransparencyLayer (float opacity_) noexcept  : Operation (beginTransparencyLayerType), opacity (opacity_) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.beginTransparencyLayer (opacity); }
+        bool hasSameParameters (const Operation& other) const       { return opacity == static_cast <const BeginTransparencyLayer&> (other).opacity; }
+        const float opacity;
+    };
+
+    struct EndTransparencyLayer  : public Operation
+    {
+        EndTransparencyLayer() noexcept  : Operation (endTransparencyLayerType) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.endTransparencyLayer(); }
+        bool hasSameParameters (const Operation&) const             { return true; }
+    };
+
+    struct SetFill  : public Operation
+    {
+        SetFill (const FillType& f)  : Operation (setFillType), fillType (f) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.setFill (fillType); }
+        bool hasSameParameters (const Operation& other) const       { return fillType == static_cast <const SetFill&> (other).fillType; }
+        const FillType fillType;
+    };
+
+    struct SetOpacity  : public Operation
+    {
+        SetOpacity (float opacity_) noexcept  : Operation (setOpacityType), opacity (opacity_) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.setOpacity (opacity); }
+        bool hasSameParameters (const Operation& other) const       { return opacity == static_cast <const SetOpacity&> (other).opacity; }
+        const float opacity;
+    };
+
+    struct SetInterpolationQuality  : public Operation
+    {
+        SetInterpolationQuality (Graphics::ResamplingQuality q) noexcept  : Operation (setInterpolationQualityType), quality (q) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.setInterpolationQuality (quality); }
+        bool hasSameParameters (const Operation& other) const       { return quality == static_cast <const SetInterpolationQuality&> (other).quality; }
+        const Graphics::ResamplingQuality quality;
+    };
+
+    struct FillRect  : public Operation
+    {
+        FillRect (const Rectangle<int>& r, bool replace) noexcept  : Operation (fillRectType), area (r), replaceExistingContents (replace) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.fillRect (area, replaceExistingContents); }
+        bool hasSameParameters (const Operation& other) const       { const FillRect& o = static_cast <const FillRect&> (other); return area == o.area && replaceExistingContents == o.replaceExistingContents; }
+        const Rectangle<int> area;
+        const bool replaceExistingContents;
+    };
+
+    struct FillPath  : public Operation
+    {
+        FillPath (const Path& p, const AffineTransform& t)  : Operation (fillPathType), path (p), transform (t) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.fillPath (path, transform); }
+        bool hasSameParameters (const Operation& other) const       { const FillPath& o = static_cast <const FillPath&> (other); return transform == o.transform && path == o.path; }
+        const Path path;
+        const AffineTransform transform;
+    };
+
+    struct DrawImage  : public Operation
+    {
+        DrawImage (const Image& i, const AffineTransform& t)  : Operation (drawImageType), image (i), transform (t) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.drawImage (image, transform); }
+        bool hasSameParameters (const Operation& other) const       { const DrawImage& o = static_cast <const DrawImage&> (other); return image == o.image && transform == o.transform; }
+        const Image image;
+        const AffineTransform transform;
+    };
+
+    struct DrawLine  : public Operation
+    {
+        DrawLine (const Line<float>& l) noexcept  : Operation (drawLineType), line (l) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.drawLine (line); }
+        bool hasSameParameters (const Operation& other) const       { return line == static_cast <const DrawLine&> (other).line; }
+        const Line<float> line;
+    };
+
+    struct DrawVerticalLine  : public Operation
+    {
+        DrawVerticalLine (int x_, float top_, float bottom_) noexcept  : Operation (drawVerticalLineType), x (x_), top (top_), bottom (bottom_) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.drawVerticalLine (x, top, bottom); }
+        bool hasSameParameters (const Operation& other) const       { const DrawVerticalLine& o = static_cast <const DrawVerticalLine&> (other); return x == o.x && top == o.top && bottom == o.bottom; }
+        const int x;
+        const float top, bottom;
+    };
+
+    struct DrawHorizontalLine  : public Operation
+    {
+        DrawHorizontalLine (int y_, float left_, float right_) noexcept  : Operation (drawHorizontalLineType), y (y_), left (left_), right (right_) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.drawHorizontalLine (y, left, right); }
+        bool hasSameParameters (const Operation& other) const       { const DrawHorizontalLine& o = static_cast <const DrawHorizontalLine&> (other); return y == o.y && left == o.left && right == o.right; }
+        const int y;
+        const float left, right;
+    };
+
+    struct SetFont  : public Operation
+    {
+        SetFont (const Font& f)  : Operation (setFontType), font (f) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.setFont (font); }
+        bool hasSameParameters (const Operation& other) const       { return font == static_cast <const SetFont&> (other).font; }
+        const Font font;
+    };
+
+    struct DrawGlyph  : public Operation
+    {
+        DrawGlyph (int glyph_, const AffineTransform& t) noexcept  : Operation (drawGlyphType), glyph (glyph_), transform (t) {}
+        void perform (LowLevelGraphicsContext& g) const             { g.drawGlyph (glyph, transform); }
+        bool hasSameParameters (const Operation& other) const       { const DrawGlyph& o = static_cast <const DrawGlyph&> (other); return glyph == o.glyph && transform == o.transform; }
+        const int glyph;
+        const AffineTransform transform;
+    };
+}
+
+//==============================================================================
+LowLevelGraphicsRecorder::LowLevelGraphicsRecorder (const Rectangle<int>& initialClip)
+    : buffer (new CommandBuffer())
+{
+    reset (Point<int>(), RectangleList (initialClip));
+}
+
+LowLevelGraphicsRecorder::LowLevelGraphicsRecorder (const Point<int>& origin, const RectangleList& initialClip)
+    : buffer (new CommandBuffer())
+{
+    reset (origin, initialClip);
+}
+
+LowLevelGraphicsRecorder::~LowLevelGraphicsRecorder()
+{
+    clear();
+}
+
+void LowLevelGraphicsRecorder::reset (const Point<int>& origin, const RectangleList& initialClip)
+{
+    clear();
+
+    initialOrigin = origin;
+    initialRegion = initialClip;
+    state = new LowLevelGraphicsSoftwareRenderer (Image::null, origin, initialClip);
+}
+
+void LowLevelGraphicsRecorder::clear()
+{
+    for (int i = operations.size(); --i >= 0;)
+        operations.getUnchecked (i)->~Operation();
+
+    operations.clearQuick();
+    buffer->reset();
+}
+
+void LowLevelGraphicsRecorder::replay (LowLevelGraphicsContext& target) const
+{
+    for (int i = 0; i < operations.size(); ++i)
+        operations.getUnchecked (i)->perform (target);
+}
+
+int LowLevelGraphicsRecorder::getNumOperations() const noexcept
+{
+    return operations.size();
+}
+
+size_t LowLevelGraphicsRecorder::getMemoryUsage() const noexcept
+{
+    return buffer->getMemoryUsage();
+}
+
+bool LowLevelGraphicsRecorder::operator== (const LowLevelGraphicsRecorder& other) const
+{
+    if (operations.size() != other.operations.size()
+         || initialOrigin != other.initialOrigin
+         || ! RecordedOperations::areSame (initialRegion, other.initialRegion))
+        return false;
+
+    for (int i = operations.size(); --i >= 0;)
+        if (! operations.getUnchecked (i)->isSameAs (*other.operations.getUnchecked (i)))
+            return false;
+
+    return true;
+}
+
+bool LowLevelGraphicsRecorder::operator!= (const LowLevelGraphicsRecorder& other) const
+{
+    return ! operator== (other);
+}
+
+bool LowLevelGraphicsRecorder::isVectorDevice() const
+{
+    return false;
+}
+
+//==============================================================================
+void LowLevelGraphicsRecorder::setOrigin (int x, int y)
+{
+    state->setOrigin (x, y);
+    operations.add (new (*buffer) RecordedOperations::SetOrigin (x, y));
+}
+
+void LowLevelGraphicsRecorder::addTransform (const AffineTransform& transform)
+{
+    state->addTransform (transform);
+    operations.add (new (*buffer) RecordedOperations::AddTransform (transform));
+}
+
+float LowLevelGraphicsRecorder::getScaleFactor()
+{
+    return state->getScaleFactor();
+}
+
+bool LowLevelGraphicsRecorder::clipToRectangle (const Rectangle<int>& r)
+{
+    operations.add (new (*buffer) RecordedOperations::ClipToRectangle (r));
+    return state->clipToRectangle (r);
+}
+
+bool LowLevelGraphicsRecorder::clipToRectangleList (const RectangleList& clipRegion)
+{
+    operations.add (new (*buffer) RecordedOperations::ClipToRectangleList (clipRegion));
+    return state->clipToRectangleList (clipRegion);
+}
+
+void LowLevelGraphicsRecorder::excludeClipRectangle (const Rectangle<int>& r)
+{
+    state->excludeClipRectangle (r);
+    operations.add (new (*buffer) RecordedOperations::ExcludeClipRectangle (r));
+}
+
+void LowLevelGraphicsRecorder::clipToPath (const Path& path, const AffineTransform& transform)
+{
+    state->clipToPath (path, transform);
+    operations.add (new (*buffer) RecordedOperations::ClipToPath (path, transform));
+}
+
+void LowLevelGraphicsRecorder::clipToImageAlpha (const Image& sourceImage, const AffineTransform& transform)
+{
+    state->clipToImageAlpha (sourceImage, transform);
+    operations.add (new (*buffer) RecordedOperations::ClipToImageAlpha (sourceImage, transform));
+}
+
+bool LowLevelGraphicsRecorder::clipRegionIntersects (const Rectangle<int>& r)
+{
+    return state->clipRegionIntersects (r);
+}
+
+Rectangle<int> LowLevelGraphicsRecorder::getClipBounds() const
+{
+    return state->getClipBounds();
+}
+
+bool LowLevelGraphicsRecorder::isClipEmpty() const
+{
+    return state->isClipEmpty();
+}
+
+//==============================================================================
+void LowLevelGraphicsRecorder::saveState()
+{
+    state->saveState();
+    operations.add (new (*buffer) RecordedOperations::SaveState());
+}
+
+void LowLevelGraphicsRecorder::restoreState()
+{
+    state->restoreState();
+    operations.add (new (*buffer) RecordedOperations::RestoreState());
+}
+
+// A transparency layer doesn't change the clip region as seen by the caller, so there's
+// no need for the state to allocate a real layer image - saving and restoring it is enough.
+void LowLevelGraphicsRecorder::beginTransparencyLayer (float opacity)
+{
+    state->saveState();
+    operations.add (new (*buffer) RecordedOperations::BeginTransparencyLayer (opacity));
+}
+
+void LowLevelGraphicsRecorder::endTransparencyLayer()
+{
+    state->restoreState();
+    operations.add (new (*buffer) RecordedOperations::EndTransparencyLayer());
+}
+
+//==============================================================================
+void LowLevelGraphicsRecorder::setFill (const FillType& fillType)
+{
+    state->setFill (fillType);
+    operations.add (new (*buffer) RecordedOperations::SetFill (fillType));
+}
+
+void LowLevelGraphicsRecorder::setOpacity (float newOpacity)
+{
+    state->setOpacity (newOpacity);
+    operations.add (new (*buffer) RecordedOperations::SetOpacity (newOpacity));
+}
+
+void LowLevelGraphicsRecorder::setInterpolationQuality (Graphics::ResamplingQuality quality)
+{
+    state->setInterpolationQuality (quality);
+    operations.add (new (*buffer) RecordedOperations::SetInterpolationQuality (quality));
+}
+
+//==============================================================================
+// Anything drawn while the clip region is empty would be invisible in the target too,
+// so drawing operations are only recorded when there's somewhere for them to go.
+void LowLevelGraphicsRecorder::fillRect (const Rectangle<int>& r, bool replaceExistingContents)
+{
+    if (! state->isClipEmpty())
+        operations.add (new (*buffer) RecordedOperations::FillRect (r, replaceExistingContents));
+}
+
+void LowLevelGraphicsRecorder::fillPath (const Path& path, const AffineTransform& transform)
+{
+    if (! state->isClipEmpty())
+        operations.add (new (*buffer) RecordedOperations::FillPath (path, transform));
+}
+
+void LowLevelGraphicsRecorder::drawImage (const Image& sourceImage, const AffineTransform& transform)
+{
+    if (! state->isClipEmpty())
+        operations.add (new (*buffer) RecordedOperations::DrawImage (sourceImage, transform));
+}
+
+void LowLevelGraphicsRecorder::drawLine (const Line <float>& line)
+{
+    if (! state->isClipEmpty())
+        operations.add (new (*buffer) RecordedOperations::DrawLine (line));
+}
+
+void LowLevelGraphicsRecorder::drawVerticalLine (int x, float top, float bottom)
+{
+    if (! state->isClipEmpty())
+        operations.add (new (*buffer) RecordedOperations::DrawVerticalLine (x, top, bottom));
+}
+
+void LowLevelGraphicsRecorder::drawHorizontalLine (int y, float left, float right)
+{
+    if (! state->isClipEmpty())
+        operations.add (new (*buffer) RecordedOperations::DrawHorizontalLine (y, left, right));
+}
+
+//==============================================================================
+void LowLevelGraphicsRecorder::setFont (const Font& newFont)
+{
+    // Font looks up its typeface lazily, which isn't thread-safe, so make sure that
+    // this has been done before the recording can be used anywhere else.
+    newFont.getTypeface();
+
+    state->setFont (newFont);
+    operations.add (new (*buffer) RecordedOperations::SetFont (newFont));
+}
+
+Font LowLevelGraphicsRecorder::getFont()
+{
+    return state->getFont();
+}
+
+void LowLevelGraphicsRecorder::drawGlyph (int glyphNumber, const AffineTransform& transform)
+{
+    if (! state->isClipEmpty())
+        operations.add (new (*buffer) RecordedOperations::DrawGlyph (glyphNumber, transform));
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class LowLevelGraphicsRecorderTests  : public UnitTest
+{
+public:
+    LowLevelGraphicsRecorderTests() : UnitTest ("LowLevelGraphicsRecorder") {}
+
+    static void drawRandomStuff (Graphics& g, Random& r, const int w, const int h)
+    {
+        for (int i = 0; i < 40; ++i)
+        {
+            g.saveState();
+
+            if (r.nextInt (4) == 0)
+                g.addTransform (AffineTransform::rotation (r.nextFloat() - 0.5f, w * 0.5f, h * 0.5f));
+            else
+                g.setOrigin (r.nextInt (40) - 20, r.nextInt (40) - 20);
+
+            if (r.nextInt (4) == 0)
+                g.reduceClipRegion (r.nextInt (w), r.nextInt (h), r.nextInt (w), r.nextInt (h));
+
+            if (r.nextInt (3) == 0)
+                g.setGradientFill (ColourGradient (Colour ((uint32) r.nextInt()), r.nextFloat() * w, r.nextFloat() * h,
+                                                   Colour ((uint32) r.nextInt()), r.nextFloat() * w, r.nextFloat() * h, r.nextBool()));
+            else
+                g.setColour (Colour ((uint32) r.nextInt()));
+
+            const bool useLayer = (r.nextInt (6) == 0);
+
+            if (useLayer)
+                g.beginTransparencyLayer (r.nextFloat());
+
+            switch (r.nextInt (4))
+            {
+                case 0:  g.fillRect (r.nextInt (w), r.nextInt (h), r.nextInt (w), r.nextInt (h)); break;
+                case 1:  g.fillEllipse (r.nextFloat() * w, r.nextFloat() * h, r.nextFloat() * w, r.nextFloat() * h); break;
+                case 2:  g.drawLine (r.nextFloat() * w, r.nextFloat() * h, r.nextFloat() * w, r.nextFloat() * h, 1.0f + r.nextFloat() * 5.0f); break;
+                default: g.setFont (8.0f + r.nextFloat() * 30.0f); g.drawSingleLineText ("Hello world", r.nextInt (w), r.nextInt (h)); break;
+            }
+
+            if (useLayer)
+                g.endTransparencyLayer();
+
+            g.restoreState();
+        }
+    }
+
+    // Everything here is drawn through transparency layers, some of them nested, and with
+    // clip regions that stretch across several bands.
+    static void drawLayers (Graphics& g, Random& r, const int w, const int h)
+    {
+        for (int i = 0; i < 20; ++i)
+        {
+            g.saveState();
+
+            if (r.nextBool())
+                g.addTransform (AffineTransform::rotation (r.nextFloat() - 0.5f, w * 0.5f, h * 0.5f)
+                                                .scaled (0.5f + r.nextFloat(), 0.5f + r.nextFloat()));
+            else
+                g.setOrigin (r.nextInt (40) - 20, r.nextInt (40) - 20);
+
+            if (r.nextBool())
+                g.reduceClipRegion (r.nextInt (w / 2), r.nextInt (h / 2), w / 4 + r.nextInt (w), h / 4 + r.nextInt (h));
+
+            g.beginTransparencyLayer (0.2f + 0.8f * r.nextFloat());
+            g.setColour (Colour ((uint32) r.nextInt()));
+            g.fillEllipse (r.nextFloat() * w, r.nextFloat() * h, r.nextFloat() * w, r.nextFloat() * h);
+
+            if (r.nextBool())
+            {
+                g.beginTransparencyLayer (r.nextFloat());
+                g.setGradientFill (ColourGradient (Colour ((uint32) r.nextInt()), r.nextFloat() * w, r.nextFloat() * h,
+                                                   Colour ((uint32) r.nextInt()), r.nextFloat() * w, r.nextFloat() * h, r.nextBool()));
+                g.fillRect (r.nextInt (w), r.nextInt (h), r.nextInt (w), r.nextInt (h));
+                g.endTransparencyLayer();
+            }
+
+            g.setColour (Colour ((uint32) r.nextInt()));
+            g.drawLine (r.nextFloat() * w, r.nextFloat() * h, r.nextFloat() * w, r.nextFloat() * h, 1.0f + r.nextFloat() * 5.0f);
+            g.endTransparencyLayer();
+
+            g.restoreState();
+        }
+    }
+
+    static bool imagesAreIdentical (const Image& a, const Image& b)
+    {
+        const Image::BitmapData d1 (a, Image::BitmapData::readOnly);
+        const Image::BitmapData d2 (b, Image::BitmapData::readOnly);
+
+        for (int y = 0; y < a.getHeight(); ++y)
+            if (memcmp (d1.getLinePointer (y), d2.getLinePointer (y), (size_t) (a.getWidth() * d1.pixelStride)) != 0)
+                return false;
+
+        return true;
+    }
+
+    void runTest()
+    {
+        beginTest ("Replaying and rendering in bands");
+
+        const int oldNumThreads = LowLevelGraphicsSoftwareRenderer::getNumRenderingThreads();
+        LowLevelGraphicsSoftwareRenderer::setNumRenderingThreads (4);
+
+        Random r;
+        const int w = 400, h = 300;
+
+        for (int i = 0; i < 20; ++i)
+        {
+            const int seed = r.nextInt();
+            const Image::PixelFormat format = r.nextBool() ? Image::ARGB : Image::RGB;
+
+            RectangleList clip (Rectangle<int> (5, 5, 200, 280));
+            clip.add (Rectangle<int> (220, 40, 170, 200));
+
+            Image direct (format, w, h, true, SoftwareImageType());
+
+            {
+                LowLevelGraphicsSoftwareRenderer context (direct, Point<int>(), clip);
+                Graphics g (&context);
+                Random r2 (seed);
+                drawRandomStuff (g, r2, w, h);
+            }
+
+            LowLevelGraphicsRecorder recorder (Point<int>(), clip);
+
+            {
+                Graphics g (&recorder);
+                Random r2 (seed);
+                drawRandomStuff (g, r2, w, h);
+            }
+
+            Image replayed (format, w, h, true, SoftwareImageType());
+
+            {
+                LowLevelGraphicsSoftwareRenderer context (replayed, Point<int>(), clip);
+                recorder.replay (context);
+            }
+
+            expect (imagesAreIdentical (direct, replayed));
+
+            Image banded (format, w, h, true, SoftwareImageType());
+            LowLevelGraphicsSoftwareRenderer::renderInBands (recorder, banded, Point<int>(), clip);
+
+            expect (imagesAreIdentical (direct, banded));
+        }
+
+        beginTest ("Transparency layers in bands");
+
+        for (int i = 0; i < 20; ++i)
+        {
+            const int seed = r.nextInt();
+            const Image::PixelFormat format = r.nextBool() ? Image::ARGB : Image::RGB;
+            const RectangleList clip (Rectangle<int> (3, 7, w - 10, h - 12));
+
+            Image direct (format, w, h, true, SoftwareImageType());
+
+            {
+                LowLevelGraphicsSoftwareRenderer context (direct, Point<int>(), clip);
+                Graphics g (&context);
+                Random r2 (seed);
+                drawLayers (g, r2, w, h);
+            }
+
+            LowLevelGraphicsRecorder recorder (Point<int>(), clip);
+
+            {
+                Graphics g (&recorder);
+                Random r2 (seed);
+                drawLayers (g, r2, w, h);
+            }
+
+            Image banded (format, w, h, true, SoftwareImageType());
+            LowLevelGraphicsSoftwareRenderer::renderInBands (recorder, banded, Point<int>(), clip);
+
+            expect (imagesAreIdentical (direct, banded));
+        }
+
+        LowLevelGraphicsSoftwareRenderer::setNumRenderingThreads (oldNumThreads);
+
+        beginTest ("Comparing");
+
+        const RectangleList clip (Rectangle<int> (0, 0, w, h));
+        LowLevelGraphicsRecorder first (Point<int>(), clip), second (Point<int>(), clip);
+
+        for (int i = 0; i < 20; ++i)
+        {
+            const int seed = r.nextInt();
+
+            first.reset (Point<int>(), clip);
+            second.reset (Point<int>(), clip);
+
+            {
+                Graphics g (&first);
+                Random r2 (seed);
+                drawRandomStuff (g, r2, w, h);
+            }
+
+            {
+                Graphics g (&second);
+                Random r2 (seed);
+                drawRandomStuff (g, r2, w, h);
+            }
+
+            expect (first == second);
+
+            {
+                Graphics g (&second);
+                g.setColour (Colours::red);
+                g.fillRect (r.nextInt (w), r.nextInt (h), 1 + r.nextInt (w), 1 + r.nextInt (h));
+            }
+
+            expect (first != second);
+
+            second.reset (Point<int> (1, 0), clip);
+
+            {
+                Graphics g (&second);
+                Random r2 (seed);
+                drawRandomStuff (g, r2, w, h);
+            }
+
+            expect (first != second);
+        }
+    }
+};
+
+static LowLevelGraphicsRecorderTests lowLevelGraphicsRecorderUnitTests;
+
+#endif
+
+END_JUCE_NAMESPACE
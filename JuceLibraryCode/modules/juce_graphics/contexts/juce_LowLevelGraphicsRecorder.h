@@ -0,0 +1,169 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library - "Jules' Utility Class Extensions"
+   Copyright 2004-11 by Raw Material Software Ltd.
+
+  ------------------------------------------------------------------------------
+
+   JUCE can be redistributed and/or modified under the terms of the GNU General
+   Public License (Version 2), as published by the Free Software Foundation.
+   A copy of the license is included in the JUCE distribution, or can be found
+   online at www.gnu.org/licenses.
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.rawmaterialsoftware.com/juce for more information.
+
+  ==============================================================================
+*/
+
+
+#ifndef __JUCE_LOWLEVELGRAPHICSRECORDER_JUCEHEADER__
+#define __JUCE_LOWLEVELGRAPHICSRECORDER_JUCEHEADER__
+
+#include "juce_LowLevelGraphicsContext.h"
+class LowLevelGraphicsSoftwareRenderer;
+
+
+//==============================================================================
+/**
+    An implementation of LowLevelGraphicsContext that doesn't draw anything, but keeps
+    a list of the operations that are performed on it, so that they can be replayed
+    into another context later.
+
+    The clip region and transform are followed in the same way that a
+    LowLevelGraphicsSoftwareRenderer would follow them, so methods such as getClipBounds()
+    and clipRegionIntersects() give the same answers that the context that the operations
+    are replayed into will give. That means that painting code, which often uses these
+    to decide what to draw, produces the same operations whether it's drawing directly or
+    being recorded.
+
+    Any fonts that are used have their typefaces looked up while they're being recorded,
+    so a recording can be replayed on a thread other than the one that made it.
+
+    The operations are stored in large blocks of memory which are kept when the recorder
+    is cleared or reset, so re-using one recorder for each frame of a repaint saves
+    allocating each operation separately. Their parameters are still ordinary objects
+    though, so recording a path, clip region, fill type or font makes a copy of it, which
+    may allocate, and reset() creates a new renderer to follow the clip region.
+
+    Two recordings can also be compared, e.g. to find out whether a repaint would produce
+    the same output as the last one did.
+
+    @see LowLevelGraphicsSoftwareRenderer::renderInBands
+*/
+class JUCE_API  LowLevelGraphicsRecorder    : public LowLevelGraphicsContext
+{
+public:
+    //==============================================================================
+    /** Creates a recorder whose clip region begins as the given area. */
+    explicit LowLevelGraphicsRecorder (const Rectangle<int>& initialClip);
+
+    /** Creates a recorder which starts with the given origin and clip region, in the
+        same way as the corresponding LowLevelGraphicsSoftwareRenderer constructor.
+    */
+    LowLevelGraphicsRecorder (const Point<int>& origin, const RectangleList& initialClip);
+
+    /** Destructor. */
+    ~LowLevelGraphicsRecorder();
+
+    //==============================================================================
+    /** Performs all the recorded operations on another context, in order. */
+    void replay (LowLevelGraphicsContext& target) const;
+
+    /** Returns the number of operations that have been recorded. */
+    int getNumOperations() const noexcept;
+
+    /** Removes all the recorded operations, but keeps the memory that they used so that
+        it can be re-used by the next recording.
+        Note that this doesn't affect the current clip region, transform, etc.
+    */
+    void clear();
+
+    /** Removes all the recorded operations and starts again with a new origin and clip
+        region, as if the recorder had just been created with these values.
+    */
+    void reset (const Point<int>& origin, const RectangleList& initialClip);
+
+    /** Returns the number of bytes that have been allocated to hold the operations. */
+    size_t getMemoryUsage() const noexcept;
+
+    //==============================================================================
+    /** Returns true if both recorders started with the same origin and clip region, and
+        have recorded the same sequence of operations with the same parameters.
+
+        If this is true, replaying them will produce the same result. Images are compared
+        by identity rather than by their contents (see Image::operator==), so two recordings
+        which draw an image whose pixels have been changed in between will still compare
+        as being the same.
+    */
+    bool operator== (const LowLevelGraphicsRecorder&) const;
+
+    /** Returns true if the recorders' operations differ in any way.
+        @see operator==
+    */
+    bool operator!= (const LowLevelGraphicsRecorder&) const;
+
+    //==============================================================================
+    bool isVectorDevice() const;
+    void setOrigin (int x, int y);
+    void addTransform (const AffineTransform&);
+    float getScaleFactor();
+
+    bool clipToRectangle (const Rectangle<int>&);
+    bool clipToRectangleList (const RectangleList&);
+    void excludeClipRectangle (const Rectangle<int>&);
+    void clipToPath (const Path&, const AffineTransform&);
+    void clipToImageAlpha (const Image&, const AffineTransform&);
+
+    bool clipRegionIntersects (const Rectangle<int>&);
+    Rectangle<int> getClipBounds() const;
+    bool isClipEmpty() const;
+
+    void saveState();
+    void restoreState();
+
+    void beginTransparencyLayer (float opacity);
+    void endTransparencyLayer();
+
+    void setFill (const FillType&);
+    void setOpacity (float opacity);
+    void setInterpolationQuality (Graphics::ResamplingQuality);
+
+    void fillRect (const Rectangle<int>&, bool replaceExistingContents);
+    void fillPath (const Path&, const AffineTransform&);
+
+    void drawImage (const Image&, const AffineTransform&);
+
+    void drawLine (const Line <float>& line);
+    void drawVerticalLine (int x, float top, float bottom);
+    void drawHorizontalLine (int y, float left, float right);
+
+    void setFont (const Font&);
+    Font getFont();
+    void drawGlyph (int glyphNumber, const AffineTransform&);
+
+   #ifndef DOXYGEN
+    class Operation;
+    class CommandBuffer;
+   #endif
+
+private:
+    //==============================================================================
+    ScopedPointer<CommandBuffer> buffer;
+    Array<Operation*> operations;
+    ScopedPointer<LowLevelGraphicsSoftwareRenderer> state;
+    Point<int> initialOrigin;
+    RectangleList initialRegion;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LowLevelGraphicsRecorder);
+};
+
+
+#endif   // __JUCE_LOWLEVELGRAPHICSRECORDER_JUCEHEADER__
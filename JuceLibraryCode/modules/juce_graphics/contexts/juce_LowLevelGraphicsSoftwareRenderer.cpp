@@ -38,6 +38,252 @@ BEGIN_JUCE_NAMESPACE
 namespace SoftwareRendererClasses
 {
 
+//==============================================================================
+/* The loops that fill or blend a horizontal run of pixels with a colour or an image.
+
+   Most of the time spent filling paths, rectangles and text goes into these, so as well as
+   the plain versions, which will work on any CPU, there are vectorised ones that are chosen
+   at run-time if the CPU supports them. The vectorised versions must always produce exactly
+   the same pixels as the plain ones (see PixelSpanFunctionsTests).
+*/
+struct PixelSpanFunctions
+{
+    void (*fillColourARGB)   (PixelARGB* dest, PixelARGB colour, int width);
+    void (*blendColourARGB)  (PixelARGB* dest, PixelARGB colour, int width);
+    void (*blendColourRGB)   (PixelRGB* dest, PixelARGB colour, int width);
+    void (*blendColourAlpha) (PixelAlpha* dest, PixelARGB colour, int width);
+
+    // Equivalent to calling PixelARGB::blend (src, alpha) for each pixel.
+    void (*blendImageARGB)   (PixelARGB* dest, const PixelARGB* src, int width, uint32 alpha);
+
+    static PixelSpanFunctions createPlain() noexcept;
+   #if JUCE_USE_SSE2_INTRINSICS
+    static PixelSpanFunctions createSSE2() noexcept;
+   #endif
+
+    // Returns the fastest set of functions that the CPU can run.
+    static const PixelSpanFunctions& getInstance() noexcept
+    {
+        static const PixelSpanFunctions functions (chooseBest());
+        return functions;
+    }
+
+private:
+    static PixelSpanFunctions chooseBest() noexcept
+    {
+       #if JUCE_USE_SSE2_INTRINSICS
+        if (SystemStats::hasSSE2())
+            return createSSE2();
+       #endif
+
+        return createPlain();
+    }
+};
+
+namespace PlainPixelSpans
+{
+    void fillColourARGB (PixelARGB* dest, const PixelARGB colour, int width) noexcept
+    {
+        do
+        {
+            dest->set (colour);
+            ++dest;
+        } while (--width > 0);
+    }
+
+    template <class PixelType>
+    void blendColour (PixelType* dest, const PixelARGB colour, int width) noexcept
+    {
+        do
+        {
+            dest->blend (colour);
+            ++dest;
+        } while (--width > 0);
+    }
+
+    void blendImageARGB (PixelARGB* dest, const PixelARGB* src, int width, const uint32 alpha) noexcept
+    {
+        do
+        {
+            dest->blend (*src++, alpha);
+            ++dest;
+        } while (--width > 0);
+    }
+}
+
+PixelSpanFunctions PixelSpanFunctions::createPlain() noexcept
+{
+    PixelSpanFunctions f;
+    f.fillColourARGB   = PlainPixelSpans::fillColourARGB;
+    f.blendColourARGB  = PlainPixelSpans::blendColour<PixelARGB>;
+    f.blendColourRGB   = PlainPixelSpans::blendColour<PixelRGB>;
+    f.blendColourAlpha = PlainPixelSpans::blendColour<PixelAlpha>;
+    f.blendImageARGB   = PlainPixelSpans::blendImageARGB;
+    return f;
+}
+
+#if JUCE_USE_SSE2_INTRINSICS
+namespace SSE2PixelSpans
+{
+    // Returns 0x100 minus the alpha of each pixel, in both of its 16-bit halves.
+    static forcedinline __m128i getInverseAlpha (const __m128i src) noexcept
+    {
+        const __m128i alpha = _mm_sub_epi32 (_mm_set1_epi32 (0x100), _mm_srli_epi32 (src, 24));
+        return _mm_or_si128 (alpha, _mm_slli_epi32 (alpha, 16));
+    }
+
+    // Does the same sums as PixelARGB::multiplyAlpha() to four pixels, where the multiplier
+    // has had 1 added to it, and is repeated in each 16-bit lane.
+    static forcedinline __m128i multiplyAlpha (const __m128i src, const __m128i multiplier) noexcept
+    {
+        const __m128i mask = _mm_set1_epi32 (0x00ff00ff);
+        const __m128i rb = _mm_srli_epi16 (_mm_mullo_epi16 (_mm_and_si128 (src, mask), multiplier), 8);
+        const __m128i ag = _mm_andnot_si128 (mask, _mm_mullo_epi16 (_mm_and_si128 (_mm_srli_epi32 (src, 8), mask), multiplier));
+        return _mm_or_si128 (rb, ag);
+    }
+
+    // Does the same sums as PixelARGB::blend() for four pixels. The components are multiplied
+    // in 16-bit lanes, but added as 32-bit words so that any carries match the plain version.
+    static forcedinline __m128i blend (const __m128i dest, const __m128i src, const __m128i inverseAlpha) noexcept
+    {
+        const __m128i mask = _mm_set1_epi32 (0x00ff00ff);
+        const __m128i rb = _mm_srli_epi16 (_mm_mullo_epi16 (_mm_and_si128 (dest, mask), inverseAlpha), 8);
+        const __m128i ag = _mm_andnot_si128 (mask, _mm_mullo_epi16 (_mm_and_si128 (_mm_srli_epi32 (dest, 8), mask), inverseAlpha));
+        return _mm_add_epi32 (_mm_add_epi32 (src, rb), ag);
+    }
+
+    // Blends sixteen 8-bit components, where each one is simply (dest * inverseAlpha) / 256 + src.
+    static forcedinline __m128i blendComponents (const __m128i dest, const __m128i src, const __m128i inverseAlpha) noexcept
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lo = _mm_srli_epi16 (_mm_mullo_epi16 (_mm_unpacklo_epi8 (dest, zero), inverseAlpha), 8);
+        const __m128i hi = _mm_srli_epi16 (_mm_mullo_epi16 (_mm_unpackhi_epi8 (dest, zero), inverseAlpha), 8);
+        return _mm_add_epi8 (_mm_packus_epi16 (lo, hi), src);
+    }
+
+    // When a colour's components are no greater than its alpha (which is always true of a properly
+    // premultiplied colour), blending it can't make one component overflow into its neighbour, so
+    // the components can be treated independently.
+    static bool canBlendComponentsIndependently (const PixelARGB& colour) noexcept
+    {
+        return colour.getRed() <= colour.getAlpha()
+            && colour.getGreen() <= colour.getAlpha()
+            && colour.getBlue() <= colour.getAlpha();
+    }
+
+    //==============================================================================
+    void fillColourARGB (PixelARGB* dest, const PixelARGB colour, int width) noexcept
+    {
+        const __m128i c = _mm_set1_epi32 ((int) colour.getARGB());
+
+        for (; width >= 4; width -= 4)
+        {
+            _mm_storeu_si128 ((__m128i*) dest, c);
+            dest += 4;
+        }
+
+        if (width > 0)
+            PlainPixelSpans::fillColourARGB (dest, colour, width);
+    }
+
+    void blendColourARGB (PixelARGB* dest, const PixelARGB colour, int width) noexcept
+    {
+        const __m128i c = _mm_set1_epi32 ((int) colour.getARGB());
+        const __m128i inverseAlpha = getInverseAlpha (c);
+
+        for (; width >= 4; width -= 4)
+        {
+            _mm_storeu_si128 ((__m128i*) dest, blend (_mm_loadu_si128 ((const __m128i*) dest), c, inverseAlpha));
+            dest += 4;
+        }
+
+        if (width > 0)
+            PlainPixelSpans::blendColour (dest, colour, width);
+    }
+
+    void blendColourRGB (PixelRGB* dest, const PixelARGB colour, int width) noexcept
+    {
+        if (width >= 16 && canBlendComponentsIndependently (colour))
+        {
+            // 16 pixels fill three registers, and the colour's components start at a different
+            // position in each of them, so this makes a copy of the colour for each one.
+            PixelRGB pattern [6];
+
+            for (int i = 0; i < numElementsInArray (pattern); ++i)
+                pattern[i].set (colour);
+
+            const uint8* const p = reinterpret_cast <const uint8*> (pattern);
+            const __m128i c0 = _mm_loadu_si128 ((const __m128i*) p);
+            const __m128i c1 = _mm_loadu_si128 ((const __m128i*) (p + 1));
+            const __m128i c2 = _mm_loadu_si128 ((const __m128i*) (p + 2));
+            const __m128i inverseAlpha = _mm_set1_epi16 ((short) (0x100 - colour.getAlpha()));
+
+            // (PixelRGB is packed, so this goes through a byte pointer rather than casting it to __m128i*)
+            uint8* d = reinterpret_cast <uint8*> (dest);
+
+            for (; width >= 16; width -= 16)
+            {
+                __m128i* const d0 = (__m128i*) d;
+                __m128i* const d1 = (__m128i*) (d + 16);
+                __m128i* const d2 = (__m128i*) (d + 32);
+
+                _mm_storeu_si128 (d0, blendComponents (_mm_loadu_si128 (d0), c0, inverseAlpha));
+                _mm_storeu_si128 (d1, blendComponents (_mm_loadu_si128 (d1), c1, inverseAlpha));
+                _mm_storeu_si128 (d2, blendComponents (_mm_loadu_si128 (d2), c2, inverseAlpha));
+                d += 48;
+            }
+
+            dest = reinterpret_cast <PixelRGB*> (d);
+        }
+
+        if (width > 0)
+            PlainPixelSpans::blendColour (dest, colour, width);
+    }
+
+    void blendColourAlpha (PixelAlpha* dest, const PixelARGB colour, int width) noexcept
+    {
+        const __m128i c = _mm_set1_epi8 ((char) colour.getAlpha());
+        const __m128i inverseAlpha = _mm_set1_epi16 ((short) (0x100 - colour.getAlpha()));
+
+        for (; width >= 16; width -= 16)
+        {
+            _mm_storeu_si128 ((__m128i*) dest, blendComponents (_mm_loadu_si128 ((const __m128i*) dest), c, inverseAlpha));
+            dest += 16;
+        }
+
+        if (width > 0)
+            PlainPixelSpans::blendColour (dest, colour, width);
+    }
+
+    void blendImageARGB (PixelARGB* dest, const PixelARGB* src, int width, const uint32 alpha) noexcept
+    {
+        const __m128i multiplier = _mm_set1_epi16 ((short) (alpha + 1));
+
+        for (; width >= 4; width -= 4)
+        {
+            const __m128i s = multiplyAlpha (_mm_loadu_si128 ((const __m128i*) src), multiplier);
+            _mm_storeu_si128 ((__m128i*) dest, blend (_mm_loadu_si128 ((const __m128i*) dest), s, getInverseAlpha (s)));
+            dest += 4;
+            src += 4;
+        }
+
+        if (width > 0)
+            PlainPixelSpans::blendImageARGB (dest, src, width, alpha);
+    }
+}
+
+PixelSpanFunctions PixelSpanFunctions::createSSE2() noexcept
+{
+    PixelSpanFunctions f;
+    f.fillColourARGB   = SSE2PixelSpans::fillColourARGB;
+    f.blendColourARGB  = SSE2PixelSpans::blendColourARGB;
+    f.blendColourRGB   = SSE2PixelSpans::blendColourRGB;
+    f.blendColourAlpha = SSE2PixelSpans::blendColourAlpha;
+    f.blendImageARGB   = SSE2PixelSpans::blendImageARGB;
+    return f;
+}
+#endif
+
 //==============================================================================
 template <class PixelType, bool replaceExisting = false>
 class SolidColourEdgeTableRenderer
@@ -45,6 +291,7 @@ class SolidColourEdgeTableRenderer
 public:
     SolidColourEdgeTableRenderer (const Image::BitmapData& data_, const PixelARGB& colour)
         : data (data_),
+          spans (PixelSpanFunctions::getInstance()),
           sourceColour (colour)
     {
         if (sizeof (PixelType) == 3)
@@ -104,32 +351,37 @@ public:
 
 private:
     const Image::BitmapData& data;
+    const PixelSpanFunctions& spans;
     PixelType* linePixels;
     PixelARGB sourceColour;
     PixelRGB filler [4];
     bool areRGBComponentsEqual;
 
-    inline void blendLine (PixelType* dest, const PixelARGB& colour, int width) const noexcept
+    forcedinline void blendLine (PixelARGB* dest, const PixelARGB& colour, int width) const noexcept
     {
-        do
-        {
-            dest->blend (colour);
-            ++dest;
-        } while (--width > 0);
+        spans.blendColourARGB (dest, colour, width);
+    }
+
+    forcedinline void blendLine (PixelRGB* dest, const PixelARGB& colour, int width) const noexcept
+    {
+        spans.blendColourRGB (dest, colour, width);
+    }
+
+    forcedinline void blendLine (PixelAlpha* dest, const PixelARGB& colour, int width) const noexcept
+    {
+        spans.blendColourAlpha (dest, colour, width);
     }
 
     forcedinline void replaceLine (PixelRGB* dest, const PixelARGB& colour, int width) const noexcept
     {
         if (areRGBComponentsEqual)  // if all the component values are the same, we can cheat..
         {
-            memset (dest, colour.getRed(), (size_t) width * 3);
+            memset ((void*) dest, colour.getRed(), (size_t) width * 3);
         }
         else
         {
             if (width >> 5)
             {
-                const int* const intFiller = reinterpret_cast<const int*> (filler);
-
                 while (width > 8 && (((pointer_sized_int) dest) & 7) != 0)
                 {
                     dest->set (colour);
@@ -139,11 +391,9 @@ private:
 
                 while (width > 4)
                 {
-                    int* d = reinterpret_cast<int*> (dest);
-                    *d++ = intFiller[0];
-                    *d++ = intFiller[1];
-                    *d++ = intFiller[2];
-                    dest = reinterpret_cast<PixelRGB*> (d);
+                    // (PixelRGB is packed, so a memcpy is used rather than casting it to an int*)
+                    memcpy ((void*) dest, (const void*) filler, sizeof (filler));
+                    dest += 4;
                     width -= 4;
                 }
             }
@@ -158,20 +408,132 @@ private:
 
     forcedinline void replaceLine (PixelAlpha* const dest, const PixelARGB& colour, int const width) const noexcept
     {
-        memset (dest, colour.getAlpha(), (size_t) width);
+        memset ((void*) dest, colour.getAlpha(), (size_t) width);
     }
 
     forcedinline void replaceLine (PixelARGB* dest, const PixelARGB& colour, int width) const noexcept
     {
-        do
+        spans.fillColourARGB (dest, colour, width);
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (SolidColourEdgeTableRenderer);
+};
+
+//==============================================================================
+/** Blends a solid colour through an 8-bit coverage mask, e.g. a pre-rendered glyph. */
+template <class PixelType>
+class SolidColourAlphaMaskRenderer
+{
+public:
+    SolidColourAlphaMaskRenderer (const Image::BitmapData& data_, const PixelARGB& colour)
+        : data (data_),
+          sourceColour (colour),
+          isOpaque (colour.getAlpha() >= 0xff)
+    {
+    }
+
+    void render (const uint8* mask, const int maskLineStride, const Rectangle<int>& area) const noexcept
+    {
+        for (int y = 0; y < area.getHeight(); ++y)
         {
-            dest->set (colour);
-            ++dest;
+            PixelType* dest = (PixelType*) data.getPixelPointer (area.getX(), area.getY() + y);
+            const uint8* src = mask + y * maskLineStride;
 
-        } while (--width > 0);
+            for (int x = area.getWidth(); --x >= 0;)
+            {
+                const uint32 alpha = *src++;
+
+                if (alpha >= 0xff && isOpaque)
+                    dest->set (sourceColour);
+                else if (alpha != 0)
+                    dest->blend (sourceColour, alpha);
+
+                ++dest;
+            }
+        }
     }
 
-    JUCE_DECLARE_NON_COPYABLE (SolidColourEdgeTableRenderer);
+private:
+    const Image::BitmapData& data;
+    PixelARGB sourceColour;
+    bool isOpaque;
+
+    JUCE_DECLARE_NON_COPYABLE (SolidColourAlphaMaskRenderer);
+};
+
+//==============================================================================
+/** Blends a solid colour through an 8-bit coverage mask, where it's covered by an edge table.
+
+    This is an edge table iteration callback, so the mask is blended directly for each
+    run of the clip's pixels, rather than being turned into an edge table of its own.
+*/
+template <class PixelType>
+class ClippedAlphaMaskRenderer
+{
+public:
+    ClippedAlphaMaskRenderer (const Image::BitmapData& data_, const PixelARGB& colour,
+                              const uint8* const mask_, const int maskLineStride_, const Rectangle<int>& area_)
+        : data (data_),
+          sourceColour (colour),
+          isOpaque (colour.getAlpha() >= 0xff),
+          mask (mask_), maskLineStride (maskLineStride_), area (area_),
+          linePixels (nullptr), maskLine (nullptr)
+    {
+    }
+
+    forcedinline void setEdgeTableYPos (const int y) noexcept
+    {
+        linePixels = (PixelType*) data.getLinePointer (y);
+        maskLine = mask + (y - area.getY()) * maskLineStride - area.getX();
+    }
+
+    forcedinline void handleEdgeTablePixel (const int x, const int alphaLevel) const noexcept
+    {
+        if (x >= area.getX() && x < area.getRight())
+            blendPixel (x, (maskLine[x] * (alphaLevel + 1)) >> 8);
+    }
+
+    forcedinline void handleEdgeTablePixelFull (const int x) const noexcept
+    {
+        if (x >= area.getX() && x < area.getRight())
+            blendPixel (x, maskLine[x]);
+    }
+
+    forcedinline void handleEdgeTableLine (const int x, const int width, const int alphaLevel) const noexcept
+    {
+        const int end = jmin (x + width, area.getRight());
+
+        for (int i = jmax (x, area.getX()); i < end; ++i)
+            blendPixel (i, (maskLine[i] * (alphaLevel + 1)) >> 8);
+    }
+
+    forcedinline void handleEdgeTableLineFull (const int x, const int width) const noexcept
+    {
+        const int end = jmin (x + width, area.getRight());
+
+        for (int i = jmax (x, area.getX()); i < end; ++i)
+            blendPixel (i, maskLine[i]);
+    }
+
+private:
+    const Image::BitmapData& data;
+    PixelARGB sourceColour;
+    const bool isOpaque;
+    const uint8* const mask;
+    const int maskLineStride;
+    const Rectangle<int> area;
+    PixelType* linePixels;
+    const uint8* maskLine;
+
+    forcedinline void blendPixel (const int x, const int alpha) const noexcept
+    {
+        if (alpha >= 0xff && isOpaque)
+            linePixels[x].set (sourceColour);
+        else if (alpha != 0)
+            linePixels[x].blend (sourceColour, (uint32) alpha);
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (ClippedAlphaMaskRenderer);
 };
 
 //==============================================================================
@@ -405,6 +767,7 @@ public:
                                 const int x, const int y)
         : destData (destData_),
           srcData (srcData_),
+          spans (PixelSpanFunctions::getInstance()),
           extraAlpha (extraAlpha_ + 1),
           xOffset (repeatPattern ? negativeAwareModulo (x, srcData_.width) - srcData_.width : x),
           yOffset (repeatPattern ? negativeAwareModulo (y, srcData_.height) - srcData_.height : y)
@@ -447,10 +810,17 @@ public:
 
         if (alphaLevel < 0xfe)
         {
-            do
+            if (repeatPattern)
             {
-                dest++ ->blend (sourceLineStart [repeatPattern ? (x++ % srcData.width) : x++], (uint32) alphaLevel);
-            } while (--width > 0);
+                do
+                {
+                    dest++ ->blend (sourceLineStart [x++ % srcData.width], (uint32) alphaLevel);
+                } while (--width > 0);
+            }
+            else
+            {
+                blendRow (dest, sourceLineStart + x, width, (uint32) alphaLevel);
+            }
         }
         else
         {
@@ -477,10 +847,17 @@ public:
 
         if (extraAlpha < 0xfe)
         {
-            do
+            if (repeatPattern)
             {
-                dest++ ->blend (sourceLineStart [repeatPattern ? (x++ % srcData.width) : x++], (uint32) extraAlpha);
-            } while (--width > 0);
+                do
+                {
+                    dest++ ->blend (sourceLineStart [x++ % srcData.width], (uint32) extraAlpha);
+                } while (--width > 0);
+            }
+            else
+            {
+                blendRow (dest, sourceLineStart + x, width, (uint32) extraAlpha);
+            }
         }
         else
         {
@@ -513,12 +890,13 @@ public:
 private:
     const Image::BitmapData& destData;
     const Image::BitmapData& srcData;
+    const PixelSpanFunctions& spans;
     const int extraAlpha, xOffset, yOffset;
     DestPixelType* linePixels;
     SrcPixelType* sourceLineStart;
 
     template <class PixelType1, class PixelType2>
-    static forcedinline void copyRow (PixelType1* dest, PixelType2* src, int width) noexcept
+    forcedinline void copyRow (PixelType1* dest, PixelType2* src, int width) const noexcept
     {
         do
         {
@@ -526,9 +904,28 @@ private:
         } while (--width > 0);
     }
 
-    static forcedinline void copyRow (PixelRGB* dest, PixelRGB* src, int width) noexcept
+    forcedinline void copyRow (PixelRGB* dest, PixelRGB* src, int width) const noexcept
+    {
+        memcpy ((void*) dest, (const void*) src, width * sizeof (PixelRGB));
+    }
+
+    forcedinline void copyRow (PixelARGB* dest, PixelARGB* src, int width) const noexcept
+    {
+        spans.blendImageARGB (dest, src, width, 0xff);  // blending with an alpha of 0xff is the same as a plain blend
+    }
+
+    template <class PixelType1, class PixelType2>
+    forcedinline void blendRow (PixelType1* dest, PixelType2* src, int width, const uint32 alpha) const noexcept
+    {
+        do
+        {
+            dest++ ->blend (*src++, alpha);
+        } while (--width > 0);
+    }
+
+    forcedinline void blendRow (PixelARGB* dest, PixelARGB* src, int width, const uint32 alpha) const noexcept
     {
-        memcpy (dest, src, width * sizeof (PixelRGB));
+        spans.blendImageARGB (dest, src, width, alpha);
     }
 
     JUCE_DECLARE_NON_COPYABLE (ImageFillEdgeTableRenderer);
@@ -1020,6 +1417,7 @@ public:
     virtual void fillRectWithColour (Image::BitmapData& destData, const Rectangle<int>& area, const PixelARGB& colour, bool replaceContents) const = 0;
     virtual void fillRectWithColour (Image::BitmapData& destData, const Rectangle<float>& area, const PixelARGB& colour) const = 0;
     virtual void fillAllWithColour (Image::BitmapData& destData, const PixelARGB& colour, bool replaceContents) const = 0;
+    virtual void fillAlphaMaskWithColour (Image::BitmapData& destData, const uint8* mask, int maskLineStride, const Rectangle<int>& area, const PixelARGB& colour) const = 0;
     virtual void fillAllWithGradient (Image::BitmapData& destData, ColourGradient& gradient, const AffineTransform& transform, bool isIdentity) const = 0;
     virtual void renderImageTransformed (const Image::BitmapData& destData, const Image::BitmapData& srcData, const int alpha, const AffineTransform& t, bool betterQuality, bool tiledFill) const = 0;
     virtual void renderImageUntransformed (const Image::BitmapData& destData, const Image::BitmapData& srcData, const int alpha, int x, int y, bool tiledFill) const = 0;
@@ -1165,6 +1563,24 @@ protected:
         }
     }
 
+    template <class DestPixelType>
+    static void renderAlphaMask (const Image::BitmapData& destData, const uint8* mask, const int maskLineStride,
+                                 const Rectangle<int>& area, const PixelARGB& fillColour, DestPixelType*)
+    {
+        jassert (destData.pixelStride == sizeof (DestPixelType));
+        SolidColourAlphaMaskRenderer <DestPixelType> r (destData, fillColour);
+        r.render (mask, maskLineStride, area);
+    }
+
+    template <class DestPixelType>
+    static void renderClippedAlphaMask (const EdgeTable& clip, const Image::BitmapData& destData, const uint8* mask, const int maskLineStride,
+                                        const Rectangle<int>& area, const PixelARGB& fillColour, DestPixelType*)
+    {
+        jassert (destData.pixelStride == sizeof (DestPixelType));
+        ClippedAlphaMaskRenderer <DestPixelType> r (destData, fillColour, mask, maskLineStride, area);
+        clip.iterate (r, area.getY(), area.getBottom());
+    }
+
     template <class Iterator, class DestPixelType>
     static void renderGradient (Iterator& iter, const Image::BitmapData& destData, const ColourGradient& g, const AffineTransform& transform,
                                 const PixelARGB* const lookupTable, const int numLookupEntries, const bool isIdentity, DestPixelType*)
@@ -1203,6 +1619,13 @@ public:
     ClipRegion_EdgeTable (const Rectangle<int>& bounds, const Path& p, const AffineTransform& t) : edgeTable (bounds, p, t) {}
     ClipRegion_EdgeTable (const ClipRegion_EdgeTable& other) : edgeTable (other.edgeTable) {}
 
+    ClipRegion_EdgeTable (const uint8* mask, const int maskLineStride, const Rectangle<int>& area)
+        : edgeTable (area)
+    {
+        for (int y = 0; y < area.getHeight(); ++y)
+            edgeTable.clipLineToMask (area.getX(), area.getY() + y, mask + y * maskLineStride, 1, area.getWidth());
+    }
+
     Ptr clone() const
     {
         return new ClipRegion_EdgeTable (*this);
@@ -1345,6 +1768,19 @@ public:
         }
     }
 
+    void fillAlphaMaskWithColour (Image::BitmapData& destData, const uint8* mask, int maskLineStride, const Rectangle<int>& area, const PixelARGB& colour) const
+    {
+        if (edgeTable.getMaximumBounds().intersects (area))
+        {
+            switch (destData.pixelFormat)
+            {
+                case Image::ARGB:   renderClippedAlphaMask (edgeTable, destData, mask, maskLineStride, area, colour, (PixelARGB*) 0); break;
+                case Image::RGB:    renderClippedAlphaMask (edgeTable, destData, mask, maskLineStride, area, colour, (PixelRGB*) 0); break;
+                default:            renderClippedAlphaMask (edgeTable, destData, mask, maskLineStride, area, colour, (PixelAlpha*) 0); break;
+            }
+        }
+    }
+
     void fillAllWithGradient (Image::BitmapData& destData, ColourGradient& gradient, const AffineTransform& transform, bool isIdentity) const
     {
         HeapBlock <PixelARGB> lookupTable;
@@ -1499,6 +1935,26 @@ public:
         }
     }
 
+    void fillAlphaMaskWithColour (Image::BitmapData& destData, const uint8* mask, int maskLineStride, const Rectangle<int>& area, const PixelARGB& colour) const
+    {
+        for (RectangleList::Iterator i (clip); i.next();)
+        {
+            const Rectangle<int> r (i.getRectangle()->getIntersection (area));
+
+            if (! r.isEmpty())
+            {
+                const uint8* const m = mask + (r.getY() - area.getY()) * maskLineStride + (r.getX() - area.getX());
+
+                switch (destData.pixelFormat)
+                {
+                    case Image::ARGB:   renderAlphaMask (destData, m, maskLineStride, r, colour, (PixelARGB*) 0); break;
+                    case Image::RGB:    renderAlphaMask (destData, m, maskLineStride, r, colour, (PixelRGB*) 0); break;
+                    default:            renderAlphaMask (destData, m, maskLineStride, r, colour, (PixelAlpha*) 0); break;
+                }
+            }
+        }
+    }
+
     void fillAllWithGradient (Image::BitmapData& destData, ColourGradient& gradient, const AffineTransform& transform, bool isIdentity) const
     {
         HeapBlock <PixelARGB> lookupTable;
@@ -1684,10 +2140,67 @@ private:
     ClipRegion_RectangleList& operator= (const ClipRegion_RectangleList&);
 };
 
-}
-
 //==============================================================================
-class LowLevelGraphicsSoftwareRenderer::SavedState
+/** The pixels of a transparency layer.
+
+    Only the layer's area is allocated, but its pixels are addressed using the same
+    co-ordinates as the image that it'll be drawn onto, so the layer's contents can be
+    drawn with the same transform as everything else. That means that a pixel in the
+    layer comes out exactly the same wherever the layer's bounds happen to be, which
+    isn't the case if the drawing is shifted by the layer's position.
+
+    A BitmapData that starts outside the area (e.g. at 0, 0) gets a data pointer that
+    lies outside the allocation, so nothing must be drawn or read outside the area.
+    The renderer that createLowLevelContext() returns is clipped to it, and a layer is
+    only ever drawn back onto its parent within the same clip bounds.
+*/
+class TransparencyLayerPixelData  : public ImagePixelData
+{
+public:
+    TransparencyLayerPixelData (const Rectangle<int>& area_)
+        : ImagePixelData (Image::ARGB, area_.getRight(), area_.getBottom()),
+          area (area_), lineStride (4 * jmax (1, area_.getWidth()))
+    {
+        pixels.allocate ((size_t) (lineStride * jmax (1, area.getHeight())), true);
+    }
+
+    LowLevelGraphicsContext* createLowLevelContext()
+    {
+        LowLevelGraphicsContext* g = new LowLevelGraphicsSoftwareRenderer (Image (this));
+        g->clipToRectangle (area);
+        return g;
+    }
+
+    void initialiseBitmapData (Image::BitmapData& bitmap, int x, int y, Image::BitmapData::ReadWriteMode)
+    {
+        bitmap.data = pixels + (x - area.getX()) * 4 + (y - area.getY()) * lineStride;
+        bitmap.pixelFormat = Image::ARGB;
+        bitmap.lineStride = lineStride;
+        bitmap.pixelStride = 4;
+    }
+
+    ImagePixelData* clone()
+    {
+        TransparencyLayerPixelData* s = new TransparencyLayerPixelData (area);
+        memcpy (s->pixels, pixels, (size_t) (lineStride * jmax (1, area.getHeight())));
+        return s;
+    }
+
+    ImageType* createType() const    { return new SoftwareImageType(); }
+
+    const Rectangle<int> area;
+
+private:
+    HeapBlock<uint8> pixels;
+    const int lineStride;
+
+    JUCE_DECLARE_NON_COPYABLE (TransparencyLayerPixelData);
+};
+
+}
+
+//==============================================================================
+class LowLevelGraphicsSoftwareRenderer::SavedState
 {
 public:
     SavedState (const Image& image_, const Rectangle<int>& clip_)
@@ -1831,14 +2344,9 @@ public:
 
         if (clip != nullptr)
         {
-            const Rectangle<int> layerBounds (clip->getClipBounds());
-
-            s->image = Image (Image::ARGB, layerBounds.getWidth(), layerBounds.getHeight(), true);
+            // (only the clip's area is allocated, but the layer is drawn in this image's co-ordinates)
+            s->image = Image (new SoftwareRendererClasses::TransparencyLayerPixelData (clip->getClipBounds()));
             s->transparencyLayerAlpha = opacity;
-            s->transform.moveOriginInDeviceSpace (-layerBounds.getX(), -layerBounds.getY());
-
-            s->cloneClipIfMultiplyReferenced();
-            s->clip->translate (-layerBounds.getPosition());
         }
 
         return s;
@@ -1848,12 +2356,10 @@ public:
     {
         if (clip != nullptr)
         {
-            const Rectangle<int> layerBounds (clip->getClipBounds());
-
             const ScopedPointer<LowLevelGraphicsContext> g (image.createLowLevelContext());
+            g->clipToRectangle (clip->getClipBounds());
             g->setOpacity (finishedLayerState.transparencyLayerAlpha);
-            g->drawImage (finishedLayerState.image, AffineTransform::translation ((float) layerBounds.getX(),
-                                                                                  (float) layerBounds.getY()));
+            g->drawImage (finishedLayerState.image, AffineTransform::identity);
         }
     }
 
@@ -1935,6 +2441,26 @@ public:
         }
     }
 
+    void fillAlphaMask (const uint8* mask, const int maskLineStride, const Rectangle<int>& area)
+    {
+        jassert (transform.isOnlyTranslated);
+
+        if (clip != nullptr)
+        {
+            const Rectangle<int> destArea (transform.translated (area));
+
+            if (fillType.isGradient() || fillType.isTiledImage())
+            {
+                fillShape (new SoftwareRendererClasses::ClipRegion_EdgeTable (mask, maskLineStride, destArea), false);
+            }
+            else if (clip->clipRegionIntersects (destArea))
+            {
+                Image::BitmapData destData (image, Image::BitmapData::readWrite);
+                clip->fillAlphaMaskWithColour (destData, mask, maskLineStride, destArea, fillType.colour.getPixelARGB());
+            }
+        }
+    }
+
     void drawGlyph (const Font& f, int glyphNumber, const AffineTransform& t)
     {
         if (clip != nullptr)
@@ -2185,7 +2711,8 @@ void LowLevelGraphicsSoftwareRenderer::fillPath (const Path& path, const AffineT
 
 void LowLevelGraphicsSoftwareRenderer::drawImage (const Image& sourceImage, const AffineTransform& transform)
 {
-    savedState->renderImage (sourceImage, transform, nullptr);
+    if (savedState->clip != nullptr)
+        savedState->renderImage (sourceImage, transform, nullptr);
 }
 
 void LowLevelGraphicsSoftwareRenderer::drawLine (const Line <float>& line)
@@ -2211,7 +2738,11 @@ void LowLevelGraphicsSoftwareRenderer::drawHorizontalLine (const int y, float le
 class CachedGlyphEdgeTable
 {
 public:
-    CachedGlyphEdgeTable() : glyph (0), lastAccessCount (0) {}
+    CachedGlyphEdgeTable() : snapToIntegerCoordinate (false) {}
+
+    // Edge tables are translated by the exact fractional amount when they're drawn,
+    // so there's no need to keep separate copies for different sub-pixel positions.
+    enum { numSubPixelPositions = 1 };
 
     void draw (LowLevelGraphicsSoftwareRenderer::SavedState& state, float x, const float y) const
     {
@@ -2222,11 +2753,10 @@ public:
             state.fillEdgeTable (*edgeTable, x, roundToInt (y));
     }
 
-    void generate (const Font& newFont, const int glyphNumber)
+    void generate (const Font& newFont, const int glyphNumber, float /*subPixelOffset*/)
     {
         font = newFont;
         snapToIntegerCoordinate = newFont.getTypeface()->isHinted();
-        glyph = glyphNumber;
 
         const float fontHeight = font.getHeight();
         edgeTable = font.getTypeface()->getEdgeTableForGlyph (glyphNumber,
@@ -2235,25 +2765,349 @@ public:
                                                                               .translated (0.0f, -0.5f)
                                                                             #endif
                                                               );
+
+        if (edgeTable != nullptr)
+            edgeTable->optimiseTable();
     }
 
+    size_t getMemoryUsage() const noexcept
+    {
+        return edgeTable != nullptr ? sizeof (EdgeTable) + edgeTable->getMemoryUsage() : 0;
+    }
+
+    static size_t getSharedMemoryUsage() noexcept       { return 0; }
+    static void setSharedMemoryLimit (size_t) noexcept  {}
+
+private:
     Font font;
-    int glyph, lastAccessCount;
+    ScopedPointer <EdgeTable> edgeTable;
     bool snapToIntegerCoordinate;
 
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CachedGlyphEdgeTable);
+};
+
+#if JUCE_USE_GLYPH_ALPHA_ATLAS
+//==============================================================================
+/** A set of 8-bit pages that pre-rendered glyph masks are packed into.
+
+    Glyphs are packed onto shelves, and each glyph holds a reference to its page. A
+    page's space is only reclaimed once none of the glyphs on it are still alive, so
+    the pages are counted as a whole towards the glyph cache's budget, and no new page
+    is made if that would take the atlas over it.
+
+    The glyph cache creates glyphs on whichever thread is drawing them, so the atlas
+    has a lock around its pages and shelves, and the pages' reference counts are atomic.
+*/
+class GlyphAlphaAtlas  : public DeletedAtShutdown
+{
+public:
+    GlyphAlphaAtlas()  : memoryLimit (std::numeric_limits<size_t>::max()) {}
+
+    ~GlyphAlphaAtlas()
+    {
+        clearSingletonInstance();
+    }
+
+    juce_DeclareSingleton (GlyphAlphaAtlas, false);
+
+    enum { pageSize = 512, maxGlyphSize = 128 };
+
+    /** Sets the most memory that the pages may use. */
+    void setMemoryLimit (const size_t maxBytes)
+    {
+        const ScopedLock sl (lock);
+        memoryLimit = maxBytes;
+    }
+
+    /** Deletes any pages that no glyphs are using, and returns the size of the others. */
+    size_t getMemoryUsage()
+    {
+        const ScopedLock sl (lock);
+        removeUnusedPages();
+        return getPagesMemoryUsage();
+    }
+
+    static size_t getPageMemoryUsage() noexcept    { return (size_t) (pageSize * pageSize); }
+
+    //==============================================================================
+    class Page  : public ReferenceCountedObject
+    {
+    public:
+        Page()
+            : image (Image::SingleChannel, pageSize, pageSize, false, SoftwareImageType()),
+              nextShelfY (0)
+        {
+            const Image::BitmapData data (image, Image::BitmapData::readWrite);
+            pixels = data.data;
+            lineStride = data.lineStride;
+        }
+
+        typedef ReferenceCountedObjectPtr<Page> Ptr;
+
+        bool allocate (const int width, const int height, Rectangle<int>& area)
+        {
+            Shelf* best = nullptr;
+
+            for (int i = shelves.size(); --i >= 0;)
+            {
+                Shelf& s = shelves.getReference (i);
+
+                if (s.height >= height && s.height < height * 2 && s.nextX + width <= pageSize
+                     && (best == nullptr || s.height < best->height))
+                    best = &s;
+            }
+
+            if (best == nullptr)
+            {
+                const int shelfHeight = (height + 3) & ~3;
+
+                if (nextShelfY + shelfHeight > pageSize)
+                    return false;
+
+                const Shelf s = { nextShelfY, shelfHeight, 0 };
+                shelves.add (s);
+                nextShelfY += shelfHeight;
+                best = &shelves.getReference (shelves.size() - 1);
+            }
+
+            area.setBounds (best->nextX, best->y, width, height);
+            best->nextX += width;
+            return true;
+        }
+
+        void reset() noexcept
+        {
+            shelves.clearQuick();
+            nextShelfY = 0;
+        }
+
+        uint8* getPixels (const Rectangle<int>& area) const noexcept    { return pixels + area.getY() * lineStride + area.getX(); }
+        int getLineStride() const noexcept                              { return lineStride; }
+
+    private:
+        struct Shelf
+        {
+            int y, height, nextX;
+        };
+
+        Image image;
+        uint8* pixels;
+        int lineStride;
+        Array<Shelf> shelves;
+        int nextShelfY;
+
+        JUCE_DECLARE_NON_COPYABLE (Page);
+    };
+
+    //==============================================================================
+    /** Finds space for a glyph, or returns nullptr if there's none, and no more pages can be made. */
+    Page::Ptr allocate (const int width, const int height, Rectangle<int>& area)
+    {
+        jassert (width <= maxGlyphSize && height <= maxGlyphSize);
+
+        const ScopedLock sl (lock);
+
+        // If the limit has been lowered, nothing more goes into the pages until enough
+        // of them have been freed.
+        if (getPagesMemoryUsage() > memoryLimit)
+        {
+            removeUnusedPages();
+
+            if (getPagesMemoryUsage() > memoryLimit)
+                return nullptr;
+        }
+
+        for (int i = pages.size(); --i >= 0;)
+            if (pages.getUnchecked (i)->allocate (width, height, area))
+                return pages.getUnchecked (i);
+
+        // Every page is full, so recycle one whose glyphs have all been deleted, and free
+        // up any others that are empty.
+        Page::Ptr page;
+
+        for (int i = pages.size(); --i >= 0;)
+        {
+            if (isUnused (i))
+            {
+                if (page == nullptr)
+                {
+                    page = pages.getUnchecked (i);
+                    page->reset();
+                    pages.move (i, -1);
+                }
+                else
+                {
+                    pages.remove (i);
+                }
+            }
+        }
+
+        if (page == nullptr)
+        {
+            if (getPagesMemoryUsage() + getPageMemoryUsage() > memoryLimit)
+                return nullptr;
+
+            page = new Page();
+            pages.add (page);
+        }
+
+        const bool ok = page->allocate (width, height, area);
+        jassert (ok); (void) ok;
+        return page;
+    }
+
+private:
+    ReferenceCountedArray<Page> pages;
+    CriticalSection lock;
+    size_t memoryLimit;
+
+    // (this mustn't use getUnchecked(), whose temporary pointer would add another reference)
+    bool isUnused (const int index) const noexcept
+    {
+        return pages.getObjectPointerUnchecked (index)->getReferenceCount() == 1;
+    }
+
+    void removeUnusedPages()
+    {
+        for (int i = pages.size(); --i >= 0;)
+            if (isUnused (i))
+                pages.remove (i);
+    }
+
+    size_t getPagesMemoryUsage() const noexcept    { return (size_t) pages.size() * getPageMemoryUsage(); }
+
+    JUCE_DECLARE_NON_COPYABLE (GlyphAlphaAtlas);
+};
+
+juce_ImplementSingleton (GlyphAlphaAtlas)
+
+//==============================================================================
+class CachedGlyphAlphaMask
+{
+public:
+    CachedGlyphAlphaMask() : subPixelOffset (0), snapToIntegerCoordinate (false) {}
+
+    enum { numSubPixelPositions = 4 };
+
+    void draw (LowLevelGraphicsSoftwareRenderer::SavedState& state, float x, const float y) const
+    {
+        if (snapToIntegerCoordinate)
+            x = std::floor (x + 0.5f);
+
+        // (the glyph was generated at its sub-pixel offset, so it goes at the whole pixel position
+        // that this offset was rounded from, whether it's in the atlas or kept as an edge table)
+        const int pixelX = roundToInt (x - subPixelOffset);
+
+        if (page != nullptr)
+            state.fillAlphaMask (page->getPixels (atlasArea), page->getLineStride(),
+                                 maskBounds.translated (pixelX, roundToInt (y)));
+        else if (edgeTable != nullptr)
+            state.fillEdgeTable (*edgeTable, (float) pixelX, roundToInt (y));
+    }
+
+    void generate (const Font& newFont, const int glyphNumber, const float newSubPixelOffset)
+    {
+        font = newFont;
+        snapToIntegerCoordinate = newFont.getTypeface()->isHinted();
+        subPixelOffset = newSubPixelOffset;
+        page = nullptr;
+
+        const float fontHeight = font.getHeight();
+        edgeTable = font.getTypeface()->getEdgeTableForGlyph (glyphNumber,
+                                                              AffineTransform::scale (fontHeight * font.getHorizontalScale(), fontHeight)
+                                                                              .translated (subPixelOffset, 0.0f)
+                                                                            #if JUCE_MAC || JUCE_IOS
+                                                                              .translated (0.0f, -0.5f)
+                                                                            #endif
+                                                              );
+
+        if (edgeTable != nullptr)
+        {
+            maskBounds = edgeTable->getMaximumBounds();
+
+            if (maskBounds.getWidth() <= GlyphAlphaAtlas::maxGlyphSize
+                 && maskBounds.getHeight() <= GlyphAlphaAtlas::maxGlyphSize)
+                page = GlyphAlphaAtlas::getInstance()->allocate (maskBounds.getWidth(), maskBounds.getHeight(), atlasArea);
+
+            if (page != nullptr)
+            {
+                MaskWriter writer (page->getPixels (atlasArea), page->getLineStride(), maskBounds);
+                edgeTable->iterate (writer);
+                edgeTable = nullptr;
+            }
+            else
+            {
+                // too big to be worth keeping as a mask, or the atlas is full, so just hang on to the edge table
+                edgeTable->optimiseTable();
+            }
+        }
+    }
+
+    // (a glyph in the atlas doesn't count its own area, because whole pages are counted
+    // by getSharedMemoryUsage() instead)
+    size_t getMemoryUsage() const noexcept
+    {
+        return edgeTable != nullptr ? sizeof (EdgeTable) + edgeTable->getMemoryUsage() : 0;
+    }
+
+    static size_t getSharedMemoryUsage()
+    {
+        GlyphAlphaAtlas* const atlas = GlyphAlphaAtlas::getInstanceWithoutCreating();
+        return atlas != nullptr ? atlas->getMemoryUsage() : 0;
+    }
+
+    static void setSharedMemoryLimit (const size_t maxBytes)
+    {
+        GlyphAlphaAtlas::getInstance()->setMemoryLimit (maxBytes);
+    }
+
 private:
+    Font font;
+    GlyphAlphaAtlas::Page::Ptr page;
+    Rectangle<int> maskBounds, atlasArea;
     ScopedPointer <EdgeTable> edgeTable;
+    float subPixelOffset;
+    bool snapToIntegerCoordinate;
 
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CachedGlyphEdgeTable);
+    // Renders an edge table's coverage levels into a mask.
+    struct MaskWriter
+    {
+        MaskWriter (uint8* const pixels_, const int lineStride_, const Rectangle<int>& bounds_) noexcept
+            : pixels (pixels_), lineStride (lineStride_), bounds (bounds_), line (nullptr)
+        {
+            for (int y = 0; y < bounds.getHeight(); ++y)
+                zeromem (pixels + y * lineStride, (size_t) bounds.getWidth());
+        }
+
+        forcedinline void setEdgeTableYPos (const int y) noexcept               { line = pixels + (y - bounds.getY()) * lineStride - bounds.getX(); }
+        forcedinline void handleEdgeTablePixel (const int x, const int alpha) noexcept     { line[x] = (uint8) alpha; }
+        forcedinline void handleEdgeTablePixelFull (const int x) noexcept       { line[x] = 0xff; }
+        forcedinline void handleEdgeTableLine (const int x, const int width, const int alpha) noexcept  { memset (line + x, alpha, (size_t) width); }
+        forcedinline void handleEdgeTableLineFull (const int x, const int width) noexcept              { memset (line + x, 0xff, (size_t) width); }
+
+        uint8* const pixels;
+        const int lineStride;
+        const Rectangle<int> bounds;
+        uint8* line;
+
+        JUCE_DECLARE_NON_COPYABLE (MaskWriter);
+    };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CachedGlyphAlphaMask);
 };
 
+typedef RenderingHelpers::GlyphCache <CachedGlyphAlphaMask, LowLevelGraphicsSoftwareRenderer::SavedState> SoftwareRendererGlyphCache;
+#else
+typedef RenderingHelpers::GlyphCache <CachedGlyphEdgeTable, LowLevelGraphicsSoftwareRenderer::SavedState> SoftwareRendererGlyphCache;
+#endif
+
 void LowLevelGraphicsSoftwareRenderer::drawGlyph (int glyphNumber, const AffineTransform& transform)
 {
     Font& f = savedState->font;
 
     if (transform.isOnlyTranslation() && savedState->transform.isOnlyTranslated)
     {
-        RenderingHelpers::GlyphCache <CachedGlyphEdgeTable, SavedState>::getInstance()
+        SoftwareRendererGlyphCache::getInstance()
             .drawGlyph (*savedState, f, glyphNumber,
                         transform.getTranslationX(),
                         transform.getTranslationY());
@@ -2270,6 +3124,500 @@ void LowLevelGraphicsSoftwareRenderer::drawGlyph (int glyphNumber, const AffineT
 void LowLevelGraphicsSoftwareRenderer::setFont (const Font& newFont)    { savedState->font = newFont; }
 Font LowLevelGraphicsSoftwareRenderer::getFont()                        { return savedState->font; }
 
+//==============================================================================
+void LowLevelGraphicsSoftwareRenderer::setGlyphCacheMemoryBudget (size_t maxBytes)
+{
+    SoftwareRendererGlyphCache::getInstance().setMemoryBudget (maxBytes);
+}
+
+RenderingHelpers::GlyphCacheStatistics LowLevelGraphicsSoftwareRenderer::getGlyphCacheStatistics()
+{
+    return SoftwareRendererGlyphCache::getInstance().getStatistics();
+}
+
+//==============================================================================
+namespace SoftwareRendererClasses
+{
+    class BandRenderingJob  : public ThreadPoolJob
+    {
+    public:
+        BandRenderingJob (const LowLevelGraphicsRecorder& recording_, const Image& image_,
+                          const Point<int>& origin_, const RectangleList& clip_)
+            : ThreadPoolJob ("Software renderer band"),
+              recording (recording_), image (image_), origin (origin_), clip (clip_)
+        {
+        }
+
+        JobStatus runJob()
+        {
+            render();
+            return jobHasFinished;
+        }
+
+        void render()
+        {
+            LowLevelGraphicsSoftwareRenderer renderer (image, origin, clip);
+            recording.replay (renderer);
+        }
+
+    private:
+        const LowLevelGraphicsRecorder& recording;
+        Image image;
+        const Point<int> origin;
+        const RectangleList clip;
+
+        JUCE_DECLARE_NON_COPYABLE (BandRenderingJob);
+    };
+
+    class BandRenderingThreads  : public DeletedAtShutdown
+    {
+    public:
+        BandRenderingThreads()
+            : pool (jmax (1, numThreads - 1), false, 0, true)
+        {
+        }
+
+        ~BandRenderingThreads()
+        {
+            clearSingletonInstance();
+        }
+
+        juce_DeclareSingleton_SingleThreaded_Minimal (BandRenderingThreads);
+
+        // The thread that calls renderInBands() draws one of the bands itself, so the
+        // pool only needs one thread fewer than the number of bands.
+        ThreadPool pool;
+
+        static int numThreads;
+
+        enum { minimumBandHeight = 32, minimumAreaForBands = 256 * 256 };
+
+    private:
+        JUCE_DECLARE_NON_COPYABLE (BandRenderingThreads);
+    };
+
+    int BandRenderingThreads::numThreads = 1;
+
+    juce_ImplementSingleton_SingleThreaded (BandRenderingThreads)
+}
+
+void LowLevelGraphicsSoftwareRenderer::setNumRenderingThreads (int numThreads)
+{
+    using namespace SoftwareRendererClasses;
+    numThreads = jlimit (1, 64, numThreads);
+
+    if (numThreads != BandRenderingThreads::numThreads)
+    {
+        BandRenderingThreads::numThreads = numThreads;
+        BandRenderingThreads::deleteInstance();
+    }
+}
+
+int LowLevelGraphicsSoftwareRenderer::getNumRenderingThreads() noexcept
+{
+    return SoftwareRendererClasses::BandRenderingThreads::numThreads;
+}
+
+bool LowLevelGraphicsSoftwareRenderer::isWorthRenderingInBands (const Rectangle<int>& area) noexcept
+{
+    using namespace SoftwareRendererClasses;
+
+    return BandRenderingThreads::numThreads > 1
+            && area.getHeight() >= 2 * BandRenderingThreads::minimumBandHeight
+            && area.getWidth() * area.getHeight() >= BandRenderingThreads::minimumAreaForBands;
+}
+
+void LowLevelGraphicsSoftwareRenderer::renderInBands (const LowLevelGraphicsRecorder& recording, const Image& image,
+                                                      const Point<int>& origin, const RectangleList& initialClip)
+{
+    using namespace SoftwareRendererClasses;
+
+    const Rectangle<int> area (initialClip.getBounds().getIntersection (image.getBounds()));
+    const int numBands = isWorthRenderingInBands (area) ? jmin (BandRenderingThreads::numThreads,
+                                                                area.getHeight() / BandRenderingThreads::minimumBandHeight)
+                                                        : 1;
+    if (numBands <= 1)
+    {
+        LowLevelGraphicsSoftwareRenderer renderer (image, origin, initialClip);
+        recording.replay (renderer);
+        return;
+    }
+
+    // Make sure that the shared objects which all the bands use have been created
+    // before any other threads go looking for them.
+    PixelSpanFunctions::getInstance();
+    SoftwareRendererGlyphCache::getInstance();
+    ThreadPool& pool = BandRenderingThreads::getInstance()->pool;
+
+    OwnedArray<BandRenderingJob> bands;
+
+    for (int i = 0; i < numBands; ++i)
+    {
+        const int top    = area.getY() + (area.getHeight() * i) / numBands;
+        const int bottom = area.getY() + (area.getHeight() * (i + 1)) / numBands;
+
+        RectangleList bandClip (initialClip);
+        bandClip.clipTo (Rectangle<int> (area.getX(), top, area.getWidth(), bottom - top));
+
+        bands.add (new BandRenderingJob (recording, image, origin, bandClip));
+    }
+
+    for (int i = 1; i < bands.size(); ++i)
+        pool.addJob (bands.getUnchecked (i));
+
+    bands.getUnchecked (0)->render();
+
+    for (int i = 1; i < bands.size(); ++i)
+        pool.waitForJobToFinish (bands.getUnchecked (i), -1);
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class PixelSpanFunctionsTests  : public UnitTest
+{
+public:
+    PixelSpanFunctionsTests() : UnitTest ("PixelSpanFunctions") {}
+
+    typedef SoftwareRendererClasses::PixelSpanFunctions Functions;
+
+    // Returns either a properly premultiplied colour, or a random (and probably invalid) one.
+    static PixelARGB createRandomColour (Random& r)
+    {
+        if (r.nextBool())
+            return PixelARGB ((uint32) r.nextInt());
+
+        PixelARGB p (Colour ((uint32) r.nextInt()).getPixelARGB());
+
+        if (r.nextBool())
+            p.setAlpha (0xff);
+        else
+            p.multiplyAlpha (r.nextInt (256));
+
+        return p;
+    }
+
+    template <class PixelType>
+    struct Buffers
+    {
+        Buffers (Random& r, const int numPixels)
+            : numBytes ((size_t) numPixels * sizeof (PixelType))
+        {
+            expected.malloc (numBytes);
+            actual.malloc (numBytes);
+
+            for (size_t i = 0; i < numBytes; ++i)
+                expected[i] = (uint8) r.nextInt (256);
+
+            memcpy (actual, expected, numBytes);
+        }
+
+        PixelType* getExpected (int offset) const noexcept  { return reinterpret_cast <PixelType*> (expected.getData()) + offset; }
+        PixelType* getActual (int offset) const noexcept    { return reinterpret_cast <PixelType*> (actual.getData()) + offset; }
+        bool matches() const noexcept                       { return memcmp (expected, actual, numBytes) == 0; }
+
+        const size_t numBytes;
+        HeapBlock<uint8> expected, actual;
+    };
+
+    template <class PixelType>
+    void testColourSpan (Random& r, void (*plain) (PixelType*, PixelARGB, int),
+                         void (*optimised) (PixelType*, PixelARGB, int))
+    {
+        const int width = 1 + r.nextInt (100);
+        const int offset = r.nextInt (20);
+        const PixelARGB colour (createRandomColour (r));
+
+        Buffers<PixelType> b (r, width + offset + 20);
+        plain (b.getExpected (offset), colour, width);
+        optimised (b.getActual (offset), colour, width);
+        expect (b.matches());
+    }
+
+    void testImageSpan (Random& r, const Functions& plain, const Functions& optimised)
+    {
+        const int width = 1 + r.nextInt (100);
+        const int offset = r.nextInt (20);
+        const uint32 alpha = (uint32) (r.nextBool() ? 0xff : r.nextInt (256));
+
+        Buffers<PixelARGB> b (r, width + offset + 20), src (r, width + offset);
+
+        for (int i = 0; i < width; ++i)
+            src.getActual (offset)[i] = createRandomColour (r);
+
+        plain.blendImageARGB (b.getExpected (offset), src.getActual (offset), width, alpha);
+        optimised.blendImageARGB (b.getActual (offset), src.getActual (offset), width, alpha);
+        expect (b.matches());
+    }
+
+    void runTest()
+    {
+        beginTest ("Optimised spans match the plain ones");
+
+        const Functions plain (Functions::createPlain());
+        const Functions& optimised = Functions::getInstance();
+        Random r;
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            testColourSpan<PixelARGB>  (r, plain.fillColourARGB,   optimised.fillColourARGB);
+            testColourSpan<PixelARGB>  (r, plain.blendColourARGB,  optimised.blendColourARGB);
+            testColourSpan<PixelRGB>   (r, plain.blendColourRGB,   optimised.blendColourRGB);
+            testColourSpan<PixelAlpha> (r, plain.blendColourAlpha, optimised.blendColourAlpha);
+            testImageSpan (r, plain, optimised);
+        }
+
+        beginTest ("Opaque fills of RGB images");
+
+        for (int i = 0; i < 100; ++i)
+        {
+            Image image (Image::RGB, 120, 4, true, SoftwareImageType());
+            const Colour colour (Colour ((uint32) r.nextInt()).withAlpha (1.0f));
+            const Colour grey (Colour::greyLevel (r.nextFloat()));
+            const int x = r.nextInt (20);
+            const int w = 1 + r.nextInt (image.getWidth() - x);
+
+            {
+                Graphics g (image);
+                g.setColour (colour);
+                g.fillRect (x, 0, w, 2);
+                g.setColour (grey);
+                g.fillRect (x, 2, w, 2);
+            }
+
+            for (int px = 0; px < image.getWidth(); ++px)
+            {
+                const bool inside = px >= x && px < x + w;
+                expect (image.getPixelAt (px, 1) == (inside ? colour : Colours::black));
+                expect (image.getPixelAt (px, 3) == (inside ? grey : Colours::black));
+            }
+        }
+    }
+};
+
+static PixelSpanFunctionsTests pixelSpanFunctionsUnitTests;
+
+//==============================================================================
+class SoftwareRendererGlyphCacheTests  : public UnitTest
+{
+public:
+    SoftwareRendererGlyphCacheTests() : UnitTest ("SoftwareRendererGlyphCache") {}
+
+    static Image drawText (const String& text, const Font& font)
+    {
+        Image image (Image::ARGB, 400, 30, true, SoftwareImageType());
+        Graphics g (image);
+        g.setColour (Colours::black);
+        g.setFont (font);
+        g.drawSingleLineText (text, 2, 22);
+        return image;
+    }
+
+    static bool imagesMatch (const Image& a, const Image& b)
+    {
+        const Image::BitmapData da (a, Image::BitmapData::readOnly);
+        const Image::BitmapData db (b, Image::BitmapData::readOnly);
+
+        for (int y = 0; y < a.getHeight(); ++y)
+            if (memcmp (da.getLinePointer (y), db.getLinePointer (y), (size_t) (a.getWidth() * da.pixelStride)) != 0)
+                return false;
+
+        return true;
+    }
+
+    struct DrawingThread  : public Thread
+    {
+        DrawingThread (const String& text_, const Array<Font>& fonts_, const OwnedArray<Image>& expected_)
+            : Thread ("glyph cache test"), text (text_), fonts (fonts_), expected (expected_), numMismatches (0)
+        {}
+
+        void run()
+        {
+            for (int i = 0; i < 10; ++i)
+                for (int j = 0; j < fonts.size(); ++j)
+                    if (! imagesMatch (drawText (text, fonts.getReference (j)), *expected.getUnchecked (j)))
+                        ++numMismatches;
+        }
+
+        const String text;
+        const Array<Font>& fonts;
+        const OwnedArray<Image>& expected;
+        int numMismatches;
+    };
+
+   #if JUCE_USE_GLYPH_ALPHA_ATLAS
+    // Fills atlas areas with its own value, and checks that nobody else has written
+    // over them before it lets them go.
+    struct AtlasThread  : public Thread
+    {
+        AtlasThread (const uint8 value_, const int seed)
+            : Thread ("glyph atlas test"), value (value_), random (seed), numOverwritten (0)
+        {}
+
+        struct Allocation
+        {
+            GlyphAlphaAtlas::Page::Ptr page;
+            Rectangle<int> area;
+        };
+
+        void run()
+        {
+            Array<Allocation> allocations;
+
+            for (int i = 0; i < 5000; ++i)
+            {
+                if (allocations.size() > 200 || (allocations.size() > 0 && random.nextInt (3) == 0))
+                {
+                    const int index = random.nextInt (allocations.size());
+                    check (allocations.getReference (index));
+                    allocations.remove (index);
+                }
+                else
+                {
+                    Allocation a;
+                    a.page = GlyphAlphaAtlas::getInstance()->allocate (1 + random.nextInt (40), 1 + random.nextInt (40), a.area);
+
+                    for (int y = 0; y < a.area.getHeight(); ++y)
+                        memset (a.page->getPixels (a.area) + y * a.page->getLineStride(), value, (size_t) a.area.getWidth());
+
+                    allocations.add (a);
+                }
+            }
+
+            for (int i = allocations.size(); --i >= 0;)
+                check (allocations.getReference (i));
+        }
+
+        void check (const Allocation& a)
+        {
+            for (int y = 0; y < a.area.getHeight(); ++y)
+            {
+                const uint8* const line = a.page->getPixels (a.area) + y * a.page->getLineStride();
+
+                for (int x = 0; x < a.area.getWidth(); ++x)
+                {
+                    if (line[x] != value)
+                    {
+                        ++numOverwritten;
+                        return;
+                    }
+                }
+            }
+        }
+
+        const uint8 value;
+        Random random;
+        int numOverwritten;
+    };
+   #endif
+
+    void runTest()
+    {
+       #if JUCE_USE_GLYPH_ALPHA_ATLAS
+        beginTest ("Allocating atlas space from several threads");
+
+        {
+            // (these allocations aren't glyphs in the cache, so the atlas mustn't run out of pages)
+            GlyphAlphaAtlas::getInstance()->setMemoryLimit (std::numeric_limits<size_t>::max());
+            OwnedArray<AtlasThread> threads;
+
+            for (int i = 0; i < 4; ++i)
+            {
+                AtlasThread* const t = new AtlasThread ((uint8) (i + 1), i);
+                threads.add (t);
+                t->startThread();
+            }
+
+            for (int i = 0; i < threads.size(); ++i)
+            {
+                threads.getUnchecked (i)->waitForThreadToExit (-1);
+                expectEquals (threads.getUnchecked (i)->numOverwritten, 0);
+            }
+
+            // (this puts the atlas's limit back to the cache's budget)
+            LowLevelGraphicsSoftwareRenderer::setGlyphCacheMemoryBudget (LowLevelGraphicsSoftwareRenderer::getGlyphCacheStatistics().memoryBudget);
+        }
+       #endif
+
+        beginTest ("Drawing from several threads");
+
+        const String text ("The quick brown fox jumps over the lazy dog 0123456789");
+        Array<Font> fonts;
+        OwnedArray<Image> expected;
+
+        for (int i = 0; i < 8; ++i)
+        {
+            const Font font (10.0f + i * 1.5f, (i & 1) != 0 ? Font::bold : Font::plain);
+            fonts.add (font);
+            expected.add (new Image (drawText (text, font)));
+            expect (imagesMatch (*expected.getLast(), drawText (text, font)));
+        }
+
+        const size_t oldBudget = LowLevelGraphicsSoftwareRenderer::getGlyphCacheStatistics().memoryBudget;
+
+        // test both with a cache that's big enough, and with one that's so small that
+        // glyphs are being purged and recycled while other threads are drawing them
+        const size_t budgets[] = { oldBudget, 8192 };
+
+        for (int b = 0; b < numElementsInArray (budgets); ++b)
+        {
+            LowLevelGraphicsSoftwareRenderer::setGlyphCacheMemoryBudget (budgets[b]);
+
+            OwnedArray<DrawingThread> threads;
+            const uint32 startTime = Time::getMillisecondCounter();
+
+            for (int i = 0; i < 4; ++i)
+            {
+                DrawingThread* const t = new DrawingThread (text, fonts, expected);
+                threads.add (t);
+                t->startThread();
+            }
+
+            for (int i = 0; i < threads.size(); ++i)
+            {
+                threads.getUnchecked (i)->waitForThreadToExit (-1);
+                expectEquals (threads.getUnchecked (i)->numMismatches, 0);
+            }
+
+            const RenderingHelpers::GlyphCacheStatistics stats (LowLevelGraphicsSoftwareRenderer::getGlyphCacheStatistics());
+            expect (stats.memoryUsage <= stats.memoryBudget + 4096);  // (it may go over by the glyph that was drawn last)
+
+            logMessage ("4 threads, " + String ((int) budgets[b]) + " byte budget: "
+                          + String (Time::getMillisecondCounter() - startTime) + "ms");
+        }
+
+       #if JUCE_USE_GLYPH_ALPHA_ATLAS
+        beginTest ("Keeping the atlas pages within the budget");
+
+        {
+            // A few glyphs that are drawn all the time keep the oldest pages alive, while lots
+            // of others fill up new ones and then get thrown away.
+            const size_t budget = 3 * GlyphAlphaAtlas::getPageMemoryUsage();
+            LowLevelGraphicsSoftwareRenderer::setGlyphCacheMemoryBudget (budget);
+
+            const Font hotFont (14.0f);
+            const Image hotText (drawText ("Hot", hotFont));
+
+            for (int i = 0; i < 200; ++i)
+            {
+                drawText (text, Font (8.0f + i * 0.25f, (i & 1) != 0 ? Font::bold : Font::plain));
+                expect (imagesMatch (drawText ("Hot", hotFont), hotText));
+
+                const RenderingHelpers::GlyphCacheStatistics stats (LowLevelGraphicsSoftwareRenderer::getGlyphCacheStatistics());
+                expect (stats.memoryUsage <= budget + 4096);
+                expect (GlyphAlphaAtlas::getInstance()->getMemoryUsage() <= budget);
+            }
+        }
+       #endif
+
+        LowLevelGraphicsSoftwareRenderer::setGlyphCacheMemoryBudget (oldBudget);
+    }
+};
+
+static SoftwareRendererGlyphCacheTests softwareRendererGlyphCacheUnitTests;
+
+#endif
+
 #if JUCE_MSVC
  #pragma warning (pop)
 
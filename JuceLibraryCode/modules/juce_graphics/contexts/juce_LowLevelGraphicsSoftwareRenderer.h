@@ -27,6 +27,7 @@
 #define __JUCE_LOWLEVELGRAPHICSSOFTWARERENDERER_JUCEHEADER__
 
 #include "juce_LowLevelGraphicsContext.h"
+class LowLevelGraphicsRecorder;
 
 #ifndef DOXYGEN
 #include "../native/juce_RenderingHelpers.h"
@@ -86,6 +87,54 @@ public:
     void drawGlyph (int glyphNumber, float x, float y);
     void drawGlyph (int glyphNumber, const AffineTransform&);
 
+    //==============================================================================
+    /** Sets the maximum number of bytes that the shared cache of rendered glyphs may use.
+        When the cache grows beyond this, the least-recently used glyphs are discarded.
+    */
+    static void setGlyphCacheMemoryBudget (size_t maxBytes);
+
+    /** Returns the hit, miss and eviction counts of the shared glyph cache. */
+    static RenderingHelpers::GlyphCacheStatistics getGlyphCacheStatistics();
+
+    //==============================================================================
+    /** Sets the number of threads that renderInBands() may use.
+
+        The default is 1, so nothing is drawn in parallel unless you ask for it. When
+        this is more than 1, windows that are drawn in software record each large repaint
+        with a LowLevelGraphicsRecorder and then render it with renderInBands(), using a
+        LowLevelGraphicsSoftwareRenderer rather than LookAndFeel::createGraphicsContext().
+        A sensible value is SystemStats::getNumCpus().
+    */
+    static void setNumRenderingThreads (int numThreads);
+
+    /** Returns the number of threads that renderInBands() may use.
+        @see setNumRenderingThreads
+    */
+    static int getNumRenderingThreads() noexcept;
+
+    /** Returns true if an area is big enough for renderInBands() to split it up, and
+        more than one rendering thread has been enabled.
+    */
+    static bool isWorthRenderingInBands (const Rectangle<int>& area) noexcept;
+
+    /** Draws a recorded set of operations onto an image using several threads.
+
+        The area covered by the clip region is divided into horizontal bands, each of
+        which is drawn by its own LowLevelGraphicsSoftwareRenderer, with its clip region
+        restricted to that band. The calling thread draws one of the bands, and waits for
+        the others to be finished by a shared pool of threads. Every pixel is calculated
+        in the same way as it would be by a single renderer, so the image ends up exactly
+        the same as if the operations had been replayed into
+        LowLevelGraphicsSoftwareRenderer (imageToRenderOn, origin, initialClip).
+
+        If the area is too small to be worth splitting up, it's just drawn by the calling
+        thread.
+
+        @see setNumRenderingThreads, LowLevelGraphicsRecorder
+    */
+    static void renderInBands (const LowLevelGraphicsRecorder& recording, const Image& imageToRenderOn,
+                               const Point<int>& origin, const RectangleList& initialClip);
+
    #ifndef DOXYGEN
     class SavedState;
    #endif
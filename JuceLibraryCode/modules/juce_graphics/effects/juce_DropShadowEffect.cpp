@@ -25,10 +25,6 @@
 
 BEGIN_JUCE_NAMESPACE
 
-#if JUCE_MSVC && JUCE_DEBUG
- #pragma optimize ("t", on)
-#endif
-
 //==============================================================================
 DropShadowEffect::DropShadowEffect()
   : offsetX (0),
@@ -55,47 +51,8 @@ void DropShadowEffect::setShadowProperties (const float newRadius,
 
 void DropShadowEffect::applyEffect (Image& image, Graphics& g, float alpha)
 {
-    const int w = image.getWidth();
-    const int h = image.getHeight();
-
-    Image shadowImage (Image::SingleChannel, w, h, false);
-
-    {
-        const Image::BitmapData srcData (image, Image::BitmapData::readOnly);
-        const Image::BitmapData destData (shadowImage, Image::BitmapData::readWrite);
-
-        const int filter = roundToInt (63.0f / radius);
-        const int radiusMinus1 = roundToInt ((radius - 1.0f) * 63.0f);
-
-        for (int x = w; --x >= 0;)
-        {
-            int shadowAlpha = 0;
-
-            const PixelARGB* src = ((const PixelARGB*) srcData.data) + x;
-            uint8* shadowPix = destData.data + x;
-
-            for (int y = h; --y >= 0;)
-            {
-                shadowAlpha = ((shadowAlpha * radiusMinus1 + (src->getAlpha() << 6)) * filter) >> 12;
-
-                *shadowPix = (uint8) shadowAlpha;
-                src = addBytesToPointer (src, srcData.lineStride);
-                shadowPix += destData.lineStride;
-            }
-        }
-
-        for (int y = h; --y >= 0;)
-        {
-            int shadowAlpha = 0;
-            uint8* shadowPix = destData.getLinePointer (y);
-
-            for (int x = w; --x >= 0;)
-            {
-                shadowAlpha = ((shadowAlpha * radiusMinus1 + (*shadowPix << 6)) * filter) >> 12;
-                *shadowPix++ = (uint8) shadowAlpha;
-            }
-        }
-    }
+    Image shadowImage;
+    ImageBlur::blurAlphaChannel (image, shadowImage, radius);
 
     g.setColour (Colours::black.withAlpha (opacity * alpha));
     g.drawImageAt (shadowImage, offsetX, offsetY, true);
@@ -104,8 +61,4 @@ void DropShadowEffect::applyEffect (Image& image, Graphics& g, float alpha)
     g.drawImageAt (image, 0, 0);
 }
 
-#if JUCE_MSVC && JUCE_DEBUG
-  #pragma optimize ("", on)  // resets optimisations to the project defaults
-#endif
-
 END_JUCE_NAMESPACE
@@ -39,11 +39,10 @@
     shadow based on what gets drawn inside it. The shadow will also
     be applied to the component's children.
 
-    For speed, this doesn't use a proper gaussian blur, but cheats by
-    using a simple bilinear filter. If you need a really high-quality
-    shadow, check out ImageConvolutionKernel::createGaussianBlur()
+    The shadow is blurred with an ImageBlur, which is a close approximation
+    of a gaussian blur.
 
-    @see Component::setComponentEffect
+    @see Component::setComponentEffect, ImageBlur
 */
 class JUCE_API  DropShadowEffect  : public ImageEffectFilter
 {
@@ -62,7 +61,8 @@ public:
     //==============================================================================
     /** Sets up parameters affecting the shadow's appearance.
 
-        @param newRadius        the (approximate) radius of the blur used
+        @param newRadius        the (approximate) radius of the blur used - see
+                                ImageBlur::applyToImage()
         @param newOpacity       the opacity with which the shadow is rendered
         @param newShadowOffsetX allows the shadow to be shifted in relation to the
                                 component's contents
@@ -45,17 +45,12 @@ void GlowEffect::setGlowProperties (const float newRadius,
 
 void GlowEffect::applyEffect (Image& image, Graphics& g, float alpha)
 {
-    Image temp (image.getFormat(), image.getWidth(), image.getHeight(), true);
-
-    ImageConvolutionKernel blurKernel (roundToInt (radius * 2.0f));
-
-    blurKernel.createGaussianBlur (radius);
-    blurKernel.rescaleAllValues (radius);
-
-    blurKernel.applyToImage (temp, image, image.getBounds());
+    // (the blur is amplified, so that the glow stays solid close to the edges)
+    Image glowImage;
+    ImageBlur::blurAlphaChannel (image, glowImage, radius, jmax (1.0f, radius));
 
     g.setColour (colour.withMultipliedAlpha (alpha));
-    g.drawImageAt (temp, 0, 0, true);
+    g.drawImageAt (glowImage, 0, 0, true);
 
     g.setOpacity (alpha);
     g.drawImageAt (image, 0, 0, false);
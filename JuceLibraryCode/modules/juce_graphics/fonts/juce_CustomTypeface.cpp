@@ -43,19 +43,30 @@ public:
     void addKerningPair (const juce_wchar subsequentCharacter,
                          const float extraKerningAmount) noexcept
     {
-        KerningPair kp;
-        kp.character2 = subsequentCharacter;
-        kp.kerningAmount = extraKerningAmount;
-        kerningPairs.add (kp);
+        // The pairs are kept sorted by character, so that they can be binary-searched
+        const int index = findKerningPairIndex (subsequentCharacter);
+
+        if (index < kerningPairs.size() && kerningPairs.getReference (index).character2 == subsequentCharacter)
+        {
+            kerningPairs.getReference (index).kerningAmount = extraKerningAmount;
+        }
+        else
+        {
+            KerningPair kp;
+            kp.character2 = subsequentCharacter;
+            kp.kerningAmount = extraKerningAmount;
+            kerningPairs.insert (index, kp);
+        }
     }
 
     float getHorizontalSpacing (const juce_wchar subsequentCharacter) const noexcept
     {
         if (subsequentCharacter != 0)
         {
-            for (int i = kerningPairs.size(); --i >= 0;)
-                if (kerningPairs.getReference(i).character2 == subsequentCharacter)
-                    return width + kerningPairs.getReference(i).kerningAmount;
+            const int index = findKerningPairIndex (subsequentCharacter);
+
+            if (index < kerningPairs.size() && kerningPairs.getReference (index).character2 == subsequentCharacter)
+                return width + kerningPairs.getReference (index).kerningAmount;
         }
 
         return width;
@@ -67,6 +78,23 @@ public:
     Array <KerningPair> kerningPairs;
 
 private:
+    int findKerningPairIndex (const juce_wchar subsequentCharacter) const noexcept
+    {
+        int start = 0, end = kerningPairs.size();
+
+        while (start < end)
+        {
+            const int mid = (start + end) / 2;
+
+            if (kerningPairs.getReference (mid).character2 < subsequentCharacter)
+                start = mid + 1;
+            else
+                end = mid;
+        }
+
+        return start;
+    }
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GlyphInfo);
 };
 
@@ -103,15 +131,96 @@ namespace CustomTypefaceHelpers
     }
 }
 
+//==============================================================================
+/** Maps a block of 256 consecutive characters to their glyphs.
+
+    The pages are indexed by the character's upper bits, so finding the glyph for any
+    character takes two array lookups. Each page also remembers which of its characters
+    have already failed to load, so that missing glyphs aren't searched for every time.
+
+    The pages are only ever added, and glyphs are only ever added to them, so other threads
+    can look glyphs up while new ones are being loaded.
+*/
+class CustomTypeface::GlyphPage
+{
+public:
+    GlyphPage() noexcept
+    {
+        zeromem (glyphs, sizeof (glyphs));
+        zeromem (missingFlags, sizeof (missingFlags));
+    }
+
+    // (there's room for every unicode character, and for 64K glyph numbers above them)
+    enum { numBits = 8, size = 1 << numBits, maxNumPages = 0x120000 >> numBits };
+
+    static int getPageIndex (const juce_wchar character) noexcept       { return (int) character >> numBits; }
+    static int getIndexInPage (const juce_wchar character) noexcept     { return (int) character & (size - 1); }
+
+    bool isMissing (const int index) const noexcept                     { return (missingFlags [index >> 5] & (1u << (index & 31))) != 0; }
+    void setMissing (const int index, const bool missing) noexcept
+    {
+        if (missing)
+            missingFlags [index >> 5] |= (1u << (index & 31));
+        else
+            missingFlags [index >> 5] &= ~(1u << (index & 31));
+    }
+
+    GlyphInfo* glyphs [size];
+
+private:
+    uint32 missingFlags [size / 32];
+
+    JUCE_DECLARE_NON_COPYABLE (GlyphPage);
+};
+
+//==============================================================================
+/** Holds the pages for a block of 256 consecutive page indexes.
+
+    A table with room for every page would need 4608 pointers, which is a lot for a typeface
+    that only uses a few of them, so the blocks are only created as they're needed. The table
+    of blocks is allocated at its full size, and blocks are never removed from it, so it can
+    still be read without the lock.
+*/
+class CustomTypeface::GlyphPageBlock
+{
+public:
+    GlyphPageBlock() noexcept
+    {
+        zeromem (pages, sizeof (pages));
+    }
+
+    ~GlyphPageBlock()
+    {
+        for (int i = 0; i < size; ++i)
+            delete pages[i];
+    }
+
+    enum { numBits = 8, size = 1 << numBits, maxNumBlocks = GlyphPage::maxNumPages >> numBits };
+
+    static int getBlockIndex (const int pageIndex) noexcept             { return pageIndex >> numBits; }
+    static int getIndexInBlock (const int pageIndex) noexcept           { return pageIndex & (size - 1); }
+
+    GlyphPage* pages [size];
+
+private:
+    JUCE_DECLARE_NON_COPYABLE (GlyphPageBlock);
+};
+
 //==============================================================================
 CustomTypeface::CustomTypeface()
-    : Typeface (String::empty)
+    : Typeface (String::empty),
+      glyphBeingLoaded (nullptr),
+      characterBeingLoaded (0),
+      isLoadingGlyph (false)
 {
     clear();
 }
 
 CustomTypeface::CustomTypeface (InputStream& serialisedTypefaceStream)
-    : Typeface (String::empty)
+    : Typeface (String::empty),
+      glyphBeingLoaded (nullptr),
+      characterBeingLoaded (0),
+      isLoadingGlyph (false)
 {
     clear();
 
@@ -157,7 +266,13 @@ void CustomTypeface::clear()
     defaultCharacter = 0;
     ascent = 1.0f;
     isBold = isItalic = false;
-    zeromem (lookupTable, sizeof (lookupTable));
+
+    glyphPageBlocks.clear();
+    glyphPageBlocks.ensureStorageAllocated (GlyphPageBlock::maxNumBlocks);
+
+    for (int i = 0; i < GlyphPageBlock::maxNumBlocks; ++i)
+        glyphPageBlocks.add (nullptr);
+
     glyphs.clear();
 }
 
@@ -173,19 +288,26 @@ void CustomTypeface::setCharacteristics (const String& name_, const float ascent
 
 void CustomTypeface::addGlyph (const juce_wchar character, const Path& path, const float width) noexcept
 {
+    const ScopedLock sl (lock);
+
     // Check that you're not trying to add the same character twice..
     jassert (findGlyph (character, false) == nullptr);
 
-    if (isPositiveAndBelow ((int) character, (int) numElementsInArray (lookupTable)))
-        lookupTable [character] = (short) glyphs.size();
+    GlyphInfo* const glyph = new GlyphInfo (character, path, width);
+    glyphs.add (glyph);
 
-    glyphs.add (new GlyphInfo (character, path, width));
+    // A glyph that's being loaded is kept hidden until loadGlyphIfPossible() has returned
+    if (isLoadingGlyph && character == characterBeingLoaded)
+        glyphBeingLoaded = glyph;
+    else
+        publishGlyph (glyph);
 }
 
 void CustomTypeface::addKerningPair (const juce_wchar char1, const juce_wchar char2, const float extraAmount) noexcept
 {
     if (extraAmount != 0)
     {
+        const ScopedLock sl (lock);
         GlyphInfo* const g = findGlyph (char1, true);
         jassert (g != nullptr); // can only add kerning pairs for characters that exist!
 
@@ -196,22 +318,123 @@ void CustomTypeface::addKerningPair (const juce_wchar char1, const juce_wchar ch
 
 CustomTypeface::GlyphInfo* CustomTypeface::findGlyph (const juce_wchar character, const bool loadIfNeeded) noexcept
 {
-    if (isPositiveAndBelow ((int) character, (int) numElementsInArray (lookupTable)) && lookupTable [character] > 0)
-        return glyphs [(int) lookupTable [(int) character]];
+    // Published glyphs are never changed or removed, so finding one doesn't need the lock
+    const GlyphPage* const page = findGlyphPage (character);
 
-    for (int i = 0; i < glyphs.size(); ++i)
+    if (page != nullptr)
     {
-        GlyphInfo* const g = glyphs.getUnchecked(i);
-        if (g->character == character)
-            return g;
+        const int index = GlyphPage::getIndexInPage (character);
+
+        if (page->glyphs [index] != nullptr)
+            return page->glyphs [index];
+
+        if (page->isMissing (index))
+            return nullptr;
     }
 
-    if (loadIfNeeded && loadGlyphIfPossible (character))
-        return findGlyph (character, false);
+    if (loadIfNeeded && character >= 0)
+        return loadGlyph (character);
 
     return nullptr;
 }
 
+CustomTypeface::GlyphInfo* CustomTypeface::loadGlyph (const juce_wchar character)
+{
+    const ScopedLock sl (lock);
+
+    // (when a glyph's kerning pairs are added, it'll be asked for before it has been published)
+    if (isLoadingGlyph && character == characterBeingLoaded)
+        return glyphBeingLoaded;
+
+    GlyphPage* const page = getGlyphPageFor (character);
+
+    if (page == nullptr)
+        return nullptr;
+
+    // Another thread may have loaded it while this one was waiting for the lock..
+    const int index = GlyphPage::getIndexInPage (character);
+
+    if (page->glyphs [index] != nullptr || page->isMissing (index))
+        return page->glyphs [index];
+
+    GlyphInfo* const previousGlyph = glyphBeingLoaded;
+    const juce_wchar previousCharacter = characterBeingLoaded;
+    const bool wasLoadingGlyph = isLoadingGlyph;
+
+    glyphBeingLoaded = nullptr;
+    characterBeingLoaded = character;
+    isLoadingGlyph = true;
+
+    loadGlyphIfPossible (character);
+    GlyphInfo* const glyph = glyphBeingLoaded;
+
+    glyphBeingLoaded = previousGlyph;
+    characterBeingLoaded = previousCharacter;
+    isLoadingGlyph = wasLoadingGlyph;
+
+    if (glyph != nullptr)
+        publishGlyph (glyph);
+    else
+        page->setMissing (index, true); // remember the failure, so we don't keep asking for a glyph that isn't there
+
+    return glyph;
+}
+
+void CustomTypeface::publishGlyph (GlyphInfo* const glyph)
+{
+    GlyphPage* const page = getGlyphPageFor (glyph->character);
+    jassert (page != nullptr); // this character's code is too high to be stored!
+
+    if (page != nullptr)
+    {
+        const int index = GlyphPage::getIndexInPage (glyph->character);
+
+        // (the glyph must be complete before any other threads can find it)
+        Atomic<int>::memoryBarrier();
+        page->glyphs [index] = glyph;
+        page->setMissing (index, false);
+    }
+}
+
+const CustomTypeface::GlyphPage* CustomTypeface::findGlyphPage (const juce_wchar character) const noexcept
+{
+    const int pageIndex = GlyphPage::getPageIndex (character);
+
+    if (! isPositiveAndBelow (pageIndex, (int) GlyphPage::maxNumPages))
+        return nullptr;
+
+    const GlyphPageBlock* const block = glyphPageBlocks.getUnchecked (GlyphPageBlock::getBlockIndex (pageIndex));
+    return block != nullptr ? block->pages [GlyphPageBlock::getIndexInBlock (pageIndex)] : nullptr;
+}
+
+CustomTypeface::GlyphPage* CustomTypeface::getGlyphPageFor (const juce_wchar character)
+{
+    const int pageIndex = GlyphPage::getPageIndex (character);
+
+    if (! isPositiveAndBelow (pageIndex, (int) GlyphPage::maxNumPages))
+        return nullptr;
+
+    GlyphPageBlock* block = glyphPageBlocks.getUnchecked (GlyphPageBlock::getBlockIndex (pageIndex));
+
+    if (block == nullptr)
+    {
+        block = new GlyphPageBlock();
+        Atomic<int>::memoryBarrier();
+        glyphPageBlocks.set (GlyphPageBlock::getBlockIndex (pageIndex), block);
+    }
+
+    GlyphPage*& page = block->pages [GlyphPageBlock::getIndexInBlock (pageIndex)];
+
+    if (page == nullptr)
+    {
+        GlyphPage* const newPage = new GlyphPage();
+        Atomic<int>::memoryBarrier();
+        page = newPage;
+    }
+
+    return page;
+}
+
 bool CustomTypeface::loadGlyphIfPossible (const juce_wchar /*characterNeeded*/)
 {
     return false;
@@ -410,5 +633,113 @@ EdgeTable* CustomTypeface::getEdgeTableForGlyph (int glyphNumber, const AffineTr
     return nullptr;
 }
 
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class CustomTypefaceTests  : public UnitTest
+{
+public:
+    CustomTypefaceTests() : UnitTest ("CustomTypeface") {}
+
+    // Loads a glyph for just one character, and counts how often it's asked for one.
+    class LoadingTypeface  : public CustomTypeface
+    {
+    public:
+        LoadingTypeface (const juce_wchar characterToLoad_)
+            : characterToLoad (characterToLoad_), numLoads (0)
+        {}
+
+        bool loadGlyphIfPossible (const juce_wchar characterNeeded)
+        {
+            ++numLoads;
+
+            if (characterNeeded != characterToLoad)
+                return false;
+
+            addGlyph (characterNeeded, createGlyphPath(), 0.75f);
+            return true;
+        }
+
+        const juce_wchar characterToLoad;
+        int numLoads;
+    };
+
+    static Path createGlyphPath()
+    {
+        Path p;
+        p.addRectangle (0.1f, -0.5f, 0.4f, 0.5f);
+        return p;
+    }
+
+    bool hasGlyph (CustomTypeface& typeface, const juce_wchar c, const float width)
+    {
+        Array<int> glyphs;
+        Array<float> xOffsets;
+        typeface.getGlyphPositions (String::charToString (c), glyphs, xOffsets);
+
+        Path path;
+
+        return glyphs.size() == 1 && glyphs.getFirst() == (int) c
+                && xOffsets.size() == 2 && xOffsets.getUnchecked (1) == width
+                && typeface.getStringWidth (String::charToString (c)) == width
+                && typeface.getOutlineForGlyph ((int) c, path)
+                && path.getBounds() == createGlyphPath().getBounds();
+    }
+
+    // (a typeface with no glyphs at all shows what the fallback typeface gives a character)
+    bool fallsBack (CustomTypeface& typeface, const juce_wchar c)
+    {
+        CustomTypeface emptyTypeface;
+        Path path;
+
+        return typeface.getStringWidth (String::charToString (c)) == emptyTypeface.getStringWidth (String::charToString (c))
+                && ! typeface.getOutlineForGlyph ((int) c, path);
+    }
+
+    void runTest()
+    {
+        beginTest ("Characters beyond the first page block");
+
+        // (each block of pages covers 0x10000 characters)
+        const juce_wchar aboveBasicPlane = 0x1f600;
+        const juce_wchar middleBlock = 0x8abcd;
+
+        CustomTypeface typeface;
+        typeface.addGlyph ('A', createGlyphPath(), 0.5f);
+        typeface.addGlyph (aboveBasicPlane, createGlyphPath(), 0.6f);
+
+        expect (hasGlyph (typeface, 'A', 0.5f));
+        expect (hasGlyph (typeface, aboveBasicPlane, 0.6f));
+
+        // (a neighbour in an existing page, one in a new page of an existing block, and one in a block that doesn't exist yet)
+        expect (fallsBack (typeface, aboveBasicPlane + 1));
+        expect (fallsBack (typeface, aboveBasicPlane + 0x1000));
+        expect (fallsBack (typeface, middleBlock));
+
+        typeface.addGlyph (middleBlock, createGlyphPath(), 0.7f);
+
+        expect (hasGlyph (typeface, middleBlock, 0.7f));
+        expect (hasGlyph (typeface, aboveBasicPlane, 0.6f));
+        expect (fallsBack (typeface, middleBlock + 1));
+        expect (fallsBack (typeface, middleBlock - 0x10000));
+
+        beginTest ("Loading glyphs in a new page block");
+
+        LoadingTypeface loadingTypeface (middleBlock);
+
+        expect (hasGlyph (loadingTypeface, middleBlock, 0.75f));
+        expect (hasGlyph (loadingTypeface, middleBlock, 0.75f));
+        expectEquals (loadingTypeface.numLoads, 1);
+
+        // (a character that can't be loaded is only asked for once, and then falls back)
+        expect (fallsBack (loadingTypeface, aboveBasicPlane));
+        expect (fallsBack (loadingTypeface, aboveBasicPlane));
+        expectEquals (loadingTypeface.numLoads, 2);
+    }
+};
+
+static CustomTypefaceTests customTypefaceUnitTests;
+
+#endif
 
 END_JUCE_NAMESPACE
@@ -41,6 +41,12 @@ class OutputStream;
     If you want to create a copy of a native face, you can use addGlyphsFromOtherTypeface()
     to copy glyphs into this face.
 
+    Once it has been set up, a CustomTypeface can be used by several threads at once.
+    Glyphs that have already been added can be looked up without any locking, and only
+    loading a new one with loadGlyphIfPossible() needs the typeface's lock. Any glyphs
+    and kerning pairs that aren't added by loadGlyphIfPossible() should be added before
+    the typeface is shared with other threads.
+
     @see Typeface, Font
 */
 class JUCE_API  CustomTypeface  : public Typeface
@@ -125,6 +131,10 @@ protected:
         particular character and there's no corresponding glyph, they'll call this
         method so that a subclass can try to add that glyph, returning true if it
         manages to do so.
+
+        This is called with the typeface's lock held, so only one thread will be loading
+        glyphs at a time. The new glyph isn't visible to other threads until this returns,
+        so it's safe to add its kerning pairs after adding the glyph itself.
     */
     virtual bool loadGlyphIfPossible (juce_wchar characterNeeded);
 
@@ -133,9 +143,22 @@ private:
     class GlyphInfo;
     friend class OwnedArray<GlyphInfo>;
     OwnedArray <GlyphInfo> glyphs;
-    short lookupTable [128];
+
+    class GlyphPage;
+    class GlyphPageBlock;
+    friend class OwnedArray<GlyphPageBlock>;
+    OwnedArray <GlyphPageBlock> glyphPageBlocks;
+
+    CriticalSection lock;
+    GlyphInfo* glyphBeingLoaded;
+    juce_wchar characterBeingLoaded;
+    bool isLoadingGlyph;
 
     GlyphInfo* findGlyph (const juce_wchar character, bool loadIfNeeded) noexcept;
+    GlyphInfo* loadGlyph (juce_wchar character);
+    const GlyphPage* findGlyphPage (juce_wchar character) const noexcept;
+    GlyphPage* getGlyphPageFor (juce_wchar character);
+    void publishGlyph (GlyphInfo*);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CustomTypeface);
 };
@@ -35,121 +35,368 @@ namespace FontValues
 
     const float defaultFontHeight = 14.0f;
     String fallbackFont;
+
+    Typeface* retain (Typeface* const typeface) noexcept
+    {
+        if (typeface != nullptr)
+            typeface->incReferenceCount();
+
+        return typeface;
+    }
 }
 
 typedef Typeface::Ptr (*GetTypefaceForFont) (const Font&);
 GetTypefaceForFont juce_getTypefaceForFont = nullptr;
 
 //==============================================================================
+/** Keeps the typefaces that were used most recently, so that fonts with the same name
+    and style share one. This can be used by any number of threads at once.
+
+    The faces are looked up by a hash of their name and style, which also picks which of
+    several shards a face lives in. Each shard has its own lock, hash table and list of
+    faces in order of use, so threads that want different fonts rarely wait for each other.
+
+    A shard holds at least its share of the size set by setSize(), and grows when faces
+    that it has just thrown away are asked for again, i.e. when the fonts in use don't fit.
+    If it goes a long time without needing to grow, it shrinks back down a face at a time.
+*/
 class TypefaceCache  : public DeletedAtShutdown
 {
 public:
     TypefaceCache()
-        : counter (0)
     {
         setSize (10);
     }
 
     ~TypefaceCache()
     {
+        if (defaultFace.value != nullptr)
+            defaultFace.value->decReferenceCount();
+
         clearSingletonInstance();
     }
 
-    juce_DeclareSingleton_SingleThreaded_Minimal (TypefaceCache);
+    juce_DeclareSingleton (TypefaceCache, false);
 
     void setSize (const int numToCache)
     {
-        faces.clear();
-        faces.insertMultiple (-1, CachedFace(), numToCache);
+        const int minFacesPerShard = jmax (1, (numToCache + numShards - 1) / numShards);
+
+        for (int i = 0; i < numShards; ++i)
+            shards[i].reset (minFacesPerShard, minFacesPerShard * maxGrowthFactor);
     }
 
     Typeface::Ptr findTypefaceFor (const Font& font)
     {
         const int flags = font.getStyleFlags() & (Font::bold | Font::italic);
         const String faceName (font.getTypefaceName());
+        const uint32 hash = (uint32) faceName.hashCode() * 31u + (uint32) flags;
+        Shard& shard = shards [hash % numShards];
 
-        int i;
-        for (i = faces.size(); --i >= 0;)
-        {
-            CachedFace& face = faces.getReference(i);
+        Typeface::Ptr typeface (shard.find (hash, faceName, flags, font));
 
-            if (face.flags == flags
-                 && face.typefaceName == faceName
-                 && face.typeface->isSuitableForFont (font))
-            {
-                face.lastUsageCount = ++counter;
-                return face.typeface;
-            }
-        }
-
-        int replaceIndex = 0;
-        int bestLastUsageCount = std::numeric_limits<int>::max();
-
-        for (i = faces.size(); --i >= 0;)
+        if (typeface == nullptr)
         {
-            const int lu = faces.getReference(i).lastUsageCount;
+            // No locks are held while the typeface is created, because the look-and-feel
+            // may need to use other fonts to do it..
+            if (juce_getTypefaceForFont == nullptr)
+                typeface = Font::getDefaultTypefaceForFont (font);
+            else
+                typeface = juce_getTypefaceForFont (font);
 
-            if (bestLastUsageCount > lu)
-            {
-                bestLastUsageCount = lu;
-                replaceIndex = i;
-            }
-        }
+            jassert (typeface != nullptr); // the look and feel must return a typeface!
 
-        CachedFace& face = faces.getReference (replaceIndex);
-        face.typefaceName = faceName;
-        face.flags = flags;
-        face.lastUsageCount = ++counter;
-
-        if (juce_getTypefaceForFont == nullptr)
-            face.typeface = Font::getDefaultTypefaceForFont (font);
-        else
-            face.typeface = juce_getTypefaceForFont (font);
+            // ..so if another thread has added this face in the meantime, its typeface is used instead
+            typeface = shard.add (hash, faceName, flags, font, typeface);
+        }
 
-        jassert (face.typeface != nullptr); // the look and feel must return a typeface!
+        if (defaultFace.value == nullptr && font == Font())
+            if (! defaultFace.compareAndSetBool (FontValues::retain (typeface), nullptr))
+                typeface->decReferenceCount();
 
-        if (defaultFace == nullptr && font == Font())
-            defaultFace = face.typeface;
+        return typeface;
+    }
 
-        return face.typeface;
+    // This is only ever set once, and is then kept until the cache is deleted, so it can be
+    // read without a lock or an atomic operation
+    Typeface* getDefaultTypeface() const noexcept
+    {
+        return defaultFace.value;
     }
 
-    Typeface::Ptr getDefaultTypeface() const noexcept
+    Typeface::CacheStatistics getStatistics() const noexcept
     {
-        return defaultFace;
+        Typeface::CacheStatistics s;
+
+        for (int i = 0; i < numShards; ++i)
+            shards[i].addStatistics (s);
+
+        return s;
     }
 
 private:
+    //==============================================================================
+    enum
+    {
+        numShards = 8,
+        maxGrowthFactor = 4,    // how far beyond its minimum size a shard can grow
+        shrinkInterval = 256    // a shard shrinks after this many lookups per face without growing
+    };
+
     struct CachedFace
     {
-        CachedFace() noexcept
-            : lastUsageCount (0), flags (-1)
+        CachedFace (const uint32 hash_, const String& typefaceName_, const int flags_, const Typeface::Ptr& typeface_) noexcept
+            : hash (hash_), typefaceName (typefaceName_), flags (flags_), typeface (typeface_),
+              nextInBucket (nullptr), previous (nullptr), next (nullptr)
         {
         }
 
+        bool matches (const uint32 otherHash, const String& otherName, const int otherFlags) const noexcept
+        {
+            return hash == otherHash && flags == otherFlags && typefaceName == otherName;
+        }
+
+        const uint32 hash;
+
         // Although it seems a bit wacky to store the name here, it's because it may be a
         // placeholder rather than a real one, e.g. "<Sans-Serif>" vs the actual typeface name.
         // Since the typeface itself doesn't know that it may have this alias, the name under
         // which it was fetched needs to be stored separately.
-        String typefaceName;
-        int lastUsageCount, flags;
+        const String typefaceName;
+        const int flags;
         Typeface::Ptr typeface;
+
+        CachedFace* nextInBucket;
+        CachedFace* previous;   // the next most-recently used face
+        CachedFace* next;       // the next least-recently used face
+
+        JUCE_DECLARE_NON_COPYABLE (CachedFace);
+    };
+
+    //==============================================================================
+    class Shard
+    {
+    public:
+        Shard() noexcept
+            : mostRecent (nullptr), leastRecent (nullptr),
+              numFaces (0), minFaces (1), maxFaces (1), capacity (1),
+              lookupsSinceGrowing (0), nextEvictedSlot (0),
+              hits (0), misses (0), evictions (0)
+        {
+            zeromem (buckets, sizeof (buckets));
+        }
+
+        ~Shard()
+        {
+            while (leastRecent != nullptr)
+                remove (leastRecent);
+        }
+
+        void reset (const int newMinFaces, const int newMaxFaces)
+        {
+            const ScopedLock sl (lock);
+
+            while (leastRecent != nullptr)
+                remove (leastRecent);
+
+            minFaces = capacity = newMinFaces;
+            maxFaces = newMaxFaces;
+            lookupsSinceGrowing = 0;
+
+            // (this remembers enough faces to notice when it needs to grow to its maximum size)
+            recentlyEvicted.clearQuick();
+            recentlyEvicted.insertMultiple (0, 0, maxFaces);
+            nextEvictedSlot = 0;
+        }
+
+        Typeface::Ptr find (const uint32 hash, const String& name, const int flags, const Font& font)
+        {
+            const ScopedLock sl (lock);
+            CachedFace* const face = findFace (hash, name, flags);
+
+            if (face != nullptr && face->typeface->isSuitableForFont (font))
+            {
+                ++hits;
+                moveToFront (face);
+                shrinkIfUnderused();
+                return face->typeface;
+            }
+
+            ++misses;
+
+            if (face == nullptr && wasRecentlyEvicted (hash) && capacity < maxFaces)
+            {
+                ++capacity;
+                lookupsSinceGrowing = 0;
+            }
+            else
+            {
+                shrinkIfUnderused();
+            }
+
+            return nullptr;
+        }
+
+        Typeface::Ptr add (const uint32 hash, const String& name, const int flags,
+                           const Font& font, const Typeface::Ptr& typeface)
+        {
+            const ScopedLock sl (lock);
+            CachedFace* face = findFace (hash, name, flags);
+
+            if (face != nullptr)
+            {
+                if (! face->typeface->isSuitableForFont (font))
+                    face->typeface = typeface;
+
+                moveToFront (face);
+                return face->typeface;
+            }
+
+            while (numFaces >= capacity)
+            {
+                addToRecentlyEvicted (leastRecent->hash);
+                remove (leastRecent);
+                ++evictions;
+            }
+
+            face = new CachedFace (hash, name, flags, typeface);
+
+            CachedFace*& bucket = buckets [(hash / numShards) % numBuckets];
+            face->nextInBucket = bucket;
+            bucket = face;
+
+            face->next = mostRecent;
+
+            if (mostRecent != nullptr)
+                mostRecent->previous = face;
+            else
+                leastRecent = face;
+
+            mostRecent = face;
+            ++numFaces;
+
+            return typeface;
+        }
+
+        void addStatistics (Typeface::CacheStatistics& s) const noexcept
+        {
+            const ScopedLock sl (lock);
+
+            s.numHits      += hits;
+            s.numMisses    += misses;
+            s.numEvictions += evictions;
+            s.numTypefaces += numFaces;
+            s.capacity     += capacity;
+        }
+
+    private:
+        enum { numBuckets = 64 };
+
+        CachedFace* buckets [numBuckets];
+        CachedFace* mostRecent;
+        CachedFace* leastRecent;
+        int numFaces, minFaces, maxFaces, capacity, lookupsSinceGrowing;
+        Array<uint32> recentlyEvicted;  // the hashes of the last faces to be thrown away
+        int nextEvictedSlot;
+        int64 hits, misses, evictions;
+        CriticalSection lock;
+
+        CachedFace* findFace (const uint32 hash, const String& name, const int flags) const noexcept
+        {
+            for (CachedFace* f = buckets [(hash / numShards) % numBuckets]; f != nullptr; f = f->nextInBucket)
+                if (f->matches (hash, name, flags))
+                    return f;
+
+            return nullptr;
+        }
+
+        void moveToFront (CachedFace* const face) noexcept
+        {
+            if (face == mostRecent)
+                return;
+
+            face->previous->next = face->next;
+
+            if (face->next != nullptr)
+                face->next->previous = face->previous;
+            else
+                leastRecent = face->previous;
+
+            face->previous = nullptr;
+            face->next = mostRecent;
+            mostRecent->previous = face;
+            mostRecent = face;
+        }
+
+        void remove (CachedFace* const face)
+        {
+            CachedFace** f = &(buckets [(face->hash / numShards) % numBuckets]);
+
+            while (*f != face)
+                f = &((*f)->nextInBucket);
+
+            *f = face->nextInBucket;
+
+            if (face->previous != nullptr)  face->previous->next = face->next;
+            else                            mostRecent = face->next;
+
+            if (face->next != nullptr)      face->next->previous = face->previous;
+            else                            leastRecent = face->previous;
+
+            --numFaces;
+            delete face;
+        }
+
+        bool wasRecentlyEvicted (const uint32 hash) const noexcept
+        {
+            return recentlyEvicted.contains (hash);
+        }
+
+        void addToRecentlyEvicted (const uint32 hash) noexcept
+        {
+            if (recentlyEvicted.size() > 0)
+            {
+                recentlyEvicted.set (nextEvictedSlot, hash);
+                nextEvictedSlot = (nextEvictedSlot + 1) % recentlyEvicted.size();
+            }
+        }
+
+        void shrinkIfUnderused()
+        {
+            if (++lookupsSinceGrowing >= capacity * shrinkInterval && capacity > minFaces)
+            {
+                --capacity;
+                lookupsSinceGrowing = 0;
+
+                while (numFaces > capacity)
+                {
+                    remove (leastRecent);
+                    ++evictions;
+                }
+            }
+        }
+
+        JUCE_DECLARE_NON_COPYABLE (Shard);
     };
 
-    Array <CachedFace> faces;
-    Typeface::Ptr defaultFace;
-    int counter;
+    Shard shards [numShards];
+    Atomic<Typeface*> defaultFace;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TypefaceCache);
 };
 
-juce_ImplementSingleton_SingleThreaded (TypefaceCache)
+juce_ImplementSingleton (TypefaceCache)
 
 void Typeface::setTypefaceCacheSize (int numFontsToCache)
 {
     TypefaceCache::getInstance()->setSize (numFontsToCache);
 }
 
+Typeface::CacheStatistics Typeface::getTypefaceCacheStatistics()
+{
+    return TypefaceCache::getInstance()->getStatistics();
+}
+
 //==============================================================================
 Font::SharedFontInternal::SharedFontInternal (const float height_, const int styleFlags_) noexcept
     : typefaceName (Font::getDefaultSansSerifFontName()),
@@ -159,7 +406,7 @@ Font::SharedFontInternal::SharedFontInternal (const float height_, const int sty
       ascent (0),
       styleFlags (styleFlags_),
       typeface ((styleFlags_ & (Font::bold | Font::italic)) == 0
-                    ? TypefaceCache::getInstance()->getDefaultTypeface() : nullptr)
+                    ? FontValues::retain (TypefaceCache::getInstance()->getDefaultTypeface()) : nullptr)
 {
 }
 
@@ -181,7 +428,7 @@ Font::SharedFontInternal::SharedFontInternal (const Typeface::Ptr& typeface_) no
       kerning (0),
       ascent (0),
       styleFlags (Font::plain),
-      typeface (typeface_)
+      typeface (FontValues::retain (typeface_))
 {
 }
 
@@ -192,8 +439,33 @@ Font::SharedFontInternal::SharedFontInternal (const SharedFontInternal& other) n
       kerning (other.kerning),
       ascent (other.ascent),
       styleFlags (other.styleFlags),
-      typeface (other.typeface)
+      typeface (FontValues::retain (other.typeface.value)) // (if another thread is filling in the other
+                                                           // font's typeface, this one will look it up again)
+{
+}
+
+Font::SharedFontInternal::~SharedFontInternal() noexcept
+{
+    clearTypeface();
+}
+
+bool Font::SharedFontInternal::setTypefaceIfNull (Typeface* const newTypeface) noexcept
 {
+    if (typeface.compareAndSetBool (FontValues::retain (newTypeface), nullptr))
+        return true;
+
+    newTypeface->decReferenceCount();
+    return false;
+}
+
+// Only called when the object isn't shared, so nobody else can be using its typeface.
+void Font::SharedFontInternal::clearTypeface() noexcept
+{
+    if (typeface.value != nullptr)
+    {
+        typeface.value->decReferenceCount();
+        typeface.value = nullptr;
+    }
 }
 
 bool Font::SharedFontInternal::operator== (const SharedFontInternal& other) const noexcept
@@ -296,7 +568,7 @@ void Font::setTypefaceName (const String& faceName)
     {
         dupeInternalIfShared();
         font->typefaceName = faceName;
-        font->typeface = nullptr;
+        font->clearTypeface();
         font->ascent = 0;
     }
 }
@@ -346,7 +618,7 @@ void Font::setStyleFlags (const int newFlags)
     {
         dupeInternalIfShared();
         font->styleFlags = newFlags;
-        font->typeface = nullptr;
+        font->clearTypeface();
         font->ascent = 0;
     }
 }
@@ -541,11 +813,130 @@ Font Font::fromString (const String& fontDescription)
 //==============================================================================
 Typeface* Font::getTypeface() const
 {
-    if (font->typeface == 0)
-        font->typeface = TypefaceCache::getInstance()->findTypefaceFor (*this);
+    // Copies of this font on other threads share the same internal object. Once its typeface
+    // has been filled in it never changes, so it can be read without any locking. Otherwise,
+    // the typeface is looked up and then only stored if nobody else has done it in the meantime.
+    Typeface* typeface = font->typeface.value;
+
+    if (typeface == nullptr)
+    {
+        const Typeface::Ptr newTypeface (TypefaceCache::getInstance()->findTypefaceFor (*this));
+
+        if (font->setTypefaceIfNull (newTypeface))
+            return newTypeface;
+
+        typeface = font->typeface.value;
+    }
 
-    return font->typeface;
+    return typeface;
 }
 
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class TypefaceCacheTests  : public UnitTest
+{
+public:
+    TypefaceCacheTests() : UnitTest ("TypefaceCache") {}
+
+    // (this avoids depending on which fonts are installed)
+    static Typeface::Ptr createEmptyTypeface (const Font& font)
+    {
+        CustomTypeface* const t = new CustomTypeface();
+        t->setCharacteristics (font.getTypefaceName(), 0.8f, font.isBold(), font.isItalic(), 0);
+        return t;
+    }
+
+    static Typeface::Ptr getTypefaceFor (const int fontIndex, const int styleFlags)
+    {
+        return Font ("Typeface cache test " + String (fontIndex), 12.0f, styleFlags).getTypeface();
+    }
+
+    class LookupThread  : public Thread
+    {
+    public:
+        LookupThread (const int seed_)  : Thread ("Typeface cache test"), seed (seed_), allFound (true) {}
+
+        void run()
+        {
+            Random r (seed);
+
+            for (int i = 0; i < 2000; ++i)
+                allFound = (getTypefaceFor (r.nextInt (40), r.nextInt (4)) != nullptr) && allFound;
+        }
+
+        const int seed;
+        bool allFound;
+    };
+
+    void runTest()
+    {
+        beginTest ("Lookups");
+
+        const GetTypefaceForFont oldTypefaceFunction = juce_getTypefaceForFont;
+        juce_getTypefaceForFont = createEmptyTypeface;
+        Typeface::setTypefaceCacheSize (10);
+        Typeface::CacheStatistics before (Typeface::getTypefaceCacheStatistics());
+
+        for (int i = 0; i < 4; ++i)
+        {
+            const Typeface::Ptr t (getTypefaceFor (i, Font::plain));
+            expect (getTypefaceFor (i, Font::plain) == t);
+            expect (getTypefaceFor (i, Font::bold) != t);
+        }
+
+        Typeface::CacheStatistics after (Typeface::getTypefaceCacheStatistics());
+        expect (after.numHits - before.numHits >= 4);
+        expect (after.numMisses - before.numMisses >= 8);
+        expect (after.numTypefaces <= after.capacity);
+
+        beginTest ("Adapting to the working set");
+
+        Typeface::setTypefaceCacheSize (10);
+        const int minimumCapacity = Typeface::getTypefaceCacheStatistics().capacity;
+
+        for (int pass = 0; pass < 3; ++pass)
+            for (int i = 0; i < 40; ++i)
+                getTypefaceFor (i, Font::plain);
+
+        before = Typeface::getTypefaceCacheStatistics();
+        expect (before.capacity > minimumCapacity);
+
+        for (int i = 0; i < 40; ++i)
+            getTypefaceFor (i, Font::plain);
+
+        after = Typeface::getTypefaceCacheStatistics();
+        expect (after.numHits - before.numHits > after.numMisses - before.numMisses);
+
+        beginTest ("Concurrent lookups");
+
+        OwnedArray<LookupThread> threads;
+
+        for (int i = 0; i < 4; ++i)
+            threads.add (new LookupThread (i + 1));
+
+        for (int i = 0; i < threads.size(); ++i)
+            threads.getUnchecked (i)->startThread();
+
+        for (int i = 0; i < threads.size(); ++i)
+        {
+            threads.getUnchecked (i)->waitForThreadToExit (-1);
+            expect (threads.getUnchecked (i)->allFound);
+        }
+
+        after = Typeface::getTypefaceCacheStatistics();
+        expect (after.numTypefaces <= after.capacity);
+        logMessage ("Typeface cache: " + String (after.numHits) + " hits, " + String (after.numMisses) + " misses, "
+                      + String (after.numEvictions) + " evictions, " + String (after.numTypefaces)
+                      + " of " + String (after.capacity) + " typefaces cached");
+
+        juce_getTypefaceForFont = oldTypefaceFunction;
+        Typeface::setTypefaceCacheSize (10);
+    }
+};
+
+static TypefaceCacheTests typefaceCacheUnitTests;
+
+#endif
 
 END_JUCE_NAMESPACE
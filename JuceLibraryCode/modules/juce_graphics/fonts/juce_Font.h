@@ -363,20 +363,23 @@ private:
     friend class FontGlyphAlphaMap;
     friend class TypefaceCache;
 
-    class SharedFontInternal  : public SingleThreadedReferenceCountedObject
+    class SharedFontInternal  : public ReferenceCountedObject
     {
     public:
         SharedFontInternal (float height, int styleFlags) noexcept;
         SharedFontInternal (const String& typefaceName, float height, int styleFlags) noexcept;
         SharedFontInternal (const Typeface::Ptr& typeface) noexcept;
         SharedFontInternal (const SharedFontInternal& other) noexcept;
+        ~SharedFontInternal() noexcept;
 
         bool operator== (const SharedFontInternal&) const noexcept;
+        bool setTypefaceIfNull (Typeface*) noexcept;
+        void clearTypeface() noexcept;
 
         String typefaceName;
         float height, horizontalScale, kerning, ascent;
         int styleFlags;
-        Typeface::Ptr typeface;
+        Atomic<Typeface*> typeface;  // holds a reference to the typeface, once it's been set
     };
 
     ReferenceCountedObjectPtr <SharedFontInternal> font;
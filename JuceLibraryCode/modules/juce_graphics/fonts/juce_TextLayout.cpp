@@ -133,12 +133,15 @@ Range<float> TextLayout::Line::getLineBoundsX() const noexcept
 
 //==============================================================================
 TextLayout::TextLayout()
-    : width (0), justification (Justification::topLeft)
+    : width (0), maxLayoutWidth (0), xOffset (0), justification (Justification::topLeft)
 {
 }
 
 TextLayout::TextLayout (const TextLayout& other)
-    : width (other.width),
+    : paragraphs (other.paragraphs),
+      width (other.width),
+      maxLayoutWidth (other.maxLayoutWidth),
+      xOffset (other.xOffset),
       justification (other.justification)
 {
     lines.addCopiesOf (other.lines);
@@ -147,7 +150,10 @@ TextLayout::TextLayout (const TextLayout& other)
 #if JUCE_COMPILER_SUPPORTS_MOVE_SEMANTICS
 TextLayout::TextLayout (TextLayout&& other) noexcept
     : lines (static_cast <OwnedArray<Line>&&> (other.lines)),
+      paragraphs (static_cast <Array<Paragraph>&&> (other.paragraphs)),
       width (other.width),
+      maxLayoutWidth (other.maxLayoutWidth),
+      xOffset (other.xOffset),
       justification (other.justification)
 {
 }
@@ -155,7 +161,10 @@ TextLayout::TextLayout (TextLayout&& other) noexcept
 TextLayout& TextLayout::operator= (TextLayout&& other) noexcept
 {
     lines = static_cast <OwnedArray<Line>&&> (other.lines);
+    paragraphs = static_cast <Array<Paragraph>&&> (other.paragraphs);
     width = other.width;
+    maxLayoutWidth = other.maxLayoutWidth;
+    xOffset = other.xOffset;
     justification = other.justification;
     return *this;
 }
@@ -164,7 +173,10 @@ TextLayout& TextLayout::operator= (TextLayout&& other) noexcept
 TextLayout& TextLayout::operator= (const TextLayout& other)
 {
     width = other.width;
+    maxLayoutWidth = other.maxLayoutWidth;
+    xOffset = other.xOffset;
     justification = other.justification;
+    paragraphs = other.paragraphs;
     lines.clear();
     lines.addCopiesOf (other.lines);
     return *this;
@@ -228,7 +240,10 @@ void TextLayout::draw (Graphics& g, const Rectangle<float>& area) const
 void TextLayout::createLayout (const AttributedString& text, float maxWidth)
 {
     lines.clear();
+    paragraphs.clearQuick();
     width = maxWidth;
+    maxLayoutWidth = maxWidth;
+    xOffset = 0;
     justification = text.getJustification();
 
     if (! createNativeLayout (text))
@@ -263,11 +278,191 @@ namespace TextLayoutHelpers
         Range<int> range;
     };
 
+    struct AttributeStartComparator
+    {
+        AttributeStartComparator (const AttributedString& text_) noexcept  : text (text_) {}
+
+        int compareElements (const int first, const int second) const noexcept
+        {
+            return text.getAttribute (first)->range.getStart() - text.getAttribute (second)->range.getStart();
+        }
+
+        const AttributedString& text;
+
+        JUCE_DECLARE_NON_COPYABLE (AttributeStartComparator);
+    };
+
+    /** A max-heap of attribute indexes, used to find the most recently added attribute
+        that covers a position as the string is swept from start to end.
+        Attributes whose ranges have already ended are only discarded once they reach the top.
+    */
+    class ActiveAttributeHeap
+    {
+    public:
+        ActiveAttributeHeap() noexcept {}
+
+        void add (const int attributeIndex)
+        {
+            int i = heap.size();
+            heap.add (attributeIndex);
+
+            while (i > 0)
+            {
+                const int parent = (i - 1) / 2;
+
+                if (heap.getUnchecked (parent) >= attributeIndex)
+                    break;
+
+                heap.getReference (i) = heap.getUnchecked (parent);
+                i = parent;
+            }
+
+            heap.getReference (i) = attributeIndex;
+        }
+
+        /** Returns the highest attribute index that covers this position, or -1 if there isn't one. */
+        int getLatestAttributeAt (const AttributedString& text, const int position)
+        {
+            while (heap.size() > 0)
+            {
+                const int top = heap.getUnchecked (0);
+
+                if (text.getAttribute (top)->range.getEnd() > position)
+                    return top;
+
+                removeTop();
+            }
+
+            return -1;
+        }
+
+    private:
+        Array<int> heap;
+
+        void removeTop()
+        {
+            const int last = heap.getLast();
+            heap.removeLast();
+            const int size = heap.size();
+
+            if (size == 0)
+                return;
+
+            int i = 0;
+
+            for (;;)
+            {
+                int child = i * 2 + 1;
+
+                if (child >= size)
+                    break;
+
+                if (child + 1 < size && heap.getUnchecked (child + 1) > heap.getUnchecked (child))
+                    ++child;
+
+                if (heap.getUnchecked (child) <= last)
+                    break;
+
+                heap.getReference (i) = heap.getUnchecked (child);
+                i = child;
+            }
+
+            heap.getReference (i) = last;
+        }
+
+        JUCE_DECLARE_NON_COPYABLE (ActiveAttributeHeap);
+    };
+
+    /** Splits part of an AttributedString into the ranges over which the font and colour are constant.
+        Any characters that have no font attribute will use the defaultFont that is passed in.
+    */
+    void findRunAttributes (const AttributedString& text, const Range<int>& wholeString,
+                            const Font& defaultFont, Array<RunAttribute>& runAttributes)
+    {
+        const int numAttributes = text.getNumAttributes();
+
+        // Collect every position at which the set of active attributes can change,
+        // so that the string can be swept one uniform segment at a time.
+        Array<int> attributesByStart, boundaries;
+        attributesByStart.ensureStorageAllocated (numAttributes);
+        boundaries.ensureStorageAllocated (numAttributes * 2 + 2);
+        boundaries.add (wholeString.getStart());
+        boundaries.add (wholeString.getEnd());
+
+        for (int i = 0; i < numAttributes; ++i)
+        {
+            const Range<int> range (text.getAttribute (i)->range.getIntersectionWith (wholeString));
+
+            if (! range.isEmpty())
+            {
+                attributesByStart.add (i);
+                boundaries.add (range.getStart());
+                boundaries.add (range.getEnd());
+            }
+        }
+
+        AttributeStartComparator startComparator (text);
+        attributesByStart.sort (startComparator);
+
+        DefaultElementComparator<int> intComparator;
+        boundaries.sort (intComparator);
+
+        ActiveAttributeHeap activeFonts, activeColours;
+        int nextAttribute = 0;
+        int rangeStart = wholeString.getStart();
+        FontAndColour lastFontAndColour (nullptr);
+
+        for (int i = 0; i < boundaries.size() - 1; ++i)
+        {
+            const int segmentStart = boundaries.getUnchecked (i);
+
+            if (segmentStart == boundaries.getUnchecked (i + 1))
+                continue;
+
+            while (nextAttribute < attributesByStart.size())
+            {
+                const int attributeIndex = attributesByStart.getUnchecked (nextAttribute);
+                const AttributedString::Attribute* const attr = text.getAttribute (attributeIndex);
+
+                if (attr->range.getStart() > segmentStart)
+                    break;
+
+                if (attr->getFont() != nullptr)    activeFonts.add (attributeIndex);
+                if (attr->getColour() != nullptr)  activeColours.add (attributeIndex);
+
+                ++nextAttribute;
+            }
+
+            // When several attributes overlap, the one that was added last wins
+            FontAndColour newFontAndColour (&defaultFont);
+
+            const int fontIndex = activeFonts.getLatestAttributeAt (text, segmentStart);
+            if (fontIndex >= 0)
+                newFontAndColour.font = text.getAttribute (fontIndex)->getFont();
+
+            const int colourIndex = activeColours.getLatestAttributeAt (text, segmentStart);
+            if (colourIndex >= 0)
+                newFontAndColour.colour = *text.getAttribute (colourIndex)->getColour();
+
+            if (lastFontAndColour.font != nullptr && newFontAndColour != lastFontAndColour)
+            {
+                runAttributes.add (RunAttribute (lastFontAndColour, Range<int> (rangeStart, segmentStart)));
+                rangeStart = segmentStart;
+            }
+
+            lastFontAndColour = newFontAndColour;
+        }
+
+        if (lastFontAndColour.font != nullptr)
+            runAttributes.add (RunAttribute (lastFontAndColour, Range<int> (rangeStart, wholeString.getEnd())));
+    }
+
     struct Token
     {
-        Token (const String& t, const Font& f, const Colour& c, const bool isWhitespace_)
+        Token (const String& t, const Font& f, const Colour& c, const bool isWhitespace_, const int textEnd_)
             : text (t), font (f), colour (c),
               area (font.getStringWidth (t), roundToInt (f.getHeight())),
+              textEnd (textEnd_),
               isWhitespace (isWhitespace_),
               isNewLine (t.containsChar ('\n') || t.containsChar ('\r'))
         {}
@@ -277,29 +472,53 @@ namespace TextLayoutHelpers
         const Colour colour;
         Rectangle<int> area;
         int line, lineHeight;
+        const int textEnd;
         const bool isWhitespace, isNewLine;
 
     private:
         Token& operator= (const Token&);
     };
 
+    /** Describes one of the newline-terminated paragraphs that a TokenList laid out.
+        As a newline always ends a line, each paragraph's lines are independent of the others'.
+    */
+    struct ParagraphInfo
+    {
+        int textStart, textEnd;
+        int numLines, height, numChars;
+    };
+
     class TokenList
     {
     public:
-        TokenList() noexcept  : totalLines (0) {}
+        TokenList (const int top_, const int firstChar_) noexcept
+            : totalLines (0), top (top_), firstChar (firstChar_)
+        {}
 
-        void createLayout (const AttributedString& text, TextLayout& layout)
+        /** Lays out the paragraphs in a range of the string, which must begin at the start of a
+            paragraph and end at the end of one. The first line will be placed at the y position
+            and character count that were given to the constructor.
+        */
+        void createLayout (const AttributedString& text, const IndexedString& indexedText,
+                           const Range<int>& textRange, TextLayout& layout)
         {
             tokens.ensureStorageAllocated (64);
             layout.ensureStorageAllocated (totalLines);
 
-            addTextRuns (text);
+            addTextRuns (text, indexedText, textRange);
+
+            if (tokens.size() == 0)
+                return;
 
             layoutRuns ((int) layout.getWidth());
 
-            int charPosition = 0;
-            int lineStartPosition = 0;
-            int runStartPosition = 0;
+            int charPosition = firstChar;
+            int lineStartPosition = firstChar;
+            int runStartPosition = firstChar;
+
+            ParagraphInfo paragraph;
+            paragraph.textStart = textRange.getStart();
+            int paragraphFirstLine = 0, paragraphTop = top, paragraphFirstChar = firstChar;
 
             TextLayout::Line* glyphLine = new TextLayout::Line();
             TextLayout::Run*  glyphRun  = new TextLayout::Run();
@@ -309,6 +528,10 @@ namespace TextLayoutHelpers
                 const Token* const t = tokens.getUnchecked (i);
                 const Point<float> tokenPos (t->area.getPosition().toFloat());
 
+                // (a line that starts with whitespace, or is empty, still needs its baseline)
+                if (i == 0 || tokens.getUnchecked (i - 1)->line != t->line)
+                    glyphLine->lineOrigin = tokenPos.translated (0, t->font.getAscent());
+
                 Array <int> newGlyphs;
                 Array <float> xOffsets;
                 t->font.getGlyphPositions (t->text.trimEnd(), newGlyphs, xOffsets);
@@ -317,9 +540,6 @@ namespace TextLayoutHelpers
 
                 for (int j = 0; j < newGlyphs.size(); ++j)
                 {
-                    if (charPosition == lineStartPosition)
-                        glyphLine->lineOrigin = tokenPos.translated (0, t->font.getAscent());
-
                     const float x = xOffsets.getUnchecked (j);
                     glyphRun->glyphs.add (TextLayout::Glyph (newGlyphs.getUnchecked(j),
                                                              Point<float> (tokenPos.getX() + x, 0),
@@ -332,32 +552,45 @@ namespace TextLayoutHelpers
 
                 const Token* const nextToken = tokens [i + 1];
 
+                if (t->isNewLine || nextToken == nullptr)
+                {
+                    paragraph.textEnd = t->textEnd;
+                    paragraph.numLines = t->line - paragraphFirstLine + 1;
+                    paragraph.height = t->area.getY() + t->lineHeight - paragraphTop;
+                    paragraph.numChars = charPosition - paragraphFirstChar;
+                    paragraphs.add (paragraph);
+
+                    if (nextToken != nullptr)
+                    {
+                        paragraph.textStart = t->textEnd;
+                        paragraphFirstLine = nextToken->line;
+                        paragraphTop = nextToken->area.getY();
+                        paragraphFirstChar = charPosition;
+                    }
+                }
+
                 if (nextToken == nullptr) // this is the last token
                 {
                     addRun (glyphLine, glyphRun, t, runStartPosition, charPosition);
                     glyphLine->stringRange = Range<int> (lineStartPosition, charPosition);
                     layout.addLine (glyphLine);
                 }
-                else
+                else if (t->line != nextToken->line)
                 {
-                    if (t->font != nextToken->font || t->colour != nextToken->colour)
-                    {
-                        addRun (glyphLine, glyphRun, t, runStartPosition, charPosition);
-                        runStartPosition = charPosition;
-                        glyphRun = new TextLayout::Run();
-                    }
+                    addRun (glyphLine, glyphRun, t, runStartPosition, charPosition);
+                    glyphLine->stringRange = Range<int> (lineStartPosition, charPosition);
+                    layout.addLine (glyphLine);
 
-                    if (t->line != nextToken->line)
-                    {
-                        addRun (glyphLine, glyphRun, t, runStartPosition, charPosition);
-                        glyphLine->stringRange = Range<int> (lineStartPosition, charPosition);
-                        layout.addLine (glyphLine);
-
-                        runStartPosition = charPosition;
-                        lineStartPosition = charPosition;
-                        glyphLine = new TextLayout::Line();
-                        glyphRun  = new TextLayout::Run();
-                    }
+                    runStartPosition = charPosition;
+                    lineStartPosition = charPosition;
+                    glyphLine = new TextLayout::Line();
+                    glyphRun  = new TextLayout::Run();
+                }
+                else if (t->font != nextToken->font || t->colour != nextToken->colour)
+                {
+                    addRun (glyphLine, glyphRun, t, runStartPosition, charPosition);
+                    runStartPosition = charPosition;
+                    glyphRun = new TextLayout::Run();
                 }
             }
 
@@ -381,6 +614,9 @@ namespace TextLayoutHelpers
             }
         }
 
+        int getNumParagraphs() const noexcept                           { return paragraphs.size(); }
+        const ParagraphInfo& getParagraph (const int index) const noexcept { return paragraphs.getReference (index); }
+
     private:
         static void addRun (TextLayout::Line* glyphLine, TextLayout::Run* glyphRun,
                             const Token* const t, const int start, const int end)
@@ -393,19 +629,18 @@ namespace TextLayoutHelpers
             glyphLine->runs.add (glyphRun);
         }
 
-        void appendText (const AttributedString& text, const Range<int>& stringRange,
-                         const Font& font, const Colour& colour)
+        void appendText (const IndexedString& text, const Range<int>& stringRange,
+                         const Font& font, const Colour& colour, const bool runContinuesAfterRange)
         {
-            String stringText (text.getText().substring (stringRange.getStart(), stringRange.getEnd()));
-            String::CharPointerType t (stringText.getCharPointer());
-            String currentString;
+            String::CharPointerType t (text.getCharPointer (stringRange.getStart()));
+            String::CharPointerType tokenStart (t);
             int lastCharType = 0;
+            int position = stringRange.getStart();
 
-            for (;;)
+            while (position < stringRange.getEnd())
             {
+                const String::CharPointerType charStart (t);
                 const juce_wchar c = t.getAndAdvance();
-                if (c == 0)
-                    break;
 
                 int charType;
                 if (c == '\r' || c == '\n')
@@ -417,30 +652,34 @@ namespace TextLayoutHelpers
 
                 if (charType == 0 || charType != lastCharType)
                 {
-                    if (currentString.isNotEmpty())
-                        tokens.add (new Token (currentString, font, colour,
-                                               lastCharType == 2 || lastCharType == 0));
+                    if (charStart != tokenStart)
+                        tokens.add (new Token (String (tokenStart, charStart), font, colour,
+                                               lastCharType == 2 || lastCharType == 0, position));
 
-                    currentString = String::charToString (c);
+                    tokenStart = charStart;
 
-                    if (c == '\r' && *t == '\n')
-                        currentString += t.getAndAdvance();
-                }
-                else
-                {
-                    currentString += c;
+                    if (c == '\r' && *t == '\n' && position + 1 < stringRange.getEnd())
+                    {
+                        ++t;
+                        ++position;
+                    }
                 }
 
+                ++position;
                 lastCharType = charType;
             }
 
-            if (currentString.isNotEmpty())
-                tokens.add (new Token (currentString, font, colour, lastCharType == 2));
+            // If the run carries on past the end of the range, the last token must be flagged
+            // the same way as it would be if the whole run had been appended.
+            if (t != tokenStart)
+                tokens.add (new Token (String (tokenStart, t), font, colour,
+                                       lastCharType == 2 || (runContinuesAfterRange && lastCharType == 0),
+                                       position));
         }
 
         void layoutRuns (const int maxWidth)
         {
-            int x = 0, y = 0, h = 0;
+            int x = 0, y = top, h = 0;
             int i;
 
             for (i = 0; i < tokens.size(); ++i)
@@ -498,55 +737,30 @@ namespace TextLayoutHelpers
             return maxW;
         }
 
-        void addTextRuns (const AttributedString& text)
+        void addTextRuns (const AttributedString& text, const IndexedString& indexedText, const Range<int>& textRange)
         {
+            // The runs are found for one extra character, to tell whether the last one ends with the range
+            const Range<int> runRange (textRange.withEnd (jmin (textRange.getEnd() + 1, indexedText.length())));
+
             Font defaultFont;
             Array<RunAttribute> runAttributes;
-
-            {
-                const int stringLength = text.getText().length();
-                int rangeStart = 0;
-                FontAndColour lastFontAndColour (nullptr);
-
-                // Iterate through every character in the string
-                for (int i = 0; i < stringLength; ++i)
-                {
-                    FontAndColour newFontAndColour (&defaultFont);
-                    const int numCharacterAttributes = text.getNumAttributes();
-
-                    for (int j = 0; j < numCharacterAttributes; ++j)
-                    {
-                        const AttributedString::Attribute* const attr = text.getAttribute (j);
-
-                        // Check if the current character falls within the range of a font attribute
-                        if (attr->getFont() != nullptr && (i >= attr->range.getStart()) && (i < attr->range.getEnd()))
-                            newFontAndColour.font = attr->getFont();
-
-                        // Check if the current character falls within the range of a foreground colour attribute
-                        if (attr->getColour() != nullptr && (i >= attr->range.getStart()) && (i < attr->range.getEnd()))
-                            newFontAndColour.colour = *attr->getColour();
-                    }
-
-                    if (i > 0 && (newFontAndColour != lastFontAndColour || i == stringLength - 1))
-                    {
-                        runAttributes.add (RunAttribute (lastFontAndColour,
-                                                         Range<int> (rangeStart, (i < stringLength - 1) ? i : (i + 1))));
-                        rangeStart = i;
-                    }
-
-                    lastFontAndColour = newFontAndColour;
-                }
-            }
+            findRunAttributes (text, runRange, defaultFont, runAttributes);
 
             for (int i = 0; i < runAttributes.size(); ++i)
             {
                 const RunAttribute& r = runAttributes.getReference(i);
-                appendText (text, r.range, *(r.fontAndColour.font), r.fontAndColour.colour);
+                const Range<int> range (r.range.getIntersectionWith (textRange));
+
+                if (! range.isEmpty())
+                    appendText (indexedText, range, *(r.fontAndColour.font), r.fontAndColour.colour,
+                                r.range.getEnd() > range.getEnd());
             }
         }
 
         OwnedArray<Token> tokens;
+        Array<ParagraphInfo> paragraphs;
         int totalLines;
+        const int top, firstChar;
 
         JUCE_DECLARE_NON_COPYABLE (TokenList);
     };
@@ -586,11 +800,240 @@ void TextLayout::createLayoutWithBalancedLineLengths (const AttributedString& te
         createLayout (text, bestWidth);
 }
 
+//==============================================================================
+namespace TextLayoutHelpers
+{
+    // A line's origin is placed at the ascent of the first token on it, which is in the font
+    // of the line's first run.
+    static float getFirstTokenAscent (const TextLayout::Line& line) noexcept
+    {
+        return line.runs.size() > 0 ? line.runs.getUnchecked (0)->font.getAscent() : 0.0f;
+    }
+
+    struct BatchLayoutCreator  : public ThreadPool::ParallelForCallback
+    {
+        BatchLayoutCreator (const OwnedArray<AttributedString>& strings_, const Array<float>& maxWidths_,
+                            TextLayout* const* layouts_) noexcept
+            : strings (strings_), maxWidths (maxWidths_), layouts (layouts_)
+        {}
+
+        void processRange (const int startIndex, const int endIndex)
+        {
+            for (int i = startIndex; i < endIndex; ++i)
+                layouts[i]->createLayout (*strings.getUnchecked (i),
+                                          maxWidths.size() == 1 ? maxWidths.getUnchecked (0)
+                                                                : maxWidths.getUnchecked (i));
+        }
+
+        const OwnedArray<AttributedString>& strings;
+        const Array<float>& maxWidths;
+        TextLayout* const* layouts;
+
+        JUCE_DECLARE_NON_COPYABLE (BatchLayoutCreator);
+    };
+}
+
+void TextLayout::createLayouts (const OwnedArray<AttributedString>& strings, const Array<float>& maxWidths,
+                                OwnedArray<TextLayout>& layouts, ThreadPool* const threadPool)
+{
+    // You need to give either a single width, or one for each string!
+    jassert (maxWidths.size() == 1 || maxWidths.size() == strings.size());
+
+    const int numStrings = strings.size();
+
+    if (numStrings == 0 || maxWidths.size() == 0)
+        return;
+
+    // The new layouts are all added first, so that the threads never change the array itself
+    const int firstNewLayout = layouts.size();
+    layouts.ensureStorageAllocated (firstNewLayout + numStrings);
+
+    for (int i = 0; i < numStrings; ++i)
+        layouts.add (new TextLayout());
+
+    TextLayoutHelpers::BatchLayoutCreator creator (strings, maxWidths, layouts.getRawDataPointer() + firstNewLayout);
+
+    if (threadPool != nullptr)
+        threadPool->parallelFor (numStrings, creator);
+    else
+        creator.processRange (0, numStrings);
+}
+
+//==============================================================================
+void TextLayout::updateLayout (const AttributedString& text, const Range<int>& oldRange, const int newLength)
+{
+    jassert (newLength >= 0);
+
+    if (paragraphs.size() == 0 || text.getJustification() != justification)
+    {
+        createLayout (text, maxLayoutWidth);
+        return;
+    }
+
+    const int lengthChange = newLength - oldRange.getLength();
+
+    // The paragraph before the edit is included in case it ends with a '\r' that the new text follows with a '\n'
+    const int firstIndex = findParagraphContaining (oldRange.getStart() - 1);
+    const int lastIndex  = findParagraphContaining (oldRange.getEnd());
+    const Paragraph first (paragraphs.getReference (firstIndex));
+    const Paragraph last  (paragraphs.getReference (lastIndex));
+
+    const int oldNumParagraphs = lastIndex + 1 - firstIndex;
+    const int oldNumLines = last.firstLine + last.numLines - first.firstLine;
+    const int oldHeight   = last.top + last.height - first.top;
+    const int oldNumChars = last.firstChar + last.numChars - first.firstChar;
+
+    const IndexedString indexedText (text.getText());
+    const Range<int> newTextRange (first.textStart, last.textEnd + lengthChange);
+    jassert (newTextRange.getEnd() <= indexedText.length());
+
+    TextLayout newLayout;
+    newLayout.width = maxLayoutWidth;
+    Array<Paragraph> newParagraphs;
+    createStandardLayout (text, indexedText, newTextRange, first.top, first.firstChar, newLayout, newParagraphs);
+
+    int newHeight = 0, newNumChars = 0;
+
+    for (int i = 0; i < newParagraphs.size(); ++i)
+    {
+        Paragraph& p = newParagraphs.getReference (i);
+        p.firstLine += first.firstLine;
+        newHeight += p.height;
+        newNumChars += p.numChars;
+    }
+
+    const int numNewLines = newLayout.lines.size();
+    const int lineChange = numNewLines - oldNumLines;
+    const int heightChange = newHeight - oldHeight;
+    const int charChange = newNumChars - oldNumChars;
+
+    // Move the paragraphs after the edit, and their lines..
+    for (int i = lastIndex + 1; i < paragraphs.size(); ++i)
+    {
+        Paragraph& p = paragraphs.getReference (i);
+
+        for (int j = p.firstLine; j < p.firstLine + p.numLines; ++j)
+        {
+            Line& line = *lines.getUnchecked (j);
+
+            // (the line's y position is worked out again from the paragraph's new top, in the same
+            // way as createLayout() does it, because adding the change to it could round differently)
+            const float ascent = TextLayoutHelpers::getFirstTokenAscent (line);
+            const int topWithinParagraph = roundToInt (line.lineOrigin.y - ascent) - p.top;
+            line.lineOrigin.y = (float) (p.top + heightChange + topWithinParagraph) + ascent;
+
+            line.stringRange += charChange;
+
+            for (int k = line.runs.size(); --k >= 0;)
+                line.runs.getUnchecked (k)->stringRange += charChange;
+        }
+
+        p.textStart += lengthChange;
+        p.textEnd += lengthChange;
+        p.firstLine += lineChange;
+        p.top += heightChange;
+        p.firstChar += charChange;
+    }
+
+    // ..and swap the new ones in place of the old ones.
+    lines.removeRange (first.firstLine, oldNumLines);
+
+    for (int i = 0; i < numNewLines; ++i)
+    {
+        Line* const line = newLayout.lines.getUnchecked (i);
+        line->lineOrigin.x -= xOffset;
+        lines.insert (first.firstLine + i, line);
+    }
+
+    newLayout.lines.clear (false);
+
+    paragraphs.removeRange (firstIndex, oldNumParagraphs);
+    paragraphs.insertArray (firstIndex, newParagraphs.getRawDataPointer(), newParagraphs.size());
+
+    if (paragraphs.size() > 0)
+    {
+        Range<float> range (paragraphs.getReference (0).left, paragraphs.getReference (0).right);
+
+        for (int i = paragraphs.size(); --i > 0;)
+            range = range.getUnionWith (Range<float> (paragraphs.getReference (i).left, paragraphs.getReference (i).right));
+
+        const float shift = range.getStart() - xOffset;
+
+        if (shift != 0)
+            for (int i = lines.size(); --i >= 0;)
+                lines.getUnchecked (i)->lineOrigin.x -= shift;
+
+        xOffset = range.getStart();
+        width = range.getLength();
+    }
+    else
+    {
+        xOffset = 0;
+        width = maxLayoutWidth;
+    }
+}
+
+int TextLayout::findParagraphContaining (const int characterIndex) const noexcept
+{
+    int start = 0, end = paragraphs.size();
+
+    while (end - start > 1)
+    {
+        const int middle = (start + end) / 2;
+
+        if (paragraphs.getReference (middle).textStart > characterIndex)
+            end = middle;
+        else
+            start = middle;
+    }
+
+    return start;
+}
+
 //==============================================================================
 void TextLayout::createStandardLayout (const AttributedString& text)
 {
-    TextLayoutHelpers::TokenList l;
-    l.createLayout (text, *this);
+    const IndexedString indexedText (text.getText());
+    createStandardLayout (text, indexedText, Range<int> (0, indexedText.length()), 0, 0, *this, paragraphs);
+}
+
+void TextLayout::createStandardLayout (const AttributedString& text, const IndexedString& indexedText,
+                                       const Range<int>& textRange, const int top, const int firstChar,
+                                       TextLayout& layout, Array<Paragraph>& newParagraphs)
+{
+    const int firstLine = layout.lines.size();
+
+    TextLayoutHelpers::TokenList l (top, firstChar);
+    l.createLayout (text, indexedText, textRange, layout);
+
+    Paragraph p;
+    p.firstLine = firstLine;
+    p.top = top;
+    p.firstChar = firstChar;
+
+    for (int i = 0; i < l.getNumParagraphs(); ++i)
+    {
+        const TextLayoutHelpers::ParagraphInfo& info = l.getParagraph (i);
+        p.textStart = info.textStart;
+        p.textEnd = info.textEnd;
+        p.numLines = info.numLines;
+        p.height = info.height;
+        p.numChars = info.numChars;
+
+        Range<float> bounds (layout.lines.getUnchecked (p.firstLine)->getLineBoundsX());
+
+        for (int j = 1; j < p.numLines; ++j)
+            bounds = bounds.getUnionWith (layout.lines.getUnchecked (p.firstLine + j)->getLineBoundsX());
+
+        p.left = bounds.getStart();
+        p.right = bounds.getEnd();
+
+        newParagraphs.add (p);
+
+        p.firstLine += p.numLines;
+        p.top += p.height;
+        p.firstChar += p.numChars;
+    }
 }
 
 void TextLayout::recalculateWidth()
@@ -606,8 +1049,372 @@ void TextLayout::recalculateWidth()
         for (i = lines.size(); --i >= 0;)
             lines.getUnchecked(i)->lineOrigin.x -= range.getStart();
 
+        xOffset = range.getStart();
         width = range.getLength();
     }
 }
 
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class TextLayoutTests  : public UnitTest
+{
+public:
+    TextLayoutTests() : UnitTest ("TextLayout") {}
+
+    struct Word
+    {
+        String text;
+        Font font;
+        Colour colour;
+    };
+
+    static Word createRandomWord (Random& r)
+    {
+        const char* const words[] = { "The", "quick", "brown", "fox", "jumps", "over", "the", "lazy", "dog.",
+                                      "AVAST", "Wavy", "typography", "fi", "ffl", "To", "Yo", "1234", "\n" };
+
+        const String word (words [r.nextInt (numElementsInArray (words))]);
+
+        Word w;
+        w.text = (word == "\n" ? word : word + " ");
+        w.font = Font (8.0f + r.nextInt (20), r.nextInt (4));
+        w.colour = Colour ((uint32) r.nextInt());
+        return w;
+    }
+
+    static void createRandomStrings (Random& r, OwnedArray<AttributedString>& strings, Array<float>& widths, const int num)
+    {
+        for (int i = 0; i < num; ++i)
+        {
+            AttributedString* const s = new AttributedString();
+            const int numWords = 1 + r.nextInt (60);
+
+            for (int j = 0; j < numWords; ++j)
+            {
+                const Word w (createRandomWord (r));
+                s->append (w.text, w.font, w.colour);
+            }
+
+            strings.add (s);
+            widths.add (50.0f + r.nextInt (300));
+        }
+    }
+
+    static bool layoutsAreIdentical (const TextLayout& a, const TextLayout& b)
+    {
+        if (a.getNumLines() != b.getNumLines() || a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight())
+            return false;
+
+        for (int i = 0; i < a.getNumLines(); ++i)
+        {
+            const TextLayout::Line& l1 = a.getLine (i);
+            const TextLayout::Line& l2 = b.getLine (i);
+
+            if (l1.lineOrigin != l2.lineOrigin || l1.stringRange != l2.stringRange || l1.runs.size() != l2.runs.size())
+                return false;
+
+            for (int j = 0; j < l1.runs.size(); ++j)
+            {
+                const TextLayout::Run& r1 = *l1.runs.getUnchecked (j);
+                const TextLayout::Run& r2 = *l2.runs.getUnchecked (j);
+
+                if (r1.font != r2.font || r1.glyphs.size() != r2.glyphs.size())
+                    return false;
+
+                for (int k = 0; k < r1.glyphs.size(); ++k)
+                {
+                    const TextLayout::Glyph& g1 = r1.glyphs.getReference (k);
+                    const TextLayout::Glyph& g2 = r2.glyphs.getReference (k);
+
+                    if (g1.glyphCode != g2.glyphCode || g1.anchor != g2.anchor || g1.width != g2.width)
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void testBatch (Random& r, ThreadPool* const pool, const bool useSingleWidth)
+    {
+        OwnedArray<AttributedString> strings;
+        Array<float> widths;
+        createRandomStrings (r, strings, widths, 200);
+
+        if (useSingleWidth)
+        {
+            widths.clearQuick();
+            widths.add (150.0f);
+        }
+
+        OwnedArray<TextLayout> layouts;
+        layouts.add (new TextLayout());
+        TextLayout::createLayouts (strings, widths, layouts, pool);
+
+        expectEquals (layouts.size(), strings.size() + 1);
+        bool allMatch = true;
+
+        for (int i = 0; i < strings.size(); ++i)
+        {
+            TextLayout expected;
+            expected.createLayout (*strings.getUnchecked (i), widths [useSingleWidth ? 0 : i]);
+            allMatch = allMatch && layoutsAreIdentical (expected, *layouts.getUnchecked (i + 1));
+        }
+
+        expect (allMatch);
+    }
+
+    static void createString (const Array<Word>& words, const Justification& justification, AttributedString& s)
+    {
+        s.clear();
+        s.setJustification (justification);
+
+        for (int i = 0; i < words.size(); ++i)
+            s.append (words.getReference (i).text, words.getReference (i).font, words.getReference (i).colour);
+    }
+
+    static int getWordStart (const Array<Word>& words, const int wordIndex)
+    {
+        int start = 0;
+
+        for (int i = 0; i < wordIndex; ++i)
+            start += words.getReference (i).text.length();
+
+        return start;
+    }
+
+    void testUpdateLayout (Random& r)
+    {
+        beginTest ("Updating a layout");
+
+        const Justification justifications[] = { Justification::left, Justification::right, Justification::horizontallyCentred };
+
+        for (int n = 0; n < 30; ++n)
+        {
+            const Justification justification (justifications [n % numElementsInArray (justifications)]);
+            const float width = 50.0f + r.nextInt (300);
+            Array<Word> words;
+
+            for (int i = r.nextInt (200); --i >= 0;)
+                words.add (createRandomWord (r));
+
+            AttributedString text;
+            createString (words, justification, text);
+
+            TextLayout layout;
+            layout.createLayout (text, width);
+            bool allMatch = true;
+
+            for (int i = 0; i < 40; ++i)
+            {
+                // (replacing some words with some others, which might be the same text in a different font)
+                const int firstWord = r.nextInt (words.size() + 1);
+                const int numWordsRemoved = jmin (words.size() - firstWord, r.nextInt (5));
+                const int numWordsAdded = r.nextInt (5);
+
+                const int start = getWordStart (words, firstWord);
+                const Range<int> oldRange (start, getWordStart (words, firstWord + numWordsRemoved));
+
+                words.removeRange (firstWord, numWordsRemoved);
+
+                for (int j = 0; j < numWordsAdded; ++j)
+                    words.insert (firstWord + j, createRandomWord (r));
+
+                createString (words, justification, text);
+                layout.updateLayout (text, oldRange, getWordStart (words, firstWord + numWordsAdded) - start);
+
+                TextLayout expected;
+                expected.createLayout (text, width);
+                allMatch = allMatch && layoutsAreIdentical (expected, layout);
+            }
+
+            expect (allMatch);
+        }
+    }
+
+    static AttributedString* createRandomSpans (Random& r, const int numChars, const int numSpans, const bool withSpaces)
+    {
+        String s;
+
+        for (int i = 0; i < numChars; ++i)
+            s << ((withSpaces && r.nextInt (6) == 0) ? ' ' : (juce_wchar) ('a' + r.nextInt (26)));
+
+        AttributedString* const text = new AttributedString();
+        text->setText (s);
+
+        for (int i = 0; i < numSpans; ++i)
+        {
+            const int start = r.nextInt (numChars);
+            const Range<int> range (start, start + 1 + r.nextInt (jmin (200, numChars - start)));
+
+            if (r.nextBool())
+                text->setColour (range, Colour ((uint32) r.nextInt() | 0xff000000));
+            else
+                text->setFont (range, Font (10.0f + r.nextInt (4) * 2.0f, r.nextInt (4)));
+        }
+
+        return text;
+    }
+
+    // The slow but obvious way to find a character's attributes: the last one that covers it wins.
+    static void resolveAttributes (const AttributedString& text, const int index, Font& font, Colour& colour)
+    {
+        font = Font();
+        colour = Colour (0xff000000);
+
+        for (int i = 0; i < text.getNumAttributes(); ++i)
+        {
+            const AttributedString::Attribute* const a = text.getAttribute (i);
+
+            if (a->range.contains (index))
+            {
+                if (a->getFont() != nullptr)    font = *a->getFont();
+                if (a->getColour() != nullptr)  colour = *a->getColour();
+            }
+        }
+    }
+
+    void testAttributeRuns (Random& r)
+    {
+        beginTest ("Attribute runs");
+
+        for (int n = 0; n < 30; ++n)
+        {
+            // (without any spaces, every character gets a glyph, so the runs' ranges cover the whole string)
+            const ScopedPointer<AttributedString> text (createRandomSpans (r, 1 + r.nextInt (300), r.nextInt (40), false));
+
+            TextLayout layout;
+            layout.createLayout (*text, 1.0e6f);
+
+            int numChecked = 0;
+            bool allMatch = true;
+
+            for (int i = 0; i < layout.getNumLines(); ++i)
+            {
+                const TextLayout::Line& line = layout.getLine (i);
+
+                for (int j = 0; j < line.runs.size(); ++j)
+                {
+                    const TextLayout::Run& run = *line.runs.getUnchecked (j);
+
+                    for (int c = run.stringRange.getStart(); c < run.stringRange.getEnd(); ++c)
+                    {
+                        Font font;
+                        Colour colour;
+                        resolveAttributes (*text, c, font, colour);
+
+                        allMatch = allMatch && font == run.font && colour == run.colour;
+                        ++numChecked;
+                    }
+                }
+            }
+
+            expect (allMatch);
+            expectEquals (numChecked, text->getText().length());
+        }
+    }
+
+    void benchmarkAttributeRuns (Random& r)
+    {
+        beginTest ("Benchmark");
+
+        // (about the size of one of the app's sample text documents, with lots of styled spans)
+        const ScopedPointer<AttributedString> text (createRandomSpans (r, 13000, 2000, true));
+
+        TextLayout layout;
+        layout.createLayout (*text, 600.0f); // (the first layout also loads the glyphs)
+
+        const int numRepeats = 5;
+        const double start = Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < numRepeats; ++i)
+            layout.createLayout (*text, 600.0f);
+
+        logMessage ("13000 characters with 2000 attributes: "
+                      + String ((Time::getMillisecondCounterHiRes() - start) / numRepeats, 1)
+                      + "ms per createLayout, " + String (layout.getNumLines()) + " lines");
+    }
+
+    void benchmarkBatchLayouts (Random& r)
+    {
+        beginTest ("Batch layout benchmark");
+
+        // All the strings use copies of the same few fonts, so the layout threads are all
+        // sharing the fonts' internal objects, and their typefaces.
+        Array<Font> fonts;
+
+        for (int i = 0; i < 8; ++i)
+            fonts.add (Font (10.0f + i * 2.0f, i & 3));
+
+        OwnedArray<AttributedString> strings;
+        Array<float> widths;
+        widths.add (300.0f);
+
+        for (int i = 0; i < 400; ++i)
+        {
+            AttributedString* const s = new AttributedString();
+
+            for (int j = 0; j < 20; ++j)
+                s->append ("The quick brown fox jumps over the lazy dog. ", fonts.getReference (r.nextInt (fonts.size())));
+
+            strings.add (s);
+        }
+
+        OwnedArray<TextLayout> layouts;
+        TextLayout::createLayouts (strings, widths, layouts, nullptr); // (this also loads the glyphs)
+
+        double singleThreadedTime = 0;
+
+        for (int numThreads = 0; numThreads <= SystemStats::getNumCpus(); numThreads = jmax (1, numThreads * 2))
+        {
+            ScopedPointer<ThreadPool> pool (numThreads > 0 ? new ThreadPool (numThreads) : nullptr);
+            layouts.clear();
+
+            const double start = Time::getMillisecondCounterHiRes();
+            TextLayout::createLayouts (strings, widths, layouts, pool);
+            const double time = Time::getMillisecondCounterHiRes() - start;
+
+            if (numThreads == 0)
+                singleThreadedTime = time;
+
+            logMessage (String (strings.size()) + " layouts, " + (numThreads == 0 ? String ("no pool") : String (numThreads) + (numThreads == 1 ? " thread" : " threads"))
+                          + ": " + String (time, 1) + "ms, " + String (singleThreadedTime / time, 2) + "x");
+        }
+
+        expectEquals (layouts.size(), strings.size());
+    }
+
+    void runTest()
+    {
+        Random r (0x1234);
+        testAttributeRuns (r);
+        benchmarkAttributeRuns (r);
+        testUpdateLayout (r);
+
+        beginTest ("Batch layouts");
+
+        ThreadPool pool (3);
+
+        testBatch (r, nullptr, false);
+        testBatch (r, &pool, false);
+        testBatch (r, &pool, true);
+
+        {
+            OwnedArray<AttributedString> strings;
+            Array<float> widths;
+            OwnedArray<TextLayout> layouts;
+            widths.add (100.0f);
+            TextLayout::createLayouts (strings, widths, layouts, &pool);
+            expectEquals (layouts.size(), 0);
+        }
+
+        benchmarkBatchLayouts (r);
+    }
+};
+
+static TextLayoutTests textLayoutUnitTests;
+
+#endif
+
 END_JUCE_NAMESPACE
@@ -37,6 +37,11 @@ class Graphics;
     A TextLayout is created from an AttributedString, and once created can be
     quickly drawn into a Graphics context.
 
+    Where the platform has its own text layout engine (CoreText or DirectWrite), that's
+    used to shape the text. On Linux, HarfBuzz is only used if JUCE_USE_HARFBUZZ is
+    enabled, which it isn't by default, so the text normally gets JUCE's own simpler
+    layout, with one glyph per character and no ligatures or right-to-left text.
+
     @see AttributedString
 */
 class JUCE_API  TextLayout
@@ -71,6 +76,44 @@ public:
     */
     void createLayoutWithBalancedLineLengths (const AttributedString& text, float maxWidth);
 
+    /** Creates layouts for a batch of strings, sharing the work between a pool of threads.
+
+        A new TextLayout is appended to the layouts array for each string, in the same order,
+        and each one is the same as the layout that createLayout() would produce for its string.
+        The calling thread helps to create them, so this can be called from one of the pool's
+        own jobs.
+
+        @param strings      the strings to lay out
+        @param maxWidths    the maximum width of each string's layout, or just a single width
+                            to use for all of them
+        @param layouts      the array that the new layouts will be added to
+        @param threadPool   the pool to use, or nullptr to create all the layouts on the
+                            calling thread
+    */
+    static void createLayouts (const OwnedArray<AttributedString>& strings, const Array<float>& maxWidths,
+                               OwnedArray<TextLayout>& layouts, ThreadPool* threadPool);
+
+    /** Updates the layout after part of the AttributedString it was created from has changed.
+
+        Rather than laying out the whole string again, this re-creates only the lines of
+        the paragraphs that contain the edited characters, and moves the lines that follow
+        them up or down, so it's much quicker than createLayout() for large amounts of text.
+
+        The layout must previously have been created by createLayout() (or updated by this
+        method) using the string as it was before the edit, and the same maximum width will
+        be used again. If the layout can't be updated incrementally (e.g. because the platform
+        laid the text out natively), the whole string is simply laid out again.
+
+        @param newText      the string after the edit. Outside the edited range, its text and
+                            attributes must be the same as before, just moved along by any
+                            change in length
+        @param oldRange     the range of characters in the previous string that was replaced.
+                            For an insertion this is an empty range at the insertion point, and
+                            for a change of attributes it's the range that was affected
+        @param newLength    the number of characters in newText that replaced oldRange
+    */
+    void updateLayout (const AttributedString& newText, const Range<int>& oldRange, int newLength);
+
     /** Draws the layout within the specified area.
         The position of the text within the rectangle is controlled by the justification
         flags set in the original AttributedString that was used to create this layout.
@@ -162,11 +205,27 @@ public:
     void ensureStorageAllocated (int numLinesNeeded);
 
 private:
+    /** The position of a paragraph created by the standard layout, so that it can be replaced.
+        (This only holds primitive types, because the Array that it lives in moves it with memmove).
+    */
+    struct Paragraph
+    {
+        int textStart, textEnd;         // the characters in the source string
+        int firstLine, numLines;
+        int top, height;
+        int firstChar, numChars;        // as counted by the lines' stringRanges
+        float left, right;              // the X extent of its lines, before recalculateWidth()
+    };
+
     OwnedArray<Line> lines;
-    float width;
+    Array<Paragraph> paragraphs;
+    float width, maxLayoutWidth, xOffset;
     Justification justification;
 
     void createStandardLayout (const AttributedString&);
+    static void createStandardLayout (const AttributedString&, const IndexedString&, const Range<int>& textRange, int top,
+                                      int firstChar, TextLayout& destLayout, Array<Paragraph>& destParagraphs);
+    int findParagraphContaining (int characterIndex) const noexcept;
     bool createNativeLayout (const AttributedString&);
     void recalculateWidth();
 };
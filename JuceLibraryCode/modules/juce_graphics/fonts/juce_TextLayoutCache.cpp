@@ -0,0 +1,635 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library - "Jules' Utility Class Extensions"
+   Copyright 2004-11 by Raw Material Software Ltd.
+
+  ------------------------------------------------------------------------------
+
+   JUCE can be redistributed and/or modified under the terms of the GNU General
+   Public License (Version 2), as published by the Free Software Foundation.
+   A copy of the license is included in the JUCE distribution, or can be found
+   online at www.gnu.org/licenses.
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.rawmaterialsoftware.com/juce for more information.
+
+  ==============================================================================
+*/
+
+BEGIN_JUCE_NAMESPACE
+
+namespace TextLayoutCacheHelpers
+{
+    struct Hasher
+    {
+        Hasher() noexcept  : value ((uint64) literal64bit (0xcbf29ce484222325)) {}
+
+        void add (const uint64 v) noexcept      { value = (value ^ v) * (uint64) literal64bit (0x100000001b3); }
+        void add (const int v) noexcept         { add ((uint64) (uint32) v); }
+        void add (const String& s) noexcept     { add ((uint64) s.hashCode64()); }
+        void add (const void* p) noexcept       { add ((uint64) (pointer_sized_uint) p); }
+
+        void add (const float f) noexcept
+        {
+            union { float asFloat; uint32 asInt; } u;
+            u.asFloat = f;
+            add ((uint64) u.asInt);
+        }
+
+        void add (const Font& f) noexcept
+        {
+            add (f.getTypefaceName());
+            add (f.getStyleFlags());
+            add (f.getHeight());
+            add (f.getHorizontalScale());
+            add (f.getExtraKerningFactor());
+        }
+
+        void add (const AttributedString& s) noexcept
+        {
+            add (s.getText());
+            add (s.getJustification().getFlags());
+            add ((int) s.getWordWrap());
+            add ((int) s.getReadingDirection());
+            add (s.getLineSpacing());
+
+            for (int i = 0; i < s.getNumAttributes(); ++i)
+            {
+                const AttributedString::Attribute* const a = s.getAttribute (i);
+                add (a->range.getStart());
+                add (a->range.getEnd());
+
+                if (a->getFont() != nullptr)    add (*a->getFont());
+                if (a->getColour() != nullptr)  add ((int) a->getColour()->getARGB());
+            }
+        }
+
+        uint64 value;
+    };
+
+    template <class ObjectType>
+    static bool arePointeesEqual (const ObjectType* const a, const ObjectType* const b) noexcept
+    {
+        return a == nullptr ? b == nullptr
+                            : (b != nullptr && *a == *b);
+    }
+
+    static bool areEqual (const AttributedString& a, const AttributedString& b) noexcept
+    {
+        if (a.getText() != b.getText()
+             || a.getJustification() != b.getJustification()
+             || a.getWordWrap() != b.getWordWrap()
+             || a.getReadingDirection() != b.getReadingDirection()
+             || a.getLineSpacing() != b.getLineSpacing()
+             || a.getNumAttributes() != b.getNumAttributes())
+            return false;
+
+        for (int i = a.getNumAttributes(); --i >= 0;)
+        {
+            const AttributedString::Attribute* const a1 = a.getAttribute (i);
+            const AttributedString::Attribute* const a2 = b.getAttribute (i);
+
+            if (a1->range != a2->range
+                 || ! arePointeesEqual (a1->getFont(), a2->getFont())
+                 || ! arePointeesEqual (a1->getColour(), a2->getColour()))
+                return false;
+        }
+
+        return true;
+    }
+
+    static size_t getMemoryUsage (const TextLayout& layout) noexcept
+    {
+        size_t total = 0;
+
+        for (int i = layout.getNumLines(); --i >= 0;)
+        {
+            const TextLayout::Line& line = layout.getLine (i);
+            total += sizeof (TextLayout::Line);
+
+            for (int j = line.runs.size(); --j >= 0;)
+                total += sizeof (TextLayout::Run) + sizeof (TextLayout::Glyph) * (size_t) line.runs.getUnchecked (j)->glyphs.size();
+        }
+
+        return total;
+    }
+}
+
+//==============================================================================
+TextLayoutCache::CachedLayout::CachedLayout (const AttributedString& text_, const float maxWidth_,
+                                             const bool balanceLineLengths_)
+    : text (text_), maxWidth (maxWidth_), balanceLineLengths (balanceLineLengths_)
+{
+    if (balanceLineLengths)
+        layout.createLayoutWithBalancedLineLengths (text, maxWidth);
+    else
+        layout.createLayout (text, maxWidth);
+}
+
+TextLayoutCache::CachedGlyphs::CachedGlyphs (const Font& font_, Typeface* const typeface_, const String& text_,
+                                             const float width_, const float height_,
+                                             const Justification& justification_, const int maximumLinesToUse_,
+                                             const float minimumHorizontalScale_)
+    : font (font_), typeface (typeface_), text (text_), width (width_), height (height_),
+      justification (justification_), maximumLinesToUse (maximumLinesToUse_),
+      minimumHorizontalScale (minimumHorizontalScale_)
+{
+    glyphs.addFittedText (font, text, 0, 0, width, height,
+                          justification, maximumLinesToUse, minimumHorizontalScale);
+}
+
+//==============================================================================
+class TextLayoutCache::Pimpl     : public DeletedAtShutdown
+{
+public:
+    Pimpl()
+        : numSlots (0), numEntries (0),
+          mostRecent (nullptr), leastRecent (nullptr),
+          memoryUsage (0), memoryBudget (defaultMemoryBudget)
+    {
+        resizeHashTable (64);
+    }
+
+    ~Pimpl()
+    {
+        clear();
+        clearSingletonInstance();
+    }
+
+    CachedLayout::Ptr getLayout (const AttributedString& text, const float maxWidth, const bool balanceLineLengths)
+    {
+        TextLayoutCacheHelpers::Hasher hasher;
+        hasher.add (text);
+        hasher.add (maxWidth);
+        hasher.add ((int) balanceLineLengths);
+        const uint64 hash = hasher.value;
+
+        {
+            const ScopedLock sl (lock);
+            Entry* const e = findLayout (hash, text, maxWidth, balanceLineLengths);
+
+            if (e != nullptr)
+            {
+                moveToFront (e);
+                return e->layout;
+            }
+        }
+
+        // (the layout is done without holding the lock, so other threads can carry on using the cache)
+        CachedLayout::Ptr newLayout (new CachedLayout (text, maxWidth, balanceLineLengths));
+
+        const ScopedLock sl (lock);
+        Entry* const e = findLayout (hash, text, maxWidth, balanceLineLengths);
+
+        if (e != nullptr)
+        {
+            moveToFront (e);
+            return e->layout;
+        }
+
+        Entry* const newEntry = new Entry (hash);
+        newEntry->layout = newLayout;
+        newEntry->memoryUsage = sizeof (Entry) + sizeof (CachedLayout)
+                                  + (size_t) text.getText().getNumBytesAsUTF8()
+                                  + sizeof (AttributedString::Attribute) * (size_t) text.getNumAttributes()
+                                  + TextLayoutCacheHelpers::getMemoryUsage (newLayout->layout);
+        addEntry (newEntry);
+        return newLayout;
+    }
+
+    CachedGlyphs::Ptr getFittedText (const Font& font, const String& text, const float width, const float height,
+                                     const Justification& justification, const int maximumLinesToUse,
+                                     const float minimumHorizontalScale)
+    {
+        // (the typeface that the font currently resolves to is part of the key, so that glyphs which were
+        // laid out with a typeface that has since been replaced aren't used again)
+        Typeface* const typeface = font.getTypeface();
+
+        TextLayoutCacheHelpers::Hasher hasher;
+        hasher.add (font);
+        hasher.add (typeface);
+        hasher.add (text);
+        hasher.add (width);
+        hasher.add (height);
+        hasher.add (justification.getFlags());
+        hasher.add (maximumLinesToUse);
+        hasher.add (minimumHorizontalScale);
+        const uint64 hash = hasher.value;
+
+        {
+            const ScopedLock sl (lock);
+            Entry* const e = findGlyphs (hash, font, typeface, text, width, height, justification, maximumLinesToUse, minimumHorizontalScale);
+
+            if (e != nullptr)
+            {
+                moveToFront (e);
+                return e->glyphs;
+            }
+        }
+
+        CachedGlyphs::Ptr newGlyphs (new CachedGlyphs (font, typeface, text, width, height, justification,
+                                                       maximumLinesToUse, minimumHorizontalScale));
+
+        const ScopedLock sl (lock);
+        Entry* const e = findGlyphs (hash, font, typeface, text, width, height, justification, maximumLinesToUse, minimumHorizontalScale);
+
+        if (e != nullptr)
+        {
+            moveToFront (e);
+            return e->glyphs;
+        }
+
+        Entry* const newEntry = new Entry (hash);
+        newEntry->glyphs = newGlyphs;
+        newEntry->memoryUsage = sizeof (Entry) + sizeof (CachedGlyphs)
+                                  + (size_t) text.getNumBytesAsUTF8()
+                                  + sizeof (PositionedGlyph) * (size_t) newGlyphs->glyphs.getNumGlyphs();
+        addEntry (newEntry);
+        return newGlyphs;
+    }
+
+    void setMemoryBudget (const size_t maxBytes)
+    {
+        const ScopedLock sl (lock);
+        memoryBudget = maxBytes;
+        purgeUntilWithinBudget();
+    }
+
+    void clear()
+    {
+        const ScopedLock sl (lock);
+
+        while (leastRecent != nullptr)
+            deleteEntry (leastRecent);
+
+        jassert (numEntries == 0 && memoryUsage == 0);
+    }
+
+    enum { defaultMemoryBudget = 1024 * 1024 };
+
+    juce_DeclareSingleton (TextLayoutCache::Pimpl, false);
+
+private:
+    //==============================================================================
+    struct Entry
+    {
+        Entry (const uint64 hash_) noexcept
+            : hash (hash_), memoryUsage (0), nextInSlot (nullptr), previous (nullptr), next (nullptr)
+        {}
+
+        // Only one of these is used, depending on the kind of layout that was asked for.
+        CachedLayout::Ptr layout;
+        CachedGlyphs::Ptr glyphs;
+
+        const uint64 hash;
+        size_t memoryUsage;
+        Entry* nextInSlot;
+        Entry* previous;  // towards the most recently used end of the list
+        Entry* next;      // towards the least recently used end of the list
+
+        JUCE_DECLARE_NON_COPYABLE (Entry);
+    };
+
+    HeapBlock<Entry*> slots;
+    int numSlots, numEntries;
+    Entry* mostRecent;
+    Entry* leastRecent;
+    size_t memoryUsage, memoryBudget;
+    CriticalSection lock;
+
+    //==============================================================================
+    Entry* findLayout (const uint64 hash, const AttributedString& text,
+                       const float maxWidth, const bool balanceLineLengths) const noexcept
+    {
+        for (Entry* e = slots [(int) (hash & (uint64) (numSlots - 1))]; e != nullptr; e = e->nextInSlot)
+        {
+            const CachedLayout* const l = e->layout;
+
+            if (e->hash == hash && l != nullptr
+                 && l->maxWidth == maxWidth
+                 && l->balanceLineLengths == balanceLineLengths
+                 && TextLayoutCacheHelpers::areEqual (l->text, text))
+                return e;
+        }
+
+        return nullptr;
+    }
+
+    Entry* findGlyphs (const uint64 hash, const Font& font, const Typeface* const typeface, const String& text,
+                       const float width, const float height, const Justification& justification,
+                       const int maximumLinesToUse, const float minimumHorizontalScale) const noexcept
+    {
+        for (Entry* e = slots [(int) (hash & (uint64) (numSlots - 1))]; e != nullptr; e = e->nextInSlot)
+        {
+            const CachedGlyphs* const g = e->glyphs;
+
+            if (e->hash == hash && g != nullptr
+                 && g->typeface == typeface
+                 && g->width == width
+                 && g->height == height
+                 && g->justification == justification
+                 && g->maximumLinesToUse == maximumLinesToUse
+                 && g->minimumHorizontalScale == minimumHorizontalScale
+                 && g->font == font
+                 && g->text == text)
+                return e;
+        }
+
+        return nullptr;
+    }
+
+    void addEntry (Entry* const entry)
+    {
+        // A layout that would take up a big chunk of the budget is just handed back uncached,
+        // rather than flushing everything else out to make room for it.
+        if (entry->memoryUsage > memoryBudget / 4)
+        {
+            delete entry;
+            return;
+        }
+
+        Entry*& slot = slots [(int) (entry->hash & (uint64) (numSlots - 1))];
+        entry->nextInSlot = slot;
+        slot = entry;
+
+        entry->next = mostRecent;
+
+        if (mostRecent != nullptr)
+            mostRecent->previous = entry;
+        else
+            leastRecent = entry;
+
+        mostRecent = entry;
+        memoryUsage += entry->memoryUsage;
+
+        if (++numEntries > numSlots * 2)
+            resizeHashTable (numSlots * 2);
+
+        purgeUntilWithinBudget();
+    }
+
+    void deleteEntry (Entry* const entry)
+    {
+        Entry** e = &slots [(int) (entry->hash & (uint64) (numSlots - 1))];
+
+        while (*e != entry)
+        {
+            jassert (*e != nullptr);
+            e = &((*e)->nextInSlot);
+        }
+
+        *e = entry->nextInSlot;
+
+        removeFromList (entry);
+        memoryUsage -= entry->memoryUsage;
+        --numEntries;
+        delete entry;
+    }
+
+    void removeFromList (Entry* const entry) noexcept
+    {
+        if (entry->previous != nullptr)  entry->previous->next = entry->next;
+        else                             mostRecent = entry->next;
+
+        if (entry->next != nullptr)      entry->next->previous = entry->previous;
+        else                             leastRecent = entry->previous;
+
+        entry->previous = entry->next = nullptr;
+    }
+
+    void moveToFront (Entry* const entry) noexcept
+    {
+        if (entry != mostRecent)
+        {
+            removeFromList (entry);
+
+            entry->next = mostRecent;
+            mostRecent->previous = entry;
+            mostRecent = entry;
+        }
+    }
+
+    void purgeUntilWithinBudget()
+    {
+        while (memoryUsage > memoryBudget && leastRecent != nullptr)
+            deleteEntry (leastRecent);
+    }
+
+    void resizeHashTable (const int newNumSlots)
+    {
+        jassert (isPowerOfTwo (newNumSlots));
+
+        HeapBlock<Entry*> newSlots;
+        newSlots.calloc ((size_t) newNumSlots);
+
+        for (Entry* e = mostRecent; e != nullptr; e = e->next)
+        {
+            Entry*& slot = newSlots [(int) (e->hash & (uint64) (newNumSlots - 1))];
+            e->nextInSlot = slot;
+            slot = e;
+        }
+
+        slots.swapWith (newSlots);
+        numSlots = newNumSlots;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (Pimpl);
+};
+
+juce_ImplementSingleton (TextLayoutCache::Pimpl);
+
+
+//==============================================================================
+TextLayoutCache::CachedLayout::Ptr TextLayoutCache::getLayout (const AttributedString& text, const float maxWidth)
+{
+    return Pimpl::getInstance()->getLayout (text, maxWidth, false);
+}
+
+TextLayoutCache::CachedLayout::Ptr TextLayoutCache::getLayoutWithBalancedLineLengths (const AttributedString& text, const float maxWidth)
+{
+    return Pimpl::getInstance()->getLayout (text, maxWidth, true);
+}
+
+TextLayoutCache::CachedGlyphs::Ptr TextLayoutCache::getFittedText (const Font& font, const String& text,
+                                                                   const float width, const float height,
+                                                                   const Justification& justification,
+                                                                   const int maximumLinesToUse,
+                                                                   const float minimumHorizontalScale)
+{
+    return Pimpl::getInstance()->getFittedText (font, text, width, height,
+                                                justification, maximumLinesToUse, minimumHorizontalScale);
+}
+
+void TextLayoutCache::setMemoryBudget (const size_t maxBytes)
+{
+    Pimpl::getInstance()->setMemoryBudget (maxBytes);
+}
+
+void TextLayoutCache::clear()
+{
+    if (Pimpl::getInstanceWithoutCreating() != nullptr)
+        Pimpl::getInstanceWithoutCreating()->clear();
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class TextLayoutCacheTests  : public UnitTest
+{
+public:
+    TextLayoutCacheTests() : UnitTest ("TextLayoutCache") {}
+
+    static AttributedString createString (const String& text)
+    {
+        AttributedString s;
+        s.append (text, Font (15.0f), Colours::black);
+        return s;
+    }
+
+    static Typeface::Ptr createEmptyTypeface (const Font& font)
+    {
+        CustomTypeface* const t = new CustomTypeface();
+        t->setCharacteristics (font.getTypefaceName(), 0.8f, font.isBold(), font.isItalic(), 0);
+        return t;
+    }
+
+    class FittedTextThread  : public Thread
+    {
+    public:
+        FittedTextThread (const int seed_)  : Thread ("TextLayoutCache test"), seed (seed_), allValid (true) {}
+
+        void run()
+        {
+            Random r (seed);
+
+            for (int i = 0; i < 500; ++i)
+            {
+                const TextLayoutCache::CachedGlyphs::Ptr g (TextLayoutCache::getFittedText (Font (12.0f), "Text " + String (r.nextInt (50)),
+                                                                                          200.0f, 20.0f, Justification::centred, 1, 1.0f));
+                allValid = (g != nullptr && g->getGlyphs().getNumGlyphs() > 0) && allValid;
+            }
+        }
+
+        const int seed;
+        bool allValid;
+    };
+
+    void runTest()
+    {
+        beginTest ("Hits and misses");
+
+        TextLayoutCache::clear();
+        TextLayoutCache::setMemoryBudget (1024 * 1024);
+
+        const AttributedString text (createString ("The quick brown fox jumps over the lazy dog"));
+        const TextLayoutCache::CachedLayout::Ptr layout (TextLayoutCache::getLayout (text, 100.0f));
+
+        expect (TextLayoutCache::getLayout (text, 100.0f) == layout);
+        expect (TextLayoutCache::getLayout (createString (text.getText()), 100.0f) == layout);
+        expect (TextLayoutCache::getLayout (text, 120.0f) != layout);
+        expect (TextLayoutCache::getLayoutWithBalancedLineLengths (text, 100.0f) != layout);
+
+        {
+            AttributedString recoloured (text);
+            recoloured.setColour (Range<int> (0, 3), Colours::red);
+            expect (TextLayoutCache::getLayout (recoloured, 100.0f) != layout);
+        }
+
+        const TextLayoutCache::CachedGlyphs::Ptr glyphs (TextLayoutCache::getFittedText (Font (12.0f), "Fitted", 100.0f, 20.0f,
+                                                                                        Justification::centred, 1, 1.0f));
+        expect (TextLayoutCache::getFittedText (Font (12.0f), "Fitted", 100.0f, 20.0f, Justification::centred, 1, 1.0f) == glyphs);
+        expect (TextLayoutCache::getFittedText (Font (12.0f), "Fitted", 90.0f, 20.0f, Justification::centred, 1, 1.0f) != glyphs);
+        expect (TextLayoutCache::getFittedText (Font (13.0f), "Fitted", 100.0f, 20.0f, Justification::centred, 1, 1.0f) != glyphs);
+
+        {
+            // the glyphs are fitted into a rectangle at the origin, whatever position they're drawn at
+            const Rectangle<float> bounds (glyphs->getGlyphs().getBoundingBox (0, -1, true));
+            expect (! bounds.isEmpty());
+            expect (Rectangle<float> (0, 0, 100.0f, 20.0f).contains (bounds));
+        }
+
+        {
+            // if the font's typeface changes, glyphs that were laid out with the old one aren't used
+            // (this needs a named font, because the default one always keeps the same typeface)
+            const GetTypefaceForFont oldTypefaceFunction = juce_getTypefaceForFont;
+            juce_getTypefaceForFont = createEmptyTypeface;
+            Typeface::setTypefaceCacheSize (10);
+
+            const Font namedFont ("TextLayoutCache test", 12.0f, Font::plain);
+            const TextLayoutCache::CachedGlyphs::Ptr oldGlyphs (TextLayoutCache::getFittedText (namedFont, "Fitted", 100.0f, 20.0f,
+                                                                                               Justification::centred, 1, 1.0f));
+            expect (TextLayoutCache::getFittedText (Font (namedFont.getTypefaceName(), 12.0f, Font::plain), "Fitted", 100.0f, 20.0f,
+                                                    Justification::centred, 1, 1.0f) == oldGlyphs);
+
+            Typeface::setTypefaceCacheSize (10);
+
+            const TextLayoutCache::CachedGlyphs::Ptr newGlyphs (TextLayoutCache::getFittedText (Font (namedFont.getTypefaceName(), 12.0f, Font::plain),
+                                                                                               "Fitted", 100.0f, 20.0f, Justification::centred, 1, 1.0f));
+            expect (newGlyphs != oldGlyphs);
+            expect (TextLayoutCache::getFittedText (Font (namedFont.getTypefaceName(), 12.0f, Font::plain), "Fitted", 100.0f, 20.0f,
+                                                    Justification::centred, 1, 1.0f) == newGlyphs);
+
+            juce_getTypefaceForFont = oldTypefaceFunction;
+            Typeface::setTypefaceCacheSize (10);
+        }
+
+        beginTest ("Eviction");
+
+        const AttributedString recentText (createString ("Used all the time"));
+        const TextLayoutCache::CachedLayout::Ptr recentLayout (TextLayoutCache::getLayout (recentText, 100.0f));
+
+        for (int i = 0; i < 3000; ++i)
+        {
+            TextLayoutCache::getLayout (createString ("Filler text number " + String (i)), 100.0f);
+
+            if (i % 10 == 0)
+                TextLayoutCache::getLayout (recentText, 100.0f);
+        }
+
+        // the least-recently used layouts have been thrown away, but one that's still held keeps working
+        expect (TextLayoutCache::getLayout (text, 100.0f) != layout);
+        expect (layout->getLayout().getNumLines() > 0);
+        expect (TextLayoutCache::getLayout (recentText, 100.0f) == recentLayout);
+
+        TextLayoutCache::clear();
+        expect (TextLayoutCache::getLayout (recentText, 100.0f) != recentLayout);
+
+        // a layout that would take too much of the budget isn't cached at all
+        TextLayoutCache::setMemoryBudget (16);
+        const TextLayoutCache::CachedLayout::Ptr uncached (TextLayoutCache::getLayout (text, 100.0f));
+        expect (TextLayoutCache::getLayout (text, 100.0f) != uncached);
+
+        beginTest ("Concurrent use");
+
+        TextLayoutCache::setMemoryBudget (4096);
+        OwnedArray<FittedTextThread> threads;
+
+        for (int i = 0; i < 4; ++i)
+            threads.add (new FittedTextThread (i + 1));
+
+        for (int i = 0; i < threads.size(); ++i)
+            threads.getUnchecked (i)->startThread();
+
+        for (int i = 0; i < threads.size(); ++i)
+        {
+            threads.getUnchecked (i)->waitForThreadToExit (-1);
+            expect (threads.getUnchecked (i)->allValid);
+        }
+
+        TextLayoutCache::setMemoryBudget (1024 * 1024);
+        TextLayoutCache::clear();
+    }
+};
+
+static TextLayoutCacheTests textLayoutCacheUnitTests;
+
+#endif
+
+END_JUCE_NAMESPACE
@@ -0,0 +1,155 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library - "Jules' Utility Class Extensions"
+   Copyright 2004-11 by Raw Material Software Ltd.
+
+  ------------------------------------------------------------------------------
+
+   JUCE can be redistributed and/or modified under the terms of the GNU General
+   Public License (Version 2), as published by the Free Software Foundation.
+   A copy of the license is included in the JUCE distribution, or can be found
+   online at www.gnu.org/licenses.
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.rawmaterialsoftware.com/juce for more information.
+
+  ==============================================================================
+*/
+
+#ifndef __JUCE_TEXTLAYOUTCACHE_JUCEHEADER__
+#define __JUCE_TEXTLAYOUTCACHE_JUCEHEADER__
+
+#include "juce_TextLayout.h"
+#include "juce_GlyphArrangement.h"
+#include "juce_AttributedString.h"
+
+
+//==============================================================================
+/**
+    A global cache of laid-out text.
+
+    Laying out a string is much slower than drawing it, and most of the text in a
+    UI (labels, button names, tooltips, etc) is drawn over and over again without
+    changing. This cache keeps the results of recent layouts, keyed by the text, its
+    attributes and the space it was laid out in, so that repainting the same text
+    doesn't have to lay it out again.
+
+    The layouts it returns are shared between everyone who asks for the same text,
+    so they can only be accessed through const references. The total size of the
+    layouts that are kept is limited, and the ones that were used least recently are
+    discarded first - see setMemoryBudget().
+
+    @see TextLayout, GlyphArrangement, Graphics::drawFittedText
+*/
+class JUCE_API  TextLayoutCache
+{
+public:
+    //==============================================================================
+    /** A TextLayout that's held by the cache. */
+    class JUCE_API  CachedLayout  : public ReferenceCountedObject
+    {
+    public:
+        /** Returns the layout. */
+        const TextLayout& getLayout() const noexcept            { return layout; }
+
+        typedef ReferenceCountedObjectPtr<CachedLayout> Ptr;
+
+    private:
+        friend class TextLayoutCache;
+        const AttributedString text;
+        const float maxWidth;
+        const bool balanceLineLengths;
+        TextLayout layout;
+
+        CachedLayout (const AttributedString&, float maxWidth, bool balanceLineLengths);
+
+        JUCE_DECLARE_NON_COPYABLE (CachedLayout);
+    };
+
+    /** A GlyphArrangement that's held by the cache. */
+    class JUCE_API  CachedGlyphs  : public ReferenceCountedObject
+    {
+    public:
+        /** Returns the glyphs, which are positioned as if their area's top-left were at the origin. */
+        const GlyphArrangement& getGlyphs() const noexcept      { return glyphs; }
+
+        typedef ReferenceCountedObjectPtr<CachedGlyphs> Ptr;
+
+    private:
+        friend class TextLayoutCache;
+        const Font font;
+        const Typeface::Ptr typeface;
+        const String text;
+        const float width, height;
+        const Justification justification;
+        const int maximumLinesToUse;
+        const float minimumHorizontalScale;
+        GlyphArrangement glyphs;
+
+        CachedGlyphs (const Font&, Typeface*, const String&, float width, float height,
+                      const Justification&, int maximumLinesToUse, float minimumHorizontalScale);
+
+        JUCE_DECLARE_NON_COPYABLE (CachedGlyphs);
+    };
+
+    //==============================================================================
+    /** Returns a layout of an AttributedString, as created by TextLayout::createLayout().
+        If the same string has recently been laid out with the same width, this will
+        return the existing layout rather than creating a new one.
+    */
+    static CachedLayout::Ptr getLayout (const AttributedString& text, float maxWidth);
+
+    /** Returns a layout of an AttributedString, as created by
+        TextLayout::createLayoutWithBalancedLineLengths().
+        If the same string has recently been laid out with the same width, this will
+        return the existing layout rather than creating a new one.
+    */
+    static CachedLayout::Ptr getLayoutWithBalancedLineLengths (const AttributedString& text, float maxWidth);
+
+    /** Returns the glyphs that GlyphArrangement::addFittedText() creates for some text.
+
+        The text is fitted into a rectangle of the given size whose top-left is at the origin,
+        so the glyphs need to be moved to wherever the rectangle really is when they're drawn.
+        If the same text has recently been fitted into a rectangle of the same size with the
+        same font, typeface and settings, this will return the existing glyphs rather than
+        creating new ones.
+
+        @see GlyphArrangement::addFittedText, Graphics::drawFittedText
+    */
+    static CachedGlyphs::Ptr getFittedText (const Font& font, const String& text,
+                                            float width, float height,
+                                            const Justification& justification,
+                                            int maximumLinesToUse,
+                                            float minimumHorizontalScale);
+
+    //==============================================================================
+    /** Sets the approximate number of bytes that the cached layouts may use.
+        When this is exceeded, the least recently used layouts are removed from the
+        cache. The default is 1MB.
+    */
+    static void setMemoryBudget (size_t maxBytes);
+
+    /** Removes all the layouts from the cache.
+        Any that are still being used elsewhere won't be deleted until they're released.
+    */
+    static void clear();
+
+private:
+    //==============================================================================
+    class Pimpl;
+    friend class Pimpl;
+
+    TextLayoutCache();
+    ~TextLayoutCache();
+
+    JUCE_DECLARE_NON_COPYABLE (TextLayoutCache);
+};
+
+#endif   // __JUCE_TEXTLAYOUTCACHE_JUCEHEADER__
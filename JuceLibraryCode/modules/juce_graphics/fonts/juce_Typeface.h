@@ -47,7 +47,7 @@ class AffineTransform;
 
     @see CustomTypeface, Font
 */
-class JUCE_API  Typeface  : public SingleThreadedReferenceCountedObject
+class JUCE_API  Typeface  : public ReferenceCountedObject
 {
 public:
     //==============================================================================
@@ -117,9 +117,33 @@ public:
     virtual bool isHinted() const                           { return false; }
 
     //==============================================================================
-    /** Changes the number of fonts that are cached in memory. */
+    /** Changes the number of fonts that are cached in memory.
+
+        This is the minimum that the cache keeps - if more fonts than this are being used
+        at once, it'll grow to hold several times as many, and then shrink again when they
+        stop being needed. Changing the size empties the cache.
+    */
     static void setTypefaceCacheSize (int numFontsToCache);
 
+    /** A snapshot of the counters kept by the typeface cache.
+        @see getTypefaceCacheStatistics
+    */
+    struct CacheStatistics
+    {
+        CacheStatistics() noexcept
+            : numHits (0), numMisses (0), numEvictions (0),
+              numTypefaces (0), capacity (0)
+        {}
+
+        int64 numHits, numMisses, numEvictions;
+        int numTypefaces, capacity;
+    };
+
+    /** Returns the hit, miss and eviction counts of the cache that fonts use to find
+        their typefaces, along with the number of typefaces it currently holds and can hold.
+    */
+    static CacheStatistics getTypefaceCacheStatistics();
+
 protected:
     //==============================================================================
     String name;
@@ -87,10 +87,13 @@ EdgeTable::EdgeTable (const Rectangle<int>& bounds_,
                     const int step = jmin (stepSize, y2 - y1, 256 - (y1 & 255));
                     int x = roundToInt (startX + multiplier * ((y1 + (step >> 1)) - startY));
 
+                    // Clamping to the right-hand edge rather than just inside it means
+                    // that the last column isn't left slightly transparent, so the levels
+                    // within the bounds don't depend on where the bounds are.
                     if (x < leftLimit)
                         x = leftLimit;
-                    else if (x >= rightLimit)
-                        x = rightLimit - 1;
+                    else if (x > rightLimit)
+                        x = rightLimit;
 
                     addEdgePoint (x, y1 >> 8, direction * step);
                     y1 += step;
@@ -441,8 +444,12 @@ void EdgeTable::intersectWithEdgeTableLine (const int y, const int* otherLine)
 
     ++otherLine;
     const size_t lineSizeBytes = (dest[0] * 2 + 1) * sizeof (int);
-    int* temp = static_cast<int*> (alloca (lineSizeBytes));
+
+    // (the loop below reads the x position after the last edge before it notices that there
+    // are no more, so there's room for one more item, although its value is never used)
+    int* temp = static_cast<int*> (alloca (lineSizeBytes + sizeof (int)));
     memcpy (temp, dest, lineSizeBytes);
+    temp [dest[0] * 2 + 1] = 0;
 
     const int* src1 = temp;
     int srcNum1 = *src1++;
@@ -90,6 +90,9 @@ public:
     */
     void optimiseTable();
 
+    /** Returns the number of bytes allocated for the table's line data. */
+    size_t getMemoryUsage() const noexcept          { return (size_t) (bounds.getHeight() + 1) * (size_t) lineStrideElements * sizeof (int); }
+
 
     //==============================================================================
     /** Iterates the lines in the table, for rendering.
@@ -110,9 +113,22 @@ public:
     template <class EdgeTableIterationCallback>
     void iterate (EdgeTableIterationCallback& iterationCallback) const noexcept
     {
-        const int* lineStart = table;
+        iterate (iterationCallback, bounds.getY(), bounds.getBottom());
+    }
+
+    /** Iterates the lines in the table that lie between two y positions.
+
+        This is the same as the other iterate() method, but skips the lines outside
+        the range startY to endY (not including endY).
+    */
+    template <class EdgeTableIterationCallback>
+    void iterate (EdgeTableIterationCallback& iterationCallback, const int startY, const int endY) const noexcept
+    {
+        const int firstLine = jmax (0, startY - bounds.getY());
+        const int endLine = jmin (bounds.getHeight(), endY - bounds.getY());
+        const int* lineStart = table + lineStrideElements * firstLine;
 
-        for (int y = 0; y < bounds.getHeight(); ++y)
+        for (int y = firstLine; y < endLine; ++y)
         {
             const int* line = lineStart;
             lineStart += lineStrideElements;
@@ -121,7 +137,7 @@ public:
             if (--numPoints > 0)
             {
                 int x = *++line;
-                jassert ((x >> 8) >= bounds.getX() && (x >> 8) < bounds.getRight());
+                jassert ((x >> 8) >= bounds.getX() && (x >> 8) <= bounds.getRight());
                 int levelAccumulator = 0;
 
                 iterationCallback.setEdgeTableYPos (bounds.getY() + y);
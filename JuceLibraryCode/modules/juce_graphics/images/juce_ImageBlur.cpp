@@ -0,0 +1,546 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library - "Jules' Utility Class Extensions"
+   Copyright 2004-11 by Raw Material Software Ltd.
+
+  ------------------------------------------------------------------------------
+
+   JUCE can be redistributed and/or modified under the terms of the GNU General
+   Public License (Version 2), as published by the Free Software Foundation.
+   A copy of the license is included in the JUCE distribution, or can be found
+   online at www.gnu.org/licenses.
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.rawmaterialsoftware.com/juce for more information.
+
+  ==============================================================================
+*/
+
+BEGIN_JUCE_NAMESPACE
+
+namespace ImageBlurHelpers
+{
+    // Finds the radii of three box filters which, when run one after the other, have the
+    // same variance as a gaussian with the given standard deviation. The radii are in
+    // ascending order.
+    static void getBoxRadii (const double sigma, int* radii) noexcept
+    {
+        const int numBoxes = 3;
+        const double idealWidth = std::sqrt (12.0 * sigma * sigma / numBoxes + 1.0);
+
+        int lowerWidth = (int) idealWidth;
+        if ((lowerWidth & 1) == 0)
+            --lowerWidth;
+
+        lowerWidth = jmax (1, lowerWidth);
+
+        const int numLower = jlimit (0, numBoxes,
+                                     roundToInt ((12.0 * sigma * sigma - numBoxes * lowerWidth * lowerWidth
+                                                   - 4.0 * numBoxes * lowerWidth - 3.0 * numBoxes)
+                                                  / (-4.0 * lowerWidth - 4.0)));
+
+        for (int i = 0; i < numBoxes; ++i)
+            radii[i] = ((i < numLower ? lowerWidth : lowerWidth + 2) - 1) / 2;
+    }
+
+    // Runs a box filter of the given radius along a row of samples. Both the source and
+    // destination must have at least (radius + 1) zeros before their first sample, and
+    // radius zeros after the last one.
+    template <typename SampleType>
+    static void boxFilter (const SampleType* src, SampleType* dest, const int length, const int radius) noexcept
+    {
+        const SampleType scale (1.0f / (float) (radius * 2 + 1));
+        SampleType sum (0.0f);
+
+        for (int i = -radius - 1; i < radius; ++i)
+            sum += src[i];
+
+        for (int i = 0; i < length; ++i)
+        {
+            sum += src[i + radius];
+            sum -= src[i - radius - 1];
+            dest[i] = sum * scale;
+        }
+    }
+
+   #if JUCE_USE_SSE2_INTRINSICS
+    // A sample from each of four rows, so that boxFilter() can filter them all at once.
+    struct FourSamples
+    {
+        FourSamples (const float value_) noexcept    : value (_mm_set1_ps (value_)) {}
+        FourSamples (const __m128 value_) noexcept   : value (value_) {}
+
+        FourSamples& operator+= (const FourSamples& other) noexcept   { value = _mm_add_ps (value, other.value); return *this; }
+        FourSamples& operator-= (const FourSamples& other) noexcept   { value = _mm_sub_ps (value, other.value); return *this; }
+        FourSamples operator* (const FourSamples& other) const noexcept  { return FourSamples (_mm_mul_ps (value, other.value)); }
+
+        __m128 value;
+    };
+   #endif
+
+    //==============================================================================
+    static inline void storeSample (uint8* const dest, const float value) noexcept   { *dest = (uint8) jlimit (0, 255, roundToInt (value)); }
+    static inline void storeSample (float* const dest, const float value) noexcept   { *dest = value; }
+
+   #if JUCE_USE_SSE2_INTRINSICS
+    // Stores the values from four rows in consecutive columns of the destination.
+    static inline void storeSamples (uint8* const dest, const int pixelStride, const __m128 values) noexcept
+    {
+        const __m128i ints = _mm_cvtps_epi32 (values);
+        const __m128i words = _mm_packs_epi32 (ints, ints);
+        const uint32 bytes = (uint32) _mm_cvtsi128_si32 (_mm_packus_epi16 (words, words));
+
+        if (pixelStride == 1)
+        {
+            *reinterpret_cast <uint32*> (dest) = bytes;
+        }
+        else
+        {
+            dest[0]               = (uint8) bytes;
+            dest[pixelStride]     = (uint8) (bytes >> 8);
+            dest[pixelStride * 2] = (uint8) (bytes >> 16);
+            dest[pixelStride * 3] = (uint8) (bytes >> 24);
+        }
+    }
+
+    static inline void storeSamples (float* const dest, const int pixelStride, const __m128 values) noexcept
+    {
+        jassert (pixelStride == 1);
+        (void) pixelStride;
+        _mm_storeu_ps (dest, values);
+    }
+   #endif
+
+    //==============================================================================
+    /* Blurs each row of one channel of an image in one direction, and writes the results
+       to the columns of the destination, so that running it twice blurs both ways.
+    */
+    template <typename SrcType, typename DestType>
+    struct Pass
+    {
+        const SrcType* src;
+        int srcPixelStride, srcLineStride;
+        DestType* dest;
+        int destPixelStride, destLineStride;
+        int rowLength;
+        const int* radii;
+        float gain;
+
+        void run (const int firstRow, const int numRows) const
+        {
+            const int padding = radii[2] + 1;
+            const int bufferSize = rowLength + padding * 2;
+            int y = firstRow;
+            const int endRow = firstRow + numRows;
+
+           #if JUCE_USE_SSE2_INTRINSICS
+            if (numRows >= 4 && SystemStats::hasSSE2())
+            {
+                // (allocated as floats, as the heap may not give us 16-byte alignment)
+                HeapBlock<float> storage;
+                storage.calloc ((size_t) (bufferSize * 8 + 4));
+                FourSamples* const buffer1 = reinterpret_cast <FourSamples*> ((reinterpret_cast <pointer_sized_int> (storage.getData()) + 15) & ~(pointer_sized_int) 15) + padding;
+                FourSamples* const buffer2 = buffer1 + bufferSize;
+                const __m128 gain4 = _mm_set1_ps (gain);
+
+                for (; y + 4 <= endRow; y += 4)
+                {
+                    const SrcType* const s0 = src + y * srcLineStride;
+                    const SrcType* const s1 = s0 + srcLineStride;
+                    const SrcType* const s2 = s1 + srcLineStride;
+                    const SrcType* const s3 = s2 + srcLineStride;
+
+                    for (int x = 0; x < rowLength; ++x)
+                    {
+                        const int offset = x * srcPixelStride;
+                        buffer1[x].value = _mm_set_ps ((float) s3[offset], (float) s2[offset], (float) s1[offset], (float) s0[offset]);
+                    }
+
+                    boxFilter (buffer1, buffer2, rowLength, radii[0]);
+                    boxFilter (buffer2, buffer1, rowLength, radii[1]);
+                    boxFilter (buffer1, buffer2, rowLength, radii[2]);
+
+                    DestType* d = dest + y * destPixelStride;
+
+                    for (int x = 0; x < rowLength; ++x)
+                    {
+                        storeSamples (d, destPixelStride, _mm_mul_ps (buffer2[x].value, gain4));
+                        d += destLineStride;
+                    }
+                }
+            }
+           #endif
+
+            if (y < endRow)
+            {
+                HeapBlock<float> storage;
+                storage.calloc ((size_t) (bufferSize * 2));
+                float* const buffer1 = storage + padding;
+                float* const buffer2 = buffer1 + bufferSize;
+
+                for (; y < endRow; ++y)
+                {
+                    const SrcType* s = src + y * srcLineStride;
+
+                    for (int x = 0; x < rowLength; ++x)
+                    {
+                        buffer1[x] = (float) *s;
+                        s += srcPixelStride;
+                    }
+
+                    boxFilter (buffer1, buffer2, rowLength, radii[0]);
+                    boxFilter (buffer2, buffer1, rowLength, radii[1]);
+                    boxFilter (buffer1, buffer2, rowLength, radii[2]);
+
+                    DestType* d = dest + y * destPixelStride;
+
+                    for (int x = 0; x < rowLength; ++x)
+                    {
+                        storeSample (d, buffer2[x] * gain);
+                        d += destLineStride;
+                    }
+                }
+            }
+        }
+    };
+
+    //==============================================================================
+    template <class PassType>
+    class BandJob  : public ThreadPoolJob
+    {
+    public:
+        BandJob (const PassType& pass_, const int firstRow_, const int numRows_)
+            : ThreadPoolJob ("Image blur band"),
+              pass (pass_), firstRow (firstRow_), numRows (numRows_)
+        {
+        }
+
+        JobStatus runJob()
+        {
+            blur();
+            return jobHasFinished;
+        }
+
+        void blur() const
+        {
+            pass.run (firstRow, numRows);
+        }
+
+    private:
+        const PassType& pass;
+        const int firstRow, numRows;
+
+        JUCE_DECLARE_NON_COPYABLE (BandJob);
+    };
+
+    template <class PassType>
+    static void runPass (const PassType& pass, const int numRows, ThreadPool* const threadPool)
+    {
+        enum { minimumRowsPerBand = 32 };
+
+        const int numBands = threadPool != nullptr ? jmin (threadPool->getNumThreads() + 1, numRows / minimumRowsPerBand)
+                                                   : 1;
+        if (numBands <= 1)
+        {
+            pass.run (0, numRows);
+            return;
+        }
+
+        // The bands are kept to multiples of four rows, so that they're all filtered in the
+        // same way, and give the same results that a single band would.
+        OwnedArray<BandJob<PassType> > bands;
+
+        for (int i = 0; i < numBands; ++i)
+        {
+            const int top    = i == 0             ? 0       : ((numRows * i) / numBands) & ~3;
+            const int bottom = i == numBands - 1  ? numRows : ((numRows * (i + 1)) / numBands) & ~3;
+
+            bands.add (new BandJob<PassType> (pass, top, bottom - top));
+        }
+
+        for (int i = 1; i < bands.size(); ++i)
+            threadPool->addJob (bands.getUnchecked (i));
+
+        bands.getUnchecked (0)->blur();
+
+        for (int i = 1; i < bands.size(); ++i)
+            threadPool->waitForJobToFinish (bands.getUnchecked (i), -1);
+    }
+
+    // Blurs some 8-bit channels of the source, which start at src and are spaced one byte
+    // apart, into the same channels of the destination. The source and destination can be
+    // the same.
+    static void blur (const uint8* const src, const int srcPixelStride, const int srcLineStride,
+                      uint8* const dest, const int destPixelStride, const int destLineStride,
+                      const int numChannels, const int width, const int height,
+                      const float radius, const float gain, ThreadPool* const threadPool)
+    {
+        int radii[3];
+        getBoxRadii (radius * 0.5, radii);
+
+        // Each channel's rows are blurred into a transposed copy, and then the rows of that
+        // are blurred back into the destination. The copy is kept as floats, so that the
+        // gain doesn't exaggerate any rounding errors from the first direction.
+        HeapBlock<float> transposed ((size_t) (width * height));
+
+        Pass<uint8, float> rows;
+        rows.srcPixelStride = srcPixelStride;
+        rows.srcLineStride = srcLineStride;
+        rows.dest = transposed;
+        rows.destPixelStride = 1;
+        rows.destLineStride = height;
+        rows.rowLength = width;
+        rows.radii = radii;
+        rows.gain = 1.0f;
+
+        Pass<float, uint8> columns;
+        columns.src = transposed;
+        columns.srcPixelStride = 1;
+        columns.srcLineStride = height;
+        columns.destPixelStride = destPixelStride;
+        columns.destLineStride = destLineStride;
+        columns.rowLength = height;
+        columns.radii = radii;
+        columns.gain = gain;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            rows.src = src + channel;
+            runPass (rows, height, threadPool);
+
+            columns.dest = dest + channel;
+            runPass (columns, width, threadPool);
+        }
+    }
+}
+
+//==============================================================================
+void ImageBlur::applyToImage (Image& image, const float radius, ThreadPool* const threadPool)
+{
+    if (image.isNull() || radius <= 0)
+        return;
+
+    image.duplicateIfShared();
+
+    const Image::BitmapData data (image, Image::BitmapData::readWrite);
+
+    ImageBlurHelpers::blur (data.data, data.pixelStride, data.lineStride,
+                            data.data, data.pixelStride, data.lineStride,
+                            data.pixelStride, data.width, data.height,
+                            radius, 1.0f, threadPool);
+}
+
+void ImageBlur::blurAlphaChannel (const Image& sourceImage, Image& destImage,
+                                  const float radius, const float gain, ThreadPool* const threadPool)
+{
+    const int w = sourceImage.getWidth();
+    const int h = sourceImage.getHeight();
+
+    if (destImage.getFormat() != Image::SingleChannel || destImage.getWidth() != w || destImage.getHeight() != h)
+        destImage = Image (Image::SingleChannel, w, h, false);
+    else
+        destImage.duplicateIfShared();
+
+    if (sourceImage.isNull())
+        return;
+
+    const Image::BitmapData srcData (sourceImage, Image::BitmapData::readOnly);
+    const Image::BitmapData destData (destImage, Image::BitmapData::writeOnly);
+
+    const uint8* src = srcData.data;
+    int srcPixelStride = srcData.pixelStride;
+    int srcLineStride = srcData.lineStride;
+
+    if (sourceImage.getFormat() == Image::ARGB)
+    {
+        src += PixelARGB::indexA;
+    }
+    else if (! sourceImage.hasAlphaChannel())
+    {
+        // an opaque image is read as a single fully-opaque pixel, repeated everywhere
+        static const uint8 opaque = 0xff;
+        src = &opaque;
+        srcPixelStride = 0;
+        srcLineStride = 0;
+    }
+
+    ImageBlurHelpers::blur (src, srcPixelStride, srcLineStride,
+                            destData.data, destData.pixelStride, destData.lineStride,
+                            1, w, h, jmax (0.0f, radius), gain, threadPool);
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class ImageBlurTests  : public UnitTest
+{
+public:
+    ImageBlurTests() : UnitTest ("ImageBlur") {}
+
+    static Image createRandomImage (Random& r, const Image::PixelFormat format, const int w, const int h)
+    {
+        Image image (format, w, h, true, SoftwareImageType());
+        Graphics g (image);
+
+        for (int i = 0; i < 30; ++i)
+        {
+            g.setColour (Colour ((uint32) r.nextInt()));
+            g.fillEllipse (r.nextFloat() * w, r.nextFloat() * h, r.nextFloat() * w * 0.5f, r.nextFloat() * h * 0.5f);
+        }
+
+        return image;
+    }
+
+    static bool imagesAreIdentical (const Image& a, const Image& b)
+    {
+        const Image::BitmapData d1 (a, Image::BitmapData::readOnly);
+        const Image::BitmapData d2 (b, Image::BitmapData::readOnly);
+
+        for (int y = 0; y < a.getHeight(); ++y)
+            if (memcmp (d1.getLinePointer (y), d2.getLinePointer (y), (size_t) (a.getWidth() * d1.pixelStride)) != 0)
+                return false;
+
+        return true;
+    }
+
+    static double timeBlur (Image& image, const float radius, const int numRepeats)
+    {
+        const double start = Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < numRepeats; ++i)
+            ImageBlur::applyToImage (image, radius);
+
+        return (Time::getMillisecondCounterHiRes() - start) / numRepeats;
+    }
+
+    void runTest()
+    {
+        beginTest ("Blurring");
+
+        {
+            // A single dot should spread out evenly in all directions.
+            Image dot (Image::SingleChannel, 81, 81, true, SoftwareImageType());
+            dot.setPixelAt (40, 40, Colours::white);
+
+            Image result;
+            ImageBlur::blurAlphaChannel (dot, result, 20.0f, 100.0f);
+
+            const int centre = result.getPixelAt (40, 40).getAlpha();
+            expect (centre > 0);
+            bool isSymmetrical = true, fallsOff = true;
+
+            for (int y = 0; y <= 40; ++y)
+            {
+                for (int x = 0; x <= 40; ++x)
+                {
+                    const int v = result.getPixelAt (40 + x, 40 + y).getAlpha();
+
+                    isSymmetrical = isSymmetrical
+                                     && std::abs (v - result.getPixelAt (40 - x, 40 + y).getAlpha()) <= 1
+                                     && std::abs (v - result.getPixelAt (40 + x, 40 - y).getAlpha()) <= 1
+                                     && std::abs (v - result.getPixelAt (40 + y, 40 + x).getAlpha()) <= 1;
+
+                    fallsOff = fallsOff && (x == 0 || v <= result.getPixelAt (40 + x - 1, 40 + y).getAlpha());
+                }
+            }
+
+            expect (isSymmetrical);
+            expect (fallsOff);
+            expectEquals (result.getPixelAt (0, 0).getAlpha(), (uint8) 0);
+        }
+
+        {
+            // Blurring a flat area should only change it near the edges.
+            Image flat (Image::ARGB, 100, 60, true, SoftwareImageType());
+            flat.clear (flat.getBounds(), Colour (0xc8804020));
+            const Colour original (flat.getPixelAt (50, 30));
+
+            ImageBlur::applyToImage (flat, 8.0f);
+
+            expect (flat.getPixelAt (50, 30) == original);
+            expect (flat.getPixelAt (0, 30).getAlpha() < 0xc8);
+            expect (flat.getPixelAt (50, 59).getAlpha() < 0xc8);
+
+            Image opaque (Image::RGB, 100, 60, true, SoftwareImageType());
+            Image result;
+            ImageBlur::blurAlphaChannel (opaque, result, 8.0f);
+
+            expectEquals (result.getPixelAt (50, 30).getAlpha(), (uint8) 0xff);
+            expect (result.getPixelAt (0, 0).getAlpha() < 0xff);
+        }
+
+        beginTest ("Blurring in bands");
+
+        {
+            Random r;
+            ThreadPool pool (3);
+
+            for (int i = 0; i < 10; ++i)
+            {
+                const Image::PixelFormat format = r.nextBool() ? Image::ARGB : Image::RGB;
+                const Image source (createRandomImage (r, format, 150 + r.nextInt (300), 150 + r.nextInt (300)));
+                const float radius = r.nextFloat() * 30.0f;
+
+                Image image1 (source), image2 (source);
+                ImageBlur::applyToImage (image1, radius);
+                ImageBlur::applyToImage (image2, radius, &pool);
+                expect (imagesAreIdentical (image1, image2));
+
+                Image alpha1, alpha2;
+                ImageBlur::blurAlphaChannel (source, alpha1, radius, 2.0f);
+                ImageBlur::blurAlphaChannel (source, alpha2, radius, 2.0f, &pool);
+                expect (imagesAreIdentical (alpha1, alpha2));
+            }
+        }
+
+        beginTest ("Benchmark");
+
+        {
+            Random r;
+            const int sizes[] = { 64, 256, 1024 };
+            const float radii[] = { 2.0f, 8.0f, 32.0f };
+
+            for (int i = 0; i < numElementsInArray (sizes); ++i)
+            {
+                for (int j = 0; j < numElementsInArray (radii); ++j)
+                {
+                    const int size = sizes[i];
+                    const float radius = radii[j];
+                    Image image (createRandomImage (r, Image::ARGB, size, size));
+
+                    String message;
+                    message << size << "x" << size << ", radius " << radius
+                            << ": ImageBlur " << String (timeBlur (image, radius, jmax (1, 65536 / (size * size))), 3) << "ms";
+
+                    // The 2D kernel is far too slow to try on the larger sizes.
+                    if (size * size * radius * radius <= 256 * 256 * 8 * 8)
+                    {
+                        const int kernelSize = roundToInt (radius * 2.0f);
+                        ImageConvolutionKernel kernel (kernelSize);
+                        kernel.createGaussianBlur (radius);
+
+                        const double start = Time::getMillisecondCounterHiRes();
+                        kernel.applyToImage (image, image, image.getBounds());
+
+                        message << ", ImageConvolutionKernel " << String (Time::getMillisecondCounterHiRes() - start, 3) << "ms";
+                    }
+
+                    logMessage (message);
+                }
+            }
+        }
+    }
+};
+
+static ImageBlurTests imageBlurUnitTests;
+
+#endif
+
+END_JUCE_NAMESPACE
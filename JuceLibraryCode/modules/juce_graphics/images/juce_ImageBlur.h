@@ -0,0 +1,88 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE library - "Jules' Utility Class Extensions"
+   Copyright 2004-11 by Raw Material Software Ltd.
+
+  ------------------------------------------------------------------------------
+
+   JUCE can be redistributed and/or modified under the terms of the GNU General
+   Public License (Version 2), as published by the Free Software Foundation.
+   A copy of the license is included in the JUCE distribution, or can be found
+   online at www.gnu.org/licenses.
+
+   JUCE is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+   A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+  ------------------------------------------------------------------------------
+
+   To release a closed-source product which uses JUCE, commercial licenses are
+   available: visit www.rawmaterialsoftware.com/juce for more information.
+
+  ==============================================================================
+*/
+
+#ifndef __JUCE_IMAGEBLUR_JUCEHEADER__
+#define __JUCE_IMAGEBLUR_JUCEHEADER__
+
+#include "juce_Image.h"
+
+
+//==============================================================================
+/**
+    Applies a fast approximation of a gaussian blur to an image.
+
+    Rather than convolving each pixel with a full 2D kernel, as ImageConvolutionKernel
+    does, this runs three box filters across the rows and then three more down the
+    columns, which gives a very close match to a true gaussian. The cost of each box
+    filter doesn't depend on its width, so large radii are just as quick as small ones.
+
+    To keep its memory access in order, each direction writes its results transposed,
+    so the columns are blurred by running along the rows of the transposed image. When
+    SSE2 is available, four rows are filtered at once.
+
+    Pixels outside the image are treated as being transparent black.
+
+    @see ImageConvolutionKernel, DropShadowEffect, GlowEffect
+*/
+class JUCE_API  ImageBlur
+{
+public:
+    //==============================================================================
+    /** Blurs all the channels of an image.
+
+        @param image        the image to blur - if it's shared, it'll be duplicated first
+        @param radius       the distance over which the blur spreads each pixel, which is
+                            about twice the standard deviation of the gaussian that it
+                            approximates
+        @param threadPool   if this isn't null, the image is split into bands and some of
+                            these are blurred on the pool's threads, while the calling thread
+                            does the rest. It's only worth doing this for large images
+    */
+    static void applyToImage (Image& image, float radius, ThreadPool* threadPool = nullptr);
+
+    /** Blurs the alpha channel of an image into a single-channel image.
+
+        If the source image is RGB, it's treated as being opaque.
+
+        @param sourceImage  the image whose alpha channel should be blurred
+        @param destImage    the image to write the result to. If this isn't a SingleChannel
+                            image of the same size as the source, a new one is created
+        @param radius       the distance over which the blur spreads each pixel - see
+                            applyToImage()
+        @param gain         a factor to multiply the blurred values by, e.g. to make the edges
+                            of a glow more solid. The results are clipped to 255
+        @param threadPool   an optional pool to share the work with - see applyToImage()
+    */
+    static void blurAlphaChannel (const Image& sourceImage, Image& destImage,
+                                  float radius, float gain = 1.0f,
+                                  ThreadPool* threadPool = nullptr);
+
+private:
+    ImageBlur();
+    JUCE_DECLARE_NON_COPYABLE (ImageBlur);
+};
+
+
+#endif   // __JUCE_IMAGEBLUR_JUCEHEADER__
@@ -26,33 +26,57 @@
 BEGIN_JUCE_NAMESPACE
 
 //==============================================================================
+/*  The images are found through a hash table, and are also kept in a list in the order
+    in which they were last used. An image that's still being used somewhere else (i.e.
+    has other references to it) is never removed, but when the images that aren't in use
+    take up more memory than the budget allows, the least-recently used ones are thrown
+    away straight away, rather than waiting for the timer to notice that they've expired.
+
+    Images that are found to be in use while the cache is being purged are moved out of the
+    way onto a separate list of pinned images, so that later purges don't have to keep
+    stepping over them. They go back on the main list when they're used again, or when the
+    timer notices that they've been released.
+*/
 class ImageCache::Pimpl     : public Timer,
                               public DeletedAtShutdown
 {
 public:
     Pimpl()
-        : cacheTimeout (5000)
+        : cacheTimeout (5000),
+          numSlots (0), numItems (0),
+          mostRecent (nullptr), leastRecent (nullptr), firstPinned (nullptr),
+          memoryUsage (0), memoryBudget (defaultMemoryBudget),
+          hits (0), misses (0), evictions (0)
     {
+        resizeHashTable (64);
     }
 
     ~Pimpl()
     {
+        while (leastRecent != nullptr)
+            removeItem (leastRecent);
+
+        while (firstPinned != nullptr)
+            removeItem (firstPinned);
+
         clearSingletonInstance();
     }
 
     Image getFromHashCode (const int64 hashCode)
     {
         const ScopedLock sl (lock);
+        Item* const item = findItem (hashCode);
 
-        for (int i = images.size(); --i >= 0;)
+        if (item == nullptr)
         {
-            Item* const item = images.getUnchecked(i);
-
-            if (item->hashCode == hashCode)
-                return item->image;
+            ++misses;
+            return Image::null;
         }
 
-        return Image::null;
+        ++hits;
+        item->lastUseTime = Time::getApproximateMillisecondCounter();
+        moveToFront (item);
+        return item->image;
     }
 
     void addImageToCache (const Image& image, const int64 hashCode)
@@ -62,56 +86,273 @@ public:
             if (! isTimerRunning())
                 startTimer (2000);
 
-            Item* const item = new Item();
-            item->hashCode = hashCode;
+            const ScopedLock sl (lock);
+            Item* item = findItem (hashCode);
+
+            if (item != nullptr)
+            {
+                // (this replaces the previous image that was stored with this hash code)
+                memoryUsage -= item->memoryUsage;
+                moveToFront (item);
+            }
+            else
+            {
+                item = new Item (hashCode);
+                linkItem (item);
+
+                if (numItems > numSlots)
+                    resizeHashTable (numSlots * 2);
+            }
+
             item->image = image;
+            item->memoryUsage = getMemoryUsage (image);
             item->lastUseTime = Time::getApproximateMillisecondCounter();
+            memoryUsage += item->memoryUsage;
 
-            const ScopedLock sl (lock);
-            images.add (item);
+            purgeUntilWithinBudget (item);
         }
     }
 
+    void setMemoryBudget (const size_t maxBytes)
+    {
+        const ScopedLock sl (lock);
+        memoryBudget = maxBytes;
+        unpinReleasedItems (Time::getApproximateMillisecondCounter());
+        purgeUntilWithinBudget (nullptr);
+    }
+
+    Statistics getStatistics() const
+    {
+        const ScopedLock sl (lock);
+
+        Statistics s;
+        s.numHits      = hits;
+        s.numMisses    = misses;
+        s.numEvictions = evictions;
+        s.numImages    = numItems;
+        s.memoryUsage  = memoryUsage;
+        s.memoryBudget = memoryBudget;
+        return s;
+    }
+
     void timerCallback()
     {
         const uint32 now = Time::getApproximateMillisecondCounter();
 
         const ScopedLock sl (lock);
 
-        for (int i = images.size(); --i >= 0;)
+        for (Item* item = leastRecent; item != nullptr;)
         {
-            Item* const item = images.getUnchecked(i);
+            Item* const next = item->previous;
 
             if (item->image.getReferenceCount() <= 1)
             {
                 if (now > item->lastUseTime + cacheTimeout || now < item->lastUseTime - 1000)
-                    images.remove (i);
+                    removeItem (item);
             }
             else
             {
                 item->lastUseTime = now; // multiply-referenced, so this image is still in use.
             }
+
+            item = next;
         }
 
-        if (images.size() == 0)
+        unpinReleasedItems (now);
+        purgeUntilWithinBudget (nullptr);
+
+        if (numItems == 0)
             stopTimer();
     }
 
-    struct Item
+    static size_t getMemoryUsage (const Image& image) noexcept
     {
-        Image image;
-        int64 hashCode;
-        uint32 lastUseTime;
-    };
+        const Image::PixelFormat format = image.getFormat();
+        const size_t pixelStride = format == Image::RGB ? 3 : ((format == Image::ARGB) ? 4 : 1);
+
+        return (size_t) image.getWidth() * (size_t) image.getHeight() * pixelStride;
+    }
+
+    enum { defaultMemoryBudget = 32 * 1024 * 1024 };
 
     int cacheTimeout;
 
     juce_DeclareSingleton_SingleThreaded_Minimal (ImageCache::Pimpl);
 
 private:
-    OwnedArray<Item> images;
+    //==============================================================================
+    struct Item
+    {
+        Item (const int64 hashCode_) noexcept
+            : hashCode (hashCode_), memoryUsage (0), lastUseTime (0), isPinned (false),
+              nextInSlot (nullptr), previous (nullptr), next (nullptr)
+        {}
+
+        Image image;
+        const int64 hashCode;
+        size_t memoryUsage;
+        uint32 lastUseTime;
+        bool isPinned;    // if true, it's in the pinned list rather than the most-recently used one
+
+        Item* nextInSlot;
+        Item* previous;   // the next most-recently used item
+        Item* next;       // the next least-recently used item
+
+        JUCE_DECLARE_NON_COPYABLE (Item);
+    };
+
+    HeapBlock<Item*> slots;
+    int numSlots, numItems;
+    Item* mostRecent;
+    Item* leastRecent;
+    Item* firstPinned;
+    size_t memoryUsage, memoryBudget;
+    int64 hits, misses, evictions;
     CriticalSection lock;
 
+    static uint32 getSlotHash (const int64 hashCode) noexcept
+    {
+        const uint64 h = (uint64) hashCode * (uint64) literal64bit (0x9e3779b97f4a7c15);
+        return (uint32) (h >> 32);
+    }
+
+    Item* findItem (const int64 hashCode) const noexcept
+    {
+        for (Item* item = slots [getSlotHash (hashCode) & (uint32) (numSlots - 1)]; item != nullptr; item = item->nextInSlot)
+            if (item->hashCode == hashCode)
+                return item;
+
+        return nullptr;
+    }
+
+    void linkItem (Item* const item) noexcept
+    {
+        Item*& slot = slots [getSlotHash (item->hashCode) & (uint32) (numSlots - 1)];
+        item->nextInSlot = slot;
+        slot = item;
+
+        addToFront (item);
+        ++numItems;
+    }
+
+    void removeItem (Item* const item)
+    {
+        Item** i = &slots [getSlotHash (item->hashCode) & (uint32) (numSlots - 1)];
+
+        while (*i != item)
+            i = &((*i)->nextInSlot);
+
+        *i = item->nextInSlot;
+
+        unlink (item);
+        memoryUsage -= item->memoryUsage;
+        --numItems;
+        delete item;
+    }
+
+    void addToFront (Item* const item) noexcept
+    {
+        item->isPinned = false;
+        item->previous = nullptr;
+        item->next = mostRecent;
+
+        if (mostRecent != nullptr)
+            mostRecent->previous = item;
+        else
+            leastRecent = item;
+
+        mostRecent = item;
+    }
+
+    void unlink (Item* const item) noexcept
+    {
+        if (item->previous != nullptr)  item->previous->next = item->next;
+        else if (item->isPinned)        firstPinned = item->next;
+        else                            mostRecent = item->next;
+
+        if (item->next != nullptr)      item->next->previous = item->previous;
+        else if (! item->isPinned)      leastRecent = item->previous;
+    }
+
+    void moveToFront (Item* const item) noexcept
+    {
+        if (item != mostRecent)
+        {
+            unlink (item);
+            addToFront (item);
+        }
+    }
+
+    void pin (Item* const item) noexcept
+    {
+        unlink (item);
+        item->isPinned = true;
+        item->previous = nullptr;
+        item->next = firstPinned;
+
+        if (firstPinned != nullptr)
+            firstPinned->previous = item;
+
+        firstPinned = item;
+    }
+
+    void unpinReleasedItems (const uint32 now) noexcept
+    {
+        for (Item* item = firstPinned; item != nullptr;)
+        {
+            Item* const next = item->next;
+
+            if (item->image.getReferenceCount() <= 1)
+                moveToFront (item);
+
+            item->lastUseTime = now;
+            item = next;
+        }
+    }
+
+    void purgeUntilWithinBudget (const Item* const itemToKeep)
+    {
+        for (Item* item = leastRecent; item != nullptr && item != itemToKeep && memoryUsage > memoryBudget;)
+        {
+            Item* const next = item->previous;
+
+            // images that are still being used elsewhere can't be removed, so they're moved
+            // onto the pinned list, where they won't get in the way of later purges
+            if (item->image.getReferenceCount() <= 1)
+            {
+                removeItem (item);
+                ++evictions;
+            }
+            else
+            {
+                pin (item);
+            }
+
+            item = next;
+        }
+    }
+
+    void resizeHashTable (const int newNumSlots)
+    {
+        jassert (isPowerOfTwo (newNumSlots));
+
+        HeapBlock<Item*> newSlots;
+        newSlots.calloc ((size_t) newNumSlots);
+
+        for (int list = 0; list < 2; ++list)
+        {
+            for (Item* item = (list == 0 ? mostRecent : firstPinned); item != nullptr; item = item->next)
+            {
+                Item*& slot = newSlots [getSlotHash (item->hashCode) & (uint32) (newNumSlots - 1)];
+                item->nextInSlot = slot;
+                slot = item;
+            }
+        }
+
+        slots.swapWith (newSlots);
+        numSlots = newNumSlots;
+    }
+
     JUCE_DECLARE_NON_COPYABLE (Pimpl);
 };
 
@@ -165,5 +406,112 @@ void ImageCache::setCacheTimeout (const int millisecs)
     Pimpl::getInstance()->cacheTimeout = millisecs;
 }
 
+void ImageCache::setMemoryBudget (const size_t maxBytes)
+{
+    Pimpl::getInstance()->setMemoryBudget (maxBytes);
+}
+
+ImageCache::Statistics ImageCache::getStatistics()
+{
+    return Pimpl::getInstance()->getStatistics();
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class ImageCacheTests  : public UnitTest
+{
+public:
+    ImageCacheTests() : UnitTest ("ImageCache") {}
+
+    static int64 getTestHash (const int index) noexcept     { return literal64bit (0x7e57ca5e00000000) + index; }
+
+    void runTest()
+    {
+        beginTest ("Lookups");
+
+        ImageCache::setMemoryBudget (1024 * 1024);
+        const ImageCache::Statistics before (ImageCache::getStatistics());
+
+        for (int i = 0; i < 1000; ++i)
+            ImageCache::addImageToCache (Image (Image::SingleChannel, 8, 8, false, SoftwareImageType()), getTestHash (i));
+
+        bool allFound = true;
+
+        for (int i = 0; i < 1000; ++i)
+            allFound = ImageCache::getFromHashCode (getTestHash (i)).getWidth() == 8 && allFound;
+
+        expect (allFound);
+        expect (ImageCache::getFromHashCode (getTestHash (1000)).isNull());
+
+        ImageCache::Statistics after (ImageCache::getStatistics());
+        expectEquals ((int) (after.numHits - before.numHits), 1000);
+        expectEquals ((int) (after.numMisses - before.numMisses), 1);
+        expect (after.numImages >= 1000);
+
+        beginTest ("Memory budget");
+
+        const Image pinned (Image::ARGB, 100, 100, false, SoftwareImageType());
+        ImageCache::addImageToCache (pinned, getTestHash (2000));
+        ImageCache::setMemoryBudget (100 * 100 * 4 + 20 * 20 * 3);
+
+        for (int i = 0; i < 10; ++i)
+            ImageCache::addImageToCache (Image (Image::RGB, 20, 20, false, SoftwareImageType()), getTestHash (3000 + i));
+
+        after = ImageCache::getStatistics();
+        expect (after.memoryUsage <= after.memoryBudget);
+        expect (ImageCache::getFromHashCode (getTestHash (2000)) == pinned);
+        expect (ImageCache::getFromHashCode (getTestHash (3009)).isValid());
+        expect (ImageCache::getFromHashCode (getTestHash (3000)).isNull());
+        expect (ImageCache::getFromHashCode (getTestHash (0)).isNull());
+
+        // an image that's in use is kept even if it's bigger than the whole budget
+        ImageCache::setMemoryBudget (0);
+        expect (ImageCache::getFromHashCode (getTestHash (2000)) == pinned);
+        expect (ImageCache::getFromHashCode (getTestHash (3009)).isNull());
+
+        beginTest ("Images in use over the budget");
+
+        const int numInUse = 500;
+        Image inUse [numInUse];
+
+        for (int i = 0; i < numInUse; ++i)
+        {
+            inUse[i] = Image (Image::SingleChannel, 16, 16, false, SoftwareImageType());
+            ImageCache::addImageToCache (inUse[i], getTestHash (4000 + i));
+        }
+
+        const ImageCache::Statistics beforeAdds (ImageCache::getStatistics());
+
+        for (int i = 0; i < 1000; ++i)
+            ImageCache::addImageToCache (Image (Image::SingleChannel, 8, 8, false, SoftwareImageType()), getTestHash (5000 + i));
+
+        after = ImageCache::getStatistics();
+        expectEquals ((int) (after.numEvictions - beforeAdds.numEvictions), 999);
+        expectEquals (after.numImages, beforeAdds.numImages + 1);
+        expect (ImageCache::getFromHashCode (getTestHash (5999)).isValid());
+        expect (ImageCache::getFromHashCode (getTestHash (5998)).isNull());
+
+        bool allInUseFound = true;
+
+        for (int i = 0; i < numInUse; ++i)
+            allInUseFound = ImageCache::getFromHashCode (getTestHash (4000 + i)) == inUse[i] && allInUseFound;
+
+        expect (allInUseFound);
+
+        // once they've been released, they can be purged again
+        for (int i = 0; i < numInUse; ++i)
+            inUse[i] = Image::null;
+        ImageCache::setMemoryBudget (0);
+        expect (ImageCache::getFromHashCode (getTestHash (4000)).isNull());
+        expect (ImageCache::getFromHashCode (getTestHash (2000)) == pinned);
+
+        ImageCache::setMemoryBudget (32 * 1024 * 1024);
+    }
+};
+
+static ImageCacheTests imageCacheUnitTests;
+
+#endif
 
 END_JUCE_NAMESPACE
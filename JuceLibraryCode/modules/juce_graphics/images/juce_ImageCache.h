@@ -42,6 +42,10 @@
     loading/deleting the same image, it'll reduce the chances of having to reload it
     each time.
 
+    Images that aren't being used anywhere else are also thrown away, least-recently
+    used first, whenever the cache holds more than its memory budget - see
+    setMemoryBudget(). Images that are still in use are never removed.
+
     @see Image, ImageFileFormat
 */
 class JUCE_API  ImageCache
@@ -109,6 +113,33 @@ public:
     */
     static void setCacheTimeout (int millisecs);
 
+    /** Sets the maximum number of bytes of pixel data that the cache should hold.
+
+        An image's size is counted as its width x height x bytes per pixel. When the
+        cache goes over this budget, the least-recently used images that aren't being
+        used anywhere else are removed until it fits. The images that are in use stay
+        cached even if they take up more than the budget. By default this is 32MB.
+    */
+    static void setMemoryBudget (size_t maxBytes);
+
+    /** A snapshot of the cache's counters.
+        @see getStatistics
+    */
+    struct Statistics
+    {
+        Statistics() noexcept
+            : numHits (0), numMisses (0), numEvictions (0),
+              numImages (0), memoryUsage (0), memoryBudget (0)
+        {}
+
+        int64 numHits, numMisses, numEvictions;   // (evictions only counts images removed to stay within the budget)
+        int numImages;
+        size_t memoryUsage, memoryBudget;
+    };
+
+    /** Returns the cache's hit, miss and eviction counts, and how much memory it's using. */
+    static Statistics getStatistics();
+
 
 private:
     //==============================================================================
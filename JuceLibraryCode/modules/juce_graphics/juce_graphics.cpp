@@ -56,9 +56,22 @@
 #elif JUCE_LINUX
  #include <ft2build.h>
  #include FT_FREETYPE_H
+ #include FT_TRUETYPE_TABLES_H
+ #if JUCE_USE_HARFBUZZ
+  /* If you're missing these headers, try installing the libharfbuzz-dev package. */
+  #include <hb.h>
+  #include <hb-ft.h>
+  #include <hb-ot.h>
+ #endif
  #undef SIZEOF
 #endif
 
+//==============================================================================
+#if JUCE_INTEL && (JUCE_MSVC || defined (__SSE2__))
+ #define JUCE_USE_SSE2_INTRINSICS 1
+ #include <emmintrin.h>
+#endif
+
 //==============================================================================
 // START_AUTOINCLUDE colour/*.cpp, geometry/*.cpp, placement/*.cpp, contexts/*.cpp, images/*.cpp,
 // image_formats/*.cpp, fonts/*.cpp, effects/*.cpp
@@ -76,8 +89,10 @@
 #include "placement/juce_RectanglePlacement.cpp"
 #include "contexts/juce_GraphicsContext.cpp"
 #include "contexts/juce_LowLevelGraphicsPostScriptRenderer.cpp"
+#include "contexts/juce_LowLevelGraphicsRecorder.cpp"
 #include "contexts/juce_LowLevelGraphicsSoftwareRenderer.cpp"
 #include "images/juce_Image.cpp"
+#include "images/juce_ImageBlur.cpp"
 #include "images/juce_ImageCache.cpp"
 #include "images/juce_ImageConvolutionKernel.cpp"
 #include "images/juce_ImageFileFormat.cpp"
@@ -89,6 +104,7 @@
 #include "fonts/juce_Font.cpp"
 #include "fonts/juce_GlyphArrangement.cpp"
 #include "fonts/juce_TextLayout.cpp"
+#include "fonts/juce_TextLayoutCache.cpp"
 #include "fonts/juce_Typeface.cpp"
 #include "effects/juce_DropShadowEffect.cpp"
 #include "effects/juce_GlowEffect.cpp"
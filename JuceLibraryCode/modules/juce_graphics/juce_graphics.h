@@ -49,6 +49,30 @@
  #define JUCE_USE_DIRECTWRITE 1
 #endif
 
+/** Config: JUCE_USE_HARFBUZZ
+
+    On Linux, enabling this flag means that HarfBuzz will be used to shape text for
+    TextLayout, which adds support for ligatures and complex scripts. You'll need to
+    link to libharfbuzz if you enable it.
+
+    It's disabled by default, and then Linux has no native layout at all: TextLayout
+    places one glyph per character, one after another, so there are no ligatures or
+    right-to-left text.
+*/
+#ifndef JUCE_USE_HARFBUZZ
+ #define JUCE_USE_HARFBUZZ 0
+#endif
+
+/** Config: JUCE_USE_GLYPH_ALPHA_ATLAS
+
+    Enabling this flag makes the software renderer cache glyphs as 8-bit coverage masks
+    packed into shared atlas pages, rather than as edge tables. Drawing text then becomes
+    a simple masked blit, at the cost of positioning glyphs to the nearest quarter-pixel.
+*/
+#ifndef JUCE_USE_GLYPH_ALPHA_ATLAS
+ #define JUCE_USE_GLYPH_ALPHA_ATLAS 0
+#endif
+
 #ifndef JUCE_INCLUDE_PNGLIB_CODE
  #define JUCE_INCLUDE_PNGLIB_CODE 1
 #endif
@@ -126,12 +150,18 @@ BEGIN_JUCE_NAMESPACE
 #ifndef __JUCE_LOWLEVELGRAPHICSPOSTSCRIPTRENDERER_JUCEHEADER__
  #include "contexts/juce_LowLevelGraphicsPostScriptRenderer.h"
 #endif
+#ifndef __JUCE_LOWLEVELGRAPHICSRECORDER_JUCEHEADER__
+ #include "contexts/juce_LowLevelGraphicsRecorder.h"
+#endif
 #ifndef __JUCE_LOWLEVELGRAPHICSSOFTWARERENDERER_JUCEHEADER__
  #include "contexts/juce_LowLevelGraphicsSoftwareRenderer.h"
 #endif
 #ifndef __JUCE_IMAGE_JUCEHEADER__
  #include "images/juce_Image.h"
 #endif
+#ifndef __JUCE_IMAGEBLUR_JUCEHEADER__
+ #include "images/juce_ImageBlur.h"
+#endif
 #ifndef __JUCE_IMAGECACHE_JUCEHEADER__
  #include "images/juce_ImageCache.h"
 #endif
@@ -159,6 +189,9 @@ BEGIN_JUCE_NAMESPACE
 #ifndef __JUCE_TYPEFACE_JUCEHEADER__
  #include "fonts/juce_Typeface.h"
 #endif
+#ifndef __JUCE_TEXTLAYOUTCACHE_JUCEHEADER__
+ #include "fonts/juce_TextLayoutCache.h"
+#endif
 #ifndef __JUCE_DROPSHADOWEFFECT_JUCEHEADER__
  #include "effects/juce_DropShadowEffect.h"
 #endif
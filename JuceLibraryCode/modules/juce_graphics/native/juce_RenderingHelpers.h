@@ -135,18 +135,64 @@ private:
 };
 
 //==============================================================================
+/** A snapshot of the counters kept by a GlyphCache. */
+struct GlyphCacheStatistics
+{
+    GlyphCacheStatistics() noexcept
+        : numHits (0), numMisses (0), numEvictions (0),
+          numGlyphs (0), memoryUsage (0), memoryBudget (0)
+    {}
+
+    int64 numHits, numMisses, numEvictions;
+    int numGlyphs;
+    size_t memoryUsage, memoryBudget;
+};
+
+//==============================================================================
+/** Caches pre-rendered glyphs, keyed by typeface, size, glyph number and sub-pixel
+    position.
+
+    Lookups go through a hash table, and the least-recently used glyphs are thrown
+    away whenever the total size of the cached glyphs goes over the memory budget.
+
+    The CachedGlyphType class must provide:
+    @code
+    enum { numSubPixelPositions = n };  // how many horizontal variants to keep per glyph
+    void generate (const Font&, int glyphNumber, float subPixelOffset);
+    void draw (RenderTargetType&, float x, float y) const;
+    size_t getMemoryUsage() const noexcept;
+    static size_t getSharedMemoryUsage();           // memory that several glyphs use, e.g. an atlas
+    static void setSharedMemoryLimit (size_t maxBytes);
+    @endcode
+
+    Shared memory counts towards the budget too, but it can only be freed by throwing
+    away the glyphs that use it, so the glyph type mustn't let it grow beyond the limit.
+
+    When a glyph has several sub-pixel variants, the x position passed to draw() is
+    rounded to the nearest one, so may be up to half a step away from its offset.
+
+    The cache can be used by several threads at once. drawGlyph() only holds the cache's
+    lock while it looks up or adds a glyph: a new glyph is created, and every glyph is
+    drawn, without it. So the CachedGlyphType's generate() may be called on several
+    threads at once, and must lock anything that its glyphs share.
+*/
 template <class CachedGlyphType, class RenderTargetType>
 class GlyphCache  : private DeletedAtShutdown
 {
 public:
     GlyphCache()
-        : accessCounter (0), hits (0), misses (0)
+        : numSlots (0), numEntries (0),
+          mostRecent (nullptr), leastRecent (nullptr),
+          memoryUsage (0), memoryBudget (defaultMemoryBudget),
+          hits (0), misses (0), evictions (0)
     {
-        addNewGlyphSlots (120);
+        resizeHashTable (256);
+        CachedGlyphType::setSharedMemoryLimit (memoryBudget);
     }
 
     ~GlyphCache()
     {
+        clear();
         getSingletonPointer() = nullptr;
     }
 
@@ -163,53 +209,336 @@ public:
     //==============================================================================
     void drawGlyph (RenderTargetType& target, const Font& font, const int glyphNumber, float x, float y)
     {
-        ++accessCounter;
-        int oldestCounter = std::numeric_limits<int>::max();
-        CachedGlyphType* oldest = nullptr;
+        const GlyphKey key (font, glyphNumber, x);
+        typename Entry::Ptr entry;
+        bool needsGenerating = false;
 
-        for (int i = glyphs.size(); --i >= 0;)
         {
-            CachedGlyphType* const glyph = glyphs.getUnchecked (i);
+            const ScopedLock sl (lock);
+            entry = findEntry (key);
 
-            if (glyph->glyph == glyphNumber && glyph->font == font)
+            if (entry != nullptr)
             {
                 ++hits;
-                glyph->lastAccessCount = accessCounter;
-                glyph->draw (target, x, y);
-                return;
+                moveToFront (entry);
             }
-
-            if (glyph->lastAccessCount <= oldestCounter)
+            else
             {
-                oldestCounter = glyph->lastAccessCount;
-                oldest = glyph;
+                ++misses;
+                entry = takeEntryForRecycling();
+                needsGenerating = true;
             }
         }
 
-        if (hits + ++misses > (glyphs.size() << 4))
+        if (needsGenerating)
         {
-            if (misses * 2 > hits)
-                addNewGlyphSlots (32);
+            // The glyph is rendered without holding the lock, so other threads can carry on
+            // drawing while it's being made. The entries are reference-counted, so one that's
+            // purged while someone is still drawing it just gets deleted when they've finished.
+            if (entry == nullptr)
+                entry = new Entry();
+
+            entry->glyph.generate (font, key.glyph, key.getSubPixelOffset());
+            entry->key = key;
+            entry->memoryUsage = sizeof (Entry) + entry->glyph.getMemoryUsage();
 
-            hits = misses = 0;
-            oldest = glyphs.getLast();
+            const ScopedLock sl (lock);
+            Entry* const existing = findEntry (key);
+
+            if (existing != nullptr)
+            {
+                entry = existing;   // another thread got there first
+                moveToFront (entry);
+            }
+            else
+            {
+                addEntry (entry);
+            }
         }
 
-        jassert (oldest != nullptr);
-        oldest->lastAccessCount = accessCounter;
-        oldest->generate (font, glyphNumber);
-        oldest->draw (target, x, y);
+        entry->glyph.draw (target, x, y);
+    }
+
+    //==============================================================================
+    /** Changes the maximum number of bytes that the cached glyphs may use.
+        If the cache is already bigger than this, the oldest glyphs are purged.
+    */
+    void setMemoryBudget (const size_t maxBytes)
+    {
+        const ScopedLock sl (lock);
+        memoryBudget = maxBytes;
+        CachedGlyphType::setSharedMemoryLimit (maxBytes);
+        purgeUntilWithinBudget (nullptr);
+    }
+
+    size_t getMemoryBudget() const noexcept         { return memoryBudget; }
+
+    /** Deletes all the cached glyphs. */
+    void clear()
+    {
+        const ScopedLock sl (lock);
+
+        while (leastRecent != nullptr)
+            deleteEntry (leastRecent);
+
+        jassert (numEntries == 0 && memoryUsage == 0);
+    }
+
+    GlyphCacheStatistics getStatistics() const noexcept
+    {
+        const ScopedLock sl (lock);
+
+        GlyphCacheStatistics s;
+        s.numHits      = hits;
+        s.numMisses    = misses;
+        s.numEvictions = evictions;
+        s.numGlyphs    = numEntries;
+        s.memoryUsage  = getTotalMemoryUsage();
+        s.memoryBudget = memoryBudget;
+        return s;
     }
 
+    void resetStatistics() noexcept
+    {
+        const ScopedLock sl (lock);
+        hits = misses = evictions = 0;
+    }
+
+    enum { defaultMemoryBudget = 2 * 1024 * 1024 };
+
 private:
-    friend class OwnedArray <CachedGlyphType>;
-    OwnedArray <CachedGlyphType> glyphs;
-    int accessCounter, hits, misses;
+    //==============================================================================
+    struct GlyphKey
+    {
+        GlyphKey() noexcept
+            : typeface (nullptr), height (0), horizontalScale (0), glyph (0), subPixelIndex (0)
+        {}
+
+        GlyphKey (const Font& font, const int glyphNumber, const float x)
+            : typeface (font.getTypeface()),
+              height (font.getHeight()),
+              horizontalScale (font.getHorizontalScale()),
+              glyph (glyphNumber),
+              subPixelIndex (typeface->isHinted() ? 0 : getSubPixelIndex (x))
+        {}
+
+        bool operator== (const GlyphKey& other) const noexcept
+        {
+            return glyph == other.glyph
+                    && typeface == other.typeface
+                    && height == other.height
+                    && horizontalScale == other.horizontalScale
+                    && subPixelIndex == other.subPixelIndex;
+        }
+
+        uint32 getHash() const noexcept
+        {
+            uint32 h = (uint32) (pointer_sized_uint) typeface;
+            h = h * 31 + floatBits (height);
+            h = h * 31 + floatBits (horizontalScale);
+            h = h * 31 + (uint32) glyph;
+            h = h * 31 + (uint32) subPixelIndex;
+            return h ^ (h >> 15);
+        }
+
+        float getSubPixelOffset() const noexcept
+        {
+            return subPixelIndex / (float) CachedGlyphType::numSubPixelPositions;
+        }
 
-    void addNewGlyphSlots (int num)
+        // The entry's copy of the Font keeps this typeface alive, so the pointer can't
+        // be recycled while the key is still in the table.
+        Typeface* typeface;
+        float height, horizontalScale;
+        int glyph, subPixelIndex;
+
+    private:
+        // Rounds x to the nearest sub-pixel step, so the glyph is never more than half
+        // a step away from where it was asked to go.
+        static int getSubPixelIndex (const float x) noexcept
+        {
+            const int numPositions = CachedGlyphType::numSubPixelPositions;
+
+            if (numPositions <= 1)
+                return 0;
+
+            const int step = (int) std::floor (x * numPositions + 0.5f) % numPositions;
+            return step < 0 ? step + numPositions : step;
+        }
+
+        static uint32 floatBits (const float f) noexcept
+        {
+            union { float asFloat; uint32 asInt; } u;
+            u.asFloat = f;
+            return u.asInt;
+        }
+    };
+
+    // While an entry is in the table, the table holds one reference to it.
+    struct Entry  : public ReferenceCountedObject
     {
-        while (--num >= 0)
-            glyphs.add (new CachedGlyphType());
+        Entry() noexcept
+            : hash (0), memoryUsage (0), nextInSlot (nullptr), previous (nullptr), next (nullptr)
+        {}
+
+        typedef ReferenceCountedObjectPtr<Entry> Ptr;
+
+        CachedGlyphType glyph;
+        GlyphKey key;
+        uint32 hash;
+        size_t memoryUsage;
+        Entry* nextInSlot;
+        Entry* previous;  // towards the most recently used end of the list
+        Entry* next;      // towards the least recently used end of the list
+
+        JUCE_DECLARE_NON_COPYABLE (Entry);
+    };
+
+    HeapBlock<Entry*> slots;
+    int numSlots, numEntries;
+    Entry* mostRecent;
+    Entry* leastRecent;
+    size_t memoryUsage, memoryBudget;
+    int64 hits, misses, evictions;
+    CriticalSection lock;
+
+    //==============================================================================
+    size_t getTotalMemoryUsage() const
+    {
+        return memoryUsage + CachedGlyphType::getSharedMemoryUsage();
+    }
+
+    Entry* findEntry (const GlyphKey& key) const noexcept
+    {
+        const uint32 hash = key.getHash();
+
+        for (Entry* e = slots [hash & (uint32) (numSlots - 1)]; e != nullptr; e = e->nextInSlot)
+            if (e->hash == hash && e->key == key)
+                return e;
+
+        return nullptr;
+    }
+
+    // If the cache is full, this removes the oldest glyph so that it can be re-used rather
+    // than allocating a new one - unless another thread is still drawing it.
+    typename Entry::Ptr takeEntryForRecycling()
+    {
+        typename Entry::Ptr entry (leastRecent);
+
+        if (entry == nullptr || entry->getReferenceCount() > 2 || getTotalMemoryUsage() < memoryBudget)
+            return nullptr;
+
+        unlinkEntry (entry);
+        ++evictions;
+        return entry;
+    }
+
+    void addEntry (Entry* const entry)
+    {
+        entry->hash = entry->key.getHash();
+        linkEntry (entry);
+
+        if (numEntries > numSlots * 2)
+            resizeHashTable (numSlots * 2);
+
+        purgeUntilWithinBudget (entry);
+    }
+
+    void linkEntry (Entry* const entry) noexcept
+    {
+        entry->incReferenceCount();
+
+        Entry*& slot = slots [entry->hash & (uint32) (numSlots - 1)];
+        entry->nextInSlot = slot;
+        slot = entry;
+
+        entry->previous = nullptr;
+        entry->next = mostRecent;
+
+        if (mostRecent != nullptr)
+            mostRecent->previous = entry;
+        else
+            leastRecent = entry;
+
+        mostRecent = entry;
+        memoryUsage += entry->memoryUsage;
+        ++numEntries;
+    }
+
+    void unlinkEntry (Entry* const entry) noexcept
+    {
+        Entry** e = &slots [entry->hash & (uint32) (numSlots - 1)];
+
+        while (*e != entry)
+        {
+            jassert (*e != nullptr);
+            e = &((*e)->nextInSlot);
+        }
+
+        *e = entry->nextInSlot;
+        entry->nextInSlot = nullptr;
+
+        removeFromList (entry);
+        memoryUsage -= entry->memoryUsage;
+        --numEntries;
+        entry->decReferenceCount();
+    }
+
+    void deleteEntry (Entry* const entry)
+    {
+        unlinkEntry (entry);    // (the entry will be deleted here unless it's still being drawn)
+    }
+
+    void removeFromList (Entry* const entry) noexcept
+    {
+        if (entry->previous != nullptr)  entry->previous->next = entry->next;
+        else                             mostRecent = entry->next;
+
+        if (entry->next != nullptr)      entry->next->previous = entry->previous;
+        else                             leastRecent = entry->previous;
+
+        entry->previous = entry->next = nullptr;
+    }
+
+    void moveToFront (Entry* const entry) noexcept
+    {
+        if (entry != mostRecent)
+        {
+            removeFromList (entry);
+
+            entry->next = mostRecent;
+            mostRecent->previous = entry;
+            mostRecent = entry;
+        }
+    }
+
+    void purgeUntilWithinBudget (Entry* const entryToKeep)
+    {
+        while (leastRecent != nullptr
+                && leastRecent != entryToKeep
+                && getTotalMemoryUsage() > memoryBudget)
+        {
+            deleteEntry (leastRecent);
+            ++evictions;
+        }
+    }
+
+    void resizeHashTable (const int newNumSlots)
+    {
+        jassert (isPowerOfTwo (newNumSlots));
+
+        HeapBlock<Entry*> newSlots;
+        newSlots.calloc ((size_t) newNumSlots);
+
+        for (Entry* e = mostRecent; e != nullptr; e = e->next)
+        {
+            Entry*& slot = newSlots [e->hash & (uint32) (newNumSlots - 1)];
+            e->nextInSlot = slot;
+            slot = e;
+        }
+
+        slots.swapWith (newSlots);
+        numSlots = newNumSlots;
     }
 
     static GlyphCache*& getSingletonPointer() noexcept
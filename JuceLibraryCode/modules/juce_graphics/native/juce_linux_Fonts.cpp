@@ -42,29 +42,341 @@ struct FTLibWrapper     : public ReferenceCountedObject
 
     FT_Library library;
 
+    /** FreeType needs calls that create or destroy faces in a library to be serialised. */
+    CriticalSection lock;
+
     typedef ReferenceCountedObjectPtr <FTLibWrapper> Ptr;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FTLibWrapper);
 };
 
+//==============================================================================
+/** A lookup table of the kerning pairs in a face's 'kern' table.
+
+    This is built once per face, so that loading a glyph's kerning doesn't need to
+    test the glyph against every other character in the charmap.
+*/
+class FTKerningIndex
+{
+public:
+    FTKerningIndex (FT_Face face)
+        : hasKerningTable (false)
+    {
+        if (FT_IS_SFNT (face))
+        {
+            FT_ULong length = 0;
+
+            if (FT_Load_Sfnt_Table (face, FT_MAKE_TAG ('k', 'e', 'r', 'n'), 0, nullptr, &length) == 0 && length > 4)
+            {
+                MemoryBlock table ((size_t) length);
+
+                if (FT_Load_Sfnt_Table (face, FT_MAKE_TAG ('k', 'e', 'r', 'n'), 0,
+                                        static_cast <FT_Byte*> (table.getData()), &length) == 0)
+                    hasKerningTable = parseKerningTable (static_cast <const uint8*> (table.getData()), (int) length);
+            }
+        }
+
+        if (hasKerningTable)
+            addCharacters (face);
+    }
+
+    /** False if the face has no kerning table that could be read, in which case the
+        caller will need to ask FreeType for each pair instead.
+    */
+    bool isValid() const noexcept       { return hasKerningTable; }
+
+    /** Calls callback.addKerningPair (rightCharacter, amount) for every character that has a
+        non-zero kerning value after the given glyph. Amounts are in font units.
+    */
+    template <class Callback>
+    void findKerningPairs (const uint32 leftGlyph, Callback& callback) const
+    {
+        for (int i = findFirstPair (leftGlyph); i < pairs.size(); ++i)
+        {
+            const KerningPair& pair = pairs.getReference (i);
+
+            if (pair.leftGlyph != leftGlyph)
+                break;
+
+            for (int j = findFirstCharacter (pair.rightGlyph); j < characters.size(); ++j)
+            {
+                const GlyphCharacter& gc = characters.getReference (j);
+
+                if (gc.glyph != pair.rightGlyph)
+                    break;
+
+                callback.addKerningPair (gc.character, pair.amount);
+            }
+        }
+    }
+
+private:
+    struct KerningPair
+    {
+        uint32 leftGlyph, rightGlyph;
+        int amount;
+        int subtable;   // the index of the subtable this came from, which only matters while they're being merged
+    };
+
+    struct GlyphCharacter
+    {
+        uint32 glyph;
+        juce_wchar character;
+    };
+
+    struct KerningPairComparator
+    {
+        static int compareElements (const KerningPair& first, const KerningPair& second) noexcept
+        {
+            if (first.leftGlyph != second.leftGlyph)
+                return first.leftGlyph < second.leftGlyph ? -1 : 1;
+
+            if (first.rightGlyph != second.rightGlyph)
+                return first.rightGlyph < second.rightGlyph ? -1 : 1;
+
+            return first.subtable - second.subtable;
+        }
+    };
+
+    struct GlyphCharacterComparator
+    {
+        static int compareElements (const GlyphCharacter& first, const GlyphCharacter& second) noexcept
+        {
+            return first.glyph < second.glyph ? -1 : (first.glyph > second.glyph ? 1 : 0);
+        }
+    };
+
+    Array<KerningPair> pairs;
+    Array<bool> subtableOverridesPrevious;
+    Array<GlyphCharacter> characters;
+    bool hasKerningTable;
+
+    static uint16 readShort (const uint8* const data) noexcept     { return ByteOrder::bigEndianShort (data); }
+
+    bool parseKerningTable (const uint8* const data, const int length)
+    {
+        // Both the Microsoft (version 0) and Apple (version 1) layouts are handled here.
+        const bool isAppleFormat = readShort (data) == 1;
+        const int headerSize = isAppleFormat ? 8 : 4;
+
+        if (length < headerSize)
+            return false;
+
+        const int numTables = isAppleFormat ? (int) ByteOrder::bigEndianInt (data + 4) : (int) readShort (data + 2);
+        int offset = headerSize;
+
+        for (int table = 0; table < numTables; ++table)
+        {
+            const int subtableHeaderSize = isAppleFormat ? 8 : 6;
+
+            if (offset + subtableHeaderSize + 8 > length)
+                break;
+
+            const uint8* const subtable = data + offset;
+            const int subtableLength = isAppleFormat ? (int) ByteOrder::bigEndianInt (subtable) : (int) readShort (subtable + 2);
+            const uint16 coverage = readShort (subtable + 4);
+
+            const int format = isAppleFormat ? (coverage & 0xff) : (coverage >> 8);
+            const bool isHorizontal = isAppleFormat ? (coverage & 0xe000) == 0
+                                                    : (coverage & 0x05) == 0x01;
+            const bool overridesPrevious = ! isAppleFormat && (coverage & 0x08) != 0;
+
+            if (format == 0 && isHorizontal)
+            {
+                const uint8* const formatData = subtable + subtableHeaderSize;
+                const int numPairs = jmin ((int) readShort (formatData),
+                                           (length - (offset + subtableHeaderSize + 8)) / 6);
+
+                addPairs (formatData + 8, numPairs, overridesPrevious);
+            }
+
+            if (subtableLength <= 0)
+                break;
+
+            offset += subtableLength;
+        }
+
+        mergePairs();
+        return true;
+    }
+
+    void addPairs (const uint8* pairData, const int numPairs, const bool overridesPrevious)
+    {
+        const int subtable = subtableOverridesPrevious.size();
+        subtableOverridesPrevious.add (overridesPrevious);
+
+        pairs.ensureStorageAllocated (pairs.size() + numPairs);
+
+        for (int i = 0; i < numPairs; ++i)
+        {
+            KerningPair pair;
+            pair.leftGlyph  = readShort (pairData);
+            pair.rightGlyph = readShort (pairData + 2);
+            pair.amount     = (int) (int16) readShort (pairData + 4);
+            pair.subtable   = subtable;
+            pairs.add (pair);
+            pairData += 6;
+        }
+    }
+
+    // Sorts the pairs from all the subtables together, and then merges each run of duplicates
+    // into the first one, in subtable order. Later subtables either add to or replace the
+    // values of any earlier ones.
+    void mergePairs()
+    {
+        KerningPairComparator comparator;
+        pairs.sort (comparator);
+
+        int numKept = 0;
+
+        for (int i = 0; i < pairs.size(); ++i)
+        {
+            const KerningPair& pair = pairs.getReference (i);
+
+            if (numKept > 0)
+            {
+                KerningPair& previous = pairs.getReference (numKept - 1);
+
+                if (previous.leftGlyph == pair.leftGlyph && previous.rightGlyph == pair.rightGlyph)
+                {
+                    previous.amount = subtableOverridesPrevious [pair.subtable] ? pair.amount
+                                                                                : previous.amount + pair.amount;
+                    continue;
+                }
+            }
+
+            pairs.getReference (numKept++) = pair;
+        }
+
+        pairs.removeRange (numKept, pairs.size() - numKept);
+        pairs.minimiseStorageOverheads();
+        subtableOverridesPrevious.clear();
+    }
+
+    void addCharacters (FT_Face face)
+    {
+        FT_UInt glyph = 0;
+        FT_ULong character = FT_Get_First_Char (face, &glyph);
+
+        while (glyph != 0)
+        {
+            GlyphCharacter gc;
+            gc.glyph = (uint32) glyph;
+            gc.character = (juce_wchar) character;
+            characters.add (gc);
+
+            character = FT_Get_Next_Char (face, character, &glyph);
+        }
+
+        GlyphCharacterComparator comparator;
+        characters.sort (comparator, true);
+    }
+
+    int findFirstPair (const uint32 leftGlyph) const noexcept
+    {
+        int start = 0, end = pairs.size();
+
+        while (start < end)
+        {
+            const int mid = (start + end) / 2;
+
+            if (pairs.getReference (mid).leftGlyph < leftGlyph)
+                start = mid + 1;
+            else
+                end = mid;
+        }
+
+        return start;
+    }
+
+    int findFirstCharacter (const uint32 glyph) const noexcept
+    {
+        int start = 0, end = characters.size();
+
+        while (start < end)
+        {
+            const int mid = (start + end) / 2;
+
+            if (characters.getReference (mid).glyph < glyph)
+                start = mid + 1;
+            else
+                end = mid;
+        }
+
+        return start;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (FTKerningIndex);
+};
+
 //==============================================================================
 struct FTFaceWrapper     : public ReferenceCountedObject
 {
     FTFaceWrapper (const FTLibWrapper::Ptr& ftLib, const File& file, int faceIndex)
         : face (0), library (ftLib)
+         #if JUCE_USE_HARFBUZZ
+          , hbFont (nullptr)
+         #endif
     {
+        const ScopedLock sl (ftLib->lock);
+
         if (FT_New_Face (ftLib->library, file.getFullPathName().toUTF8(), faceIndex, &face) != 0)
             face = 0;
     }
 
     ~FTFaceWrapper()
     {
+       #if JUCE_USE_HARFBUZZ
+        if (hbFont != nullptr)
+            hb_font_destroy (hbFont);
+       #endif
+
         if (face != 0)
+        {
+            const ScopedLock sl (library->lock);
             FT_Done_Face (face);
+        }
+    }
+
+    /** Returns the kerning pairs for this face, reading them the first time it's called. */
+    const FTKerningIndex& getKerningIndex()
+    {
+        if (kerningIndex == nullptr)
+            kerningIndex = new FTKerningIndex (face);
+
+        return *kerningIndex;
+    }
+
+   #if JUCE_USE_HARFBUZZ
+    /** Returns a HarfBuzz font for this face, scaled so that positions are in font units. */
+    hb_font_t* getHarfBuzzFont()
+    {
+        if (hbFont == nullptr && face != 0)
+        {
+            hb_face_t* const hbFace = hb_ft_face_create_referenced (face);
+            hbFont = hb_font_create (hbFace);
+            hb_face_destroy (hbFace);
+
+            hb_ot_font_set_funcs (hbFont);
+            hb_font_set_scale (hbFont, face->units_per_EM, face->units_per_EM);
+        }
+
+        return hbFont;
     }
+   #endif
 
     FT_Face face;
     FTLibWrapper::Ptr library;
+    ScopedPointer<FTKerningIndex> kerningIndex;
+
+    /** An FT_Face can only be used by one thread at a time, so this must be held while
+        loading glyphs or shaping text with it.
+    */
+    CriticalSection lock;
+
+   #if JUCE_USE_HARFBUZZ
+    hb_font_t* hbFont;
+   #endif
 
     typedef ReferenceCountedObjectPtr <FTFaceWrapper> Ptr;
 
@@ -72,12 +384,139 @@ struct FTFaceWrapper     : public ReferenceCountedObject
 };
 
 //==============================================================================
-class LinuxFontFileIterator
+/** A record of the faces in all the font files that live in the font directories.
+
+    Finding out what's in a font file means opening it with FreeType, which can take
+    several seconds when there are lots of fonts installed, so the results are kept in
+    a cache file between runs. Each directory is stored with its modification time and
+    contents, and each font file with its size and modification time, so that only the
+    directories and files that have changed since the catalogue was saved get rescanned.
+    The files that do need opening are shared out between a pool of threads.
+*/
+class FTFontCatalogue
 {
 public:
-    LinuxFontFileIterator()
-        : index (0)
+    FTFontCatalogue (const File& cacheFile_)
+        : cacheFile (cacheFile_), needsSaving (false)
+    {
+        if (! load())
+        {
+            directories.clear();
+            files.clear();
+        }
+    }
+
+    //==============================================================================
+    struct Face
+    {
+        String family;
+        int faceIndex;
+        bool isBold, isItalic, isMonospaced, isSansSerif;
+    };
+
+    struct FontFile
+    {
+        File file;
+        int64 size, modificationTime;
+        OwnedArray<Face> faces;
+    };
+
+    //==============================================================================
+    /** Finds the font files in these directories and their sub-directories, and opens
+        any that aren't already up-to-date in the catalogue.
+
+        Afterwards, the catalogue only contains the files that were found, in the order
+        that they were found.
+    */
+    void scan (const StringArray& fontDirs, const FTLibWrapper::Ptr& library)
+    {
+        OwnedArray<DirectoryInfo> oldDirectories;
+        OwnedArray<FontFile> oldFiles;
+        oldDirectories.swapWithArray (directories);
+        oldFiles.swapWithArray (files);
+
+        HashMap<String, DirectoryInfo*> oldDirectoryMap (oldDirectories.size() + 1);
+        HashMap<String, FontFile*> oldFileMap (oldFiles.size() + 1);
+
+        for (int i = 0; i < oldDirectories.size(); ++i)
+            oldDirectoryMap.set (oldDirectories.getUnchecked(i)->path, oldDirectories.getUnchecked(i));
+
+        for (int i = 0; i < oldFiles.size(); ++i)
+            oldFileMap.set (oldFiles.getUnchecked(i)->file.getFullPathName(), oldFiles.getUnchecked(i));
+
+        StringArray directoriesScanned;
+        Array<FontFile*> filesToScan;
+
+        for (int i = 0; i < fontDirs.size(); ++i)
+            scanDirectory (File (fontDirs[i]), oldDirectoryMap, oldFileMap, directoriesScanned, filesToScan);
+
+        scanFontFiles (filesToScan, library);
+
+        if (directories.size() != oldDirectories.size() || files.size() != oldFiles.size())
+            needsSaving = true;
+    }
+
+    int getNumFiles() const noexcept                        { return files.size(); }
+    const FontFile& getFile (const int index) const noexcept { return *files.getUnchecked (index); }
+
+    /** Writes the catalogue back to its cache file if the last scan changed anything. */
+    void saveIfNeeded()
     {
+        if (needsSaving && cacheFile != File::nonexistent)
+        {
+            needsSaving = false;
+
+            MemoryOutputStream out;
+            out.writeInt (catalogueMagicNumber);
+            out.writeInt (directories.size());
+
+            for (int i = 0; i < directories.size(); ++i)
+            {
+                const DirectoryInfo& d = *directories.getUnchecked(i);
+                out.writeString (d.path);
+                out.writeInt64 (d.modificationTime);
+                writeStringArray (out, d.fontFileNames);
+                writeStringArray (out, d.subDirectoryNames);
+            }
+
+            out.writeInt (files.size());
+
+            for (int i = 0; i < files.size(); ++i)
+            {
+                const FontFile& f = *files.getUnchecked(i);
+                out.writeString (f.file.getFullPathName());
+                out.writeInt64 (f.size);
+                out.writeInt64 (f.modificationTime);
+                out.writeInt (f.faces.size());
+
+                for (int j = 0; j < f.faces.size(); ++j)
+                {
+                    const Face& face = *f.faces.getUnchecked (j);
+                    out.writeString (face.family);
+                    out.writeInt (face.faceIndex);
+                    out.writeByte ((char) ((face.isBold ? 1 : 0) | (face.isItalic ? 2 : 0)
+                                             | (face.isMonospaced ? 4 : 0) | (face.isSansSerif ? 8 : 0)));
+                }
+            }
+
+            // repeating the magic number at the end means a truncated file won't be loaded
+            out.writeInt (catalogueMagicNumber);
+
+            cacheFile.getParentDirectory().createDirectory();
+            const TemporaryFile temp (cacheFile);
+
+            if (temp.getFile().replaceWithData (out.getData(), out.getDataSize()))
+                temp.overwriteTargetFileWithTemporary();
+        }
+    }
+
+    //==============================================================================
+    /** Returns the directories listed in the JUCE_FONT_PATH environment variable or,
+        failing that, in /etc/fonts/fonts.conf.
+    */
+    static StringArray getFontDirectories()
+    {
+        StringArray fontDirs;
         fontDirs.addTokens (CharPointer_UTF8 (getenv ("JUCE_FONT_PATH")), ";,", String::empty);
         fontDirs.removeEmptyStrings (true);
 
@@ -98,32 +537,327 @@ public:
             fontDirs.add ("/usr/X11R6/lib/X11/fonts");
 
         fontDirs.removeEmptyStrings (true);
+        return fontDirs;
+    }
+
+    /** Returns the file that the catalogue is kept in, which is in $XDG_CACHE_HOME, or
+        ~/.cache if that's not set.
+    */
+    static File getDefaultCacheFile()
+    {
+        const String cacheDir (CharPointer_UTF8 (getenv ("XDG_CACHE_HOME")));
+
+        return (cacheDir.isNotEmpty() ? File (cacheDir) : File ("~/.cache"))
+                  .getChildFile ("juce").getChildFile ("FontCatalogue.bin");
     }
 
-    bool next()
+    /** Opens a font file with FreeType and reads the details of its scalable faces. */
+    static void scanFontFile (const FTLibWrapper::Ptr& library, FontFile& fontFile)
     {
-        if (iter != nullptr)
+        fontFile.faces.clear();
+
+        int faceIndex = 0;
+        int numFaces = 0;
+
+        do
         {
-            while (iter->next())
-                if (getFile().hasFileExtension ("ttf;pfb;pcf"))
-                    return true;
+            FTFaceWrapper face (library, fontFile.file, faceIndex);
+
+            if (face.face != 0)
+            {
+                if (faceIndex == 0)
+                    numFaces = face.face->num_faces;
+
+                if ((face.face->face_flags & FT_FACE_FLAG_SCALABLE) != 0)
+                {
+                    Face* const f = new Face();
+                    fontFile.faces.add (f);
+
+                    // (FreeType leaves the family name null if the font doesn't have one)
+                    f->family       = face.face->family_name != nullptr ? String (face.face->family_name)
+                                                                        : fontFile.file.getFileNameWithoutExtension();
+                    f->faceIndex    = faceIndex;
+                    f->isBold       = (face.face->style_flags & FT_STYLE_FLAG_BOLD) != 0;
+                    f->isItalic     = (face.face->style_flags & FT_STYLE_FLAG_ITALIC) != 0;
+                    f->isMonospaced = (face.face->face_flags & FT_FACE_FLAG_FIXED_WIDTH) != 0;
+                    f->isSansSerif  = isFaceSansSerif (f->family);
+                }
+            }
+
+            ++faceIndex;
+        }
+        while (faceIndex < numFaces);
+    }
+
+private:
+    //==============================================================================
+    struct DirectoryInfo
+    {
+        String path;
+        int64 modificationTime;
+        StringArray fontFileNames, subDirectoryNames;
+    };
+
+    File cacheFile;
+    OwnedArray<DirectoryInfo> directories;
+    OwnedArray<FontFile> files;
+    bool needsSaving;
+
+    enum { catalogueMagicNumber = 0x3143464a /* "JFC1" */ };
+
+    //==============================================================================
+    void scanDirectory (const File& dir,
+                        const HashMap<String, DirectoryInfo*>& oldDirectoryMap,
+                        const HashMap<String, FontFile*>& oldFileMap,
+                        StringArray& directoriesScanned,
+                        Array<FontFile*>& filesToScan)
+    {
+        const String path (dir.getFullPathName());
+
+        if (directoriesScanned.contains (path) || ! dir.isDirectory())
+            return;
+
+        directoriesScanned.add (path);
+
+        DirectoryInfo* const info = new DirectoryInfo();
+        info->path = path;
+        info->modificationTime = dir.getLastModificationTime().toMilliseconds();
+        directories.add (info);
+
+        const DirectoryInfo* const oldInfo = oldDirectoryMap [path];
+
+        if (oldInfo != nullptr && oldInfo->modificationTime == info->modificationTime)
+        {
+            info->fontFileNames = oldInfo->fontFileNames;
+            info->subDirectoryNames = oldInfo->subDirectoryNames;
+        }
+        else
+        {
+            needsSaving = true;
+
+            DirectoryIterator iter (dir, false, "*", File::findFilesAndDirectories);
+            bool isDirectory;
+
+            while (iter.next (&isDirectory, nullptr, nullptr, nullptr, nullptr, nullptr))
+            {
+                if (isDirectory)
+                    info->subDirectoryNames.add (iter.getFile().getFileName());
+                else if (iter.getFile().hasFileExtension ("ttf;pfb;pcf"))
+                    info->fontFileNames.add (iter.getFile().getFileName());
+            }
+        }
+
+        for (int i = 0; i < info->fontFileNames.size(); ++i)
+            addFontFile (dir.getChildFile (info->fontFileNames[i]), oldFileMap, filesToScan);
+
+        for (int i = 0; i < info->subDirectoryNames.size(); ++i)
+            scanDirectory (dir.getChildFile (info->subDirectoryNames[i]),
+                           oldDirectoryMap, oldFileMap, directoriesScanned, filesToScan);
+    }
+
+    void addFontFile (const File& file, const HashMap<String, FontFile*>& oldFileMap,
+                      Array<FontFile*>& filesToScan)
+    {
+        FontFile* const fontFile = new FontFile();
+        fontFile->file = file;
+        fontFile->size = file.getSize();
+        fontFile->modificationTime = file.getLastModificationTime().toMilliseconds();
+        files.add (fontFile);
+
+        FontFile* const oldFile = oldFileMap [file.getFullPathName()];
+
+        if (oldFile != nullptr
+             && oldFile->size == fontFile->size
+             && oldFile->modificationTime == fontFile->modificationTime)
+        {
+            // (the old file's entry is about to be thrown away, so its faces can be taken)
+            fontFile->faces.swapWithArray (oldFile->faces);
+        }
+        else
+        {
+            needsSaving = true;
+            filesToScan.add (fontFile);
+        }
+    }
+
+    //==============================================================================
+    /** Opens a list of font files, using a thread per CPU if there are enough of them.
+
+        Each file's results go into its own FontFile object, so the catalogue's order
+        doesn't depend on which thread happens to get to a file first.
+    */
+    static void scanFontFiles (const Array<FontFile*>& filesToScan, const FTLibWrapper::Ptr& library)
+    {
+        Atomic<int> nextFileIndex;
+        const int numExtraThreads = jmin (SystemStats::getNumCpus(), filesToScan.size() / minFilesPerThread) - 1;
+
+        if (numExtraThreads > 0)
+        {
+            OwnedArray<FontFileScanJob> jobs;
+            ThreadPool pool (numExtraThreads);
+
+            for (int i = 0; i < numExtraThreads; ++i)
+            {
+                FontFileScanJob* const job = new FontFileScanJob (filesToScan, nextFileIndex);
+                jobs.add (job);
+                pool.addJob (job);
+            }
+
+            scanFontFiles (filesToScan, nextFileIndex, library);
+
+            for (int i = 0; i < jobs.size(); ++i)
+                pool.waitForJobToFinish (jobs.getUnchecked (i), -1);
+        }
+        else
+        {
+            scanFontFiles (filesToScan, nextFileIndex, library);
+        }
+    }
+
+    static void scanFontFiles (const Array<FontFile*>& filesToScan, Atomic<int>& nextFileIndex,
+                               const FTLibWrapper::Ptr& library)
+    {
+        for (;;)
+        {
+            const int index = (++nextFileIndex) - 1;
+
+            if (index >= filesToScan.size())
+                break;
+
+            scanFontFile (library, *filesToScan.getUnchecked (index));
+        }
+    }
+
+    /** Works through the shared list of files on a pool thread. Each job has its own
+        FreeType library, because an FT_Library mustn't be used by two threads at once.
+    */
+    class FontFileScanJob  : public ThreadPoolJob
+    {
+    public:
+        FontFileScanJob (const Array<FontFile*>& filesToScan_, Atomic<int>& nextFileIndex_)
+            : ThreadPoolJob ("Font scanner"),
+              filesToScan (filesToScan_), nextFileIndex (nextFileIndex_)
+        {
+        }
+
+        JobStatus runJob()
+        {
+            scanFontFiles (filesToScan, nextFileIndex, new FTLibWrapper());
+            return jobHasFinished;
+        }
+
+    private:
+        const Array<FontFile*>& filesToScan;
+        Atomic<int>& nextFileIndex;
+
+        JUCE_DECLARE_NON_COPYABLE (FontFileScanJob);
+    };
+
+    enum { minFilesPerThread = 8 };
+
+    //==============================================================================
+    bool load()
+    {
+        MemoryBlock data;
+
+        if (! cacheFile.loadFileAsData (data))
+            return false;
+
+        MemoryInputStream in (data, false);
+
+        if (in.readInt() != catalogueMagicNumber)
+            return false;
+
+        const int numDirectories = in.readInt();
+
+        if (! isSensibleCount (in, numDirectories))
+            return false;
+
+        for (int i = 0; i < numDirectories; ++i)
+        {
+            DirectoryInfo* const d = new DirectoryInfo();
+            directories.add (d);
+            d->path = in.readString();
+            d->modificationTime = in.readInt64();
+
+            if (! (readStringArray (in, d->fontFileNames) && readStringArray (in, d->subDirectoryNames)))
+                return false;
+        }
+
+        const int numFiles = in.readInt();
+
+        if (! isSensibleCount (in, numFiles))
+            return false;
+
+        for (int i = 0; i < numFiles; ++i)
+        {
+            FontFile* const f = new FontFile();
+            files.add (f);
+            f->file = File (in.readString());
+            f->size = in.readInt64();
+            f->modificationTime = in.readInt64();
+
+            const int numFaces = in.readInt();
+
+            if (! isSensibleCount (in, numFaces))
+                return false;
+
+            for (int j = 0; j < numFaces; ++j)
+            {
+                Face* const face = new Face();
+                f->faces.add (face);
+                face->family = in.readString();
+                face->faceIndex = in.readInt();
+
+                const int flags = in.readByte();
+                face->isBold       = (flags & 1) != 0;
+                face->isItalic     = (flags & 2) != 0;
+                face->isMonospaced = (flags & 4) != 0;
+                face->isSansSerif  = (flags & 8) != 0;
+            }
         }
 
-        if (index >= fontDirs.size())
+        return in.readInt() == catalogueMagicNumber;
+    }
+
+    static bool isSensibleCount (InputStream& in, const int count)
+    {
+        return count >= 0 && count <= in.getTotalLength() - in.getPosition();
+    }
+
+    static void writeStringArray (OutputStream& out, const StringArray& strings)
+    {
+        out.writeInt (strings.size());
+
+        for (int i = 0; i < strings.size(); ++i)
+            out.writeString (strings[i]);
+    }
+
+    static bool readStringArray (InputStream& in, StringArray& strings)
+    {
+        const int num = in.readInt();
+
+        if (! isSensibleCount (in, num))
             return false;
 
-        iter = new DirectoryIterator (fontDirs [index++], true);
-        return next();
+        for (int i = 0; i < num; ++i)
+            strings.add (in.readString());
+
+        return true;
     }
 
-    File getFile() const    { jassert (iter != nullptr); return iter->getFile(); }
+    static bool isFaceSansSerif (const String& family)
+    {
+        const char* sansNames[] = { "Sans", "Verdana", "Arial", "Ubuntu" };
 
-private:
-    StringArray fontDirs;
-    int index;
-    ScopedPointer<DirectoryIterator> iter;
+        for (int i = 0; i < numElementsInArray (sansNames); ++i)
+            if (family.containsIgnoreCase (sansNames[i]))
+                return true;
 
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LinuxFontFileIterator);
+        return false;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (FTFontCatalogue);
 };
 
 //==============================================================================
@@ -133,29 +867,16 @@ public:
     FTTypefaceList()
         : library (new FTLibWrapper())
     {
-        LinuxFontFileIterator fontFileIterator;
+        FTFontCatalogue catalogue (FTFontCatalogue::getDefaultCacheFile());
+        catalogue.scan (FTFontCatalogue::getFontDirectories(), library);
+        catalogue.saveIfNeeded();
 
-        while (fontFileIterator.next())
+        for (int i = 0; i < catalogue.getNumFiles(); ++i)
         {
-            int faceIndex = 0;
-            int numFaces = 0;
-
-            do
-            {
-                FTFaceWrapper face (library, fontFileIterator.getFile(), faceIndex);
-
-                if (face.face != 0)
-                {
-                    if (faceIndex == 0)
-                        numFaces = face.face->num_faces;
-
-                    if ((face.face->face_flags & FT_FACE_FLAG_SCALABLE) != 0)
-                        faces.add (new KnownTypeface (fontFileIterator.getFile(), faceIndex, face));
-                }
+            const FTFontCatalogue::FontFile& fontFile = catalogue.getFile (i);
 
-                ++faceIndex;
-            }
-            while (faceIndex < numFaces);
+            for (int j = 0; j < fontFile.faces.size(); ++j)
+                faces.add (new KnownTypeface (fontFile.file, *fontFile.faces.getUnchecked (j)));
         }
     }
 
@@ -167,14 +888,14 @@ public:
     //==============================================================================
     struct KnownTypeface
     {
-        KnownTypeface (const File& file_, const int faceIndex_, const FTFaceWrapper& face)
+        KnownTypeface (const File& file_, const FTFontCatalogue::Face& face)
            : file (file_),
-             family (face.face->family_name),
-             faceIndex (faceIndex_),
-             isBold   ((face.face->style_flags & FT_STYLE_FLAG_BOLD) != 0),
-             isItalic ((face.face->style_flags & FT_STYLE_FLAG_ITALIC) != 0),
-             isMonospaced ((face.face->face_flags & FT_FACE_FLAG_FIXED_WIDTH) != 0),
-             isSansSerif (isFaceSansSerif (family))
+             family (face.family),
+             faceIndex (face.faceIndex),
+             isBold (face.isBold),
+             isItalic (face.isItalic),
+             isMonospaced (face.isMonospaced),
+             isSansSerif (face.isSansSerif)
         {
         }
 
@@ -249,7 +970,7 @@ public:
                 sansSerif.addIfNotAlreadyThere (faces.getUnchecked(i)->family);
     }
 
-    juce_DeclareSingleton_SingleThreaded_Minimal (FTTypefaceList);
+    juce_DeclareSingleton (FTTypefaceList, false);
 
 private:
     FTLibWrapper::Ptr library;
@@ -270,21 +991,10 @@ private:
         return nullptr;
     }
 
-    static bool isFaceSansSerif (const String& family)
-    {
-        const char* sansNames[] = { "Sans", "Verdana", "Arial", "Ubuntu" };
-
-        for (int i = 0; i < numElementsInArray (sansNames); ++i)
-            if (family.containsIgnoreCase (sansNames[i]))
-                return true;
-
-        return false;
-    }
-
     JUCE_DECLARE_NON_COPYABLE (FTTypefaceList);
 };
 
-juce_ImplementSingleton_SingleThreaded (FTTypefaceList)
+juce_ImplementSingleton (FTTypefaceList)
 
 
 //==============================================================================
@@ -309,12 +1019,33 @@ public:
         }
     }
 
+    FTFaceWrapper* getFaceWrapper() const noexcept      { return faceWrapper; }
+
+   #if JUCE_USE_HARFBUZZ
+    /** Shaped text can contain glyphs that don't correspond to any single character, such as
+        ligatures and contextual forms. These are stored in the CustomTypeface under glyph
+        numbers that start above the highest unicode character.
+    */
+    enum { firstGlyphIndexNumber = 0x110000 };
+
+    static int getGlyphNumberForIndex (const uint32 glyphIndex) noexcept    { return (int) (firstGlyphIndexNumber + glyphIndex); }
+   #endif
+
     bool loadGlyphIfPossible (const juce_wchar character)
     {
         if (faceWrapper != nullptr)
         {
+            const ScopedLock sl (faceWrapper->lock);
             FT_Face face = faceWrapper->face;
+
+           #if JUCE_USE_HARFBUZZ
+            const bool isGlyphIndex = (uint32) character >= (uint32) firstGlyphIndexNumber;
+            const unsigned int glyphIndex = isGlyphIndex ? (unsigned int) (character - firstGlyphIndexNumber)
+                                                         : FT_Get_Char_Index (face, character);
+           #else
+            const bool isGlyphIndex = false;
             const unsigned int glyphIndex = FT_Get_Char_Index (face, character);
+           #endif
 
             if (FT_Load_Glyph (face, glyphIndex, FT_LOAD_NO_SCALE | FT_LOAD_NO_BITMAP | FT_LOAD_IGNORE_TRANSFORM) == 0
                   && face->glyph->format == ft_glyph_format_outline)
@@ -326,7 +1057,7 @@ public:
                 {
                     addGlyph (character, destShape, face->glyph->metrics.horiAdvance * scale);
 
-                    if ((face->face_flags & FT_FACE_FLAG_KERNING) != 0)
+                    if ((face->face_flags & FT_FACE_FLAG_KERNING) != 0 && ! isGlyphIndex)
                         addKerning (face, character, glyphIndex);
 
                     return true;
@@ -427,10 +1158,38 @@ private:
         return true;
     }
 
+    struct KerningPairAdder
+    {
+        KerningPairAdder (FreeTypeTypeface& owner_, const juce_wchar character_, const float height_) noexcept
+            : owner (owner_), character (character_), height (height_)
+        {}
+
+        void addKerningPair (const juce_wchar rightCharacter, const int amount)
+        {
+            if (amount != 0)
+                owner.addKerningPair (character, rightCharacter, amount / height);
+        }
+
+        FreeTypeTypeface& owner;
+        const juce_wchar character;
+        const float height;
+
+        JUCE_DECLARE_NON_COPYABLE (KerningPairAdder);
+    };
+
     void addKerning (FT_Face face, const uint32 character, const uint32 glyphIndex)
     {
         const float height = (float) (face->ascender - face->descender);
+        const FTKerningIndex& kerningIndex = faceWrapper->getKerningIndex();
+
+        if (kerningIndex.isValid())
+        {
+            KerningPairAdder adder (*this, (juce_wchar) character, height);
+            kerningIndex.findKerningPairs (glyphIndex, adder);
+            return;
+        }
 
+        // This face has kerning that isn't in a 'kern' table, so FreeType has to be asked for each pair
         uint32 rightGlyphIndex;
         uint32 rightCharCode = FT_Get_First_Char (face, &rightGlyphIndex);
 
@@ -543,7 +1302,462 @@ Typeface::Ptr Font::getDefaultTypefaceForFont (const Font& font)
     return Typeface::createSystemTypefaceFor (f);
 }
 
-bool GlyphLayout::createNativeLayout (const AttributedString&)
+//==============================================================================
+#if JUCE_USE_HARFBUZZ
+namespace HarfBuzzTypeLayout
+{
+    struct ShapedGlyph
+    {
+        int glyphCode;
+        int character;  // the first character of the cluster that this glyph belongs to
+        int runIndex;
+        float advance;
+        Point<float> offset;
+        bool isWhitespace, isNewLine;
+    };
+
+    struct ShapedRun
+    {
+        ShapedRun (const Font& font_, const Colour& colour_, const bool isRightToLeft_)
+            : font (font_), colour (colour_), isRightToLeft (isRightToLeft_)
+        {}
+
+        Font font;
+        Colour colour;
+        bool isRightToLeft;
+    };
+
+    struct HarfBuzzBuffer
+    {
+        HarfBuzzBuffer() : buffer (hb_buffer_create()) {}
+        ~HarfBuzzBuffer()  { hb_buffer_destroy (buffer); }
+
+        hb_buffer_t* const buffer;
+
+        JUCE_DECLARE_NON_COPYABLE (HarfBuzzBuffer);
+    };
+
+    FreeTypeTypeface* getFreeTypeTypeface (const Font& font)
+    {
+        FreeTypeTypeface* const typeface = dynamic_cast <FreeTypeTypeface*> (font.getTypeface());
+
+        if (typeface != nullptr && typeface->getFaceWrapper() != nullptr)
+            return typeface;
+
+        return nullptr;
+    }
+
+    bool isStrongScript (const hb_script_t script) noexcept
+    {
+        return script != HB_SCRIPT_COMMON && script != HB_SCRIPT_INHERITED && script != HB_SCRIPT_UNKNOWN;
+    }
+
+    /** Shapes a range of characters that all use the same font and script, appending the
+        results to the glyph list in logical order.
+    */
+    void shapeItem (HarfBuzzBuffer& hb, const Array<uint32>& text, const Range<int>& range,
+                    const hb_script_t script, const hb_direction_t direction,
+                    const Font& font, FTFaceWrapper& faceWrapper,
+                    const int runIndex, Array<ShapedGlyph>& glyphs)
+    {
+        const ScopedLock sl (faceWrapper.lock);
+        FT_Face face = faceWrapper.face;
+
+        hb_buffer_clear_contents (hb.buffer);
+        hb_buffer_add_utf32 (hb.buffer, text.begin(), text.size(),
+                             (unsigned int) range.getStart(), range.getLength());
+        hb_buffer_set_direction (hb.buffer, direction);
+
+        if (isStrongScript (script))
+            hb_buffer_set_script (hb.buffer, script);
+
+        hb_buffer_guess_segment_properties (hb.buffer);
+        hb_shape (faceWrapper.getHarfBuzzFont(), hb.buffer, nullptr, 0);
+
+        // HarfBuzz returns right-to-left glyphs in visual order, but lines are broken in logical order
+        if (HB_DIRECTION_IS_BACKWARD (hb_buffer_get_direction (hb.buffer)))
+            hb_buffer_reverse (hb.buffer);
+
+        unsigned int numGlyphs = 0;
+        const hb_glyph_info_t* const infos = hb_buffer_get_glyph_infos (hb.buffer, &numGlyphs);
+        const hb_glyph_position_t* const positions = hb_buffer_get_glyph_positions (hb.buffer, nullptr);
+
+        const float scale = font.getHeight() / (float) (face->ascender - face->descender);
+        const float scaleX = scale * font.getHorizontalScale();
+
+        glyphs.ensureStorageAllocated (glyphs.size() + (int) numGlyphs);
+
+        for (unsigned int i = 0; i < numGlyphs; ++i)
+        {
+            const int character = (int) infos[i].cluster;
+            const juce_wchar c = (juce_wchar) text.getUnchecked (character);
+
+            ShapedGlyph g;
+            g.character = character;
+            g.runIndex = runIndex;
+            g.advance = positions[i].x_advance * scaleX;
+            g.offset = Point<float> (positions[i].x_offset * scaleX, positions[i].y_offset * -scale);
+            g.isNewLine = (c == '\n' || c == '\r');
+            g.isWhitespace = g.isNewLine || CharacterFunctions::isWhitespace (c);
+
+            // Where a glyph simply represents its character, use the character code so that
+            // the typeface's existing glyph cache is shared with the standard layout.
+            g.glyphCode = (infos[i].codepoint == 0 || FT_Get_Char_Index (face, c) == infos[i].codepoint)
+                            ? (int) c : FreeTypeTypeface::getGlyphNumberForIndex (infos[i].codepoint);
+
+            glyphs.add (g);
+        }
+    }
+
+    class LineBuilder
+    {
+    public:
+        LineBuilder (TextLayout& layout_, const AttributedString& text_, const int textLength_,
+                     const OwnedArray<ShapedRun>& runs_, const Array<ShapedGlyph>& glyphs_)
+            : layout (layout_), text (text_), textLength (textLength_), runs (runs_), glyphs (glyphs_), y (0)
+        {}
+
+        void addLine (const int start, const int end)
+        {
+            int visibleEnd = end;
+
+            while (visibleEnd > start && glyphs.getReference (visibleEnd - 1).isWhitespace)
+                --visibleEnd;
+
+            const int lineStartChar = start < glyphs.size() ? glyphs.getReference (start).character : textLength;
+            const int lineEndChar   = end   < glyphs.size() ? glyphs.getReference (end).character   : textLength;
+
+            // Split the line into pieces that each come from a single shaped run..
+            Array<Range<int> > pieces;
+
+            for (int i = start; i < visibleEnd;)
+            {
+                const int runIndex = glyphs.getReference (i).runIndex;
+                int pieceEnd = i + 1;
+
+                while (pieceEnd < visibleEnd && glyphs.getReference (pieceEnd).runIndex == runIndex)
+                    ++pieceEnd;
+
+                pieces.add (Range<int> (i, pieceEnd));
+                i = pieceEnd;
+            }
+
+            // ..and lay those pieces out in visual order
+            if (text.getReadingDirection() == AttributedString::rightToLeft)
+                for (int i = 0; i < pieces.size() / 2; ++i)
+                    pieces.swap (i, pieces.size() - 1 - i);
+
+            TextLayout::Line* const line = new TextLayout::Line (Range<int> (lineStartChar, lineEndChar),
+                                                                 Point<float>(), 0, 0, text.getLineSpacing(),
+                                                                 pieces.size());
+            float x = 0;
+
+            for (int i = 0; i < pieces.size(); ++i)
+            {
+                const Range<int> piece (pieces.getReference (i));
+                const ShapedRun& shapedRun = *runs.getUnchecked (glyphs.getReference (piece.getStart()).runIndex);
+
+                const int pieceEndChar = piece.getEnd() < glyphs.size() ? glyphs.getReference (piece.getEnd()).character
+                                                                        : textLength;
+
+                TextLayout::Run* const run = new TextLayout::Run (Range<int> (glyphs.getReference (piece.getStart()).character,
+                                                                              pieceEndChar),
+                                                                  piece.getLength());
+                run->font = shapedRun.font;
+                run->colour = shapedRun.colour;
+
+                for (int j = 0; j < piece.getLength(); ++j)
+                {
+                    const ShapedGlyph& g = glyphs.getReference (shapedRun.isRightToLeft ? piece.getEnd() - 1 - j
+                                                                                        : piece.getStart() + j);
+
+                    run->glyphs.add (TextLayout::Glyph (g.glyphCode, Point<float> (x, 0) + g.offset, g.advance));
+                    x += g.advance;
+                }
+
+                line->ascent  = jmax (line->ascent,  run->font.getAscent());
+                line->descent = jmax (line->descent, run->font.getDescent());
+                line->runs.add (run);
+            }
+
+            if (pieces.size() == 0)
+            {
+                // An empty line still needs a height, so use the font of the run it's in
+                const Font& font = (start < glyphs.size()) ? runs.getUnchecked (glyphs.getReference (start).runIndex)->font
+                                                           : runs.getLast()->font;
+                line->ascent  = font.getAscent();
+                line->descent = font.getDescent();
+            }
+
+            line->lineOrigin = Point<float> (getJustificationOffset (x), y + line->ascent);
+            y += line->ascent + line->descent + line->leading;
+
+            layout.addLine (line);
+        }
+
+    private:
+        TextLayout& layout;
+        const AttributedString& text;
+        const int textLength;
+        const OwnedArray<ShapedRun>& runs;
+        const Array<ShapedGlyph>& glyphs;
+        float y;
+
+        float getJustificationOffset (const float lineWidth) const noexcept
+        {
+            const int flags = text.getJustification().getFlags();
+            const float spare = layout.getWidth() - lineWidth;
+
+            if ((flags & Justification::right) != 0)                return spare;
+            if ((flags & Justification::horizontallyCentred) != 0)  return spare / 2.0f;
+
+            return 0;
+        }
+
+        JUCE_DECLARE_NON_COPYABLE (LineBuilder);
+    };
+
+    /** Returns the glyph index at which a line should be broken, given that the glyph
+        at overflowIndex doesn't fit on the line that begins at lineStart.
+    */
+    int findLineBreak (const Array<ShapedGlyph>& glyphs, const int lineStart,
+                       const int overflowIndex, const int lastBreakOpportunity) noexcept
+    {
+        if (lastBreakOpportunity > lineStart)
+            return lastBreakOpportunity;
+
+        // No word boundary is available, so break between clusters instead
+        int i = overflowIndex;
+
+        while (i > lineStart + 1 && glyphs.getReference (i).character == glyphs.getReference (i - 1).character)
+            --i;
+
+        return jmax (i, lineStart + 1);
+    }
+
+    bool createLayout (TextLayout& layout, const AttributedString& text)
+    {
+        Font defaultFont;
+        Array<TextLayoutHelpers::RunAttribute> runAttributes;
+        const int textLength = text.getText().length();
+        TextLayoutHelpers::findRunAttributes (text, Range<int> (0, textLength), defaultFont, runAttributes);
+
+        // If any of the fonts can't be shaped, let the standard layout deal with the whole string
+        for (int i = 0; i < runAttributes.size(); ++i)
+            if (getFreeTypeTypeface (*runAttributes.getReference (i).fontAndColour.font) == nullptr)
+                return false;
+
+        Array<uint32> utf32;
+        utf32.ensureStorageAllocated (textLength);
+
+        for (String::CharPointerType t (text.getText().getCharPointer()); ! t.isEmpty();)
+            utf32.add ((uint32) t.getAndAdvance());
+
+        const hb_direction_t paragraphDirection = text.getReadingDirection() == AttributedString::rightToLeft
+                                                    ? HB_DIRECTION_RTL : HB_DIRECTION_LTR;
+        hb_unicode_funcs_t* const unicodeFuncs = hb_unicode_funcs_get_default();
+
+        HarfBuzzBuffer hb;
+        OwnedArray<ShapedRun> runs;
+        Array<ShapedGlyph> glyphs;
+
+        for (int i = 0; i < runAttributes.size(); ++i)
+        {
+            const TextLayoutHelpers::RunAttribute& r = runAttributes.getReference (i);
+            const Font& font = *r.fontAndColour.font;
+            FTFaceWrapper& faceWrapper = *getFreeTypeTypeface (font)->getFaceWrapper();
+
+            // Each attribute run is itemised into sections of a single script, so that
+            // mixed-direction text gets shaped in the correct direction.
+            int itemStart = r.range.getStart();
+            hb_script_t itemScript = HB_SCRIPT_COMMON;
+
+            for (int j = r.range.getStart(); j <= r.range.getEnd(); ++j)
+            {
+                const hb_script_t script = j < r.range.getEnd() ? hb_unicode_script (unicodeFuncs, utf32.getUnchecked (j))
+                                                                : HB_SCRIPT_INVALID;
+
+                if (j == r.range.getEnd() || (isStrongScript (script) && isStrongScript (itemScript) && script != itemScript))
+                {
+                    hb_direction_t direction = hb_script_get_horizontal_direction (itemScript);
+
+                    if (! isStrongScript (itemScript) || direction == HB_DIRECTION_INVALID)
+                        direction = paragraphDirection;
+
+                    runs.add (new ShapedRun (font, r.fontAndColour.colour, direction == HB_DIRECTION_RTL));
+                    shapeItem (hb, utf32, Range<int> (itemStart, j), itemScript, direction,
+                               font, faceWrapper, runs.size() - 1, glyphs);
+
+                    itemStart = j;
+                    itemScript = script;
+                }
+                else if (! isStrongScript (itemScript))
+                {
+                    itemScript = script;
+                }
+            }
+        }
+
+        LineBuilder lineBuilder (layout, text, textLength, runs, glyphs);
+
+        const bool shouldWrap = text.getWordWrap() != AttributedString::none;
+        const bool breakOnChars = text.getWordWrap() == AttributedString::byChar;
+        const float maxWidth = layout.getWidth();
+        int lineStart = 0, lastBreakOpportunity = -1;
+        float x = 0;
+
+        for (int i = 0; i < glyphs.size(); ++i)
+        {
+            const ShapedGlyph& g = glyphs.getReference (i);
+
+            if (g.isNewLine)
+            {
+                // A CR-LF pair shapes as two glyphs, but should only end one line
+                if (i + 1 < glyphs.size() && glyphs.getReference (i + 1).isNewLine
+                     && utf32.getUnchecked (g.character) == '\r' && utf32.getUnchecked (glyphs.getReference (i + 1).character) == '\n')
+                    ++i;
+
+                lineBuilder.addLine (lineStart, i + 1);
+                lineStart = i + 1;
+                lastBreakOpportunity = -1;
+                x = 0;
+                continue;
+            }
+
+            if (shouldWrap && ! g.isWhitespace && i > lineStart && x + g.advance > maxWidth)
+            {
+                const int breakIndex = findLineBreak (glyphs, lineStart, i,
+                                                      breakOnChars ? -1 : lastBreakOpportunity);
+                lineBuilder.addLine (lineStart, breakIndex);
+                lineStart = breakIndex;
+                lastBreakOpportunity = -1;
+                x = 0;
+
+                for (int j = lineStart; j < i; ++j)
+                    x += glyphs.getReference (j).advance;
+            }
+
+            x += g.advance;
+
+            if (g.isWhitespace)
+                lastBreakOpportunity = i + 1;
+        }
+
+        if (lineStart < glyphs.size())
+            lineBuilder.addLine (lineStart, glyphs.size());
+
+        return true;
+    }
+}
+#endif
+
+bool TextLayout::createNativeLayout (const AttributedString& text)
 {
+   #if JUCE_USE_HARFBUZZ
+    return HarfBuzzTypeLayout::createLayout (*this, text);
+   #else
+    (void) text;
     return false;
+   #endif
 }
+
+//==============================================================================
+#if JUCE_UNIT_TESTS && JUCE_USE_HARFBUZZ
+
+class HarfBuzzTypeLayoutTests  : public UnitTest
+{
+public:
+    HarfBuzzTypeLayoutTests() : UnitTest ("HarfBuzzTypeLayout") {}
+
+    static void getGlyphs (const String& text, const Font& font, Array<TextLayout::Glyph>& glyphs)
+    {
+        AttributedString s;
+        s.append (text, font);
+
+        TextLayout layout;
+        layout.createLayout (s, 1000.0f);
+        glyphs.clearQuick();
+
+        for (int i = 0; i < layout.getNumLines(); ++i)
+        {
+            const TextLayout::Line& line = layout.getLine (i);
+
+            for (int j = 0; j < line.runs.size(); ++j)
+                glyphs.addArray (line.runs.getUnchecked (j)->glyphs);
+        }
+    }
+
+    static int getGlyphCode (const Array<TextLayout::Glyph>& glyphs, const int index)
+    {
+        return isPositiveAndBelow (index, glyphs.size()) ? glyphs.getReference (index).glyphCode : -1;
+    }
+
+    void expectGlyphsAreAdjacent (const Array<TextLayout::Glyph>& glyphs)
+    {
+        expect (glyphs.size() > 0 && glyphs.getReference (0).anchor.getX() == 0);
+
+        for (int i = 0; i < glyphs.size(); ++i)
+        {
+            const TextLayout::Glyph& g = glyphs.getReference (i);
+            expect (g.width > 0);
+
+            if (i > 0)
+            {
+                const TextLayout::Glyph& previous = glyphs.getReference (i - 1);
+                expect (std::abs (g.anchor.getX() - (previous.anchor.getX() + previous.width)) < 0.01f);
+            }
+        }
+    }
+
+    void runTest()
+    {
+        // (DejaVu Sans has both latin ligatures and arabic joining forms)
+        const Font font ("DejaVu Sans", 20.0f, Font::plain);
+
+        if (HarfBuzzTypeLayout::getFreeTypeTypeface (font) == nullptr)
+        {
+            logMessage ("DejaVu Sans isn't installed, so the shaping tests can't be run");
+            return;
+        }
+
+        Array<TextLayout::Glyph> glyphs;
+
+        beginTest ("Ligatures");
+
+        getGlyphs ("fx", font, glyphs);
+        expectEquals (glyphs.size(), 2);
+        expectEquals (getGlyphCode (glyphs, 0), (int) 'f');
+        expectEquals (getGlyphCode (glyphs, 1), (int) 'x');
+        expectGlyphsAreAdjacent (glyphs);
+
+        getGlyphs ("fix", font, glyphs);
+        expectEquals (glyphs.size(), 2);
+        expect (getGlyphCode (glyphs, 0) >= (int) FreeTypeTypeface::firstGlyphIndexNumber);
+        expectEquals (getGlyphCode (glyphs, 1), (int) 'x');
+        expectGlyphsAreAdjacent (glyphs);
+
+        beginTest ("Arabic joining");
+
+        const String beh (String::charToString ((juce_wchar) 0x628));
+
+        getGlyphs (beh, font, glyphs);
+        expectEquals (glyphs.size(), 1);
+        expectEquals (getGlyphCode (glyphs, 0), 0x628);
+
+        // Three joined letters use their final, medial and initial forms, from left to right
+        getGlyphs (String::repeatedString (beh, 3), font, glyphs);
+        expectEquals (glyphs.size(), 3);
+
+        for (int i = 0; i < glyphs.size(); ++i)
+            expect (getGlyphCode (glyphs, i) >= (int) FreeTypeTypeface::firstGlyphIndexNumber);
+
+        expect (getGlyphCode (glyphs, 0) != getGlyphCode (glyphs, 1)
+                 && getGlyphCode (glyphs, 1) != getGlyphCode (glyphs, 2)
+                 && getGlyphCode (glyphs, 0) != getGlyphCode (glyphs, 2));
+        expectGlyphsAreAdjacent (glyphs);
+    }
+};
+
+static HarfBuzzTypeLayoutTests harfBuzzTypeLayoutUnitTests;
+
+#endif
@@ -39,6 +39,15 @@
  #define JUCE_ENABLE_REPAINT_DEBUGGING 0
 #endif
 
+/** Config: JUCE_ENABLE_REPAINT_STATISTICS
+    If this option is turned on, windows on Linux keep track of how long their repaints
+    take to paint and to upload to the X server, and how many pixels they cover, and
+    regularly write a summary of these to the debug output.
+*/
+#ifndef JUCE_ENABLE_REPAINT_STATISTICS
+ #define JUCE_ENABLE_REPAINT_STATISTICS 0
+#endif
+
 /** JUCE_USE_XINERAMA: Enables Xinerama multi-monitor support (Linux only).
     Unless you specifically want to disable this, it's best to leave this option turned on.
 */
@@ -96,7 +96,7 @@ namespace LookAndFeelHelpers
         return baseColour;
     }
 
-    TextLayout layoutTooltipText (const String& text) noexcept
+    TextLayoutCache::CachedLayout::Ptr layoutTooltipText (const String& text)
     {
         const float tooltipFontSize = 13.0f;
         const int maxToolTipWidth = 400;
@@ -105,9 +105,7 @@ namespace LookAndFeelHelpers
         s.setJustification (Justification::centred);
         s.append (text, Font (tooltipFontSize, Font::bold));
 
-        TextLayout tl;
-        tl.createLayoutWithBalancedLineLengths (s, (float) maxToolTipWidth);
-        return tl;
+        return TextLayoutCache::getLayoutWithBalancedLineLengths (s, (float) maxToolTipWidth);
     }
 }
 
@@ -1655,10 +1653,10 @@ ImageEffectFilter* LookAndFeel::getSliderEffect()
 //==============================================================================
 void LookAndFeel::getTooltipSize (const String& tipText, int& width, int& height)
 {
-    const TextLayout tl (LookAndFeelHelpers::layoutTooltipText (tipText));
+    const TextLayoutCache::CachedLayout::Ptr tl (LookAndFeelHelpers::layoutTooltipText (tipText));
 
-    width  = (int) (tl.getWidth() + 14.0f);
-    height = (int) (tl.getHeight() + 6.0f);
+    width  = (int) (tl->getLayout().getWidth() + 14.0f);
+    height = (int) (tl->getLayout().getHeight() + 6.0f);
 }
 
 void LookAndFeel::drawTooltip (Graphics& g, const String& text, int width, int height)
@@ -1670,10 +1668,10 @@ void LookAndFeel::drawTooltip (Graphics& g, const String& text, int width, int h
     g.drawRect (0, 0, width, height, 1);
    #endif
 
-    const TextLayout tl (LookAndFeelHelpers::layoutTooltipText (text));
+    const TextLayoutCache::CachedLayout::Ptr tl (LookAndFeelHelpers::layoutTooltipText (text));
 
     g.setColour (findColour (TooltipWindow::textColourId));
-    tl.draw (g, Rectangle<float> (0.0f, 0.0f, (float) width, (float) height));
+    tl->getLayout().draw (g, Rectangle<float> (0.0f, 0.0f, (float) width, (float) height));
 }
 
 //==============================================================================
@@ -591,6 +591,10 @@ public:
 
     ImageType* createType() const                       { return new NativeImageType(); }
 
+   #if JUCE_USE_XSHM
+    bool isUsingXShm() const noexcept                   { return usingXShm; }
+   #endif
+
     void blitToWindow (Window window, int dx, int dy, int dw, int dh, int sx, int sy)
     {
         ScopedXLock xlock;
@@ -736,6 +740,185 @@ namespace PixmapHelpers
     }
 }
 
+//==============================================================================
+namespace RepaintAreas
+{
+    enum
+    {
+        maxRectangles = 16,                 // the most separate areas that one frame will paint
+        maxRectanglesToSearch = 64,         // the most areas that coalesce() will compare pairwise
+        neighboursToSearch = 16,            // how far along the sorted list mergeNeighbours() looks
+        rectangleOverhead = 64 * 64         // the cost of painting and uploading an area, in pixels
+    };
+
+    int64 getArea (const Rectangle<int>& r) noexcept
+    {
+        return r.getWidth() * (int64) r.getHeight();
+    }
+
+    // The number of extra pixels that would have to be painted if two areas were merged,
+    // less the cost of painting them separately.
+    int64 getMergeCost (const Rectangle<int>& r1, const Rectangle<int>& r2) noexcept
+    {
+        return getArea (r1.getUnion (r2)) - getArea (r1) - getArea (r2)
+                 + getArea (r1.getIntersection (r2)) - rectangleOverhead;
+    }
+
+    struct TopToBottomOrder
+    {
+        static int compareElements (const Rectangle<int>& r1, const Rectangle<int>& r2) noexcept
+        {
+            return r1.getY() != r2.getY() ? r1.getY() - r2.getY()
+                                          : r1.getX() - r2.getX();
+        }
+    };
+
+    struct PossibleMerge
+    {
+        int64 cost;
+        int first, second;
+    };
+
+    struct CheapestFirstOrder
+    {
+        static int compareElements (const PossibleMerge& m1, const PossibleMerge& m2) noexcept
+        {
+            return m1.cost != m2.cost ? (m1.cost < m2.cost ? -1 : 1)
+                                      : m1.first - m2.first;
+        }
+    };
+
+    /* Cuts down a long list of areas without comparing every pair of them. The areas are
+       sorted from top to bottom, and each one is paired with whichever of the next few it's
+       cheapest to merge with. Then the cheapest of those pairs are merged, but never more than
+       a quarter of the list at once, so that an area which had no good partner nearby gets
+       another chance to find one once its neighbours have been merged.
+    */
+    void mergeNeighbours (Array<Rectangle<int> >& areas)
+    {
+        while (areas.size() > maxRectanglesToSearch)
+        {
+            TopToBottomOrder topToBottom;
+            areas.sort (topToBottom);
+
+            Array<PossibleMerge> merges;
+            merges.ensureStorageAllocated (areas.size());
+
+            for (int i = 0; i < areas.size() - 1; ++i)
+            {
+                const Rectangle<int>& r = areas.getReference (i);
+                PossibleMerge best = { getMergeCost (r, areas.getReference (i + 1)), i, i + 1 };
+
+                for (int j = i + 2; j < jmin (areas.size(), i + 1 + (int) neighboursToSearch); ++j)
+                {
+                    const int64 cost = getMergeCost (r, areas.getReference (j));
+
+                    if (cost < best.cost)
+                    {
+                        best.cost = cost;
+                        best.second = j;
+                    }
+                }
+
+                merges.add (best);
+            }
+
+            CheapestFirstOrder cheapestFirst;
+            merges.sort (cheapestFirst);
+
+            const int maxMerges = jmin (areas.size() - (int) maxRectanglesToSearch, jmax (1, areas.size() / 4));
+            HeapBlock<bool> isMerged, isRemoved;
+            isMerged.calloc ((size_t) areas.size());
+            isRemoved.calloc ((size_t) areas.size());
+            int numMerges = 0;
+
+            for (int i = 0; i < merges.size() && numMerges < maxMerges; ++i)
+            {
+                const PossibleMerge& m = merges.getReference (i);
+
+                if (! (isMerged [m.first] || isMerged [m.second]))
+                {
+                    areas.getReference (m.first) = areas.getReference (m.first).getUnion (areas.getReference (m.second));
+                    isMerged [m.first] = isMerged [m.second] = true;
+                    isRemoved [m.second] = true;
+                    ++numMerges;
+                }
+            }
+
+            Array<Rectangle<int> > remaining;
+            remaining.ensureStorageAllocated (areas.size() - numMerges);
+
+            for (int i = 0; i < areas.size(); ++i)
+                if (! isRemoved [i])
+                    remaining.add (areas.getReference (i));
+
+            areas.swapWithArray (remaining);
+        }
+    }
+
+    /* Merges the areas that need repainting into a few larger ones. Each time round, the
+       pair whose union is cheapest to paint is merged, until none can be merged for less
+       than the cost of painting them separately, and there are no more than maxRectangles.
+
+       Two areas that overlap are always merged, so that the ones that are left can go into
+       the list without RectangleList::add() splitting them up into more pieces again.
+    */
+    RectangleList coalesce (const RectangleList& region)
+    {
+        Array<Rectangle<int> > areas;
+        areas.ensureStorageAllocated (region.getNumRectangles());
+
+        for (RectangleList::Iterator i (region); i.next();)
+            areas.add (*i.getRectangle());
+
+        // (with lots of areas, comparing every pair of them below would take too long)
+        mergeNeighbours (areas);
+
+        while (areas.size() > 1)
+        {
+            int best1 = -1, best2 = -1;
+            int64 bestCost = 0;
+            bool bestOverlaps = false;
+
+            for (int i = 0; i < areas.size(); ++i)
+            {
+                for (int j = i + 1; j < areas.size(); ++j)
+                {
+                    const Rectangle<int>& r1 = areas.getReference (i);
+                    const Rectangle<int>& r2 = areas.getReference (j);
+                    const bool overlaps = r1.intersects (r2);
+                    const int64 cost = getMergeCost (r1, r2);
+
+                    if (best1 < 0 || (overlaps && ! bestOverlaps)
+                         || (overlaps == bestOverlaps && cost < bestCost))
+                    {
+                        bestCost = cost;
+                        bestOverlaps = overlaps;
+                        best1 = i;
+                        best2 = j;
+                    }
+                }
+            }
+
+            if (bestCost > 0 && ! bestOverlaps && areas.size() <= maxRectangles)
+                break;
+
+            // (the order of the areas doesn't matter here, so the last one can fill the gap)
+            areas.getReference (best1) = areas.getReference (best1).getUnion (areas.getReference (best2));
+            areas.getReference (best2) = areas.getLast();
+            areas.removeLast();
+        }
+
+        RectangleList result;
+
+        for (int i = 0; i < areas.size(); ++i)
+            result.addWithoutMerging (areas.getReference (i));
+
+        jassert (result.getNumRectangles() <= maxRectangles);
+        return result;
+    }
+}
+
 
 //==============================================================================
 class LinuxComponentPeer  : public ComponentPeer
@@ -1679,10 +1862,13 @@ private:
     public:
         LinuxRepaintManager (LinuxComponentPeer* const peer_)
             : peer (peer_),
-              lastTimeImageUsed (0)
+              recorder (Rectangle<int>()),
+              lastTimeImageUsed (0),
+              lastFrameTime (0)
         {
            #if JUCE_USE_XSHM
-            shmCompletedDrawing = true;
+            numPendingCompletions = 0;
+            lastUploadTime = 0;
 
             useARGBImagesForRendering = XSHMHelpers::isShmAvailable();
 
@@ -1704,47 +1890,71 @@ private:
         void timerCallback()
         {
            #if JUCE_USE_XSHM
-            if (! shmCompletedDrawing)
-                return;
+            if (numPendingCompletions > 0)
+            {
+                // If the server hasn't told us that the last frame has been drawn after all
+                // this time, its completion events have probably gone astray, so stop waiting.
+                if (Time::getApproximateMillisecondCounter() < lastUploadTime + completionTimeout)
+                    return;
+
+                numPendingCompletions = 0;
+            }
            #endif
+
             if (! regionsNeedingRepaint.isEmpty())
             {
                 stopTimer();
                 performAnyPendingRepaintsNow();
             }
-            else if (Time::getApproximateMillisecondCounter() > lastTimeImageUsed + 3000)
+            else
             {
-                stopTimer();
-                image = Image::null;
+                const uint32 now = Time::getApproximateMillisecondCounter();
+
+                if (now > lastTimeImageUsed + imageReleaseDelay)
+                {
+                    stopTimer();
+                    image = Image::null;
+                }
+                else
+                {
+                    startTimer ((int) (lastTimeImageUsed + imageReleaseDelay - now));
+                }
             }
         }
 
         void repaint (const Rectangle<int>& area)
         {
-            if (! isTimerRunning())
-                startTimer (repaintTimerPeriod);
-
             regionsNeedingRepaint.add (area);
+            scheduleFrame();
         }
 
         void performAnyPendingRepaintsNow()
         {
            #if JUCE_USE_XSHM
-            if (! shmCompletedDrawing)
+            if (numPendingCompletions > 0)
             {
-                startTimer (repaintTimerPeriod);
+                // notifyPaintCompleted() will start the next frame
+                if (! isTimerRunning())
+                    startTimer (completionTimeout);
+
                 return;
             }
            #endif
 
             peer->clearMaskedRegion();
 
-            RectangleList originalRepaintRegion (regionsNeedingRepaint);
+            const RectangleList repaintRegion (RepaintAreas::coalesce (regionsNeedingRepaint));
             regionsNeedingRepaint.clear();
-            const Rectangle<int> totalArea (originalRepaintRegion.getBounds());
+            const Rectangle<int> totalArea (repaintRegion.getBounds());
 
             if (! totalArea.isEmpty())
             {
+                lastFrameTime = Time::getApproximateMillisecondCounter();
+
+               #if JUCE_ENABLE_REPAINT_STATISTICS
+                const int64 paintStartTime = Time::getHighResolutionTicks();
+               #endif
+
                 if (image.isNull() || image.getWidth() < totalArea.getWidth()
                      || image.getHeight() < totalArea.getHeight())
                 {
@@ -1759,33 +1969,46 @@ private:
                                                      false, peer->depth, peer->visual));
                 }
 
-                startTimer (repaintTimerPeriod);
-
-                RectangleList adjustedList (originalRepaintRegion);
+                RectangleList adjustedList (repaintRegion);
                 adjustedList.offsetAll (-totalArea.getX(), -totalArea.getY());
 
                 if (peer->depth == 32)
                 {
-                    RectangleList::Iterator i (originalRepaintRegion);
+                    RectangleList::Iterator i (repaintRegion);
 
                     while (i.next())
                         image.clear (*i.getRectangle() - totalArea.getPosition());
                 }
 
+                if (LowLevelGraphicsSoftwareRenderer::isWorthRenderingInBands (totalArea))
+                {
+                    // the recorder re-uses the blocks that held the last frame's operations
+                    recorder.reset (-totalArea.getPosition(), adjustedList);
+                    peer->handlePaint (recorder);
+
+                    LowLevelGraphicsSoftwareRenderer::renderInBands (recorder, image, -totalArea.getPosition(), adjustedList);
+                    recorder.clear();
+                }
+                else
                 {
                     ScopedPointer<LowLevelGraphicsContext> context (peer->getComponent()->getLookAndFeel()
                                                                       .createGraphicsContext (image, -totalArea.getPosition(), adjustedList));
                     peer->handlePaint (*context);
                 }
 
+                RectangleList blitRegion (repaintRegion);
+
                 if (! peer->maskedRegion.isEmpty())
-                    originalRepaintRegion.subtract (peer->maskedRegion);
+                    blitRegion.subtract (peer->maskedRegion);
 
-                for (RectangleList::Iterator i (originalRepaintRegion); i.next();)
+               #if JUCE_ENABLE_REPAINT_STATISTICS
+                const int64 uploadStartTime = Time::getHighResolutionTicks();
+                statistics.addPaint (Time::highResolutionTicksToSeconds (uploadStartTime - paintStartTime),
+                                     repaintRegion);
+               #endif
+
+                for (RectangleList::Iterator i (blitRegion); i.next();)
                 {
-                   #if JUCE_USE_XSHM
-                    shmCompletedDrawing = false;
-                   #endif
                     const Rectangle<int>& r = *i.getRectangle();
 
                     static_cast<XBitmapImage*> (image.getPixelData())
@@ -1793,27 +2016,152 @@ private:
                                         r.getX(), r.getY(), r.getWidth(), r.getHeight(),
                                         r.getX() - totalArea.getX(), r.getY() - totalArea.getY());
                 }
+
+               #if JUCE_USE_XSHM
+                if (static_cast<XBitmapImage*> (image.getPixelData())->isUsingXShm())
+                {
+                    // Each XShmPutImage sends a completion event, and the image can't be drawn
+                    // into again until they've all arrived.
+                    numPendingCompletions = blitRegion.getNumRectangles();
+                    lastUploadTime = Time::getApproximateMillisecondCounter();
+
+                   #if JUCE_ENABLE_REPAINT_STATISTICS
+                    uploadStartTicks = uploadStartTime;
+                   #endif
+                }
+               #endif
+
+               #if JUCE_ENABLE_REPAINT_STATISTICS
+                if (! isWaitingForCompletion())
+                    statistics.addUpload (Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - uploadStartTime));
+               #endif
             }
 
             lastTimeImageUsed = Time::getApproximateMillisecondCounter();
-            startTimer (repaintTimerPeriod);
+
+            if (isWaitingForCompletion())
+                startTimer (completionTimeout);
+            else
+                startTimer (imageReleaseDelay);
         }
 
        #if JUCE_USE_XSHM
-        void notifyPaintCompleted()                 { shmCompletedDrawing = true; }
+        void notifyPaintCompleted()
+        {
+            if (numPendingCompletions > 0 && --numPendingCompletions == 0)
+            {
+               #if JUCE_ENABLE_REPAINT_STATISTICS
+                statistics.addUpload (Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - uploadStartTicks));
+               #endif
+
+                if (regionsNeedingRepaint.isEmpty())
+                    startTimer (imageReleaseDelay);
+                else
+                    scheduleFrame();
+            }
+        }
        #endif
 
     private:
-        enum { repaintTimerPeriod = 1000 / 100 };
+        enum
+        {
+            minimumFrameInterval = 1000 / 100,  // the shortest time between the starts of two frames
+            completionTimeout = 100,            // how long to wait for XShm to say that a frame has been drawn
+            imageReleaseDelay = 3000            // how long the image is kept after the last repaint
+
+        };
 
         LinuxComponentPeer* const peer;
         Image image;
-        uint32 lastTimeImageUsed;
+        LowLevelGraphicsRecorder recorder;
+        uint32 lastTimeImageUsed, lastFrameTime;
         RectangleList regionsNeedingRepaint;
 
        #if JUCE_USE_XSHM
-        bool useARGBImagesForRendering, shmCompletedDrawing;
+        bool useARGBImagesForRendering;
+        int numPendingCompletions;
+        uint32 lastUploadTime;
+       #endif
+
+        bool isWaitingForCompletion() const noexcept
+        {
+           #if JUCE_USE_XSHM
+            return numPendingCompletions > 0;
+           #else
+            return false;
+           #endif
+        }
+
+        // Starts the next frame as soon as the previous one has been drawn, as long as that's
+        // not too soon after it started.
+        void scheduleFrame()
+        {
+            if (isWaitingForCompletion())
+                return;
+
+            const int delay = jmax (1, (int) (lastFrameTime + minimumFrameInterval - Time::getApproximateMillisecondCounter()));
+
+            if (! isTimerRunning() || getTimerInterval() > delay)
+                startTimer (delay);
+        }
+
+       #if JUCE_ENABLE_REPAINT_STATISTICS
+        /* Keeps track of how long frames take to paint and upload, and regularly prints
+           out the averages and worst cases.
+        */
+        struct Statistics
+        {
+            Statistics() noexcept   { reset(); }
+
+            void reset() noexcept
+            {
+                numFrames = numUploads = 0;
+                numPixels = numRectangles = 0;
+                totalPaintTime = maxPaintTime = totalUploadTime = maxUploadTime = 0;
+            }
+
+            void addPaint (const double seconds, const RectangleList& region) noexcept
+            {
+                ++numFrames;
+                numRectangles += region.getNumRectangles();
+
+                for (RectangleList::Iterator i (region); i.next();)
+                    numPixels += RepaintAreas::getArea (*i.getRectangle());
+
+                totalPaintTime += seconds;
+                maxPaintTime = jmax (maxPaintTime, seconds);
+            }
+
+            void addUpload (const double seconds)
+            {
+                ++numUploads;
+                totalUploadTime += seconds;
+                maxUploadTime = jmax (maxUploadTime, seconds);
+
+                if (numUploads >= framesPerPrintout)
+                {
+                    Logger::outputDebugString ("Repaints: " + String (numFrames) + " frames, "
+                                                 + String (numRectangles / (double) numFrames, 1) + " areas and "
+                                                 + String ((int) (numPixels / numFrames)) + " pixels per frame, paint time "
+                                                 + String (totalPaintTime * 1000.0 / numFrames, 2) + "ms (max "
+                                                 + String (maxPaintTime * 1000.0, 2) + "ms), upload time "
+                                                 + String (totalUploadTime * 1000.0 / numUploads, 2) + "ms (max "
+                                                 + String (maxUploadTime * 1000.0, 2) + "ms)");
+                    reset();
+                }
+            }
+
+            enum { framesPerPrintout = 100 };
+
+            int numFrames, numUploads;
+            int64 numPixels, numRectangles;
+            double totalPaintTime, maxPaintTime, totalUploadTime, maxUploadTime;
+        };
+
+        Statistics statistics;
+        int64 uploadStartTicks;
        #endif
+
         JUCE_DECLARE_NON_COPYABLE (LinuxRepaintManager);
     };
 
@@ -3116,3 +3464,143 @@ const int KeyPress::playKey                 = (0xffeeff00) | Keys::extendedKeyMo
 const int KeyPress::stopKey                 = (0xffeeff01) | Keys::extendedKeyModifier;
 const int KeyPress::fastForwardKey          = (0xffeeff02) | Keys::extendedKeyModifier;
 const int KeyPress::rewindKey               = (0xffeeff03) | Keys::extendedKeyModifier;
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class RepaintAreaTests  : public UnitTest
+{
+public:
+    RepaintAreaTests() : UnitTest ("RepaintAreas") {}
+
+    /* Adds some small areas scattered around inside each of the clusters, in a random order,
+       and checks that the coalesced ones still cover them, never join two clusters together,
+       and so don't add up to more than the clusters themselves.
+    */
+    void checkClusters (const Array<Rectangle<int> >& clusters, const int areasPerCluster, Random& r)
+    {
+        Array<Rectangle<int> > areas;
+
+        for (int i = 0; i < clusters.size(); ++i)
+        {
+            const Rectangle<int>& c = clusters.getReference (i);
+
+            for (int j = 0; j < areasPerCluster; ++j)
+                areas.add (Rectangle<int> (c.getX() + r.nextInt (c.getWidth() - 8),
+                                           c.getY() + r.nextInt (c.getHeight() - 8), 8, 8));
+        }
+
+        RectangleList region;
+
+        while (areas.size() > 0)
+        {
+            const int index = r.nextInt (areas.size());
+            region.add (areas.getReference (index));
+            areas.remove (index);
+        }
+
+        const RectangleList result (RepaintAreas::coalesce (region));
+
+        expect (result.getNumRectangles() <= (int) RepaintAreas::maxRectangles);
+
+        for (RectangleList::Iterator i (region); i.next();)
+            expect (result.containsRectangle (*i.getRectangle()));
+
+        int64 totalArea = 0, clusterArea = 0;
+
+        for (RectangleList::Iterator i (result); i.next();)
+        {
+            const Rectangle<int>& area = *i.getRectangle();
+            totalArea += RepaintAreas::getArea (area);
+
+            bool isInsideOneCluster = false;
+
+            for (int j = 0; j < clusters.size(); ++j)
+                isInsideOneCluster = isInsideOneCluster || clusters.getReference (j).contains (area);
+
+            expect (isInsideOneCluster);
+        }
+
+        for (int i = 0; i < clusters.size(); ++i)
+            clusterArea += RepaintAreas::getArea (clusters.getReference (i));
+
+        expect (totalArea <= clusterArea);
+    }
+
+    void runTest()
+    {
+        Random r (0x1234);
+
+        beginTest ("A few areas");
+
+        {
+            RectangleList region;
+            region.add (Rectangle<int> (0, 0, 10, 10));
+            region.add (Rectangle<int> (1000, 1000, 10, 10));
+
+            const RectangleList result (RepaintAreas::coalesce (region));
+            expectEquals (result.getNumRectangles(), 2);
+            expect (result.getBounds() == region.getBounds());
+        }
+
+        {
+            RectangleList region;
+            region.add (Rectangle<int> (0, 0, 10, 10));
+            region.add (Rectangle<int> (12, 0, 10, 10));
+
+            const RectangleList result (RepaintAreas::coalesce (region));
+            expectEquals (result.getNumRectangles(), 1);
+            expect (result.getBounds() == Rectangle<int> (0, 0, 22, 10));
+        }
+
+        {
+            Array<Rectangle<int> > clusters;
+
+            for (int i = 0; i < 6; ++i)
+                clusters.add (Rectangle<int> (300 * i, 200 * (i % 2), 64, 64));
+
+            for (int pass = 0; pass < 20; ++pass)
+                checkClusters (clusters, 5, r);
+        }
+
+        beginTest ("More areas than can be searched pairwise");
+
+        {
+            Array<Rectangle<int> > clusters;
+
+            for (int y = 0; y < 4; ++y)
+                for (int x = 0; x < 4; ++x)
+                    clusters.add (Rectangle<int> (400 * x, 400 * y, 64, 64));
+
+            for (int pass = 0; pass < 20; ++pass)
+                checkClusters (clusters, 12, r);
+        }
+
+        {
+            // a row of clusters, whose areas are all mixed together when they're sorted from top to bottom
+            Array<Rectangle<int> > clusters;
+
+            for (int x = 0; x < 16; ++x)
+                clusters.add (Rectangle<int> (200 * x, 0, 64, 64));
+
+            for (int pass = 0; pass < 20; ++pass)
+                checkClusters (clusters, 16, r);
+        }
+
+        {
+            // lots of areas along a line should end up as one strip, not a block
+            RectangleList region;
+
+            for (int i = 0; i < 300; ++i)
+                region.add (Rectangle<int> (r.nextInt (3000), 0, 4, 4));
+
+            const RectangleList result (RepaintAreas::coalesce (region));
+            expect (result.getNumRectangles() <= (int) RepaintAreas::maxRectangles);
+            expectEquals (result.getBounds().getHeight(), 4);
+        }
+    }
+};
+
+static RepaintAreaTests repaintAreaUnitTests;
+
+#endif
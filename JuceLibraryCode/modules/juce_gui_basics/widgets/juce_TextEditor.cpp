@@ -69,14 +69,16 @@ public:
                         const Colour& colour_,
                         const juce_wchar passwordCharacter)
       : font (font_),
-        colour (colour_)
+        colour (colour_),
+        totalLength (0)
     {
         initialiseAtoms (text, passwordCharacter);
     }
 
     UniformTextSection (const UniformTextSection& other)
       : font (other.font),
-        colour (other.colour)
+        colour (other.colour),
+        totalLength (other.totalLength)
     {
         atoms.ensureStorageAllocated (other.atoms.size());
 
@@ -95,6 +97,7 @@ public:
             delete getAtom(i);
 
         atoms.clear();
+        totalLength = 0;
     }
 
     int getNumAtoms() const
@@ -111,6 +114,8 @@ public:
     {
         if (other.atoms.size() > 0)
         {
+            totalLength += other.totalLength;
+
             TextAtom* const lastAtom = atoms.getLast();
             int i = 0;
 
@@ -147,6 +152,10 @@ public:
         UniformTextSection* const section2 = new UniformTextSection (String::empty,
                                                                      font, colour,
                                                                      passwordCharacter);
+        const int splitPoint = jlimit (0, totalLength, indexToBreakAt);
+        section2->totalLength = totalLength - splitPoint;
+        totalLength = splitPoint;
+
         int index = 0;
 
         for (int i = 0; i < atoms.size(); ++i)
@@ -196,6 +205,33 @@ public:
         return section2;
     }
 
+    // moves the atoms from the given index onwards into a new section
+    UniformTextSection* splitAtAtom (const int firstAtomToMove,
+                                     const juce_wchar passwordCharacter)
+    {
+        UniformTextSection* const section2 = new UniformTextSection (String::empty,
+                                                                     font, colour,
+                                                                     passwordCharacter);
+        section2->atoms.addArray (atoms, firstAtomToMove);
+
+        for (int i = section2->atoms.size(); --i >= 0;)
+            section2->totalLength += section2->getAtom(i)->numChars;
+
+        totalLength -= section2->totalLength;
+        atoms.removeRange (firstAtomToMove, atoms.size() - firstAtomToMove);
+        return section2;
+    }
+
+    // true if this section ends part-way through a word that the other one carries on
+    bool endsInWordContinuedBy (const UniformTextSection& other) const
+    {
+        const TextAtom* const lastAtom = atoms.getLast();
+
+        return lastAtom != nullptr && other.atoms.size() > 0
+                && ! CharacterFunctions::isWhitespace (lastAtom->atomText.getLastCharacter())
+                && ! CharacterFunctions::isWhitespace (other.getAtom(0)->atomText[0]);
+    }
+
     void appendAllText (MemoryOutputStream& mo) const
     {
         for (int i = 0; i < atoms.size(); ++i)
@@ -225,14 +261,9 @@ public:
         }
     }
 
-    int getTotalLength() const
+    int getTotalLength() const noexcept
     {
-        int total = 0;
-
-        for (int i = atoms.size(); --i >= 0;)
-            total += getAtom(i)->numChars;
-
-        return total;
+        return totalLength;
     }
 
     void setFont (const Font& newFont,
@@ -256,6 +287,7 @@ public:
 
 private:
     Array <TextAtom*> atoms;
+    int totalLength;
 
     //==============================================================================
     void initialiseAtoms (const String& textToParse,
@@ -313,6 +345,7 @@ private:
             atom->numChars = (uint16) numChars;
 
             atoms.add (atom);
+            totalLength += atom->numChars;
         }
     }
 
@@ -340,7 +373,9 @@ public:
         sectionIndex (0),
         atomIndex (0),
         wordWrapWidth (wordWrapWidth_),
-        passwordCharacter (passwordCharacter_)
+        passwordCharacter (passwordCharacter_),
+        splitAtomStart (0),
+        atomIsPending (false)
     {
         jassert (wordWrapWidth_ > 0);
 
@@ -353,6 +388,71 @@ public:
         }
     }
 
+    //==============================================================================
+    /* Where an iterator was, and the size of the atom it was on, when it reached the first atom
+       of a line. This doesn't refer to any of the sections or atoms, so it stays valid when the
+       sections are split up or joined together, and it can be moved along when text before it
+       is inserted or removed.
+    */
+    struct LineStart
+    {
+        int indexInText;
+        int splitAtomStart;     // if the line starts with a piece of an atom that was too wide to fit on a
+        int pieceLength;        // line, this is where the atom begins and how much of it is on the line, else -1
+        float lineY, lineHeight, maxDescent, atomRight;
+
+        bool isLaidOutLike (const LineStart& other) const noexcept
+        {
+            return indexInText == other.indexInText
+                    && splitAtomStart == other.splitAtomStart
+                    && pieceLength == other.pieceLength
+                    && lineHeight == other.lineHeight
+                    && maxDescent == other.maxDescent
+                    && atomRight == other.atomRight;
+        }
+    };
+
+    // Creates an iterator that's on the first atom of a line, as another one was when it got there.
+    // The section given must be the one that contains the start of the line's first atom.
+    Iterator (const Array <UniformTextSection*>& sections_,
+              const float wordWrapWidth_,
+              const juce_wchar passwordCharacter_,
+              const LineStart& line,
+              const int sectionIndex_,
+              const int sectionStart)
+      : indexInText (line.indexInText),
+        lineY (line.lineY),
+        lineHeight (line.lineHeight),
+        maxDescent (line.maxDescent),
+        atomX (0),
+        atomRight (line.atomRight),
+        atom (0),
+        currentSection (sections_.getUnchecked (sectionIndex_)),
+        sections (sections_),
+        sectionIndex (sectionIndex_),
+        atomIndex (0),
+        wordWrapWidth (wordWrapWidth_),
+        passwordCharacter (passwordCharacter_),
+        splitAtomStart (jmax (0, line.splitAtomStart)),
+        atomIsPending (false)
+    {
+        const int atomStart = line.splitAtomStart >= 0 ? line.splitAtomStart : line.indexInText;
+
+        for (int index = sectionStart; index < atomStart;)
+            index += currentSection->getAtom (atomIndex++)->numChars;
+
+        atom = currentSection->getAtom (atomIndex++);
+
+        if (line.splitAtomStart >= 0)
+        {
+            tempAtom = *atom;
+            tempAtom.atomText = atom->atomText.substring (line.indexInText - line.splitAtomStart);
+            tempAtom.numChars = (uint16) line.pieceLength;
+            tempAtom.width = line.atomRight;
+            atom = &tempAtom;
+        }
+    }
+
     Iterator (const Iterator& other)
       : indexInText (other.indexInText),
         lineY (other.lineY),
@@ -360,20 +460,28 @@ public:
         maxDescent (other.maxDescent),
         atomX (other.atomX),
         atomRight (other.atomRight),
-        atom (other.atom),
+        atom (other.atom == &other.tempAtom ? &tempAtom : other.atom),
         currentSection (other.currentSection),
         sections (other.sections),
         sectionIndex (other.sectionIndex),
         atomIndex (other.atomIndex),
         wordWrapWidth (other.wordWrapWidth),
         passwordCharacter (other.passwordCharacter),
-        tempAtom (other.tempAtom)
+        tempAtom (other.tempAtom),
+        splitAtomStart (other.splitAtomStart),
+        atomIsPending (other.atomIsPending)
     {
     }
 
     //==============================================================================
     bool next()
     {
+        if (atomIsPending)
+        {
+            atomIsPending = false;
+            return true;
+        }
+
         if (atom == &tempAtom)
         {
             const int numRemaining = tempAtom.atomText.length() - tempAtom.numChars;
@@ -502,6 +610,7 @@ public:
                     tempAtom.width = 0;
                     tempAtom.numChars = 0;
                     atom = &tempAtom;
+                    splitAtomStart = indexInText;
 
                     if (atomX > 0)
                         beginNewLine();
@@ -711,6 +820,35 @@ public:
         return false;
     }
 
+    /** Makes the next call to next() stay on the current atom, so that an iterator which was
+        copied while it was on an atom can be used as if it was just about to reach it.
+    */
+    void repeatCurrentAtom() noexcept
+    {
+        jassert (atom != nullptr);
+        atomIsPending = true;
+    }
+
+    /** Returns the index of the first character of the current atom. When an atom is too wide
+        to fit on a line and has been broken up, this is the start of the whole atom, rather
+        than of the piece of it that the iterator is on.
+    */
+    int getStartOfCurrentAtom() const noexcept
+    {
+        return atom == &tempAtom ? splitAtomStart : indexInText;
+    }
+
+    /** Returns the iterator's state, when it's on the first atom of a line. */
+    LineStart getLineStart() const noexcept
+    {
+        jassert (atomX == 0);
+
+        const bool isOnPiece = (atom == &tempAtom);
+        const LineStart l = { indexInText, isOnPiece ? splitAtomStart : -1, isOnPiece ? (int) tempAtom.numChars : 0,
+                              lineY, lineHeight, maxDescent, atomRight };
+        return l;
+    }
+
     //==============================================================================
     int indexInText;
     float lineY, lineHeight, maxDescent;
@@ -724,6 +862,8 @@ private:
     const float wordWrapWidth;
     const juce_wchar passwordCharacter;
     TextAtom tempAtom;
+    int splitAtomStart;
+    bool atomIsPending;
 
     Iterator& operator= (const Iterator&);
 
@@ -749,6 +889,301 @@ private:
     JUCE_LEAK_DETECTOR (Iterator);
 };
 
+//==============================================================================
+// Remembers where each wrapped line starts, so that painting and position lookups can jump
+// straight to the lines they need rather than wrapping all the text from the top again. Lines
+// are only found as far down as they've been asked for.
+//
+// When the text is changed, the lines from just before the change are wrapped again, but the
+// ones after it are kept to one side, with their character positions moved along. As soon as
+// the re-wrapping arrives at the start of one of those lines in exactly the same state, the
+// layout from there on can't have changed, so the rest of them are moved up or down into place
+// and the wrapping stops. So an edit only costs the lines up to the next point where the old
+// and new layouts line up again, which is the next paragraph at the latest.
+class TextEditor::LineIndex
+{
+public:
+    LineIndex (const TextEditor& owner_)
+        : owner (owner_),
+          sections (owner_.sections),
+          wordWrapWidth (0),
+          passwordCharacter (0),
+          isComplete (false),
+          textHeight (0),
+          numLinesAfterEditPassed (0),
+          linesAfterEditAreComplete (false),
+          textHeightAfterEdit (0)
+    {
+    }
+
+    void invalidateAll()
+    {
+        lines.clearQuick();
+        linesAfterEdit.clearQuick();
+        frontier = nullptr;
+        isComplete = false;
+    }
+
+    // Called when the sections are split up or joined together without the text changing, or
+    // are about to be changed. The frontier points into them, so has to be made again.
+    void sectionsRearranged() noexcept
+    {
+        frontier = nullptr;
+    }
+
+    // Finishes dealing with the last change, if that's still to be done. This has to be called
+    // before the sections are split up for the next one.
+    void catchUp()
+    {
+        while (linesAfterEdit.size() > 0)
+            findNextAtom();
+    }
+
+    // Called when some text is replaced, with the sections still as they were before the change.
+    // As well as the lines containing the change, the one before it is dropped, as words may get
+    // pulled back onto it. If the change is in a word that was too wide for a line and got broken
+    // up, all of its pieces are dropped, starting from the line before the one where the word begins.
+    void textChanged (const int start, const int numCharsRemoved, const int numCharsInserted)
+    {
+        catchUp();
+        frontier = nullptr;
+
+        int firstLineToRemove = findLastLineStartingBefore (start);
+
+        if (firstLineToRemove > 0)
+            firstLineToRemove = findLastLineStartingBefore (getStartOfAtom (lines.getReference (firstLineToRemove).start) + 1);
+
+        firstLineToRemove = jmax (0, firstLineToRemove - 1);
+
+        // (the lines to keep must start with a whole atom that comes after the change)
+        const int end = start + numCharsRemoved;
+        int firstLineToKeep = jmax (firstLineToRemove, findLastLineStartingBefore (end) + 1);
+
+        while (firstLineToKeep < lines.size() && getStartOfAtom (lines.getReference (firstLineToKeep).start) < end)
+            ++firstLineToKeep;
+
+        const int delta = numCharsInserted - numCharsRemoved;
+        linesAfterEdit.clearQuick();
+        linesAfterEdit.addArray (lines, firstLineToKeep);
+
+        for (int i = linesAfterEdit.size(); --i >= 0;)
+        {
+            Iterator::LineStart& l = linesAfterEdit.getReference (i).start;
+            l.indexInText += delta;
+
+            if (l.splitAtomStart >= 0)
+                l.splitAtomStart += delta;
+        }
+
+        numLinesAfterEditPassed = 0;
+        linesAfterEditAreComplete = isComplete;
+        textHeightAfterEdit = textHeight;
+
+        lines.removeRange (firstLineToRemove, lines.size() - firstLineToRemove);
+        isComplete = false;
+    }
+
+    // Returns an iterator whose next atom will be the first one on the line at this y position.
+    Iterator getIteratorForY (const float wordWrapWidth_, const juce_wchar passwordCharacter_, const float y)
+    {
+        checkSettings (wordWrapWidth_, passwordCharacter_);
+
+        while (! isComplete && (lines.size() == 0 || lines.getReference (lines.size() - 1).start.lineY <= y))
+            findNextAtom();
+
+        int start = 0, end = lines.size();
+
+        while (end - start > 1)
+        {
+            const int middle = (start + end) / 2;
+
+            if (lines.getReference (middle).start.lineY > y)
+                end = middle;
+            else
+                start = middle;
+        }
+
+        return getIteratorForLine (start);
+    }
+
+    // Returns an iterator whose next atom will be at the start of a line that comes before this character.
+    Iterator getIteratorForIndex (const float wordWrapWidth_, const juce_wchar passwordCharacter_, const int index)
+    {
+        checkSettings (wordWrapWidth_, passwordCharacter_);
+
+        while (! isComplete && (lines.size() == 0 || lines.getReference (lines.size() - 1).start.indexInText < index))
+            findNextAtom();
+
+        return getIteratorForLine (jmax (0, findLastLineStartingBefore (index)));
+    }
+
+    void getTextSize (const float wordWrapWidth_, const juce_wchar passwordCharacter_, float& width, float& height)
+    {
+        checkSettings (wordWrapWidth_, passwordCharacter_);
+
+        while (! isComplete)
+            findNextAtom();
+
+        width = 0;
+
+        for (int i = lines.size(); --i >= 0;)
+            width = jmax (width, lines.getReference (i).right);
+
+        height = textHeight;
+    }
+
+private:
+    struct Line
+    {
+        Iterator::LineStart start;
+        float right;    // the right-hand edge of the line's last atom
+    };
+
+    const TextEditor& owner;
+    const Array <UniformTextSection*>& sections;
+    float wordWrapWidth;
+    juce_wchar passwordCharacter;
+    Array<Line> lines;
+    ScopedPointer<Iterator> frontier;
+    bool isComplete;
+    float textHeight;
+
+    // the lines that came after the last change, which are still waiting to be put back
+    Array<Line> linesAfterEdit;
+    int numLinesAfterEditPassed;
+    bool linesAfterEditAreComplete;
+    float textHeightAfterEdit;
+
+    void checkSettings (const float wordWrapWidth_, const juce_wchar passwordCharacter_)
+    {
+        if (wordWrapWidth != wordWrapWidth_ || passwordCharacter != passwordCharacter_)
+        {
+            wordWrapWidth = wordWrapWidth_;
+            passwordCharacter = passwordCharacter_;
+            invalidateAll();
+        }
+    }
+
+    static int getStartOfAtom (const Iterator::LineStart& l) noexcept
+    {
+        return l.splitAtomStart >= 0 ? l.splitAtomStart : l.indexInText;
+    }
+
+    int findLastLineStartingBefore (const int index) const noexcept
+    {
+        int start = 0, end = lines.size();
+
+        while (start < end)
+        {
+            const int middle = (start + end) / 2;
+
+            if (lines.getReference (middle).start.indexInText < index)
+                start = middle + 1;
+            else
+                end = middle;
+        }
+
+        return start - 1;
+    }
+
+    Iterator createIterator (const Iterator::LineStart& l) const
+    {
+        int sectionStart;
+        const int sectionIndex = owner.findSectionContaining (getStartOfAtom (l), sectionStart);
+
+        return Iterator (sections, wordWrapWidth, passwordCharacter, l, sectionIndex, sectionStart);
+    }
+
+    Iterator getIteratorForLine (const int lineIndex) const
+    {
+        if (! isPositiveAndBelow (lineIndex, lines.size()))
+            return Iterator (sections, wordWrapWidth, passwordCharacter);
+
+        Iterator i (createIterator (lines.getReference (lineIndex).start));
+        i.repeatCurrentAtom();
+        return i;
+    }
+
+    void findNextAtom()
+    {
+        if (frontier == nullptr)
+        {
+            if (lines.size() > 0)
+            {
+                Line& last = lines.getReference (lines.size() - 1);
+                frontier = new Iterator (createIterator (last.start));
+                last.right = frontier->atomRight;
+            }
+            else
+            {
+                frontier = new Iterator (sections, wordWrapWidth, passwordCharacter);
+            }
+        }
+
+        if (! frontier->next())
+        {
+            isComplete = true;
+            textHeight = frontier->lineY + frontier->lineHeight;
+            linesAfterEdit.clearQuick();
+            return;
+        }
+
+        if (lines.size() == 0 || frontier->lineY > lines.getReference (lines.size() - 1).start.lineY)
+        {
+            const Line line = { frontier->getLineStart(), frontier->atomRight };
+            lines.add (line);
+
+            if (linesAfterEdit.size() > 0)
+                rejoinLinesAfterEdit();
+        }
+        else
+        {
+            Line& last = lines.getReference (lines.size() - 1);
+            last.right = jmax (last.right, frontier->atomRight);
+        }
+    }
+
+    // Called when the frontier has just started a new line. If one of the lines that came after
+    // the last change started in the same place and in the same way, then the rest of them will
+    // be laid out just as they were, so they're moved into place after it.
+    void rejoinLinesAfterEdit()
+    {
+        const Iterator::LineStart& newLine = lines.getReference (lines.size() - 1).start;
+
+        while (numLinesAfterEditPassed < linesAfterEdit.size()
+                && linesAfterEdit.getReference (numLinesAfterEditPassed).start.indexInText < newLine.indexInText)
+            ++numLinesAfterEditPassed;
+
+        if (numLinesAfterEditPassed >= linesAfterEdit.size())
+        {
+            linesAfterEdit.clearQuick();
+            return;
+        }
+
+        const Line& oldLine = linesAfterEdit.getReference (numLinesAfterEditPassed);
+
+        if (oldLine.start.isLaidOutLike (newLine))
+        {
+            const float deltaY = newLine.lineY - oldLine.start.lineY;
+            lines.getReference (lines.size() - 1).right = oldLine.right;
+
+            for (int i = numLinesAfterEditPassed + 1; i < linesAfterEdit.size(); ++i)
+            {
+                Line l (linesAfterEdit.getReference (i));
+                l.start.lineY += deltaY;
+                lines.add (l);
+            }
+
+            linesAfterEdit.clearQuick();
+            frontier = nullptr;
+            isComplete = linesAfterEditAreComplete;
+            textHeight = textHeightAfterEdit + deltaY;
+        }
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (LineIndex);
+};
+
 
 //==============================================================================
 class TextEditor::InsertAction  : public UndoableAction
@@ -953,6 +1388,11 @@ namespace TextEditorDefs
 
     const int maxActionsPerTransaction = 100;
 
+    // Long runs of text in the same font and colour are kept in several sections of about this
+    // many atoms, so that inserting or removing text only needs to split and re-join the atoms
+    // near the edit rather than the whole run.
+    const int maxAtomsPerSection = 256;
+
     int getCharacterCategory (const juce_wchar character)
     {
         return CharacterFunctions::isLetterOrDigit (character)
@@ -984,11 +1424,14 @@ TextEditor::TextEditor (const String& name,
       currentFont (14.0f),
       totalNumChars (0),
       caretPosition (0),
+      numValidSectionStarts (0),
       passwordCharacter (passwordCharacter_),
       dragType (notDragging)
 {
     setOpaque (true);
 
+    lineIndex = new LineIndex (*this);
+
     addAndMakeVisible (viewport = new TextEditorViewport (*this));
     viewport->setViewedComponent (textHolder = new TextHolderComponent (*this));
     viewport->setWantsKeyboardFocus (false);
@@ -1131,6 +1574,7 @@ void TextEditor::applyFontToAllText (const Font& newFont)
     currentFont = newFont;
 
     const Colour overallColour (findColour (textColourId));
+    lineIndex->invalidateAll();
 
     for (int i = sections.size(); --i >= 0;)
     {
@@ -1336,9 +1780,7 @@ void TextEditor::repaintText (const Range<int>& range)
 
         if (wordWrapWidth > 0)
         {
-            Iterator i (sections, wordWrapWidth, passwordCharacter);
-
-            i.getCharPosition (range.getStart(), x, y, lh);
+            getCharPosition (range.getStart(), x, y, lh);
 
             const int y1 = (int) y;
             int y2;
@@ -1349,7 +1791,7 @@ void TextEditor::repaintText (const Range<int>& range)
             }
             else
             {
-                i.getCharPosition (range.getEnd(), x, y, lh);
+                getCharPosition (range.getEnd(), x, y, lh);
                 y2 = (int) (y + lh * 2.0f);
             }
 
@@ -1442,16 +1884,11 @@ void TextEditor::updateTextHolderSize()
 
     if (wordWrapWidth > 0)
     {
-        float maxWidth = 0.0f;
-
-        Iterator i (sections, wordWrapWidth, passwordCharacter);
-
-        while (i.next())
-            maxWidth = jmax (maxWidth, i.atomRight);
+        float maxWidth, textHeight;
+        lineIndex->getTextSize (wordWrapWidth, passwordCharacter, maxWidth, textHeight);
 
         const int w = leftIndent + roundToInt (maxWidth);
-        const int h = topIndent + roundToInt (jmax (i.lineY + i.lineHeight,
-                                                    currentFont.getHeight()));
+        const int h = topIndent + roundToInt (jmax (textHeight, currentFont.getHeight()));
 
         textHolder->setSize (w + 2, h + 1); // (the +2 allows a bit of space for the cursor to be at the right-hand-edge)
     }
@@ -1668,10 +2105,7 @@ void TextEditor::drawContent (Graphics& g)
         const Rectangle<int> clip (g.getClipBounds());
         Colour selectedTextColour;
 
-        Iterator i (sections, wordWrapWidth, passwordCharacter);
-
-        while (i.lineY + 200.0 < clip.getY() && i.next())
-        {}
+        Iterator i (lineIndex->getIteratorForY (wordWrapWidth, passwordCharacter, (float) clip.getY()));
 
         if (! selection.isEmpty())
         {
@@ -1713,7 +2147,7 @@ void TextEditor::drawContent (Graphics& g)
         {
             const Range<int>& underlinedSection = underlinedSections.getReference (j);
 
-            Iterator i2 (sections, wordWrapWidth, passwordCharacter);
+            Iterator i2 (lineIndex->getIteratorForY (wordWrapWidth, passwordCharacter, (float) clip.getY()));
 
             while (i2.next() && i2.lineY < clip.getBottom())
             {
@@ -2271,40 +2705,26 @@ void TextEditor::insert (const String& text,
         {
             repaintText (Range<int> (insertIndex, getTotalNumChars())); // must do this before and after changing the data, in case
                                                                         // a line gets moved due to word wrap
+            lineIndex->textChanged (insertIndex, 0, text.length());
 
-            int index = 0;
-            int nextIndex = 0;
+            const int oldNumChars = getTotalNumChars();
 
-            for (int i = 0; i < sections.size(); ++i)
+            if (insertIndex <= oldNumChars)
             {
-                nextIndex = index + sections.getUnchecked (i)->getTotalLength();
+                int sectionStart;
+                int i = findSectionContaining (insertIndex, sectionStart);
 
-                if (insertIndex == index)
-                {
-                    sections.insert (i, new UniformTextSection (text,
-                                                                font, colour,
-                                                                passwordCharacter));
-                    break;
-                }
-                else if (insertIndex > index && insertIndex < nextIndex)
-                {
-                    splitSection (i, insertIndex - index);
-                    sections.insert (i + 1, new UniformTextSection (text,
-                                                                    font, colour,
-                                                                    passwordCharacter));
-                    break;
-                }
+                if (insertIndex > sectionStart)
+                    splitSection (i++, insertIndex - sectionStart);
 
-                index = nextIndex;
-            }
+                UniformTextSection* const newSection = new UniformTextSection (text, font, colour, passwordCharacter);
+                sections.insert (i, newSection);
+                sectionsChangedFrom (i);
+                totalNumChars = oldNumChars + newSection->getTotalLength();
 
-            if (nextIndex == insertIndex)
-                sections.add (new UniformTextSection (text,
-                                                      font, colour,
-                                                      passwordCharacter));
+                coalesceSimilarSections (i - 1, i + 1);
+            }
 
-            coalesceSimilarSections();
-            totalNumChars = -1;
             valueTextNeedsUpdating = true;
 
             updateTextHolderSize();
@@ -2318,95 +2738,63 @@ void TextEditor::insert (const String& text,
 void TextEditor::reinsert (const int insertIndex,
                            const Array <UniformTextSection*>& sectionsToInsert)
 {
-    int index = 0;
-    int nextIndex = 0;
+    const int oldNumChars = getTotalNumChars();
 
-    for (int i = 0; i < sections.size(); ++i)
+    if (insertIndex <= oldNumChars)
     {
-        nextIndex = index + sections.getUnchecked (i)->getTotalLength();
+        int numCharsInserted = 0;
 
-        if (insertIndex == index)
-        {
-            for (int j = sectionsToInsert.size(); --j >= 0;)
-                sections.insert (i, new UniformTextSection (*sectionsToInsert.getUnchecked(j)));
+        for (int j = sectionsToInsert.size(); --j >= 0;)
+            numCharsInserted += sectionsToInsert.getUnchecked(j)->getTotalLength();
 
-            break;
-        }
-        else if (insertIndex > index && insertIndex < nextIndex)
-        {
-            splitSection (i, insertIndex - index);
+        lineIndex->textChanged (insertIndex, 0, numCharsInserted);
 
-            for (int j = sectionsToInsert.size(); --j >= 0;)
-                sections.insert (i + 1, new UniformTextSection (*sectionsToInsert.getUnchecked(j)));
+        int sectionStart;
+        int i = findSectionContaining (insertIndex, sectionStart);
 
-            break;
-        }
+        if (insertIndex > sectionStart)
+            splitSection (i++, insertIndex - sectionStart);
 
-        index = nextIndex;
-    }
+        for (int j = sectionsToInsert.size(); --j >= 0;)
+            sections.insert (i, new UniformTextSection (*sectionsToInsert.getUnchecked(j)));
 
-    if (nextIndex == insertIndex)
-    {
-        for (int j = 0; j < sectionsToInsert.size(); ++j)
-            sections.add (new UniformTextSection (*sectionsToInsert.getUnchecked(j)));
+        sectionsChangedFrom (i);
+        totalNumChars = oldNumChars + numCharsInserted;
+
+        coalesceSimilarSections (i - 1, i + sectionsToInsert.size());
     }
 
-    coalesceSimilarSections();
-    totalNumChars = -1;
     valueTextNeedsUpdating = true;
 }
 
-void TextEditor::remove (const Range<int>& range,
+void TextEditor::remove (const Range<int>& range_,
                          UndoManager* const um,
                          const int caretPositionToMoveTo)
 {
+    const Range<int> range (range_.getIntersectionWith (Range<int> (0, getTotalNumChars())));
+
     if (! range.isEmpty())
     {
-        int index = 0;
+        lineIndex->catchUp();
 
-        for (int i = 0; i < sections.size(); ++i)
-        {
-            const int nextIndex = index + sections.getUnchecked(i)->getTotalLength();
+        // split the sections at each end of the range, so that it covers a whole number of them..
+        int sectionStart;
+        int firstSection = findSectionContaining (range.getStart(), sectionStart);
 
-            if (range.getStart() > index && range.getStart() < nextIndex)
-            {
-                splitSection (i, range.getStart() - index);
-                --i;
-            }
-            else if (range.getEnd() > index && range.getEnd() < nextIndex)
-            {
-                splitSection (i, range.getEnd() - index);
-                --i;
-            }
-            else
-            {
-                index = nextIndex;
+        if (range.getStart() > sectionStart)
+            splitSection (firstSection++, range.getStart() - sectionStart);
 
-                if (index > range.getEnd())
-                    break;
-            }
-        }
+        int endSection = findSectionContaining (range.getEnd(), sectionStart);
 
-        index = 0;
+        if (range.getEnd() > sectionStart)
+            splitSection (endSection++, range.getEnd() - sectionStart);
 
         if (um != nullptr)
         {
             Array <UniformTextSection*> removedSections;
 
-            for (int i = 0; i < sections.size(); ++i)
-            {
-                if (range.getEnd() <= range.getStart())
-                    break;
-
-                UniformTextSection* const section = sections.getUnchecked (i);
-
-                const int nextIndex = index + section->getTotalLength();
-
-                if (range.getStart() <= index && range.getEnd() >= nextIndex)
-                    removedSections.add (new UniformTextSection (*section));
-
-                index = nextIndex;
-            }
+            for (int i = firstSection; i < endSection; ++i)
+                removedSections.add (new UniformTextSection (*sections.getUnchecked (i)));
 
             if (um->getNumActionsInCurrentTransaction() > TextEditorDefs::maxActionsPerTransaction)
                 newTransaction();
@@ -2416,34 +2804,20 @@ void TextEditor::remove (const Range<int>& range,
         }
         else
         {
-            Range<int> remainingRange (range);
+            lineIndex->textChanged (range.getStart(), range.getLength(), 0);
 
-            for (int i = 0; i < sections.size(); ++i)
+            for (int i = firstSection; i < endSection; ++i)
             {
                 UniformTextSection* const section = sections.getUnchecked (i);
-
-                const int nextIndex = index + section->getTotalLength();
-
-                if (remainingRange.getStart() <= index && remainingRange.getEnd() >= nextIndex)
-                {
-                    sections.remove(i);
-                    section->clear();
-                    delete section;
-
-                    remainingRange.setEnd (remainingRange.getEnd() - (nextIndex - index));
-                    if (remainingRange.isEmpty())
-                        break;
-
-                    --i;
-                }
-                else
-                {
-                    index = nextIndex;
-                }
+                section->clear();
+                delete section;
             }
 
-            coalesceSimilarSections();
-            totalNumChars = -1;
+            sections.removeRange (firstSection, endSection - firstSection);
+            sectionsChangedFrom (firstSection);
+            totalNumChars -= range.getLength();
+
+            coalesceSimilarSections (firstSection - 1, firstSection);
             valueTextNeedsUpdating = true;
 
             moveCaretTo (caretPositionToMoveTo, false);
@@ -2473,22 +2847,16 @@ String TextEditor::getTextInRange (const Range<int>& range) const
     MemoryOutputStream mo;
     mo.preallocate ((size_t) jmin (getTotalNumChars(), range.getLength()));
 
-    int index = 0;
+    int index;
 
-    for (int i = 0; i < sections.size(); ++i)
+    for (int i = findSectionContaining (jmax (0, range.getStart()), index); i < sections.size(); ++i)
     {
-        const UniformTextSection* const s = sections.getUnchecked (i);
-        const int nextIndex = index + s->getTotalLength();
-
-        if (range.getStart() < nextIndex)
-        {
-            if (range.getEnd() <= index)
-                break;
-
-            s->appendSubstring (mo, range - index);
-        }
+        if (range.getEnd() <= index)
+            break;
 
-        index = nextIndex;
+        const UniformTextSection* const s = sections.getUnchecked (i);
+        s->appendSubstring (mo, range - index);
+        index += s->getTotalLength();
     }
 
     return mo.toString();
@@ -2523,7 +2891,7 @@ void TextEditor::getCharPosition (const int index, float& cx, float& cy, float&
 
     if (wordWrapWidth > 0 && sections.size() > 0)
     {
-        Iterator i (sections, wordWrapWidth, passwordCharacter);
+        Iterator i (lineIndex->getIteratorForIndex (wordWrapWidth, passwordCharacter, index));
 
         i.getCharPosition (index, cx, cy, lineHeight);
     }
@@ -2540,7 +2908,7 @@ int TextEditor::indexAtPosition (const float x, const float y)
 
     if (wordWrapWidth > 0)
     {
-        Iterator i (sections, wordWrapWidth, passwordCharacter);
+        Iterator i (lineIndex->getIteratorForY (wordWrapWidth, passwordCharacter, y));
 
         while (i.next())
         {
@@ -2616,24 +2984,120 @@ void TextEditor::splitSection (const int sectionIndex,
 
     sections.insert (sectionIndex + 1,
                      sections.getUnchecked (sectionIndex)->split (charToSplitAt, passwordCharacter));
+
+    sectionsChangedFrom (sectionIndex);
+    lineIndex->sectionsRearranged();
+}
+
+void TextEditor::sectionsChangedFrom (const int sectionIndex) const noexcept
+{
+    numValidSectionStarts = jmin (numValidSectionStarts, jmax (0, sectionIndex));
+}
+
+int TextEditor::getSectionStart (const int sectionIndex) const
+{
+    jassert (isPositiveAndNotGreaterThan (sectionIndex, sections.size()));
+
+    if (sectionIndex >= numValidSectionStarts)
+    {
+        sectionStarts.resize (sections.size() + 1);
+        int index = numValidSectionStarts > 0 ? sectionStarts.getUnchecked (numValidSectionStarts - 1)
+                                                  + sections.getUnchecked (numValidSectionStarts - 1)->getTotalLength()
+                                              : 0;
+
+        for (; numValidSectionStarts <= sectionIndex; ++numValidSectionStarts)
+        {
+            sectionStarts.set (numValidSectionStarts, index);
+
+            if (numValidSectionStarts < sections.size())
+                index += sections.getUnchecked (numValidSectionStarts)->getTotalLength();
+        }
+    }
+
+    return sectionStarts.getUnchecked (sectionIndex);
+}
+
+int TextEditor::findSectionContaining (const int charIndex, int& sectionStart) const
+{
+    jassert (charIndex >= 0);
+
+    // the start positions are only worked out as far as they're needed, so first find a
+    // valid one that's beyond the index, then binary-search the ones before it..
+    int end = numValidSectionStarts;
+
+    if (end == 0 || sectionStarts.getUnchecked (end - 1) <= charIndex)
+    {
+        while (end <= sections.size())
+        {
+            if (getSectionStart (end) > charIndex)
+                break;
+
+            end = jmin (sections.size() + 1, end * 2 + 1);
+        }
+    }
+
+    int start = 0;
+
+    while (end - start > 1)
+    {
+        const int mid = (start + end) / 2;
+
+        if (getSectionStart (mid) <= charIndex)
+            start = mid;
+        else
+            end = mid;
+    }
+
+    sectionStart = getSectionStart (start);
+    return start;
 }
 
 void TextEditor::coalesceSimilarSections()
 {
-    for (int i = 0; i < sections.size() - 1; ++i)
+    coalesceSimilarSections (0, sections.size());
+}
+
+void TextEditor::coalesceSimilarSections (int firstSection, int lastSection)
+{
+    firstSection = jmax (0, firstSection);
+    lastSection = jmin (lastSection, sections.size() - 1);
+
+    sectionsChangedFrom (firstSection);
+    lineIndex->sectionsRearranged();
+
+    // (sections only get joined where the text has just been changed, and the line index has
+    // already dropped the lines around there, so it doesn't need telling about it)
+    for (int i = firstSection; i < lastSection; ++i)
     {
         UniformTextSection* const s1 = sections.getUnchecked (i);
         UniformTextSection* const s2 = sections.getUnchecked (i + 1);
 
         if (s1->font == s2->font
-             && s1->colour == s2->colour)
+             && s1->colour == s2->colour
+             && (s1->getNumAtoms() + s2->getNumAtoms() <= TextEditorDefs::maxAtomsPerSection
+                  || s1->endsInWordContinuedBy (*s2)))
         {
             s1->append (*s2, passwordCharacter);
             sections.remove (i + 1);
             delete s2;
+            --lastSection;
             --i;
         }
     }
+
+    // (the atoms inside a section always break between words, so it can be split at any of them
+    // without changing the layout)
+    for (int i = firstSection; i <= lastSection; ++i)
+    {
+        UniformTextSection* const s = sections.getUnchecked (i);
+
+        while (s->getNumAtoms() > TextEditorDefs::maxAtomsPerSection)
+        {
+            sections.insert (i + 1, s->splitAtAtom (s->getNumAtoms() - TextEditorDefs::maxAtomsPerSection,
+                                                    passwordCharacter));
+            ++lastSection;
+        }
+    }
 }
 
 void TextEditor::Listener::textEditorTextChanged (TextEditor&) {}
@@ -2641,4 +3105,174 @@ void TextEditor::Listener::textEditorReturnKeyPressed (TextEditor&) {}
 void TextEditor::Listener::textEditorEscapeKeyPressed (TextEditor&) {}
 void TextEditor::Listener::textEditorFocusLost (TextEditor&) {}
 
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class TextEditorTests  : public UnitTest
+{
+public:
+    TextEditorTests() : UnitTest ("TextEditor") {}
+
+    // Compares the caret positions and hit-testing of an editor that has been edited with
+    // those of a new editor that lays out the same text from scratch.
+    static bool layoutMatchesNewEditor (TextEditor& editor)
+    {
+        TextEditor newEditor;
+        newEditor.setMultiLine (true, true);
+        newEditor.setBounds (editor.getBounds());
+        newEditor.setText (editor.getText(), false);
+
+        for (int i = 0; i <= editor.getTotalNumChars(); ++i)
+        {
+            editor.setCaretPosition (i);
+            newEditor.setCaretPosition (i);
+
+            const Rectangle<int> caret (editor.getCaretRectangle());
+
+            if (caret != newEditor.getCaretRectangle()
+                 || editor.getTextIndexAt (caret.getX() + 1, caret.getY() + 1)
+                      != newEditor.getTextIndexAt (caret.getX() + 1, caret.getY() + 1))
+                return false;
+        }
+
+        return editor.getTextWidth() == newEditor.getTextWidth()
+                && editor.getTextHeight() == newEditor.getTextHeight();
+    }
+
+    void runTest()
+    {
+        beginTest ("Editing a word that's wider than several lines");
+
+        String longWord;
+
+        for (int i = 0; i < 40; ++i)
+            longWord << "abcdefghij";
+
+        TextEditor editor;
+        editor.setMultiLine (true, true);
+        editor.setBounds (0, 0, 150, 3000);
+        editor.setText ("Some text before " + longWord + " and some after it", false);
+        expect (layoutMatchesNewEditor (editor));
+
+        const int middleOfWord = 17 + longWord.length() / 2;
+
+        editor.setHighlightedRegion (Range<int> (middleOfWord, middleOfWord));
+        editor.insertTextAtCaret ("WWWWWWWWWW");
+        expect (layoutMatchesNewEditor (editor));
+
+        editor.setHighlightedRegion (Range<int> (middleOfWord - 25, middleOfWord + 5));
+        editor.insertTextAtCaret (String::empty);
+        expect (layoutMatchesNewEditor (editor));
+
+        editor.setHighlightedRegion (Range<int> (middleOfWord + 40, middleOfWord + 40));
+        editor.insertTextAtCaret (" ");
+        expect (layoutMatchesNewEditor (editor));
+
+        editor.setHighlightedRegion (Range<int> (middleOfWord + 40, middleOfWord + 41));
+        editor.insertTextAtCaret (String::empty);
+        expect (layoutMatchesNewEditor (editor));
+
+        beginTest ("Random edits");
+
+        Random r (1234);
+        editor.setText (String::empty, false);
+        String expected;
+
+        for (int i = 0; i < 2000; ++i)
+        {
+            const int start = r.nextInt (expected.length() + 1);
+            const int end = jmin (expected.length(), start + r.nextInt (r.nextBool() ? 3 : 300));
+            const String newText (createRandomText (r, r.nextInt (r.nextBool() ? 5 : 500)));
+
+            editor.setHighlightedRegion (Range<int> (start, end));
+            editor.insertTextAtCaret (newText);
+            expected = expected.substring (0, start) + newText + expected.substring (end);
+
+            if ((i & 63) == 0)
+            {
+                expect (editor.undo() && editor.redo());
+                expect (editor.getText() == expected);
+            }
+
+            expectEquals (editor.getTotalNumChars(), expected.length());
+            expect (editor.getTextInRange (Range<int> (start, start + newText.length() + 10))
+                     == expected.substring (start, start + newText.length() + 10));
+        }
+
+        expect (editor.getText() == expected);
+        expect (layoutMatchesNewEditor (editor));
+
+        beginTest ("Random edits to several paragraphs");
+
+        editor.setText (String::empty, false);
+        editor.setBounds (0, 0, 300, 3000);
+
+        for (int i = 0; i < 300; ++i)
+        {
+            const int start = r.nextInt (editor.getTotalNumChars() + 1);
+            const int end = jmin (editor.getTotalNumChars(), start + r.nextInt (r.nextBool() ? 3 : 100));
+
+            editor.setHighlightedRegion (Range<int> (start, end));
+            editor.insertTextAtCaret (createRandomText (r, r.nextInt (r.nextBool() ? 5 : 200), true));
+
+            if ((i & 1) == 0)
+                editor.getTextHeight();
+
+            if ((i & 15) == 0)
+            {
+                expect (layoutMatchesNewEditor (editor));
+
+                if ((i & 31) == 0)
+                    expect (editor.undo() && layoutMatchesNewEditor (editor)
+                             && editor.redo() && layoutMatchesNewEditor (editor));
+            }
+        }
+
+        expect (layoutMatchesNewEditor (editor));
+
+        beginTest ("Editing a large document");
+
+        String document;
+        while (document.length() < 400000)
+            document << createRandomText (r, 1000) << newLine;
+
+        editor.setText (document, false);
+        editor.getTextHeight();
+
+        const uint32 startTime = Time::getMillisecondCounter();
+
+        for (int i = 0; i < 300; ++i)
+        {
+            const int pos = r.nextInt (editor.getTotalNumChars());
+
+            editor.setHighlightedRegion (Range<int> (pos, pos + (i % 3 == 0 ? 1 : 0)));
+            editor.insertTextAtCaret (i % 3 == 1 ? String::empty : String ("x"));
+            editor.getTextHeight();
+        }
+
+        logMessage ("300 edits to a " + String (editor.getTotalNumChars()) + " character document: "
+                      + String (Time::getMillisecondCounter() - startTime) + "ms");
+    }
+
+private:
+    static String createRandomText (Random& r, const int numChars, const bool includeNewLines = false)
+    {
+        String s;
+
+        for (int i = 0; i < numChars; ++i)
+        {
+            if (includeNewLines && r.nextInt (40) == 0)
+                s << '\n';
+            else
+                s << (juce_wchar) (r.nextInt (6) == 0 ? ' ' : ('a' + r.nextInt (26)));
+        }
+
+        return s;
+    }
+};
+
+static TextEditorTests textEditorUnitTests;
+
+#endif
+
 END_JUCE_NAMESPACE
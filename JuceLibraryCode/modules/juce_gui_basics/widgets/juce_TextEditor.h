@@ -623,10 +623,12 @@ private:
     //==============================================================================
     class Iterator;
     class UniformTextSection;
+    class LineIndex;
     class TextHolderComponent;
     class InsertAction;
     class RemoveAction;
     friend class InsertAction;
+    friend class LineIndex;
     friend class RemoveAction;
 
     ScopedPointer <Viewport> viewport;
@@ -656,6 +658,9 @@ private:
     mutable int totalNumChars;
     int caretPosition;
     Array <UniformTextSection*> sections;
+    mutable Array<int> sectionStarts;
+    mutable int numValidSectionStarts;
+    ScopedPointer<LineIndex> lineIndex;
     String textToShowWhenEmpty;
     Colour colourForTextWhenEmpty;
     juce_wchar passwordCharacter;
@@ -673,7 +678,11 @@ private:
     Array <Range<int> > underlinedSections;
 
     void coalesceSimilarSections();
+    void coalesceSimilarSections (int firstSection, int lastSection);
     void splitSection (int sectionIndex, int charToSplitAt);
+    void sectionsChangedFrom (int sectionIndex) const noexcept;
+    int getSectionStart (int sectionIndex) const;
+    int findSectionContaining (int charIndex, int& sectionStart) const;
     void clearInternal (UndoManager* um);
     void insert (const String& text, int insertIndex, const Font& font,
                  const Colour& colour, UndoManager* um, int caretPositionToMoveTo);
@@ -28,6 +28,21 @@ public:
     //==============================================================================
     void initialise (const String& commandLine)
     {
+       #if JUCE_UNIT_TESTS
+        if (commandLine.contains ("--run-unit-tests"))
+        {
+            UnitTestRunner runner;
+            runner.runAllTests();
+
+            for (int i = 0; i < runner.getNumResults(); ++i)
+                if (runner.getResult (i)->failures > 0)
+                    setApplicationReturnValue (1);
+
+            quit();
+            return;
+        }
+       #endif
+
         // Do your application's initialisation code here..
         mainWindow = new MainAppWindow();
     }
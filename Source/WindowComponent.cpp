@@ -26,6 +26,139 @@
 
 
 //[MiscUserDefs] You can add your own user definitions and misc code here...
+/*  Keeps the elements of the sample files that have been read, so that clicking
+    through them doesn't read and parse a file again unless it has changed on disk.
+*/
+class SampleTextCache  : public DeletedAtShutdown
+{
+public:
+    SampleTextCache() : numHits (0), numMisses (0) {}
+    ~SampleTextCache()  { clearSingletonInstance(); }
+
+    /* One of the elements inside the <textarray>. Anything other than a <text> element is
+       kept as an empty entry, so that the entries are numbered in the same way as the
+       buttons' counter, which counts every element.
+    */
+    struct Entry
+    {
+        bool isText;
+        String language, text;
+    };
+
+    /* The entries of one file. This isn't changed once it has been loaded, so it can be
+       kept and used after the file has been re-read.
+    */
+    class Document  : public ReferenceCountedObject
+    {
+    public:
+        int getNumEntries() const noexcept                  { return entries.size(); }
+        const Entry& getEntry (int index) const noexcept    { return *entries.getUnchecked (index); }
+
+        /* Returns the index of the first <text> entry at or after the given one, or -1. */
+        int findText (int index) const noexcept
+        {
+            for (; index < entries.size(); ++index)
+                if (entries.getUnchecked (index)->isText)
+                    return index;
+
+            return -1;
+        }
+
+        typedef ReferenceCountedObjectPtr<Document> Ptr;
+
+    private:
+        friend class SampleTextCache;
+        int64 fileSize;
+        Time modificationTime;
+        OwnedArray<Entry> entries;
+    };
+
+    /* Returns the entries of a file, which is only read again if its size or modification
+       time have changed since last time. Returns nullptr if it isn't a textarray document.
+    */
+    Document::Ptr getDocument (const File& file)
+    {
+        const int64 fileSize = file.getSize();
+        const Time modificationTime (file.getLastModificationTime());
+        const String path (file.getFullPathName());
+
+        const ScopedLock sl (lock);
+        Document::Ptr doc (documents [path]);
+
+        if (doc != nullptr && doc->fileSize == fileSize && doc->modificationTime == modificationTime)
+        {
+            ++numHits;
+            return doc;
+        }
+
+        ++numMisses;
+        doc = load (file);
+
+        if (doc != nullptr)
+        {
+            doc->fileSize = fileSize;
+            doc->modificationTime = modificationTime;
+            documents.set (path, doc);
+        }
+        else
+        {
+            documents.remove (path);
+        }
+
+        return doc;
+    }
+
+    int getNumHits() const noexcept      { return numHits; }
+    int getNumMisses() const noexcept    { return numMisses; }
+
+    juce_DeclareSingleton (SampleTextCache, false);
+
+private:
+    HashMap<String, Document::Ptr> documents;
+    CriticalSection lock;
+    int numHits, numMisses;
+
+    static Document* load (const File& file)
+    {
+        XmlStreamReader reader (file);
+
+        if (reader.next() != XmlStreamReader::startOfElement || ! reader.hasTagName ("textarray"))
+            return nullptr;
+
+        Document* const doc = new Document();
+
+        for (;;)
+        {
+            const XmlStreamReader::TokenType token = reader.next();
+
+            if (token == XmlStreamReader::text)
+                continue;
+
+            if (token != XmlStreamReader::startOfElement)
+                break;
+
+            Entry* const e = new Entry();
+            doc->entries.add (e);
+            e->isText = reader.hasTagName ("text");
+
+            if (e->isText)
+            {
+                e->language = reader.getAttributeValue ("lang").toString();
+                e->text = reader.readAllSubText();
+            }
+            else
+            {
+                reader.skipElement();
+            }
+        }
+
+        return doc;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (SampleTextCache);
+};
+
+juce_ImplementSingleton (SampleTextCache);
 //[/MiscUserDefs]
 
 //==============================================================================
@@ -342,43 +475,37 @@ void WindowComponent::readXMLLayout(String xmlFile, Label* labelOne, Label* labe
 {
     String xmlPath = File::getSpecialLocation(File::userHomeDirectory).getFullPathName();
     xmlPath += "/Projects/JuceText/SampleText/";
-    XmlDocument myDocument (File (xmlPath + xmlFile));
-    ScopedPointer<XmlElement> xml (myDocument.getDocumentElement());
-    if (xml != nullptr && xml->hasTagName ("textarray"))
+    SampleTextCache::Document::Ptr doc (SampleTextCache::getInstance()->getDocument (File (xmlPath + xmlFile)));
+    if (doc != nullptr)
     {
-        int subCounter = 0;
-        forEachXmlChildElement (*xml, e)
+        const int index = doc->findText (counter);
+        if (index >= 0)
         {
-            if (subCounter != counter)
-            {
-                subCounter++;
-                continue;
-            }
-            if (e->hasTagName ("text"))
-            {
-                ScopedPointer<AttributedString> as1;
-                as1 = new AttributedString(e->getAllSubText());
-                // Test Colored Text
-                //as1->setForegroundColour(3, 5, Colours::blue);
-                // Test Single Font
-                Font lucidiaGrande("Lucidia Grande", 13.0f, 0);
-                Range<int> textRange(0, e->getAllSubText().length());
-                as1->setFont(textRange, lucidiaGrande);
-                // Test Multiple Fonts
-                /*Font lucidiaGrande("Lucidia Grande", 13.0f, 0);
-                as1->setFont(0, 5, lucidiaGrande);
-                Font times("Times", 13.0f, 0);
-                as1->setFont(6, e->getAllSubText().length(), times);*/
-                // Test Paragraph Alignment
-                //as1->setTextAlignment(AttributedString::center);
-                labelOne->setText (e->getAllSubText(), false);
-                labelTwo->setText (e->getAllSubText(), false);
-                AlertWindow::showMessageBox(AlertWindow::NoIcon, "Title", e->getAllSubText());
-                counter++;
-                break;
-            }
+            const String text (doc->getEntry (index).text);
+            ScopedPointer<AttributedString> as1;
+            as1 = new AttributedString(text);
+            // Test Colored Text
+            //as1->setForegroundColour(3, 5, Colours::blue);
+            // Test Single Font
+            Font lucidiaGrande("Lucidia Grande", 13.0f, 0);
+            Range<int> textRange(0, text.length());
+            as1->setFont(textRange, lucidiaGrande);
+            // Test Multiple Fonts
+            /*Font lucidiaGrande("Lucidia Grande", 13.0f, 0);
+            as1->setFont(0, 5, lucidiaGrande);
+            Font times("Times", 13.0f, 0);
+            as1->setFont(6, text.length(), times);*/
+            // Test Paragraph Alignment
+            //as1->setTextAlignment(AttributedString::center);
+            labelOne->setText (text, false);
+            labelTwo->setText (text, false);
+            AlertWindow::showMessageBox(AlertWindow::NoIcon, "Title", text);
+            counter++;
+        }
+        else
+        {
+            counter = 0;
         }
-        if (subCounter == counter) counter = 0;
     }
 }
 
@@ -386,43 +513,35 @@ void WindowComponent::readXMLFrame(String xmlFile, Label* labelOne, Label* label
 {
     String xmlPath = File::getSpecialLocation(File::userHomeDirectory).getFullPathName();
     xmlPath += "/Projects/JulesText/SampleText/";
-    XmlDocument myDocument (File (xmlPath + xmlFile));
-    ScopedPointer<XmlElement> xml (myDocument.getDocumentElement());
-    if (xml != nullptr && xml->hasTagName ("textarray"))
+    SampleTextCache::Document::Ptr doc (SampleTextCache::getInstance()->getDocument (File (xmlPath + xmlFile)));
+    if (doc != nullptr)
     {
-        int subCounter = 0;
-        forEachXmlChildElement (*xml, e)
+        // an odd counter (left by the "one" and "two" buttons) shows the first entry
+        const int index = doc->findText ((counter % 2 == 0) ? counter : 0);
+        if (index >= 0)
         {
-            if (counter % 2 == 0 && subCounter != counter)
-            {
-                subCounter++;
-                continue;
-            }
-            if (e->hasTagName ("text"))
-            {
-                ScopedPointer<AttributedString> as1;
-                as1 = new AttributedString(e->getAllSubText());
-                Range<int> textRange1(100, 200);
-                as1->setColour(textRange1, Colours::blue);
-                //Font times("Times", 14.0f, 0);
-                Font times("Times New Roman", 14.0f, 0);
-                Range<int> textRange2(0, 301);
-                as1->setFont(textRange2, times);
-                //Font lucidiaGrande("Lucidia Grande", 15.0f, 0);
-                Font lucidiaGrande("Verdana", 15.0f, 0);
-                Range<int> textRange3(301, e->getAllSubText().length());
-                as1->setFont(textRange3, lucidiaGrande);
-                as1->setJustification(Justification::right);
-                //as1->setReadingDirection(AttributedString::rightToLeft);
-                if ((counter > 13) && (counter < 19)) as1->setReadingDirection(AttributedString::rightToLeft);
-                labelOne->setText (e->getAllSubText(), false);
-                labelTwo->setText (e->getAllSubText(), false);
-                AlertWindow::showMessageBox(AlertWindow::InfoIcon, "Title", e->getAllSubText());
-                counter += 2;
-                break;
-            }
+            const String text (doc->getEntry (index).text);
+            ScopedPointer<AttributedString> as1;
+            as1 = new AttributedString(text);
+            Range<int> textRange1(100, 200);
+            as1->setColour(textRange1, Colours::blue);
+            //Font times("Times", 14.0f, 0);
+            Font times("Times New Roman", 14.0f, 0);
+            Range<int> textRange2(0, 301);
+            as1->setFont(textRange2, times);
+            //Font lucidiaGrande("Lucidia Grande", 15.0f, 0);
+            Font lucidiaGrande("Verdana", 15.0f, 0);
+            Range<int> textRange3(301, text.length());
+            as1->setFont(textRange3, lucidiaGrande);
+            as1->setJustification(Justification::right);
+            //as1->setReadingDirection(AttributedString::rightToLeft);
+            if ((counter > 13) && (counter < 19)) as1->setReadingDirection(AttributedString::rightToLeft);
+            labelOne->setText (text, false);
+            labelTwo->setText (text, false);
+            AlertWindow::showMessageBox(AlertWindow::InfoIcon, "Title", text);
+            counter += 2;
         }
-        if (subCounter == counter)
+        else
         {
             counter = 0;
         }